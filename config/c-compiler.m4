@@ -622,6 +622,34 @@ undefine([Ac_cachevar])dnl
 ])# PGAC_SSE42_CRC32_INTRINSICS
 
 
+# PGAC_AVX2_INTRINSICS
+# --------------------
+# Check if the compiler supports the x86 AVX2 instructions, using the
+# _mm256_cmpgt_epi64 and _mm256_movemask_epi8 intrinsic functions.
+#
+# An optional compiler flag can be passed as argument (e.g. -mavx2). If the
+# intrinsics are supported, sets pgac_avx2_intrinsics, and CFLAGS_AVX2.
+AC_DEFUN([PGAC_AVX2_INTRINSICS],
+[define([Ac_cachevar], [AS_TR_SH([pgac_cv_avx2_intrinsics_$1])])dnl
+AC_CACHE_CHECK([for _mm256_cmpgt_epi64 and _mm256_movemask_epi8 with CFLAGS=$1], [Ac_cachevar],
+[pgac_save_CFLAGS=$CFLAGS
+CFLAGS="$pgac_save_CFLAGS $1"
+AC_LINK_IFELSE([AC_LANG_PROGRAM([#include <immintrin.h>],
+  [__m256i a = _mm256_set1_epi64x(1);
+   __m256i b = _mm256_cmpgt_epi64(a, _mm256_setzero_si256());
+   /* return computed value, to prevent the above being optimized away */
+   return _mm256_movemask_epi8(b) == 0;])],
+  [Ac_cachevar=yes],
+  [Ac_cachevar=no])
+CFLAGS="$pgac_save_CFLAGS"])
+if test x"$Ac_cachevar" = x"yes"; then
+  CFLAGS_AVX2="$1"
+  pgac_avx2_intrinsics=yes
+fi
+undefine([Ac_cachevar])dnl
+])# PGAC_AVX2_INTRINSICS
+
+
 # PGAC_ARMV8_CRC32C_INTRINSICS
 # ----------------------------
 # Check if the compiler supports the CRC32C instructions using the __crc32cb,
@@ -967,12 +967,12 @@ fail:
  * EOF to the end of the splitpoint; this keeps smgr's idea of the EOF in
  * sync with ours, so that we don't get complaints from smgr.
  *
- * We do this by writing a page of zeroes at the end of the splitpoint range.
- * We expect that the filesystem will ensure that the intervening pages read
- * as zeroes too.  On many filesystems this "hole" will not be allocated
- * immediately, which means that the index file may end up more fragmented
- * than if we forced it all to be allocated now; but since we don't scan
- * hash indexes sequentially anyway, that probably doesn't matter.
+ * We do this by zero-extending the file up to the last page of the
+ * splitpoint range and then writing that page.  Zero-extending allocates the
+ * space for the intervening pages without writing them out where the
+ * filesystem supports that, so that the index file doesn't end up with a
+ * hole that has to be allocated page by page later, and so that we find out
+ * now if we're out of disk space.
  *
  * XXX It's annoying that this code is executed with the metapage lock held.
  * We need to interlock against _hash_addovflpage() adding a new overflow page
@@ -1025,6 +1025,9 @@ _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
 					true);
 
 	RelationOpenSmgr(rel);
+	if (nblocks > 1)
+		smgrzeroextend(rel->rd_smgr, MAIN_FORKNUM, firstblock, nblocks - 1,
+					   false);
 	PageSetChecksumInplace(page, lastblock);
 	smgrextend(rel->rd_smgr, MAIN_FORKNUM, lastblock, zerobuf.data, false);
 
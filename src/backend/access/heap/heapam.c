@@ -71,6 +71,10 @@
 #include "utils/spccache.h"
 
 
+static void heap_scan_stream_start(HeapScanDesc scan);
+static BlockNumber heap_scan_stream_next(ReadStream *stream,
+										 void *callback_private_data,
+										 void *per_block_data);
 static HeapTuple heap_prepare_insert(Relation relation, HeapTuple tup,
 									 TransactionId xid, CommandId cid, int options);
 static XLogRecPtr log_heap_update(Relation reln, Buffer oldbuf,
@@ -303,6 +307,11 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
 
+	/* drop any pages the read stream had read ahead for the previous scan */
+	scan->rs_stream_active = false;
+	if (scan->rs_read_stream != NULL)
+		ReadStreamReset(scan->rs_read_stream);
+
 	/* page-at-a-time fields are always invalid when not rs_inited */
 
 	/*
@@ -342,6 +351,56 @@ heap_setscanlimits(TableScanDesc sscan, BlockNumber startBlk, BlockNumber numBlk
 	scan->rs_numblocks = numBlks;
 }
 
+/*
+ * heap_scan_stream_start - point the read stream at the start of a scan
+ *
+ * Called when a serial forward scan reads its first page.  From then on,
+ * heapgetpage() consumes one block of the stream for every page it reads, as
+ * long as the pages requested agree with what heap_scan_stream_next predicted.
+ */
+static void
+heap_scan_stream_start(HeapScanDesc scan)
+{
+	if (scan->rs_read_stream == NULL)
+		return;
+
+	ReadStreamReset(scan->rs_read_stream);
+	ReadStreamSetAccessStrategy(scan->rs_read_stream, scan->rs_strategy);
+	scan->rs_prefetch_block = scan->rs_startblock;
+	scan->rs_prefetch_remaining = scan->rs_numblocks;
+	scan->rs_stream_active = true;
+}
+
+/*
+ * heap_scan_stream_next - read stream callback for serial forward scans
+ *
+ * Produces the pages of the scan in the order heapgettup() and
+ * heapgettup_pagemode() visit them going forward: from rs_startblock to the
+ * end of the relation, then wrapping around, stopping when we get back to
+ * rs_startblock or when rs_numblocks pages have been visited.
+ */
+static BlockNumber
+heap_scan_stream_next(ReadStream *stream,
+					  void *callback_private_data,
+					  void *per_block_data)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private_data;
+	BlockNumber page = scan->rs_prefetch_block;
+
+	if (!BlockNumberIsValid(page))
+		return InvalidBlockNumber;
+
+	scan->rs_prefetch_block++;
+	if (scan->rs_prefetch_block >= scan->rs_nblocks)
+		scan->rs_prefetch_block = 0;
+	if (scan->rs_prefetch_block == scan->rs_startblock ||
+		(scan->rs_prefetch_remaining != InvalidBlockNumber ?
+		 --scan->rs_prefetch_remaining == 0 : false))
+		scan->rs_prefetch_block = InvalidBlockNumber;
+
+	return page;
+}
+
 /*
  * heapgetpage - subroutine for heapgettup()
  *
@@ -378,9 +437,32 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	/*
+	 * Take the page from the read stream, if it's following this scan.  The
+	 * stream reads runs of consecutive pages with a single I/O call and
+	 * issues read-ahead advice for pages further on.  If the page isn't the
+	 * one it expected, e.g. because the scan changed direction, we stop
+	 * using the stream until the scan is restarted.
+	 */
+	if (scan->rs_stream_active)
+	{
+		scan->rs_cbuf = ReadStreamNextBuffer(scan->rs_read_stream, NULL);
+		if (!BufferIsValid(scan->rs_cbuf) ||
+			BufferGetBlockNumber(scan->rs_cbuf) != page)
+		{
+			if (BufferIsValid(scan->rs_cbuf))
+				ReleaseBuffer(scan->rs_cbuf);
+			scan->rs_cbuf = InvalidBuffer;
+			ReadStreamReset(scan->rs_read_stream);
+			scan->rs_stream_active = false;
+		}
+	}
+
+	/* otherwise, read page using selected strategy */
+	if (!BufferIsValid(scan->rs_cbuf))
+		scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM,
+										   page, RBM_NORMAL,
+										   scan->rs_strategy);
 	scan->rs_cblock = page;
 
 	if (!(scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE))
@@ -539,7 +621,10 @@ heapgettup(HeapScanDesc scan,
 				}
 			}
 			else
+			{
 				page = scan->rs_startblock; /* first page */
+				heap_scan_stream_start(scan);
+			}
 			heapgetpage((TableScanDesc) scan, page);
 			lineoff = FirstOffsetNumber;	/* first offnum */
 			scan->rs_inited = true;
@@ -857,7 +942,10 @@ heapgettup_pagemode(HeapScanDesc scan,
 				}
 			}
 			else
+			{
 				page = scan->rs_startblock; /* first page */
+				heap_scan_stream_start(scan);
+			}
 			heapgetpage((TableScanDesc) scan, page);
 			lineindex = 0;
 			scan->rs_inited = true;
@@ -1168,6 +1256,22 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 		palloc(sizeof(ParallelBlockTableScanWorkerData));
 	scan->rs_strategy = NULL;	/* set in initscan */
 
+	/*
+	 * Serial sequential scans read ahead of themselves through a read stream,
+	 * rather than relying on the kernel to detect the sequential access
+	 * pattern.  Parallel scans don't know which pages they'll be assigned
+	 * next, so they can't.  Catalog scans are numerous and short, and would
+	 * mostly pay for the extra buffer lookups without any benefit.
+	 */
+	if ((flags & SO_TYPE_SEQSCAN) && parallel_scan == NULL &&
+		!IsCatalogRelation(relation))
+		scan->rs_read_stream =
+			ReadStreamBegin(relation, MAIN_FORKNUM, NULL,
+							get_tablespace_io_concurrency(relation->rd_rel->reltablespace),
+							heap_scan_stream_next, scan, 0);
+	else
+		scan->rs_read_stream = NULL;
+
 	/*
 	 * Disable page-at-a-time mode if it's not a MVCC-safe snapshot.
 	 */
@@ -1276,6 +1380,9 @@ heap_endscan(TableScanDesc sscan)
 	if (scan->rs_strategy != NULL)
 		FreeAccessStrategy(scan->rs_strategy);
 
+	if (scan->rs_read_stream != NULL)
+		ReadStreamEnd(scan->rs_read_stream);
+
 	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
 		UnregisterSnapshot(scan->rs_base.rs_snapshot);
 
@@ -1810,6 +1917,7 @@ GetBulkInsertState(void)
 	bistate = (BulkInsertState) palloc(sizeof(BulkInsertStateData));
 	bistate->strategy = GetAccessStrategy(BAS_BULKWRITE);
 	bistate->current_buf = InvalidBuffer;
+	bistate->already_extended_by = 0;
 	return bistate;
 }
 
@@ -2047,9 +2155,10 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
 	 * To allow parallel inserts, we need to ensure that they are safe to be
 	 * performed in workers. We have the infrastructure to allow parallel
 	 * inserts in general except for the cases where inserts generate a new
-	 * CommandId (eg. inserts into a table having a foreign key column).
+	 * CommandId (eg. inserts into a table having a foreign key column), so
+	 * we rely on the caller to tell us when it has excluded those cases.
 	 */
-	if (IsParallelWorker())
+	if (IsParallelWorker() && !(options & HEAP_INSERT_PARALLEL))
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
 				 errmsg("cannot insert tuples in a parallel worker")));
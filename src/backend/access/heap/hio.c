@@ -24,6 +24,9 @@
 #include "storage/lmgr.h"
 #include "storage/smgr.h"
 
+/* upper limit on the number of blocks added by RelationAddExtraBlocks */
+#define MAX_EXTRA_BLOCKS	512
+
 
 /*
  * RelationPutHeapTuple - place tuple at specified page
@@ -191,76 +194,56 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
  * Extend a relation by multiple blocks to avoid future contention on the
  * relation extension lock.  Our goal is to pre-extend the relation by an
  * amount which ramps up as the degree of contention ramps up, but limiting
- * the result to some sane overall value.
+ * the result to some sane overall value.  Bulk inserts also ramp up the
+ * amount as they add more data, even without contention, since adding many
+ * blocks at once is much cheaper than adding them one at a time.
  */
 static void
 RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 {
-	BlockNumber blockNum,
-				firstBlock = InvalidBlockNumber;
+	BlockNumber firstBlock;
 	int			extraBlocks;
 	int			lockWaiters;
+	Size		freespace;
 
 	/* Use the length of the lock wait queue to judge how much to extend. */
 	lockWaiters = RelationExtensionLockWaiterCount(relation);
-	if (lockWaiters <= 0)
-		return;
 
 	/*
 	 * It might seem like multiplying the number of lock waiters by as much as
 	 * 20 is too aggressive, but benchmarking revealed that smaller numbers
-	 * were insufficient.  512 is just an arbitrary cap to prevent
-	 * pathological results.
+	 * were insufficient.  A bulk insert extends by as much as it has added
+	 * so far, doubling the size of the relation's tail each time.
+	 * MAX_EXTRA_BLOCKS is just an arbitrary cap to prevent pathological
+	 * results.
 	 */
-	extraBlocks = Min(512, lockWaiters * 20);
-
-	do
-	{
-		Buffer		buffer;
-		Page		page;
-		Size		freespace;
-
-		/*
-		 * Extend by one page.  This should generally match the main-line
-		 * extension code in RelationGetBufferForTuple, except that we hold
-		 * the relation extension lock throughout, and we don't immediately
-		 * initialize the page (see below).
-		 */
-		buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
-		page = BufferGetPage(buffer);
-
-		if (!PageIsNew(page))
-			elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
-				 BufferGetBlockNumber(buffer),
-				 RelationGetRelationName(relation));
-
-		/*
-		 * Add the page to the FSM without initializing. If we were to
-		 * initialize here, the page would potentially get flushed out to disk
-		 * before we add any useful content. There's no guarantee that that'd
-		 * happen before a potential crash, so we need to deal with
-		 * uninitialized pages anyway, thus avoid the potential for
-		 * unnecessary writes.
-		 */
-
-		/* we'll need this info below */
-		blockNum = BufferGetBlockNumber(buffer);
-		freespace = BufferGetPageSize(buffer) - SizeOfPageHeaderData;
-
-		UnlockReleaseBuffer(buffer);
+	extraBlocks = Min(MAX_EXTRA_BLOCKS, lockWaiters * 20);
+	if (bistate != NULL)
+		extraBlocks = Max(extraBlocks,
+						  Min(MAX_EXTRA_BLOCKS, bistate->already_extended_by));
+	if (extraBlocks <= 0)
+		return;
 
-		/* Remember first block number thus added. */
-		if (firstBlock == InvalidBlockNumber)
-			firstBlock = blockNum;
+	/*
+	 * Extend by all the pages at once.  The new pages are not initialized,
+	 * nor even read into shared buffers.  If we were to initialize them
+	 * here, they would potentially get flushed out to disk before we add any
+	 * useful content.  There's no guarantee that that'd happen before a
+	 * potential crash, so we need to deal with uninitialized pages anyway,
+	 * thus avoid the potential for unnecessary writes.
+	 */
+	firstBlock = ExtendRelationBy(relation, MAIN_FORKNUM, extraBlocks);
+	if (bistate != NULL)
+		bistate->already_extended_by += extraBlocks;
 
-		/*
-		 * Immediately update the bottom level of the FSM.  This has a good
-		 * chance of making this page visible to other concurrently inserting
-		 * backends, and we want that to happen without delay.
-		 */
-		RecordPageWithFreeSpace(relation, blockNum, freespace);
-	}
-	while (--extraBlocks > 0);
+	/*
+	 * Immediately update the bottom level of the FSM.  This has a good chance
+	 * of making these pages visible to other concurrently inserting backends,
+	 * and we want that to happen without delay.
+	 */
+	freespace = BLCKSZ - SizeOfPageHeaderData;
+	for (int i = 0; i < extraBlocks; i++)
+		RecordPageWithFreeSpace(relation, firstBlock + i, freespace);
 
 	/*
 	 * Updating the upper levels of the free space map is too expensive to do
@@ -268,7 +251,7 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 * subsequent insertion activity sees all of those nifty free pages we
 	 * just inserted.
 	 */
-	FreeSpaceMapVacuumRange(relation, firstBlock, blockNum + 1);
+	FreeSpaceMapVacuumRange(relation, firstBlock, firstBlock + extraBlocks);
 }
 
 /*
@@ -591,18 +574,22 @@ loop:
 			/* Time to bulk-extend. */
 			RelationAddExtraBlocks(relation, bistate);
 		}
+		else if (bistate != NULL)
+		{
+			/* Bulk inserts extend in growing batches regardless. */
+			RelationAddExtraBlocks(relation, bistate);
+		}
 	}
 
 	/*
 	 * In addition to whatever extension we performed above, we always add at
-	 * least one block to satisfy our own request.
-	 *
-	 * XXX This does an lseek - rather expensive - but at the moment it is the
-	 * only way to accurately determine how many blocks are in a relation.  Is
-	 * it worth keeping an accurate file length in shared memory someplace,
-	 * rather than relying on the kernel to do it for us?
+	 * least one block to satisfy our own request.  The relation's length is
+	 * usually found in the shared relation size cache, so this doesn't need
+	 * to ask the kernel.
 	 */
 	buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
+	if (bistate != NULL)
+		bistate->already_extended_by++;
 
 	/*
 	 * We need to initialize the empty new page.  Double-check that it really
@@ -78,6 +78,7 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
+#include "utils/spccache.h"
 #include "utils/timestamp.h"
 
 
@@ -321,6 +322,29 @@ typedef struct LVRelStats
 	VacErrPhase phase;
 } LVRelStats;
 
+/*
+ * State of the read stream that lazy_scan_heap uses to visit the heap.  The
+ * stream's callback, lazy_scan_stream_next, decides which blocks can be
+ * skipped according to the visibility map, so that only the blocks that will
+ * actually be read are handed to the stream and read ahead.
+ */
+typedef struct LVScanStreamState
+{
+	Relation	onerel;
+	LVRelStats *vacrelstats;
+	BlockNumber nblocks;
+	bool		aggressive;
+	bool		disable_page_skipping;
+	BlockNumber next_block;		/* next block to consider */
+	BlockNumber next_unskippable_block;
+	bool		skipping_blocks;
+	Buffer		vmbuffer;		/* VM page pinned by the callback, if any */
+} LVScanStreamState;
+
+/* Flags passed to lazy_scan_heap for each block, as per-block stream data */
+#define LVSCAN_ALL_VISIBLE_VM	0x01	/* all-visible according to VM */
+#define LVSCAN_SKIPPABLE		0x02	/* skip unless FORCE_CHECK_PAGE() */
+
 /* Struct for saving and restoring vacuum error information. */
 typedef struct LVSavedErrInfo
 {
@@ -343,6 +367,11 @@ static BufferAccessStrategy vac_strategy;
 static void lazy_scan_heap(Relation onerel, VacuumParams *params,
 						   LVRelStats *vacrelstats, Relation *Irel, int nindexes,
 						   bool aggressive);
+static BlockNumber lazy_scan_stream_next(ReadStream *stream,
+										 void *callback_private_data,
+										 void *per_block_data);
+static void lazy_scan_find_unskippable(LVScanStreamState *sstate,
+									   BlockNumber blkno);
 static void lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats);
 static bool lazy_check_needs_freeze(Buffer buf, bool *hastup,
 									LVRelStats *vacrelstats);
@@ -772,8 +801,9 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	int			i;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
-	BlockNumber next_unskippable_block;
-	bool		skipping_blocks;
+	LVScanStreamState sstate;
+	ReadStream *stream;
+	void	   *per_block_data;
 	xl_heap_freeze_tuple *frozen;
 	StringInfoData buf;
 	const int	initprog_index[] = {
@@ -861,36 +891,38 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	 * Except when aggressive is set, we want to skip pages that are
 	 * all-visible according to the visibility map, but only when we can skip
 	 * at least SKIP_PAGES_THRESHOLD consecutive pages.  Since we're reading
-	 * sequentially, the OS should be doing readahead for us, so there's no
-	 * gain in skipping a page now and then; that's likely to disable
-	 * readahead and so be counterproductive. Also, skipping even a single
-	 * page means that we can't update relfrozenxid, so we only want to do it
-	 * if we can skip a goodly number of pages.
+	 * sequentially, there's no gain in skipping a page now and then. Also,
+	 * skipping even a single page means that we can't update relfrozenxid, so
+	 * we only want to do it if we can skip a goodly number of pages.
 	 *
 	 * When aggressive is set, we can't skip pages just because they are
 	 * all-visible, but we can still skip pages that are all-frozen, since
 	 * such pages do not need freezing and do not affect the value that we can
 	 * safely set for relfrozenxid or relminmxid.
 	 *
-	 * Before entering the main loop, establish the invariant that
-	 * next_unskippable_block is the next block number >= blkno that we can't
-	 * skip based on the visibility map, either all-visible for a regular scan
-	 * or all-frozen for an aggressive scan.  We set it to nblocks if there's
-	 * no such block.  We also set up the skipping_blocks flag correctly at
-	 * this stage.
+	 * The decisions about which blocks to skip are made by the callback of
+	 * the read stream we visit the heap through, lazy_scan_stream_next, so
+	 * that the blocks we do read can be read ahead of time.  It maintains the
+	 * invariant that next_unskippable_block is the next block number >= the
+	 * block being considered that we can't skip based on the visibility map,
+	 * either all-visible for a regular scan or all-frozen for an aggressive
+	 * scan.  It's set to nblocks if there's no such block.  The callback also
+	 * keeps the skipping_blocks flag set correctly as it goes.
 	 *
 	 * Note: The value returned by visibilitymap_get_status could be slightly
 	 * out-of-date, since we make this test before reading the corresponding
-	 * heap page or locking the buffer.  This is OK.  If we mistakenly think
-	 * that the page is all-visible or all-frozen when in fact the flag's just
-	 * been cleared, we might fail to vacuum the page.  It's easy to see that
-	 * skipping a page when aggressive is not set is not a very big deal; we
-	 * might leave some dead tuples lying around, but the next vacuum will
-	 * find them.  But even when aggressive *is* set, it's still OK if we miss
-	 * a page whose all-frozen marking has just been cleared.  Any new XIDs
-	 * just added to that page are necessarily newer than the GlobalXmin we
-	 * computed, so they'll have no effect on the value to which we can safely
-	 * set relfrozenxid.  A similar argument applies for MXIDs and relminmxid.
+	 * heap page or locking the buffer, and with the read stream it may be
+	 * made some blocks ahead of the page we're processing.  This is OK.  If
+	 * we mistakenly think that the page is all-visible or all-frozen when in
+	 * fact the flag's just been cleared, we might fail to vacuum the page.
+	 * It's easy to see that skipping a page when aggressive is not set is not
+	 * a very big deal; we might leave some dead tuples lying around, but the
+	 * next vacuum will find them.  But even when aggressive *is* set, it's
+	 * still OK if we miss a page whose all-frozen marking has just been
+	 * cleared.  Any new XIDs just added to that page are necessarily newer
+	 * than the GlobalXmin we computed, so they'll have no effect on the value
+	 * to which we can safely set relfrozenxid.  A similar argument applies for
+	 * MXIDs and relminmxid.
 	 *
 	 * We will scan the table's last page, at least to the extent of
 	 * determining whether it has tuples or not, even if it should be skipped
@@ -899,39 +931,31 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	 * lazy_truncate_heap() take access-exclusive lock on the table to attempt
 	 * a truncation that just fails immediately because there are tuples in
 	 * the last page.  This is worth avoiding mainly because such a lock must
-	 * be replayed on any hot standby, where it can be disruptive.
+	 * be replayed on any hot standby, where it can be disruptive.  Whether
+	 * that's the case can only be decided when we get to the last page, so
+	 * the callback always returns it, flagged as LVSCAN_SKIPPABLE.
 	 */
-	next_unskippable_block = 0;
-	if ((params->options & VACOPT_DISABLE_PAGE_SKIPPING) == 0)
-	{
-		while (next_unskippable_block < nblocks)
-		{
-			uint8		vmstatus;
-
-			vmstatus = visibilitymap_get_status(onerel, next_unskippable_block,
-												&vmbuffer);
-			if (aggressive)
-			{
-				if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
-					break;
-			}
-			else
-			{
-				if ((vmstatus & VISIBILITYMAP_ALL_VISIBLE) == 0)
-					break;
-			}
-			vacuum_delay_point();
-			next_unskippable_block++;
-		}
-	}
-
-	if (next_unskippable_block >= SKIP_PAGES_THRESHOLD)
-		skipping_blocks = true;
+	sstate.onerel = onerel;
+	sstate.vacrelstats = vacrelstats;
+	sstate.nblocks = nblocks;
+	sstate.aggressive = aggressive;
+	sstate.disable_page_skipping =
+		(params->options & VACOPT_DISABLE_PAGE_SKIPPING) != 0;
+	sstate.next_block = 0;
+	sstate.vmbuffer = InvalidBuffer;
+	lazy_scan_find_unskippable(&sstate, 0);
+	if (sstate.next_unskippable_block >= SKIP_PAGES_THRESHOLD)
+		sstate.skipping_blocks = true;
 	else
-		skipping_blocks = false;
+		sstate.skipping_blocks = false;
 
-	for (blkno = 0; blkno < nblocks; blkno++)
+	stream = ReadStreamBegin(onerel, MAIN_FORKNUM, vac_strategy,
+							 get_tablespace_maintenance_io_concurrency(onerel->rd_rel->reltablespace),
+							 lazy_scan_stream_next, &sstate, sizeof(uint8));
+
+	while ((blkno = ReadStreamNextBlock(stream, &per_block_data)) != InvalidBlockNumber)
 	{
+		uint8		blkflags = *(uint8 *) per_block_data;
 		Buffer		buf;
 		Page		page;
 		OffsetNumber offnum,
@@ -956,43 +980,28 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		update_vacuum_error_info(vacrelstats, NULL, VACUUM_ERRCB_PHASE_SCAN_HEAP,
 								 blkno, InvalidOffsetNumber);
 
-		if (blkno == next_unskippable_block)
+		if (blkflags & LVSCAN_SKIPPABLE)
 		{
-			/* Time to advance next_unskippable_block */
-			next_unskippable_block++;
-			if ((params->options & VACOPT_DISABLE_PAGE_SKIPPING) == 0)
-			{
-				while (next_unskippable_block < nblocks)
-				{
-					uint8		vmskipflags;
-
-					vmskipflags = visibilitymap_get_status(onerel,
-														   next_unskippable_block,
-														   &vmbuffer);
-					if (aggressive)
-					{
-						if ((vmskipflags & VISIBILITYMAP_ALL_FROZEN) == 0)
-							break;
-					}
-					else
-					{
-						if ((vmskipflags & VISIBILITYMAP_ALL_VISIBLE) == 0)
-							break;
-					}
-					vacuum_delay_point();
-					next_unskippable_block++;
-				}
-			}
-
 			/*
-			 * We know we can't skip the current block.  But set up
-			 * skipping_blocks to do the right thing at the following blocks.
+			 * This is the last page, in a run of pages long enough to skip.
+			 * Skip it unless we're forced to check it; see the comments in
+			 * lazy_scan_stream_next about how skipped pages are counted.
 			 */
-			if (next_unskippable_block - blkno > SKIP_PAGES_THRESHOLD)
-				skipping_blocks = true;
-			else
-				skipping_blocks = false;
+			if (!FORCE_CHECK_PAGE())
+			{
+				if (aggressive || VM_ALL_FROZEN(onerel, blkno, &vmbuffer))
+					vacrelstats->frozenskipped_pages++;
+				continue;
+			}
+		}
 
+		if (blkflags & LVSCAN_ALL_VISIBLE_VM)
+		{
+			/* a potentially skippable page must be at least all-visible */
+			all_visible_according_to_vm = true;
+		}
+		else
+		{
 			/*
 			 * Normally, the fact that we can't skip this block must mean that
 			 * it's not all-visible.  But in an aggressive vacuum we know only
@@ -1001,33 +1010,6 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			if (aggressive && VM_ALL_VISIBLE(onerel, blkno, &vmbuffer))
 				all_visible_according_to_vm = true;
 		}
-		else
-		{
-			/*
-			 * The current block is potentially skippable; if we've seen a
-			 * long enough run of skippable blocks to justify skipping it, and
-			 * we're not forced to check it, then go ahead and skip.
-			 * Otherwise, the page must be at least all-visible if not
-			 * all-frozen, so we can set all_visible_according_to_vm = true.
-			 */
-			if (skipping_blocks && !FORCE_CHECK_PAGE())
-			{
-				/*
-				 * Tricky, tricky.  If this is in aggressive vacuum, the page
-				 * must have been all-frozen at the time we checked whether it
-				 * was skippable, but it might not be any more.  We must be
-				 * careful to count it as a skipped all-frozen page in that
-				 * case, or else we'll think we can't update relfrozenxid and
-				 * relminmxid.  If it's not an aggressive vacuum, we don't
-				 * know whether it was all-frozen, so we have to recheck; but
-				 * in this case an approximate answer is OK.
-				 */
-				if (aggressive || VM_ALL_FROZEN(onerel, blkno, &vmbuffer))
-					vacrelstats->frozenskipped_pages++;
-				continue;
-			}
-			all_visible_according_to_vm = true;
-		}
 
 		vacuum_delay_point();
 
@@ -1049,6 +1031,11 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 				ReleaseBuffer(vmbuffer);
 				vmbuffer = InvalidBuffer;
 			}
+			if (BufferIsValid(sstate.vmbuffer))
+			{
+				ReleaseBuffer(sstate.vmbuffer);
+				sstate.vmbuffer = InvalidBuffer;
+			}
 
 			/* Work on all the indexes, then the heap */
 			lazy_vacuum_all_indexes(onerel, Irel, indstats,
@@ -1665,8 +1652,10 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			RecordPageWithFreeSpace(onerel, blkno, freespace);
 	}
 
+	ReadStreamEnd(stream);
+
 	/* report that everything is scanned and vacuumed */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, nblocks);
 
 	/* Clear the block number information */
 	vacrelstats->blkno = InvalidBlockNumber;
@@ -1698,6 +1687,11 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		ReleaseBuffer(vmbuffer);
 		vmbuffer = InvalidBuffer;
 	}
+	if (BufferIsValid(sstate.vmbuffer))
+	{
+		ReleaseBuffer(sstate.vmbuffer);
+		sstate.vmbuffer = InvalidBuffer;
+	}
 
 	/* If any tuples need to be deleted, perform final vacuum cycle */
 	/* XXX put a threshold on min number of tuples here? */
@@ -1715,11 +1709,11 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	 * Vacuum the remainder of the Free Space Map.  We must do this whether or
 	 * not there were indexes.
 	 */
-	if (blkno > next_fsm_block_to_vacuum)
-		FreeSpaceMapVacuumRange(onerel, next_fsm_block_to_vacuum, blkno);
+	if (nblocks > next_fsm_block_to_vacuum)
+		FreeSpaceMapVacuumRange(onerel, next_fsm_block_to_vacuum, nblocks);
 
 	/* report all blocks vacuumed */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, blkno);
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, nblocks);
 
 	/* Do post-vacuum cleanup */
 	if (vacrelstats->useindex)
@@ -1828,6 +1822,123 @@ lazy_vacuum_all_indexes(Relation onerel, Relation *Irel,
 }
 
 
+/*
+ *	lazy_scan_find_unskippable() -- advance next_unskippable_block
+ *
+ *		Sets sstate->next_unskippable_block to the first block >= blkno that
+ *		can't be skipped according to the visibility map, or to nblocks if
+ *		there's none.
+ */
+static void
+lazy_scan_find_unskippable(LVScanStreamState *sstate, BlockNumber blkno)
+{
+	sstate->next_unskippable_block = blkno;
+
+	if (sstate->disable_page_skipping)
+		return;
+
+	while (sstate->next_unskippable_block < sstate->nblocks)
+	{
+		uint8		vmstatus;
+
+		vmstatus = visibilitymap_get_status(sstate->onerel,
+											sstate->next_unskippable_block,
+											&sstate->vmbuffer);
+		if (sstate->aggressive)
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
+				break;
+		}
+		else
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_VISIBLE) == 0)
+				break;
+		}
+		vacuum_delay_point();
+		sstate->next_unskippable_block++;
+	}
+}
+
+/*
+ *	lazy_scan_stream_next() -- read stream callback for lazy_scan_heap
+ *
+ *		Returns the next heap block lazy_scan_heap needs to look at, skipping
+ *		runs of at least SKIP_PAGES_THRESHOLD pages that the visibility map
+ *		says we don't need to visit (see comments in lazy_scan_heap).
+ *
+ *		The block's flags are returned as per-block data: LVSCAN_ALL_VISIBLE_VM
+ *		for a page in a run that was too short to skip, and additionally
+ *		LVSCAN_SKIPPABLE for the last page of the relation if it would be
+ *		skipped, since only the caller can decide whether it must be checked
+ *		anyway.
+ */
+static BlockNumber
+lazy_scan_stream_next(ReadStream *stream,
+					  void *callback_private_data,
+					  void *per_block_data)
+{
+	LVScanStreamState *sstate = (LVScanStreamState *) callback_private_data;
+	uint8	   *blkflags = (uint8 *) per_block_data;
+
+	while (sstate->next_block < sstate->nblocks)
+	{
+		BlockNumber blkno = sstate->next_block++;
+
+		if (blkno == sstate->next_unskippable_block)
+		{
+			/* Time to advance next_unskippable_block */
+			lazy_scan_find_unskippable(sstate, blkno + 1);
+
+			/*
+			 * We know we can't skip the current block.  But set up
+			 * skipping_blocks to do the right thing at the following blocks.
+			 */
+			if (sstate->next_unskippable_block - blkno > SKIP_PAGES_THRESHOLD)
+				sstate->skipping_blocks = true;
+			else
+				sstate->skipping_blocks = false;
+
+			*blkflags = 0;
+			return blkno;
+		}
+
+		/*
+		 * The current block is potentially skippable; if we've seen a long
+		 * enough run of skippable blocks to justify skipping it, go ahead and
+		 * skip.  Otherwise, the page must be at least all-visible if not
+		 * all-frozen.
+		 */
+		if (!sstate->skipping_blocks)
+		{
+			*blkflags = LVSCAN_ALL_VISIBLE_VM;
+			return blkno;
+		}
+
+		/* The last page might have to be checked anyway; let caller decide */
+		if (blkno == sstate->nblocks - 1)
+		{
+			*blkflags = LVSCAN_ALL_VISIBLE_VM | LVSCAN_SKIPPABLE;
+			return blkno;
+		}
+
+		/*
+		 * Tricky, tricky.  If this is in aggressive vacuum, the page must
+		 * have been all-frozen at the time we checked whether it was
+		 * skippable, but it might not be any more.  We must be careful to
+		 * count it as a skipped all-frozen page in that case, or else we'll
+		 * think we can't update relfrozenxid and relminmxid.  If it's not an
+		 * aggressive vacuum, we don't know whether it was all-frozen, so we
+		 * have to recheck; but in this case an approximate answer is OK.
+		 */
+		if (sstate->aggressive ||
+			VM_ALL_FROZEN(sstate->onerel, blkno, &sstate->vmbuffer))
+			sstate->vacrelstats->frozenskipped_pages++;
+	}
+
+	return InvalidBlockNumber;
+}
+
+
 /*
  *	lazy_vacuum_heap() -- second pass over the heap
  *
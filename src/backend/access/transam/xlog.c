@@ -35,6 +35,8 @@
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
 #include "access/xloginsert.h"
+#include "access/xlogparallel.h"
+#include "access/xlogprefetch.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
@@ -48,8 +50,10 @@
 #include "pg_trace.h"
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "port/pg_bitutils.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/startup.h"
+#include "postmaster/walsummarizer.h"
 #include "postmaster/walwriter.h"
 #include "replication/basebackup.h"
 #include "replication/logical.h"
@@ -97,16 +101,19 @@ char	   *XLogArchiveCommand = NULL;
 bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
 bool		wal_log_hints = false;
-bool		wal_compression = false;
+int			wal_compression = WAL_COMPRESSION_NONE;
+bool		wal_fpi_dedup = false;
 char	   *wal_consistency_checking_string = NULL;
 bool	   *wal_consistency_checking = NULL;
 bool		wal_init_zero = true;
 bool		wal_recycle = true;
+int			wal_prealloc_segments = 2;
 bool		log_checkpoints = false;
 int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_MINIMAL;
 int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
+bool		wal_group_commit = true;
 int			wal_retrieve_retry_interval = 5000;
 int			max_slot_wal_keep_size_mb = -1;
 
@@ -117,11 +124,27 @@ bool		XLOG_DEBUG = false;
 int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 
 /*
- * Number of WAL insertion locks to use. A higher value allows more insertions
- * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * Number of WAL insertion locks to use (wal_insert_locks). A higher value
+ * allows more insertions to happen concurrently, but adds some CPU overhead
+ * to flushing the WAL, which needs to iterate all the locks. -1 means choose
+ * a value based on the number of CPUs, see XLOGChooseNumInsertLocks().
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			NumXLogInsertLocks = -1;
+
+/*
+ * When wal_group_commit is on and commit_delay is not set, a group commit
+ * leader waits for more members to join for this fraction of the observed
+ * WAL flush latency, but never longer than GROUP_COMMIT_MAX_DELAY
+ * microseconds.
+ */
+#define GROUP_COMMIT_DELAY_FRACTION		4
+#define GROUP_COMMIT_MAX_DELAY			10000
+
+/*
+ * Background WAL segment preallocation keeps enough segments ready to
+ * absorb this many milliseconds of WAL at the recent generation rate.
+ */
+#define PREALLOC_LOOKAHEAD_MS			1000
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -504,6 +527,19 @@ typedef union WALInsertLockPadded
 	char		pad[PG_CACHE_LINE_SIZE];
 } WALInsertLockPadded;
 
+/*
+ * An entry in the prev-link table.  Each inserter publishes the start of its
+ * record keyed by the end of the record, and the inserter that reserves the
+ * space right after it looks up the entry by its own start position to fill
+ * in xl_prev.  endpos is 0 when the slot is free, and startpos is stored +1
+ * so that 0 means "not set yet".  Both are usable byte positions.
+ */
+typedef struct XLogPrevLink
+{
+	pg_atomic_uint64 endpos;
+	pg_atomic_uint64 startpos;
+} XLogPrevLink;
+
 /*
  * State of an exclusive backup, necessary to control concurrent activities
  * across sessions when working on exclusive backups.
@@ -538,27 +574,35 @@ static SessionBackupState sessionBackupState = SESSION_BACKUP_NONE;
  */
 typedef struct XLogCtlInsert
 {
-	slock_t		insertpos_lck;	/* protects CurrBytePos and PrevBytePos */
-
 	/*
 	 * CurrBytePos is the end of reserved WAL. The next record will be
-	 * inserted at that position. PrevBytePos is the start position of the
-	 * previously inserted (or rather, reserved) record - it is copied to the
-	 * prev-link of the next record. These are stored as "usable byte
-	 * positions" rather than XLogRecPtrs (see XLogBytePosToRecPtr()).
+	 * inserted at that position. It is stored as a "usable byte position"
+	 * rather than an XLogRecPtr (see XLogBytePosToRecPtr()), and advanced
+	 * with an atomic fetch-add by ReserveXLogInsertLocation().
+	 *
+	 * The start position of the previously reserved record, which is copied
+	 * to the prev-link of the next record, is handed over through the
+	 * PrevLinks table below, see ReserveXLogInsertLocation().
 	 */
-	uint64		CurrBytePos;
-	uint64		PrevBytePos;
+	pg_atomic_uint64 CurrBytePos;
 
 	/*
-	 * Make sure the above heavily-contended spinlock and byte positions are
-	 * on their own cache line. In particular, the RedoRecPtr and full page
-	 * write variables below should be on a different cache line. They are
-	 * read on every WAL insertion, but updated rarely, and we don't want
-	 * those reads to steal the cache line containing Curr/PrevBytePos.
+	 * Make sure the above heavily-contended byte position is on its own cache
+	 * line. In particular, the RedoRecPtr and full page write variables below
+	 * should be on a different cache line. They are read on every WAL
+	 * insertion, but updated rarely, and we don't want those reads to steal
+	 * the cache line containing CurrBytePos.
 	 */
 	char		pad[PG_CACHE_LINE_SIZE];
 
+	/*
+	 * Hash table of prev-links of reserved records, keyed by the end of the
+	 * record. numPrevLinks is a power of two that doesn't change after
+	 * shared memory initialization.
+	 */
+	XLogPrevLink *PrevLinks;
+	uint32		numPrevLinks;
+
 	/*
 	 * fullPageWrites is the authoritative value used by all backends to
 	 * determine whether to write full-page image to WAL. This shared value,
@@ -622,6 +666,21 @@ typedef struct XLogCtlData
 	 */
 	XLogwrtResult LogwrtResult;
 
+	/*
+	 * Position up to which all WAL insertions are known to have finished, as
+	 * last computed by WaitXLogInsertionsToFinish().  Only ever advances.
+	 */
+	pg_atomic_uint64 logInsertResult;
+
+	/*
+	 * Moving average of WAL flush latency in microseconds, and the size of
+	 * the latest flush group.  Used to size the group commit batching window,
+	 * see XLogGroupCommitDelay().  flushLatency is only updated while holding
+	 * WALWriteLock.
+	 */
+	pg_atomic_uint64 flushLatency;
+	pg_atomic_uint32 lastFlushGroupSize;
+
 	/*
 	 * Latest initialized page in the cache (last byte position + 1).
 	 *
@@ -1027,8 +1086,8 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * record to the shared WAL buffer cache is a two-step process:
 	 *
 	 * 1. Reserve the right amount of space from the WAL. The current head of
-	 *	  reserved space is kept in Insert->CurrBytePos, and is protected by
-	 *	  insertpos_lck.
+	 *	  reserved space is kept in Insert->CurrBytePos, and is advanced with
+	 *	  an atomic fetch-add.
 	 *
 	 * 2. Copy the record to the reserved WAL space. This involves finding the
 	 *	  correct WAL buffer containing the reserved space, and copying the
@@ -1038,7 +1097,7 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
 	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * determined by wal_insert_locks. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -1267,6 +1326,100 @@ XLogInsertRecord(XLogRecData *rdata,
 	return EndPos;
 }
 
+/*
+ * Slot in the prev-link table to start probing at for a given byte position.
+ * Byte positions are MAXALIGNed and consecutive records are close to each
+ * other, so use multiplicative hashing to spread them over the table.
+ */
+static inline uint32
+XLogPrevLinkSlot(XLogCtlInsert *Insert, uint64 bytepos)
+{
+	return (uint32) ((bytepos * UINT64CONST(0x9E3779B97F4A7C15)) >> 40) &
+		(Insert->numPrevLinks - 1);
+}
+
+/*
+ * Publish the start position of a reserved record, keyed by its end.
+ *
+ * Every entry is eventually consumed by the inserter that reserves the space
+ * right after the record, and every inserter holds a WAL insertion lock while
+ * an entry is pending on it, so at most NumXLogInsertLocks + 1 entries are in
+ * use at a time.  The table is sized so that there is always a free slot.
+ */
+static void
+XLogPrevLinkPublish(XLogCtlInsert *Insert, uint64 endbytepos,
+					uint64 startbytepos)
+{
+	uint32		slot = XLogPrevLinkSlot(Insert, endbytepos);
+
+	for (;;)
+	{
+		XLogPrevLink *link = &Insert->PrevLinks[slot];
+		uint64		expected = 0;
+
+		if (pg_atomic_read_u64(&link->endpos) == 0 &&
+			pg_atomic_compare_exchange_u64(&link->endpos, &expected,
+										   endbytepos))
+		{
+			pg_atomic_write_u64(&link->startpos, startbytepos + 1);
+			return;
+		}
+		slot = (slot + 1) & (Insert->numPrevLinks - 1);
+	}
+}
+
+/*
+ * Look up and remove the prev-link entry published for the record that ends
+ * at 'startbytepos', and return the start of that record.
+ *
+ * The previous inserter publishes its entry right after reserving its space,
+ * so if it's not there yet we only have to wait a few instructions, unless
+ * the inserter got descheduled in between.  Back off the same way as a
+ * spinlock does in that case.
+ */
+static uint64
+XLogPrevLinkConsume(XLogCtlInsert *Insert, uint64 startbytepos)
+{
+	uint32		first = XLogPrevLinkSlot(Insert, startbytepos);
+	uint32		slot = first;
+	SpinDelayStatus delayStatus;
+
+	init_local_spin_delay(&delayStatus);
+
+	for (;;)
+	{
+		XLogPrevLink *link = &Insert->PrevLinks[slot];
+
+		if (pg_atomic_read_u64(&link->endpos) == startbytepos)
+		{
+			uint64		prevbytepos;
+
+			/*
+			 * Don't read startpos before endpos, or we might see the value
+			 * left by the slot's previous occupant.  That was cleared before
+			 * its endpos was, so once we have seen our endpos, startpos is
+			 * either ours or zero.
+			 */
+			pg_read_barrier();
+
+			while ((prevbytepos = pg_atomic_read_u64(&link->startpos)) == 0)
+				perform_spin_delay(&delayStatus);
+			finish_spin_delay(&delayStatus);
+
+			/* release the slot; startpos must be cleared first */
+			pg_atomic_write_u64(&link->startpos, 0);
+			pg_write_barrier();
+			pg_atomic_write_u64(&link->endpos, 0);
+
+			return prevbytepos - 1;
+		}
+
+		slot = (slot + 1) & (Insert->numPrevLinks - 1);
+		if (slot == first)
+			perform_spin_delay(&delayStatus);
+	}
+}
+
 /*
  * Reserves the right amount of space for a record of given size from the WAL.
  * *StartPos is set to the beginning of the reserved section, *EndPos to
@@ -1274,9 +1427,11 @@ XLogInsertRecord(XLogRecData *rdata,
  * used to set the xl_prev of this record.
  *
  * This is the performance critical part of XLogInsert that must be serialized
- * across backends. The rest can happen mostly in parallel. Try to keep this
- * section as short as possible, insertpos_lck can be heavily contended on a
- * busy system.
+ * across backends. The rest can happen mostly in parallel. The reservation
+ * itself is a single atomic fetch-add on CurrBytePos; the prev-link is
+ * handed over from the previous inserter through the PrevLinks table.
+ *
+ * The caller must hold a WAL insertion lock.
  *
  * NB: The space calculation here must match the code in CopyXLogRecordToWAL,
  * where we actually copy the record to the reserved space.
@@ -1296,24 +1451,23 @@ ReserveXLogInsertLocation(int size, XLogRecPtr *StartPos, XLogRecPtr *EndPos,
 	Assert(size > SizeOfXLogRecord);
 
 	/*
-	 * The duration the spinlock needs to be held is minimized by minimizing
-	 * the calculations that have to be done while holding the lock. The
-	 * current tip of reserved WAL is kept in CurrBytePos, as a byte position
-	 * that only counts "usable" bytes in WAL, that is, it excludes all WAL
-	 * page headers. The mapping between "usable" byte positions and physical
-	 * positions (XLogRecPtrs) can be done outside the locked region, and
+	 * The current tip of reserved WAL is kept in CurrBytePos, as a byte
+	 * position that only counts "usable" bytes in WAL, that is, it excludes
+	 * all WAL page headers. The mapping between "usable" byte positions and
+	 * physical positions (XLogRecPtrs) can be done after the reservation, and
 	 * because the usable byte position doesn't include any headers, reserving
-	 * X bytes from WAL is almost as simple as "CurrBytePos += X".
+	 * X bytes from WAL is as simple as "CurrBytePos += X".
 	 */
-	SpinLockAcquire(&Insert->insertpos_lck);
-
-	startbytepos = Insert->CurrBytePos;
+	startbytepos = pg_atomic_fetch_add_u64(&Insert->CurrBytePos, size);
 	endbytepos = startbytepos + size;
-	prevbytepos = Insert->PrevBytePos;
-	Insert->CurrBytePos = endbytepos;
-	Insert->PrevBytePos = startbytepos;
 
-	SpinLockRelease(&Insert->insertpos_lck);
+	/*
+	 * Let the next inserter know where we start, before waiting for the
+	 * previous one to tell us where it starts.  Publishing first means the
+	 * handover never forms a cycle.
+	 */
+	XLogPrevLinkPublish(Insert, endbytepos, startbytepos);
+	prevbytepos = XLogPrevLinkConsume(Insert, startbytepos);
 
 	*StartPos = XLogBytePosToRecPtr(startbytepos);
 	*EndPos = XLogBytePosToEndRecPtr(endbytepos);
@@ -1349,25 +1503,22 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 	uint32		segleft;
 
 	/*
-	 * These calculations are a bit heavy-weight to be done while holding a
-	 * spinlock, but since we're holding all the WAL insertion locks, there
-	 * are no other inserters competing for it. GetXLogInsertRecPtr() does
-	 * compete for it, but that's not called very frequently.
+	 * Since we're holding all the WAL insertion locks, there are no other
+	 * inserters competing for CurrBytePos, so we can read it and advance it
+	 * without a compare-and-swap loop.
 	 */
-	SpinLockAcquire(&Insert->insertpos_lck);
+	Assert(holdingAllLocks);
 
-	startbytepos = Insert->CurrBytePos;
+	startbytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	ptr = XLogBytePosToEndRecPtr(startbytepos);
 	if (XLogSegmentOffset(ptr, wal_segment_size) == 0)
 	{
-		SpinLockRelease(&Insert->insertpos_lck);
 		*EndPos = *StartPos = ptr;
 		return false;
 	}
 
 	endbytepos = startbytepos + size;
-	prevbytepos = Insert->PrevBytePos;
 
 	*StartPos = XLogBytePosToRecPtr(startbytepos);
 	*EndPos = XLogBytePosToEndRecPtr(endbytepos);
@@ -1379,10 +1530,10 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 		*EndPos += segleft;
 		endbytepos = XLogRecPtrToBytePos(*EndPos);
 	}
-	Insert->CurrBytePos = endbytepos;
-	Insert->PrevBytePos = startbytepos;
+	pg_atomic_write_u64(&Insert->CurrBytePos, endbytepos);
 
-	SpinLockRelease(&Insert->insertpos_lck);
+	XLogPrevLinkPublish(Insert, endbytepos, startbytepos);
+	prevbytepos = XLogPrevLinkConsume(Insert, startbytepos);
 
 	*PrevPtr = XLogBytePosToRecPtr(prevbytepos);
 
@@ -1479,7 +1630,9 @@ checkXLogConsistency(XLogReaderState *record)
 		 * can be directly applied on it.
 		 */
 		if (!RestoreBlockImage(record, block_id, primary_image_masked))
-			elog(ERROR, "failed to restore block image");
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg_internal("%s", record->errormsg_buf)));
 
 		/*
 		 * If masking function is defined, mask both the primary and replay
@@ -1669,7 +1822,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+		lockToTry = MyProc->pgprocno % NumXLogInsertLocks;
 	MyLockNo = lockToTry;
 
 	/*
@@ -1687,7 +1840,7 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % NumXLogInsertLocks;
 	}
 }
 
@@ -1705,7 +1858,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < NumXLogInsertLocks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1731,7 +1884,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < NumXLogInsertLocks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1759,8 +1912,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[NumXLogInsertLocks - 1].l.lock,
+						&WALInsertLocks[NumXLogInsertLocks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1789,16 +1942,30 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	uint64		bytepos;
 	XLogRecPtr	reservedUpto;
 	XLogRecPtr	finishedUpto;
+	XLogRecPtr	inserted;
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	int			i;
 
 	if (MyProc == NULL)
 		elog(PANIC, "cannot wait without a PGPROC structure");
 
-	/* Read the current insert position */
-	SpinLockAcquire(&Insert->insertpos_lck);
-	bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	/*
+	 * Check if some other process already found that all insertions up to
+	 * 'upto' have finished.  Many backends flushing at about the same point
+	 * would otherwise each scan all the insertion locks.
+	 */
+	pg_memory_barrier();
+	inserted = pg_atomic_read_u64(&XLogCtl->logInsertResult);
+	if (upto <= inserted)
+		return inserted;
+
+	/*
+	 * Read the current insert position.  The barrier makes sure that any
+	 * insertion that has reserved space below it is seen holding its lock
+	 * in the loop below.
+	 */
+	bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
+	pg_memory_barrier();
 	reservedUpto = XLogBytePosToEndRecPtr(bytepos);
 
 	/*
@@ -1828,7 +1995,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < NumXLogInsertLocks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1864,6 +2031,16 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 		if (insertingat != InvalidXLogRecPtr && insertingat < finishedUpto)
 			finishedUpto = insertingat;
 	}
+
+	/* Advertise the result, unless someone already got further */
+	inserted = pg_atomic_read_u64(&XLogCtl->logInsertResult);
+	while (inserted < finishedUpto)
+	{
+		if (pg_atomic_compare_exchange_u64(&XLogCtl->logInsertResult,
+										   &inserted, finishedUpto))
+			break;
+	}
+
 	return finishedUpto;
 }
 
@@ -2488,6 +2665,8 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible)
 			use_existent = true;
 			openLogFile = XLogFileInit(openLogSegNo, &use_existent, true);
 			ReserveExternalFD();
+			if (!use_existent)
+				WalStats.m_wal_segments_foreground++;
 		}
 
 		/* Make sure we have the current logfile open */
@@ -2839,44 +3018,19 @@ UpdateMinRecoveryPoint(XLogRecPtr lsn, bool force)
 }
 
 /*
- * Ensure that all XLOG data through the given position is flushed to disk.
+ * Flush XLOG through the given position, racing with other backends for
+ * WALWriteLock.  This is the work horse of XLogFlush(); the caller must be
+ * in a critical section.
  *
- * NOTE: this differs from XLogWrite mainly in that the WALWriteLock is not
- * already held, and we try to avoid acquiring it if possible.
+ * If allow_delay is true, sleep for commit_delay before flushing, if it's
+ * set and there are enough concurrently active transactions.
  */
-void
-XLogFlush(XLogRecPtr record)
+static void
+XLogFlushInternal(XLogRecPtr record, bool allow_delay)
 {
 	XLogRecPtr	WriteRqstPtr;
 	XLogwrtRqst WriteRqst;
 
-	/*
-	 * During REDO, we are reading not writing WAL.  Therefore, instead of
-	 * trying to flush the WAL, we should update minRecoveryPoint instead. We
-	 * test XLogInsertAllowed(), not InRecovery, because we need checkpointer
-	 * to act this way too, and because when it tries to write the
-	 * end-of-recovery checkpoint, it should indeed flush.
-	 */
-	if (!XLogInsertAllowed())
-	{
-		UpdateMinRecoveryPoint(record, false);
-		return;
-	}
-
-	/* Quick exit if already known flushed */
-	if (record <= LogwrtResult.Flush)
-		return;
-
-#ifdef WAL_DEBUG
-	if (XLOG_DEBUG)
-		elog(LOG, "xlog flush request %X/%X; write %X/%X; flush %X/%X",
-			 (uint32) (record >> 32), (uint32) record,
-			 (uint32) (LogwrtResult.Write >> 32), (uint32) LogwrtResult.Write,
-			 (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
-#endif
-
-	START_CRIT_SECTION();
-
 	/*
 	 * Since fsync is usually a horribly expensive operation, we try to
 	 * piggyback as much data as we can on each fsync: if we see any more data
@@ -2947,7 +3101,7 @@ XLogFlush(XLogRecPtr record)
 		 * We do not sleep if enableFsync is not turned on, nor if there are
 		 * fewer than CommitSiblings other backends with active transactions.
 		 */
-		if (CommitDelay > 0 && enableFsync &&
+		if (allow_delay && CommitDelay > 0 && enableFsync &&
 			MinimumActiveBackends(CommitSiblings))
 		{
 			pg_usleep(CommitDelay);
@@ -2969,12 +3123,278 @@ XLogFlush(XLogRecPtr record)
 		WriteRqst.Write = insertpos;
 		WriteRqst.Flush = insertpos;
 
-		XLogWrite(WriteRqst, false);
+		if (wal_group_commit)
+		{
+			instr_time	start;
+			instr_time	duration;
+			uint64		latency;
+			uint64		avg;
+
+			INSTR_TIME_SET_CURRENT(start);
+			XLogWrite(WriteRqst, false);
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, start);
+
+			/* Fold this flush into the moving average, with weight 1/8 */
+			latency = INSTR_TIME_GET_MICROSEC(duration);
+			avg = pg_atomic_read_u64(&XLogCtl->flushLatency);
+			if (avg == 0)
+				avg = latency;
+			else
+				avg = avg - avg / 8 + latency / 8;
+			pg_atomic_write_u64(&XLogCtl->flushLatency, avg);
+		}
+		else
+			XLogWrite(WriteRqst, false);
 
 		LWLockRelease(WALWriteLock);
 		/* done */
 		break;
 	}
+}
+
+/*
+ * Sleep before a group commit leader flushes, to let more backends join its
+ * group.
+ *
+ * If commit_delay is set, it is used as-is, like in XLogFlushInternal().
+ * Otherwise the window is a fraction of the recently observed flush latency,
+ * and only used when the previous group had more than one member; a lone
+ * committer on an idle system should not have to wait.
+ */
+static void
+XLogGroupCommitDelay(void)
+{
+	uint64		delay;
+
+	if (!enableFsync)
+		return;
+
+	if (CommitDelay > 0)
+	{
+		if (MinimumActiveBackends(CommitSiblings))
+			pg_usleep(CommitDelay);
+		return;
+	}
+
+	if (pg_atomic_read_u32(&XLogCtl->lastFlushGroupSize) <= 1)
+		return;
+
+	delay = pg_atomic_read_u64(&XLogCtl->flushLatency) /
+		GROUP_COMMIT_DELAY_FRACTION;
+	if (delay > GROUP_COMMIT_MAX_DELAY)
+		delay = GROUP_COMMIT_MAX_DELAY;
+	if (delay > 0)
+		pg_usleep((long) delay);
+}
+
+/*
+ * XLogFlushGroup -- group WAL flush
+ *
+ * Add ourselves to a list of processes that need WAL flushed.  The first
+ * process to add itself to the list becomes the leader: it waits for any
+ * flush already in progress to finish and for the batching window to pass,
+ * then flushes up to the highest position requested by any member of the
+ * group, and wakes the members in LSN order.  This replaces a thundering
+ * herd on WALWriteLock with a single flush per group, which matters most
+ * when fsync is slow.
+ *
+ * A member whose request wasn't covered by the leader's flush (which can
+ * only happen if it asked for a position past the end of WAL) falls back to
+ * flushing by itself.
+ */
+static void
+XLogFlushGroup(XLogRecPtr record)
+{
+	PROC_HDR   *procglobal = ProcGlobal;
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	XLogRecPtr	groupLsn;
+	int			groupSize;
+	int			bucket;
+
+	/* Add ourselves to the list of processes needing a WAL flush. */
+	proc->walFlushGroupMember = true;
+	proc->walFlushGroupMemberLsn = record;
+	nextidx = pg_atomic_read_u32(&procglobal->walFlushGroupFirst);
+	while (true)
+	{
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->walFlushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush for us.  It is
+	 * impossible to have followers without a leader because the first process
+	 * that has added itself to the list will always have nextidx as
+	 * INVALID_PGPROCNO.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		/* Sleep until the leader has flushed. */
+		pgstat_report_wait_start(WAIT_EVENT_WAL_GROUP_FLUSH);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(proc->sem);
+
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+
+		if (record > LogwrtResult.Flush)
+			XLogFlushInternal(record, false);
+		return;
+	}
+
+	/*
+	 * We are the leader.  While a flush is in progress, more backends pile up
+	 * behind us, so wait for it to finish before closing the group.  We don't
+	 * keep WALWriteLock, because we must not hold it while waiting for
+	 * in-progress insertions.
+	 */
+	if (LWLockAcquireOrWait(WALWriteLock, LW_EXCLUSIVE))
+		LWLockRelease(WALWriteLock);
+
+	XLogGroupCommitDelay();
+
+	/*
+	 * Close the group, saving a pointer to the head of the list.  Trying to
+	 * pop elements one at a time could lead to an ABA problem.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->walFlushGroupFirst,
+									 INVALID_PGPROCNO);
+
+	/*
+	 * Walk the list to find the highest requested position, and relink it in
+	 * LSN order for the wakeups.  Members are pushed to the front of the list,
+	 * so it's mostly in reverse LSN order already, and inserting each member
+	 * at the head of the new list is usually enough.
+	 */
+	groupLsn = InvalidXLogRecPtr;
+	groupSize = 0;
+	wakeidx = INVALID_PGPROCNO;
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		uint32		thisidx = nextidx;
+		PGPROC	   *member = &ProcGlobal->allProcs[thisidx];
+		XLogRecPtr	lsn = member->walFlushGroupMemberLsn;
+
+		/* Move to next proc in list. */
+		nextidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+
+		groupSize++;
+		if (lsn > groupLsn)
+			groupLsn = lsn;
+
+		if (wakeidx == INVALID_PGPROCNO ||
+			lsn <= ProcGlobal->allProcs[wakeidx].walFlushGroupMemberLsn)
+		{
+			pg_atomic_write_u32(&member->walFlushGroupNext, wakeidx);
+			wakeidx = thisidx;
+		}
+		else
+		{
+			PGPROC	   *prev = &ProcGlobal->allProcs[wakeidx];
+			uint32		afteridx;
+
+			while ((afteridx = pg_atomic_read_u32(&prev->walFlushGroupNext)) != INVALID_PGPROCNO &&
+				   ProcGlobal->allProcs[afteridx].walFlushGroupMemberLsn < lsn)
+				prev = &ProcGlobal->allProcs[afteridx];
+			pg_atomic_write_u32(&member->walFlushGroupNext, afteridx);
+			pg_atomic_write_u32(&prev->walFlushGroupNext, thisidx);
+		}
+	}
+	Assert(groupSize > 0);
+
+	XLogFlushInternal(groupLsn, false);
+
+	/* Count the group in the histogram: 1, 2, 3-4, 5-8, ... */
+	bucket = (groupSize == 1) ? 0 : pg_leftmost_one_pos32(groupSize - 1) + 1;
+	if (bucket >= PGSTAT_NUM_WAL_GROUP_SIZES)
+		bucket = PGSTAT_NUM_WAL_GROUP_SIZES - 1;
+	WalStats.m_wal_group_sizes[bucket]++;
+	pg_atomic_write_u32(&XLogCtl->lastFlushGroupSize, (uint32) groupSize);
+
+	/*
+	 * Now that we've released WALWriteLock, wake everybody up, in the order
+	 * of the positions they asked for.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+		pg_atomic_write_u32(&member->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->walFlushGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(member->sem);
+	}
+}
+
+/*
+ * Ensure that all XLOG data through the given position is flushed to disk.
+ *
+ * NOTE: this differs from XLogWrite mainly in that the WALWriteLock is not
+ * already held, and we try to avoid acquiring it if possible.
+ */
+void
+XLogFlush(XLogRecPtr record)
+{
+	/*
+	 * During REDO, we are reading not writing WAL.  Therefore, instead of
+	 * trying to flush the WAL, we should update minRecoveryPoint instead. We
+	 * test XLogInsertAllowed(), not InRecovery, because we need checkpointer
+	 * to act this way too, and because when it tries to write the
+	 * end-of-recovery checkpoint, it should indeed flush.
+	 */
+	if (!XLogInsertAllowed())
+	{
+		UpdateMinRecoveryPoint(record, false);
+		return;
+	}
+
+	/* Quick exit if already known flushed */
+	if (record <= LogwrtResult.Flush)
+		return;
+
+#ifdef WAL_DEBUG
+	if (XLOG_DEBUG)
+		elog(LOG, "xlog flush request %X/%X; write %X/%X; flush %X/%X",
+			 (uint32) (record >> 32), (uint32) record,
+			 (uint32) (LogwrtResult.Write >> 32), (uint32) LogwrtResult.Write,
+			 (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
+#endif
+
+	START_CRIT_SECTION();
+
+	if (wal_group_commit && MyProc != NULL)
+		XLogFlushGroup(record);
+	else
+		XLogFlushInternal(record, true);
 
 	END_CRIT_SECTION();
 
@@ -3913,6 +4333,80 @@ PreallocXlogFiles(XLogRecPtr endptr)
 	}
 }
 
+/*
+ * Create WAL segments ahead of the insert position in the background, so
+ * that backends switching to a new segment rarely have to create and fill
+ * one themselves.
+ *
+ * This is called by the WAL writer.  At least wal_prealloc_segments future
+ * segments are kept ready, more if WAL is being generated fast enough to
+ * use them up within PREALLOC_LOOKAHEAD_MS.  At most one segment is created
+ * per call, so that flushing asynchronous commits isn't held up for long.
+ *
+ * Returns true if a segment was created.
+ */
+bool
+XLogBackgroundPrealloc(void)
+{
+	static XLogRecPtr prevInsertPos = InvalidXLogRecPtr;
+	static TimestampTz prevTime = 0;
+	static double insertRate = 0;	/* bytes per second, smoothed */
+	static XLogSegNo readySegNo = 0;	/* segments up to this one exist */
+	XLogRecPtr	insertpos;
+	TimestampTz now;
+	XLogSegNo	cursegno;
+	XLogSegNo	segno;
+	int			ahead;
+
+	if (wal_prealloc_segments <= 0 || RecoveryInProgress())
+		return false;
+
+	insertpos = GetXLogInsertRecPtr();
+	now = GetCurrentTimestamp();
+
+	/*
+	 * Track the WAL generation rate.  React immediately to an increase, but
+	 * let the estimate decay slowly, so that we stay prepared for bursts.
+	 */
+	if (prevTime != 0 && now > prevTime && insertpos >= prevInsertPos)
+	{
+		double		rate;
+
+		rate = (double) (insertpos - prevInsertPos) * 1000000.0 /
+			(double) (now - prevTime);
+		insertRate = Max(rate, 0.90 * insertRate + 0.10 * rate);
+	}
+	prevInsertPos = insertpos;
+	prevTime = now;
+
+	ahead = (int) Min(ceil(insertRate * PREALLOC_LOOKAHEAD_MS / 1000.0 /
+						   wal_segment_size),
+					  CheckPointSegments);
+	ahead = Max(ahead, wal_prealloc_segments);
+
+	XLByteToSeg(insertpos, cursegno, wal_segment_size);
+	if (readySegNo < cursegno)
+		readySegNo = cursegno;
+
+	for (segno = readySegNo + 1; segno <= cursegno + ahead; segno++)
+	{
+		bool		use_existent = true;
+		int			lf;
+
+		lf = XLogFileInit(segno, &use_existent, true);
+		close(lf);
+		readySegNo = segno;
+
+		if (!use_existent)
+		{
+			WalStats.m_wal_segments_background++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /*
  * Throws an error if the given log segment has already been removed or
  * recycled. The caller should only pass a segment that it knows to have
@@ -5018,6 +5512,77 @@ check_wal_buffers(int *newval, void **extra, GucSource source)
 	return true;
 }
 
+/*
+ * Auto-tune the number of WAL insertion locks based on the number of CPUs.
+ *
+ * With few CPUs there's little to gain from more than the historical 8
+ * locks, while each extra lock adds a little overhead to every WAL flush.
+ * We use a quarter of the CPU count, rounded up to a power of two, between 8
+ * and 64.  If the CPU count can't be determined, use 8.
+ */
+static int
+XLOGChooseNumInsertLocks(void)
+{
+	int			nlocks = 8;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	{
+		long		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (ncpus > 0)
+			nlocks = pg_nextpower2_32((uint32) Min(ncpus, PG_INT32_MAX)) / 4;
+	}
+#endif
+
+	if (nlocks < 8)
+		nlocks = 8;
+	if (nlocks > 64)
+		nlocks = 64;
+	return nlocks;
+}
+
+/*
+ * GUC check_hook for wal_insert_locks
+ */
+bool
+check_wal_insert_locks(int *newval, void **extra, GucSource source)
+{
+	/*
+	 * -1 indicates a request for auto-tune.
+	 */
+	if (*newval == -1)
+	{
+		/*
+		 * If we haven't yet changed the boot_val default of -1, just let it
+		 * be.  We'll fix it when XLOGShmemSize is called.
+		 */
+		if (NumXLogInsertLocks == -1)
+			return true;
+
+		/* Otherwise, substitute the auto-tune value */
+		*newval = XLOGChooseNumInsertLocks();
+	}
+
+	if (*newval < 1)
+	{
+		GUC_check_errdetail("\"wal_insert_locks\" must be -1 or at least 1.");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Number of entries in the prev-link table.  At most NumXLogInsertLocks + 1
+ * entries are in use at a time (see XLogPrevLinkPublish()); keep the table
+ * at most half full so that probe sequences stay short.
+ */
+static uint32
+XLOGNumPrevLinks(void)
+{
+	return pg_nextpower2_32((uint32) (NumXLogInsertLocks + 1) * 2);
+}
+
 /*
  * Read the control file, set respective GUCs.
  *
@@ -5061,11 +5626,24 @@ XLOGShmemSize(void)
 	}
 	Assert(XLOGbuffers > 0);
 
+	/* Likewise for wal_insert_locks */
+	if (NumXLogInsertLocks == -1)
+	{
+		char		buf[32];
+
+		snprintf(buf, sizeof(buf), "%d", XLOGChooseNumInsertLocks());
+		SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER,
+						PGC_S_OVERRIDE);
+	}
+	Assert(NumXLogInsertLocks > 0);
+
 	/* XLogCtl */
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NumXLogInsertLocks + 1));
+	/* prev-link table */
+	size = add_size(size, mul_size(sizeof(XLogPrevLink), XLOGNumPrevLinks()));
 	/* xlblocks array */
 	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
@@ -5155,15 +5733,26 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * NumXLogInsertLocks;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < NumXLogInsertLocks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
 		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
 		WALInsertLocks[i].l.lastImportantAt = InvalidXLogRecPtr;
 	}
 
+	/* prev-link table, all slots initially free */
+	XLogCtl->Insert.numPrevLinks = XLOGNumPrevLinks();
+	XLogCtl->Insert.PrevLinks = (XLogPrevLink *) allocptr;
+	allocptr += sizeof(XLogPrevLink) * XLogCtl->Insert.numPrevLinks;
+
+	for (i = 0; i < XLogCtl->Insert.numPrevLinks; i++)
+	{
+		pg_atomic_init_u64(&XLogCtl->Insert.PrevLinks[i].endpos, 0);
+		pg_atomic_init_u64(&XLogCtl->Insert.PrevLinks[i].startpos, 0);
+	}
+
 	/*
 	 * Align the start of the page buffers to a full xlog block size boundary.
 	 * This simplifies some calculations in XLOG insertion. It is also
@@ -5183,7 +5772,10 @@ XLOGShmemInit(void)
 	XLogCtl->SharedPromoteIsTriggered = false;
 	XLogCtl->WalWriterSleeping = false;
 
-	SpinLockInit(&XLogCtl->Insert.insertpos_lck);
+	pg_atomic_init_u64(&XLogCtl->Insert.CurrBytePos, 0);
+	pg_atomic_init_u64(&XLogCtl->logInsertResult, InvalidXLogRecPtr);
+	pg_atomic_init_u64(&XLogCtl->flushLatency, 0);
+	pg_atomic_init_u32(&XLogCtl->lastFlushGroupSize, 0);
 	SpinLockInit(&XLogCtl->info_lck);
 	SpinLockInit(&XLogCtl->ulsn_lck);
 }
@@ -6016,6 +6608,9 @@ recoveryPausesHere(bool endOfRecovery)
 	if (LocalPromoteIsTriggered)
 		return;
 
+	/* Let everything handed to parallel redo workers be replayed first */
+	ParallelRedoBarrier();
+
 	if (endOfRecovery)
 		ereport(LOG,
 				(errmsg("pausing at the end of recovery"),
@@ -7168,11 +7763,18 @@ StartupXLOG(void)
 			ErrorContextCallback errcallback;
 			TimestampTz xtime;
 			PGRUsage	ru0;
+			XLogPrefetcher *prefetcher;
 
 			pg_rusage_init(&ru0);
 
 			InRedo = true;
 
+			/* Prepare to prefetch blocks referenced by upcoming records */
+			prefetcher = XLogPrefetcherAllocate();
+
+			/* Launch parallel redo workers, if enabled */
+			ParallelRedoStartWorkers();
+
 			ereport(LOG,
 					(errmsg("redo starts at %X/%X",
 							(uint32) (ReadRecPtr >> 32), (uint32) ReadRecPtr)));
@@ -7248,6 +7850,13 @@ StartupXLOG(void)
 						recoveryPausesHere(false);
 				}
 
+				/*
+				 * Look ahead in the WAL and start reading blocks that will
+				 * be needed soon.
+				 */
+				XLogPrefetcherReadAhead(prefetcher, xlogreader, curFileTLI,
+										currentSource == XLOG_FROM_STREAM);
+
 				/* Setup error traceback support for ereport() */
 				errcallback.callback = rm_redo_error_callback;
 				errcallback.arg = (void *) xlogreader;
@@ -7320,17 +7929,24 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
-				/* Now apply the WAL record itself */
-				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
-
 				/*
-				 * After redo, check whether the backup pages associated with
-				 * the WAL record are consistent with the existing pages. This
-				 * check is done only if consistency check is enabled for this
-				 * record.
+				 * Now apply the WAL record itself, unless a parallel redo
+				 * worker will do that.  For those records, the positions
+				 * below only mean that the record has been handed over.
 				 */
-				if ((record->xl_info & XLR_CHECK_CONSISTENCY) != 0)
-					checkXLogConsistency(xlogreader);
+				if (!ParallelRedoDispatch(xlogreader))
+				{
+					RmgrTable[record->xl_rmid].rm_redo(xlogreader);
+
+					/*
+					 * After redo, check whether the backup pages associated
+					 * with the WAL record are consistent with the existing
+					 * pages. This check is done only if consistency check is
+					 * enabled for this record.
+					 */
+					if ((record->xl_info & XLR_CHECK_CONSISTENCY) != 0)
+						checkXLogConsistency(xlogreader);
+				}
 
 				/* Pop the error context stack */
 				error_context_stack = errcallback.previous;
@@ -7394,6 +8010,9 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			ParallelRedoStopWorkers();
+			XLogPrefetcherFree(prefetcher);
+
 			if (reachedRecoveryTarget)
 			{
 				if (!reachedConsistency)
@@ -7659,8 +8278,9 @@ StartupXLOG(void)
 	 * previous incarnation.
 	 */
 	Insert = &XLogCtl->Insert;
-	Insert->PrevBytePos = XLogRecPtrToBytePos(LastRec);
-	Insert->CurrBytePos = XLogRecPtrToBytePos(EndOfLog);
+	pg_atomic_write_u64(&Insert->CurrBytePos, XLogRecPtrToBytePos(EndOfLog));
+	XLogPrevLinkPublish(Insert, XLogRecPtrToBytePos(EndOfLog),
+						XLogRecPtrToBytePos(LastRec));
 
 	/*
 	 * Tricky point here: readBuf contains the *last* block that the LastRec
@@ -7992,6 +8612,9 @@ CheckRecoveryConsistency(void)
 	if (!XLogRecPtrIsInvalid(ControlFile->backupEndPoint) &&
 		ControlFile->backupEndPoint <= lastReplayedEndRecPtr)
 	{
+		/* Records handed to parallel redo workers must be replayed, too */
+		ParallelRedoBarrier();
+
 		/*
 		 * We have reached the end of base backup, as indicated by pg_control.
 		 * The data on disk is now consistent. Reset backupStartPoint and
@@ -8025,6 +8648,9 @@ CheckRecoveryConsistency(void)
 		minRecoveryPoint <= lastReplayedEndRecPtr &&
 		XLogRecPtrIsInvalid(ControlFile->backupStartPoint))
 	{
+		/* Records handed to parallel redo workers must be replayed, too */
+		ParallelRedoBarrier();
+
 		/*
 		 * Check to see if the XLOG sequence contained any unresolved
 		 * references to uninitialized pages.
@@ -8443,7 +9069,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < NumXLogInsertLocks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -8818,7 +9444,7 @@ CreateCheckPoint(int flags)
 	 * determine the checkpoint REDO pointer.
 	 */
 	WALInsertLockAcquireExclusive();
-	curInsert = XLogBytePosToRecPtr(Insert->CurrBytePos);
+	curInsert = XLogBytePosToRecPtr(pg_atomic_read_u64(&Insert->CurrBytePos));
 
 	/*
 	 * If this isn't a shutdown or forced checkpoint, and if there has been no
@@ -9604,7 +10230,7 @@ GetWALAvailability(XLogRecPtr targetLSN)
 
 /*
  * Retreat *logSegNo to the last segment that we need to retain because of
- * either wal_keep_size or replication slots.
+ * wal_keep_size, replication slots or the WAL summarizer.
  *
  * This is calculated by subtracting wal_keep_size from the given xlog
  * location, recptr and by making sure that that result is below the
@@ -9660,6 +10286,17 @@ KeepLogSeg(XLogRecPtr recptr, XLogSegNo *logSegNo)
 		}
 	}
 
+	/* and keep whatever the WAL summarizer has yet to read */
+	keep = GetOldestUnsummarizedLSN();
+	if (keep != InvalidXLogRecPtr)
+	{
+		XLogSegNo	summarizer_segno;
+
+		XLByteToSeg(keep, summarizer_segno, wal_segment_size);
+		if (summarizer_segno < segno)
+			segno = summarizer_segno;
+	}
+
 	/* don't delete WAL segments newer than the calculated segment */
 	if (segno < *logSegNo)
 		*logSegNo = segno;
@@ -10347,9 +10984,18 @@ get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
 
+	/*
+	 * If direct I/O was requested for WAL, use it regardless of the sync
+	 * method, except in walreceiver for the reasons explained below.  WAL is
+	 * always written from XLOG_BLCKSZ-aligned buffers in whole pages, so it
+	 * meets the alignment requirements.
+	 */
+	if ((io_direct_flags & IO_DIRECT_WAL) && !AmWalReceiverProcess())
+		o_direct_flag = PG_O_DIRECT;
+
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return o_direct_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -10379,7 +11025,7 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return (io_direct_flags & IO_DIRECT_WAL) ? o_direct_flag : 0;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
 			return OPEN_SYNC_FLAG | o_direct_flag;
@@ -11537,9 +12183,7 @@ GetXLogInsertRecPtr(void)
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	uint64		current_bytepos;
 
-	SpinLockAcquire(&Insert->insertpos_lck);
-	current_bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	current_bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	return XLogBytePosToRecPtr(current_bytepos);
 }
@@ -11691,6 +12335,17 @@ read_backup_label(XLogRecPtr *checkPointLoc, bool *backupEndRequired,
 						tli_from_file, BACKUP_LABEL_FILE)));
 	}
 
+	/*
+	 * An incremental backup only contains the blocks changed since an
+	 * earlier backup, so it can't be used until pg_combinebackup has
+	 * reconstructed the full files.
+	 */
+	if (fscanf(lfp, "INCREMENTAL FROM LSN: %X/%X\n", &hi, &lo) > 0)
+		ereport(FATAL,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("this is an incremental backup, not a data directory"),
+				 errhint("Use pg_combinebackup to reconstruct a valid data directory.")));
+
 	if (ferror(lfp) || FreeFile(lfp))
 		ereport(FATAL,
 				(errcode_for_file_access(),
@@ -19,11 +19,20 @@
 
 #include "postgres.h"
 
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
 #include "catalog/pg_control.h"
+#include "common/hashfn.h"
 #include "common/pg_lzcompress.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
@@ -33,8 +42,25 @@
 #include "storage/proc.h"
 #include "utils/memutils.h"
 
-/* Buffer size required to store a compressed version of backup block image */
-#define PGLZ_MAX_BLCKSZ PGLZ_MAX_OUTPUT(BLCKSZ)
+/*
+ * Guess the maximum buffer size required to store a compressed version of
+ * backup block image.
+ */
+#ifdef USE_LZ4
+#define LZ4_MAX_BLCKSZ		LZ4_COMPRESSBOUND(BLCKSZ)
+#else
+#define LZ4_MAX_BLCKSZ		0
+#endif
+
+#ifdef USE_ZSTD
+#define ZSTD_MAX_BLCKSZ		ZSTD_COMPRESSBOUND(BLCKSZ)
+#else
+#define ZSTD_MAX_BLCKSZ		0
+#endif
+
+#define PGLZ_MAX_BLCKSZ		PGLZ_MAX_OUTPUT(BLCKSZ)
+
+#define COMPRESS_BUFSIZE	Max(Max(PGLZ_MAX_BLCKSZ, LZ4_MAX_BLCKSZ), ZSTD_MAX_BLCKSZ)
 
 /*
  * For each block reference registered with XLogRegisterBuffer, we fill in
@@ -57,8 +83,13 @@ typedef struct
 	XLogRecData bkp_rdatas[2];	/* temporary rdatas used to hold references to
 								 * backup block data in XLogRecordAssemble() */
 
+	/* wal_fpi_dedup state, set by XLogRecordAssemble() */
+	bool		fpi_remember;	/* remember the image once inserted? */
+	pg_crc32c	fpi_crc;		/* CRC of the image, see XLogFPIDedupCRC() */
+	XLogRecPtr	fpi_ref_lsn;	/* payload of an image reference */
+
 	/* buffer to store a compressed version of backup block image */
-	char		compressed_page[PGLZ_MAX_BLCKSZ];
+	char		compressed_page[COMPRESS_BUFSIZE];
 } registered_buffer;
 
 static registered_buffer *registered_buffers;
@@ -70,6 +101,25 @@ static int	max_registered_block_id = 0;	/* highest block_id + 1 currently
  * A chain of XLogRecDatas to hold the "main data" of a WAL record, registered
  * with XLogRegisterData(...).
  */
+/*
+ * Backend-local cache of recently logged full-page images, for
+ * wal_fpi_dedup.  It is direct-mapped by block; an entry can only be used
+ * while the page is still stamped with the end of the record that carried
+ * the image, and only within the checkpoint cycle it was logged in.
+ */
+#define FPI_DEDUP_CACHE_SIZE	256
+
+typedef struct
+{
+	RelFileNode rnode;
+	ForkNumber	forkno;
+	BlockNumber block;
+	XLogRecPtr	lsn;			/* end of the record holding the image */
+	pg_crc32c	crc;			/* CRC of the image */
+} FPIDedupEntry;
+
+static FPIDedupEntry fpi_dedup_cache[FPI_DEDUP_CACHE_SIZE];
+
 static XLogRecData *mainrdata_head;
 static XLogRecData *mainrdata_last = (XLogRecData *) &mainrdata_head;
 static uint32 mainrdata_len;	/* total # of bytes in chain */
@@ -112,6 +162,10 @@ static MemoryContext xloginsert_cxt;
 static XLogRecData *XLogRecordAssemble(RmgrId rmid, uint8 info,
 									   XLogRecPtr RedoRecPtr, bool doPageWrites,
 									   XLogRecPtr *fpw_lsn, int *num_fpi);
+static FPIDedupEntry *XLogFPIDedupSlot(registered_buffer *regbuf);
+static pg_crc32c XLogFPIDedupCRC(Page page, uint16 hole_offset,
+								 uint16 hole_length);
+static void XLogFPIDedupRemember(XLogRecPtr EndPos);
 static bool XLogCompressBackupBlock(char *page, uint16 hole_offset,
 									uint16 hole_length, char *dest, uint16 *dlen);
 
@@ -470,6 +524,9 @@ XLogInsert(RmgrId rmid, uint8 info)
 		EndPos = XLogInsertRecord(rdt, fpw_lsn, curinsert_flags, num_fpi);
 	} while (EndPos == InvalidXLogRecPtr);
 
+	if (wal_fpi_dedup)
+		XLogFPIDedupRemember(EndPos);
+
 	XLogResetInsertion();
 
 	return EndPos;
@@ -539,11 +596,14 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 		XLogRecordBlockCompressHeader cbimg = {0};
 		bool		samerel;
 		bool		is_compressed = false;
+		bool		is_ref = false;
 		bool		include_image;
 
 		if (!regbuf->in_use)
 			continue;
 
+		regbuf->fpi_remember = false;
+
 		/* Determine if this block needs to be backed up */
 		if (regbuf->flags & REGBUF_FORCE_IMAGE)
 			needs_backup = true;
@@ -625,10 +685,51 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 				cbimg.hole_length = 0;
 			}
 
+			/*
+			 * If wal_fpi_dedup is enabled and this is a forced image of a
+			 * standard page that has not changed since we last logged an
+			 * image of it in this checkpoint cycle, refer to that image
+			 * instead of logging it again.  The page LSN still being the end
+			 * of that record means nothing else has been logged for the page
+			 * since; the CRC catches unlogged changes such as hint bits.
+			 */
+			if (wal_fpi_dedup && needs_backup && doPageWrites &&
+				(info & XLR_CHECK_CONSISTENCY) == 0 &&
+				(regbuf->flags & REGBUF_FORCE_IMAGE) &&
+				(regbuf->flags & REGBUF_STANDARD) &&
+				(regbuf->flags & REGBUF_WILL_INIT) != REGBUF_WILL_INIT)
+			{
+				FPIDedupEntry *entry = XLogFPIDedupSlot(regbuf);
+				XLogRecPtr	page_lsn = PageGetLSN(page);
+
+				regbuf->fpi_crc = XLogFPIDedupCRC(page, bimg.hole_offset,
+												  cbimg.hole_length);
+				regbuf->fpi_remember = true;
+
+				if (page_lsn > RedoRecPtr &&
+					entry->lsn == page_lsn &&
+					entry->crc == regbuf->fpi_crc &&
+					RelFileNodeEquals(entry->rnode, regbuf->rnode) &&
+					entry->forkno == regbuf->forkno &&
+					entry->block == regbuf->block)
+				{
+					is_ref = true;
+					regbuf->fpi_ref_lsn = page_lsn;
+
+					/*
+					 * The reference is only valid if the earlier image is
+					 * replayed, so have XLogInsertRecord() recheck it against
+					 * the current RedoRecPtr like any skipped image.
+					 */
+					if (*fpw_lsn == InvalidXLogRecPtr || page_lsn < *fpw_lsn)
+						*fpw_lsn = page_lsn;
+				}
+			}
+
 			/*
 			 * Try to compress a block image if wal_compression is enabled
 			 */
-			if (wal_compression)
+			if (!is_ref && wal_compression != WAL_COMPRESSION_NONE)
 			{
 				is_compressed =
 					XLogCompressBackupBlock(page, bimg.hole_offset,
@@ -644,7 +745,8 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			bkpb.fork_flags |= BKPBLOCK_HAS_IMAGE;
 
 			/* Report a full page image constructed for the WAL record */
-			*num_fpi += 1;
+			if (!is_ref)
+				*num_fpi += 1;
 
 			/*
 			 * Construct XLogRecData entries for the page content.
@@ -663,10 +765,49 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			if (needs_backup)
 				bimg.bimg_info |= BKPIMAGE_APPLY;
 
-			if (is_compressed)
+			if (is_ref)
 			{
+				/* The image is replaced by the LSN of the earlier one */
+				bimg.bimg_info = BKPIMAGE_APPLY | BKPIMAGE_IS_REF;
+				bimg.hole_offset = 0;
+				bimg.length = sizeof(XLogRecPtr);
+
+				rdt_datas_last->data = (char *) &regbuf->fpi_ref_lsn;
+				rdt_datas_last->len = sizeof(XLogRecPtr);
+			}
+			else if (is_compressed)
+			{
+				/* The current compression is stored in the WAL record */
 				bimg.length = compressed_len;
-				bimg.bimg_info |= BKPIMAGE_IS_COMPRESSED;
+
+				/* Set the compression method used for this block */
+				switch ((WalCompression) wal_compression)
+				{
+					case WAL_COMPRESSION_PGLZ:
+						bimg.bimg_info |= BKPIMAGE_COMPRESS_PGLZ;
+						break;
+
+					case WAL_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+						bimg.bimg_info |= BKPIMAGE_COMPRESS_LZ4;
+#else
+						elog(ERROR, "LZ4 is not supported by this build");
+#endif
+						break;
+
+					case WAL_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+						bimg.bimg_info |= BKPIMAGE_COMPRESS_ZSTD;
+#else
+						elog(ERROR, "zstd is not supported by this build");
+#endif
+						break;
+
+					case WAL_COMPRESSION_NONE:
+						Assert(false);	/* cannot happen */
+						break;
+						/* no default case, so that compiler will warn */
+				}
 
 				rdt_datas_last->data = regbuf->compressed_page;
 				rdt_datas_last->len = compressed_len;
@@ -818,6 +959,73 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	return &hdr_rdt;
 }
 
+/*
+ * Returns the wal_fpi_dedup cache slot for a registered block.
+ */
+static FPIDedupEntry *
+XLogFPIDedupSlot(registered_buffer *regbuf)
+{
+	uint32		hash;
+
+	hash = hash_combine(murmurhash32(regbuf->rnode.relNode),
+						murmurhash32(regbuf->block ^ (regbuf->forkno << 28)));
+	return &fpi_dedup_cache[hash % FPI_DEDUP_CACHE_SIZE];
+}
+
+/*
+ * Compute the CRC that identifies the content of a standard page image.
+ *
+ * pd_lsn and pd_checksum are left out, as they change without the page
+ * content changing, and so is the hole, which is not logged anyway.
+ */
+static pg_crc32c
+XLogFPIDedupCRC(Page page, uint16 hole_offset, uint16 hole_length)
+{
+	pg_crc32c	crc;
+	Size		start = offsetof(PageHeaderData, pd_flags);
+
+	INIT_CRC32C(crc);
+	if (hole_length == 0)
+		COMP_CRC32C(crc, page + start, BLCKSZ - start);
+	else
+	{
+		COMP_CRC32C(crc, page + start, hole_offset - start);
+		COMP_CRC32C(crc, page + (hole_offset + hole_length),
+					BLCKSZ - (hole_offset + hole_length));
+	}
+	FIN_CRC32C(crc);
+
+	return crc;
+}
+
+/*
+ * Remember the images logged by the record just inserted, ending at EndPos,
+ * so that later unchanged images of the same blocks can refer to them.
+ * References are remembered too: after replay, the page carries the end of
+ * the referencing record just as it would after a real image.
+ */
+static void
+XLogFPIDedupRemember(XLogRecPtr EndPos)
+{
+	int			block_id;
+
+	for (block_id = 0; block_id < max_registered_block_id; block_id++)
+	{
+		registered_buffer *regbuf = &registered_buffers[block_id];
+		FPIDedupEntry *entry;
+
+		if (!regbuf->in_use || !regbuf->fpi_remember)
+			continue;
+
+		entry = XLogFPIDedupSlot(regbuf);
+		entry->rnode = regbuf->rnode;
+		entry->forkno = regbuf->forkno;
+		entry->block = regbuf->block;
+		entry->lsn = EndPos;
+		entry->crc = regbuf->fpi_crc;
+	}
+}
+
 /*
  * Create a compressed version of a backup block image.
  *
@@ -830,7 +1038,7 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 						char *dest, uint16 *dlen)
 {
 	int32		orig_len = BLCKSZ - hole_length;
-	int32		len;
+	int32		len = -1;
 	int32		extra_bytes = 0;
 	char	   *source;
 	PGAlignedBlock tmp;
@@ -853,12 +1061,49 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 	else
 		source = page;
 
+	switch ((WalCompression) wal_compression)
+	{
+		case WAL_COMPRESSION_PGLZ:
+			len = pglz_compress(source, orig_len, dest, PGLZ_strategy_default);
+			break;
+
+		case WAL_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			len = LZ4_compress_default(source, dest, orig_len,
+									   COMPRESS_BUFSIZE);
+			if (len <= 0)
+				len = -1;		/* failure */
+#else
+			elog(ERROR, "LZ4 is not supported by this build");
+#endif
+			break;
+
+		case WAL_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				size_t		zlen;
+
+				zlen = ZSTD_compress(dest, COMPRESS_BUFSIZE, source, orig_len,
+									 ZSTD_CLEVEL_DEFAULT);
+				if (!ZSTD_isError(zlen))
+					len = (int32) zlen;
+			}
+#else
+			elog(ERROR, "zstd is not supported by this build");
+#endif
+			break;
+
+		case WAL_COMPRESSION_NONE:
+			Assert(false);		/* cannot happen */
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
 	/*
-	 * We recheck the actual size even if pglz_compress() reports success and
-	 * see if the number of bytes saved by compression is larger than the
-	 * length of extra data needed for the compressed version of block image.
+	 * We recheck the actual size even if compression reports success and see
+	 * if the number of bytes saved by compression is larger than the length
+	 * of extra data needed for the compressed version of block image.
 	 */
-	len = pglz_compress(source, orig_len, dest, PGLZ_strategy_default);
 	if (len >= 0 &&
 		len + extra_bytes < orig_len)
 	{
@@ -0,0 +1,861 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.c
+ *		Parallel WAL redo.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogparallel.c
+ *
+ * When recovery_parallel_workers is set, the startup process launches that
+ * many parallel redo workers before entering the main redo loop, and hands
+ * some of the records it reads over to them instead of replaying them
+ * itself.  Each worker has a ring buffer in shared memory, into which the
+ * startup process copies raw WAL records; the worker decodes each record
+ * with its own XLogReaderState and calls the resource manager's redo
+ * routine.
+ *
+ * Only records that modify exactly one block, and whose redo routine touches
+ * nothing but that block (plus the free space map and visibility map bits
+ * for it, which are protected by buffer locks) are handed over.  They are
+ * distributed by a hash of the block's RelFileNode and block number, so all
+ * changes to one block are replayed by the same worker, in WAL order.
+ * Changes to different blocks can be replayed in any order relative to each
+ * other, because nothing can look at them until the transaction that made
+ * them commits.
+ *
+ * All other records are replayed by the startup process, and act as
+ * barriers: before replaying one, the startup process waits for all the
+ * workers to finish the records that came before it.  That covers records
+ * that touch several blocks (such as a B-tree page split, or a heap update
+ * that moves the tuple to another page), and those that create, truncate or
+ * drop relations.  Transaction commit and abort records that don't drop
+ * relations need to be barriers only if queries might be running, that is,
+ * in hot standby; otherwise they are replayed without waiting.  Standby
+ * records don't touch relations at all, so they never wait.
+ *
+ * Since workers extend relations concurrently, they serialize extension on
+ * ParallelRedoExtensionLock, and smgrnblocks() doesn't trust the sizes it
+ * has cached locally.  When a barrier record might have changed the size of
+ * some relation or dropped it, the workers close all their smgr relations
+ * before replaying anything else.
+ *
+ * A worker can't maintain the startup process's table of references to
+ * invalid pages, so it passes such references back to the startup process,
+ * which logs them whenever it waits for the workers.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/heapam_xlog.h"
+#include "access/nbtxlog.h"
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
+#include "access/xlogutils.h"
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+/* Size of each worker's queue of records */
+#define PARALLEL_REDO_QUEUE_SIZE (1024 * 1024)
+
+/* Larger records are replayed by the startup process */
+#define PARALLEL_REDO_MAX_RECORD_SIZE (PARALLEL_REDO_QUEUE_SIZE / 4)
+
+/* Number of invalid page references a worker can pass back at a time */
+#define PARALLEL_REDO_MAX_INVALID_PAGES 32
+
+/*
+ * Header of a record in a worker's queue.  The XLogRecord follows it.  A
+ * header with size 0 means that the rest of the ring is unused, and the
+ * next record starts at the beginning.
+ */
+typedef struct ParallelRedoEntry
+{
+	uint32		size;			/* total size, including header */
+	XLogRecPtr	ReadRecPtr;		/* start of the record */
+	XLogRecPtr	EndRecPtr;		/* end+1 of the record */
+} ParallelRedoEntry;
+
+#define ParallelRedoEntryHeaderSize MAXALIGN(sizeof(ParallelRedoEntry))
+
+/* A reference to an invalid page, passed back to the startup process */
+typedef struct ParallelRedoInvalidPage
+{
+	RelFileNode node;
+	ForkNumber	forkno;
+	BlockNumber blkno;
+	bool		present;
+} ParallelRedoInvalidPage;
+
+typedef struct ParallelRedoWorkerSlot
+{
+	/*
+	 * Positions in the queue, counted in bytes since the start of recovery.
+	 * insert_pos is advanced by the startup process after adding a record,
+	 * apply_pos by the worker after replaying one.
+	 */
+	pg_atomic_uint64 insert_pos;
+	pg_atomic_uint64 apply_pos;
+
+	Latch	   *latch;			/* the worker's latch, once it's running */
+	bool		sleeping;		/* worker is about to wait on its latch */
+	bool		failed;			/* worker exited before being told to */
+
+	slock_t		mutex;			/* protects the invalid page array */
+	int			ninvalid;
+	ParallelRedoInvalidPage invalid[PARALLEL_REDO_MAX_INVALID_PAGES];
+} ParallelRedoWorkerSlot;
+
+typedef struct ParallelRedoCtlData
+{
+	Latch	   *startup_latch;
+	bool		startup_sleeping;	/* startup process is waiting for us */
+	bool		shutdown;		/* workers should exit */
+
+	/* Advanced when workers have to close their smgr relations */
+	pg_atomic_uint32 smgr_generation;
+
+	ParallelRedoWorkerSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} ParallelRedoCtlData;
+
+static ParallelRedoCtlData *ParallelRedo = NULL;
+static char *ParallelRedoQueues = NULL;
+
+/* GUCs */
+int			recovery_parallel_workers = 0;
+
+bool		am_parallel_redo_worker = false;
+
+/* Our slot, in a parallel redo worker */
+static ParallelRedoWorkerSlot *MyParallelRedoSlot = NULL;
+
+/* Workers started by the startup process */
+static int	parallel_redo_nworkers = 0;
+static BackgroundWorkerHandle **parallel_redo_handles = NULL;
+
+static void parallel_redo_terminate_workers(int nworkers);
+static bool parallel_redo_is_block_local(XLogReaderState *record);
+static bool parallel_redo_xact_drops_relations(XLogReaderState *record);
+static void parallel_redo_enqueue(int worker, XLogReaderState *record);
+static bool parallel_redo_all_idle(void);
+static void parallel_redo_sleep(uint32 wait_event_info);
+static void parallel_redo_drain_invalid_pages(void);
+static void parallel_redo_worker_exit(int code, Datum arg);
+static void parallel_redo_error_callback(void *arg);
+
+static inline char *
+parallel_redo_queue(int worker)
+{
+	return ParallelRedoQueues + (Size) worker * PARALLEL_REDO_QUEUE_SIZE;
+}
+
+/*
+ * Report shared memory space needed by ParallelRedoShmemInit.
+ */
+Size
+ParallelRedoShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(ParallelRedoCtlData, slots);
+	size = add_size(size, mul_size(recovery_parallel_workers,
+								   sizeof(ParallelRedoWorkerSlot)));
+	size = BUFFERALIGN(size);
+	size = add_size(size, mul_size(recovery_parallel_workers,
+								   PARALLEL_REDO_QUEUE_SIZE));
+
+	return size;
+}
+
+/*
+ * Initialize the shared state for parallel redo.
+ */
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+	Size		offset;
+
+	ParallelRedo = (ParallelRedoCtlData *)
+		ShmemInitStruct("Parallel Redo", ParallelRedoShmemSize(), &found);
+
+	offset = BUFFERALIGN(offsetof(ParallelRedoCtlData, slots) +
+						 recovery_parallel_workers * sizeof(ParallelRedoWorkerSlot));
+	ParallelRedoQueues = (char *) ParallelRedo + offset;
+
+	if (!found)
+	{
+		ParallelRedo->startup_latch = NULL;
+		ParallelRedo->startup_sleeping = false;
+		ParallelRedo->shutdown = false;
+		pg_atomic_init_u32(&ParallelRedo->smgr_generation, 0);
+
+		for (int i = 0; i < recovery_parallel_workers; i++)
+		{
+			ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[i];
+
+			pg_atomic_init_u64(&slot->insert_pos, 0);
+			pg_atomic_init_u64(&slot->apply_pos, 0);
+			slot->latch = NULL;
+			slot->sleeping = false;
+			slot->failed = false;
+			SpinLockInit(&slot->mutex);
+			slot->ninvalid = 0;
+		}
+	}
+}
+
+/*
+ * Launch the parallel redo workers.  Called by the startup process before
+ * entering the main redo loop.  If the workers can't be started, we log a
+ * message and replay everything in the startup process.
+ */
+void
+ParallelRedoStartWorkers(void)
+{
+	BackgroundWorker bgw;
+	int			nworkers = recovery_parallel_workers;
+	int			i;
+
+	Assert(AmStartupProcess());
+
+	if (nworkers == 0)
+		return;
+
+	ParallelRedo->startup_latch = MyLatch;
+	ParallelRedo->startup_sleeping = false;
+	ParallelRedo->shutdown = false;
+	for (i = 0; i < nworkers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[i];
+
+		pg_atomic_write_u64(&slot->insert_pos, 0);
+		pg_atomic_write_u64(&slot->apply_pos, 0);
+		slot->latch = NULL;
+		slot->sleeping = false;
+		slot->failed = false;
+		slot->ninvalid = 0;
+	}
+
+	parallel_redo_handles = (BackgroundWorkerHandle **)
+		MemoryContextAllocZero(TopMemoryContext,
+							   nworkers * sizeof(BackgroundWorkerHandle *));
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	bgw.bgw_start_time = BgWorkerStart_PostmasterStart;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "ParallelRedoWorkerMain");
+	snprintf(bgw.bgw_type, BGW_MAXLEN, "parallel redo worker");
+	bgw.bgw_restart_time = BGW_NEVER_RESTART;
+	bgw.bgw_notify_pid = MyProcPid;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		snprintf(bgw.bgw_name, BGW_MAXLEN, "parallel redo worker %d", i);
+		bgw.bgw_main_arg = Int32GetDatum(i);
+
+		if (!RegisterDynamicBackgroundWorker(&bgw, &parallel_redo_handles[i]))
+		{
+			ereport(LOG,
+					(errmsg("could not register parallel redo worker, replaying WAL serially"),
+					 errhint("You might need to increase max_worker_processes.")));
+			parallel_redo_terminate_workers(i);
+			return;
+		}
+	}
+
+	for (i = 0; i < nworkers; i++)
+	{
+		pid_t		pid;
+
+		if (WaitForBackgroundWorkerStartup(parallel_redo_handles[i],
+										   &pid) != BGWH_STARTED)
+		{
+			ereport(LOG,
+					(errmsg("could not start parallel redo worker, replaying WAL serially")));
+			parallel_redo_terminate_workers(nworkers);
+			return;
+		}
+	}
+
+	parallel_redo_nworkers = nworkers;
+
+	ereport(LOG,
+			(errmsg("started %d parallel redo workers", nworkers)));
+}
+
+/*
+ * Wait for the workers to replay everything they've been given, and shut
+ * them down.  Called by the startup process at the end of redo.
+ */
+void
+ParallelRedoStopWorkers(void)
+{
+	int			nworkers = parallel_redo_nworkers;
+
+	if (nworkers == 0)
+		return;
+
+	ParallelRedoBarrier();
+
+	parallel_redo_nworkers = 0;
+	ParallelRedo->shutdown = true;
+	pg_memory_barrier();
+	for (int i = 0; i < nworkers; i++)
+	{
+		Latch	   *latch = ParallelRedo->slots[i].latch;
+
+		if (latch != NULL)
+			SetLatch(latch);
+	}
+
+	for (int i = 0; i < nworkers; i++)
+	{
+		WaitForBackgroundWorkerShutdown(parallel_redo_handles[i]);
+		pfree(parallel_redo_handles[i]);
+	}
+	pfree(parallel_redo_handles);
+	parallel_redo_handles = NULL;
+}
+
+/*
+ * Get rid of the first nworkers workers, after failing to start the rest.
+ */
+static void
+parallel_redo_terminate_workers(int nworkers)
+{
+	ParallelRedo->shutdown = true;
+	for (int i = 0; i < nworkers; i++)
+	{
+		TerminateBackgroundWorker(parallel_redo_handles[i]);
+		WaitForBackgroundWorkerShutdown(parallel_redo_handles[i]);
+		pfree(parallel_redo_handles[i]);
+	}
+	pfree(parallel_redo_handles);
+	parallel_redo_handles = NULL;
+}
+
+/*
+ * Hand a record over to a parallel redo worker, if that's allowed.  Returns
+ * true if a worker will replay it.  Otherwise, waits for the workers to
+ * catch up if the record has to be replayed after all earlier records, and
+ * returns false; the caller must then replay the record itself.
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	uint8		rmid = XLogRecGetRmid(record);
+
+	if (parallel_redo_nworkers == 0)
+		return false;
+
+	if (parallel_redo_is_block_local(record))
+	{
+		RelFileNode rnode;
+		BlockNumber blkno;
+		uint32		hash;
+
+		XLogRecGetBlockTag(record, 0, &rnode, NULL, &blkno);
+		hash = hash_bytes((const unsigned char *) &rnode, sizeof(rnode));
+		hash = hash_combine(hash, hash_uint32(blkno));
+
+		parallel_redo_enqueue(hash % parallel_redo_nworkers, record);
+
+		return true;
+	}
+
+	/* Standby records don't touch relations. */
+	if (rmid == RM_STANDBY_ID)
+		return false;
+
+	/*
+	 * A commit or abort only needs to wait if queries could see its effects
+	 * before the changes it made are replayed.
+	 */
+	if (rmid == RM_XACT_ID && !parallel_redo_xact_drops_relations(record))
+	{
+		if (standbyState != STANDBY_DISABLED)
+			ParallelRedoBarrier();
+		return false;
+	}
+
+	ParallelRedoBarrier();
+
+	/*
+	 * This record might extend, truncate or drop relations, so the workers
+	 * mustn't trust any sizes or file descriptors they have cached.  They
+	 * are all idle now, and will notice before replaying anything else.
+	 */
+	pg_atomic_fetch_add_u32(&ParallelRedo->smgr_generation, 1);
+
+	return false;
+}
+
+/*
+ * Can this record be replayed by a worker, concurrently with records that
+ * modify other blocks?
+ */
+static bool
+parallel_redo_is_block_local(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	if (record->max_block_id != 0 || !record->blocks[0].in_use)
+		return false;
+
+	/* The consistency check runs in the startup process */
+	if ((XLogRecGetInfo(record) & XLR_CHECK_CONSISTENCY) != 0)
+		return false;
+
+	if (XLogRecGetTotalLen(record) > PARALLEL_REDO_MAX_RECORD_SIZE)
+		return false;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+				case XLOG_HEAP_DELETE:
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+				case XLOG_HEAP_CONFIRM:
+				case XLOG_HEAP_LOCK:
+				case XLOG_HEAP_INPLACE:
+					return true;
+			}
+			break;
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_MULTI_INSERT:
+				case XLOG_HEAP2_LOCK_UPDATED:
+					return true;
+			}
+			break;
+		case RM_BTREE_ID:
+			switch (info)
+			{
+				case XLOG_BTREE_INSERT_LEAF:
+				case XLOG_BTREE_INSERT_POST:
+				case XLOG_BTREE_DEDUP:
+					return true;
+			}
+			break;
+	}
+
+	/*
+	 * Everything else either touches several blocks, or might have to
+	 * resolve conflicts with queries, which only the startup process does.
+	 */
+	return false;
+}
+
+/*
+ * Does this transaction record drop any relations?
+ */
+static bool
+parallel_redo_xact_drops_relations(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & XLOG_XACT_OPMASK;
+
+	if (info == XLOG_XACT_COMMIT || info == XLOG_XACT_COMMIT_PREPARED)
+	{
+		xl_xact_parsed_commit parsed;
+
+		ParseCommitRecord(XLogRecGetInfo(record),
+						  (xl_xact_commit *) XLogRecGetData(record), &parsed);
+		return parsed.nrels > 0;
+	}
+	else if (info == XLOG_XACT_ABORT || info == XLOG_XACT_ABORT_PREPARED)
+	{
+		xl_xact_parsed_abort parsed;
+
+		ParseAbortRecord(XLogRecGetInfo(record),
+						 (xl_xact_abort *) XLogRecGetData(record), &parsed);
+		return parsed.nrels > 0;
+	}
+
+	return false;
+}
+
+/*
+ * Copy a record into a worker's queue, waiting for space if necessary.
+ */
+static void
+parallel_redo_enqueue(int worker, XLogReaderState *record)
+{
+	ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[worker];
+	char	   *queue = parallel_redo_queue(worker);
+	ParallelRedoEntry *entry;
+	uint64		insert_pos;
+	Size		offset;
+	Size		size;
+	Size		needed;
+
+	insert_pos = pg_atomic_read_u64(&slot->insert_pos);
+	offset = insert_pos % PARALLEL_REDO_QUEUE_SIZE;
+	size = ParallelRedoEntryHeaderSize + MAXALIGN(XLogRecGetTotalLen(record));
+
+	/* If the record doesn't fit before the end, we skip to the start. */
+	needed = size;
+	if (offset + size > PARALLEL_REDO_QUEUE_SIZE)
+		needed += PARALLEL_REDO_QUEUE_SIZE - offset;
+
+	if (PARALLEL_REDO_QUEUE_SIZE -
+		(insert_pos - pg_atomic_read_u64(&slot->apply_pos)) < needed)
+	{
+		ParallelRedo->startup_sleeping = true;
+		pg_memory_barrier();
+		for (;;)
+		{
+			ResetLatch(MyLatch);
+			if (PARALLEL_REDO_QUEUE_SIZE -
+				(insert_pos - pg_atomic_read_u64(&slot->apply_pos)) >= needed)
+				break;
+			parallel_redo_sleep(WAIT_EVENT_PARALLEL_REDO_DISPATCH);
+		}
+		ParallelRedo->startup_sleeping = false;
+	}
+
+	if (offset + size > PARALLEL_REDO_QUEUE_SIZE)
+	{
+		entry = (ParallelRedoEntry *) (queue + offset);
+		entry->size = 0;
+		insert_pos += PARALLEL_REDO_QUEUE_SIZE - offset;
+		offset = 0;
+	}
+
+	entry = (ParallelRedoEntry *) (queue + offset);
+	entry->size = size;
+	entry->ReadRecPtr = record->ReadRecPtr;
+	entry->EndRecPtr = record->EndRecPtr;
+	memcpy(queue + offset + ParallelRedoEntryHeaderSize,
+		   record->decoded_record, XLogRecGetTotalLen(record));
+
+	/* Make the record visible before advancing insert_pos. */
+	pg_write_barrier();
+	pg_atomic_write_u64(&slot->insert_pos, insert_pos + size);
+
+	/* Wake the worker, if it went to sleep. */
+	pg_memory_barrier();
+	if (slot->sleeping)
+		SetLatch(slot->latch);
+}
+
+/*
+ * Wait until the workers have replayed all the records they've been given.
+ */
+void
+ParallelRedoBarrier(void)
+{
+	if (parallel_redo_nworkers == 0)
+		return;
+
+	if (!parallel_redo_all_idle())
+	{
+		ParallelRedo->startup_sleeping = true;
+		pg_memory_barrier();
+		for (;;)
+		{
+			ResetLatch(MyLatch);
+			if (parallel_redo_all_idle())
+				break;
+			parallel_redo_sleep(WAIT_EVENT_PARALLEL_REDO_BARRIER);
+		}
+		ParallelRedo->startup_sleeping = false;
+	}
+
+	/* Pick up any invalid page references from the records just replayed. */
+	parallel_redo_drain_invalid_pages();
+}
+
+static bool
+parallel_redo_all_idle(void)
+{
+	for (int i = 0; i < parallel_redo_nworkers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[i];
+
+		if (pg_atomic_read_u64(&slot->apply_pos) !=
+			pg_atomic_read_u64(&slot->insert_pos))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Sleep in the startup process, while waiting for the workers.
+ */
+static void
+parallel_redo_sleep(uint32 wait_event_info)
+{
+	/* A worker might be waiting for us to take its invalid page references. */
+	parallel_redo_drain_invalid_pages();
+
+	for (int i = 0; i < parallel_redo_nworkers; i++)
+	{
+		if (ParallelRedo->slots[i].failed)
+			ereport(FATAL,
+					(errmsg("parallel redo worker %d exited unexpectedly", i)));
+	}
+
+	(void) WaitLatch(MyLatch,
+					 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+					 1000L, wait_event_info);
+
+	HandleStartupProcInterrupts();
+}
+
+/*
+ * Log the invalid page references passed back by the workers.
+ */
+static void
+parallel_redo_drain_invalid_pages(void)
+{
+	ParallelRedoInvalidPage invalid[PARALLEL_REDO_MAX_INVALID_PAGES];
+
+	for (int i = 0; i < parallel_redo_nworkers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[i];
+		int			ninvalid;
+
+		SpinLockAcquire(&slot->mutex);
+		ninvalid = slot->ninvalid;
+		memcpy(invalid, slot->invalid,
+			   ninvalid * sizeof(ParallelRedoInvalidPage));
+		slot->ninvalid = 0;
+		SpinLockRelease(&slot->mutex);
+
+		for (int j = 0; j < ninvalid; j++)
+			XLogRememberInvalidPage(invalid[j].node, invalid[j].forkno,
+									invalid[j].blkno, invalid[j].present);
+	}
+}
+
+/*
+ * Called by a worker instead of logging an invalid page reference itself.
+ */
+void
+ParallelRedoForwardInvalidPage(RelFileNode node, ForkNumber forkno,
+							   BlockNumber blkno, bool present)
+{
+	ParallelRedoWorkerSlot *slot = MyParallelRedoSlot;
+
+	Assert(am_parallel_redo_worker);
+
+	for (;;)
+	{
+		SpinLockAcquire(&slot->mutex);
+		if (slot->ninvalid < PARALLEL_REDO_MAX_INVALID_PAGES)
+		{
+			ParallelRedoInvalidPage *ref = &slot->invalid[slot->ninvalid++];
+
+			ref->node = node;
+			ref->forkno = forkno;
+			ref->blkno = blkno;
+			ref->present = present;
+			SpinLockRelease(&slot->mutex);
+			return;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		/* Full; wait for the startup process to empty it. */
+		SetLatch(ParallelRedo->startup_latch);
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 10L, WAIT_EVENT_PARALLEL_REDO_MAIN);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Main entry point for a parallel redo worker.
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			worker = DatumGetInt32(main_arg);
+	ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[worker];
+	char	   *queue = parallel_redo_queue(worker);
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+	ErrorContextCallback errcallback;
+	uint32		smgr_generation;
+	uint64		apply_pos;
+
+	am_parallel_redo_worker = true;
+	MyParallelRedoSlot = slot;
+	InRecovery = true;
+
+	BackgroundWorkerUnblockSignals();
+	CreateAuxProcessResourceOwner();
+
+	reader = XLogReaderAllocate(wal_segment_size, NULL, XL_ROUTINE(), NULL);
+	if (!reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "parallel redo",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	before_shmem_exit(parallel_redo_worker_exit, main_arg);
+
+	slot->latch = MyLatch;
+	smgr_generation = pg_atomic_read_u32(&ParallelRedo->smgr_generation);
+	apply_pos = pg_atomic_read_u64(&slot->apply_pos);
+
+	for (;;)
+	{
+		ParallelRedoEntry *entry;
+		XLogRecord *xlrec;
+		Size		offset;
+		char	   *errormsg;
+		MemoryContext oldcontext;
+
+		if (pg_atomic_read_u64(&slot->insert_pos) == apply_pos)
+		{
+			if (ParallelRedo->shutdown)
+				break;
+
+			slot->sleeping = true;
+			pg_memory_barrier();
+			ResetLatch(MyLatch);
+			if (pg_atomic_read_u64(&slot->insert_pos) == apply_pos &&
+				!ParallelRedo->shutdown)
+				(void) WaitLatch(MyLatch,
+								 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+								 1000L, WAIT_EVENT_PARALLEL_REDO_MAIN);
+			slot->sleeping = false;
+			continue;
+		}
+
+		/* Read the record only after seeing insert_pos advance. */
+		pg_read_barrier();
+
+		if (pg_atomic_read_u32(&ParallelRedo->smgr_generation) != smgr_generation)
+		{
+			smgrcloseall();
+			smgr_generation = pg_atomic_read_u32(&ParallelRedo->smgr_generation);
+		}
+
+		offset = apply_pos % PARALLEL_REDO_QUEUE_SIZE;
+		entry = (ParallelRedoEntry *) (queue + offset);
+
+		if (entry->size == 0)
+		{
+			/* Skip to the start of the ring. */
+			apply_pos += PARALLEL_REDO_QUEUE_SIZE - offset;
+		}
+		else
+		{
+			xlrec = (XLogRecord *) (queue + offset + ParallelRedoEntryHeaderSize);
+			reader->ReadRecPtr = entry->ReadRecPtr;
+			reader->EndRecPtr = entry->EndRecPtr;
+			if (!DecodeXLogRecord(reader, xlrec, &errormsg))
+				ereport(ERROR,
+						(errmsg("could not decode WAL record at %X/%X: %s",
+								(uint32) (entry->ReadRecPtr >> 32),
+								(uint32) entry->ReadRecPtr,
+								errormsg)));
+
+			errcallback.callback = parallel_redo_error_callback;
+			errcallback.arg = (void *) reader;
+			errcallback.previous = error_context_stack;
+			error_context_stack = &errcallback;
+
+			oldcontext = MemoryContextSwitchTo(redo_context);
+			RmgrTable[xlrec->xl_rmid].rm_redo(reader);
+			MemoryContextSwitchTo(oldcontext);
+			MemoryContextReset(redo_context);
+
+			error_context_stack = errcallback.previous;
+
+			apply_pos += entry->size;
+		}
+
+		/* Done with the record; give the space back to the startup process. */
+		pg_memory_barrier();
+		pg_atomic_write_u64(&slot->apply_pos, apply_pos);
+
+		pg_memory_barrier();
+		if (ParallelRedo->startup_sleeping)
+			SetLatch(ParallelRedo->startup_latch);
+	}
+
+	proc_exit(0);
+}
+
+/*
+ * Tell the startup process if we're exiting when we weren't asked to.
+ */
+static void
+parallel_redo_worker_exit(int code, Datum arg)
+{
+	ParallelRedoWorkerSlot *slot = &ParallelRedo->slots[DatumGetInt32(arg)];
+
+	slot->sleeping = false;
+	if (!ParallelRedo->shutdown)
+	{
+		slot->failed = true;
+		pg_memory_barrier();
+		SetLatch(ParallelRedo->startup_latch);
+	}
+}
+
+/*
+ * Error context callback for errors occurring during rm_redo() in a worker.
+ */
+static void
+parallel_redo_error_callback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record);
+	const char *id;
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, RmgrTable[rmid].rm_name);
+	appendStringInfoChar(&buf, '/');
+
+	id = RmgrTable[rmid].rm_identify(info);
+	if (id == NULL)
+		appendStringInfo(&buf, "UNKNOWN (%X): ", info & ~XLR_INFO_MASK);
+	else
+		appendStringInfo(&buf, "%s: ", id);
+
+	RmgrTable[rmid].rm_desc(&buf, record);
+
+	/* translator: %s is a WAL record description */
+	errcontext("WAL redo at %X/%X for %s",
+			   (uint32) (record->ReadRecPtr >> 32),
+			   (uint32) record->ReadRecPtr,
+			   buf.data);
+
+	pfree(buf.data);
+}
@@ -0,0 +1,744 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching support for recovery.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogprefetch.c
+ *
+ * The goal of this module is to read future WAL records and issue
+ * PrefetchSharedBuffer() calls for referenced blocks, so that we avoid I/O
+ * stalls in the main recovery loop.
+ *
+ * The prefetcher has its own XLogReaderState, which runs ahead of the one
+ * used for replay, reading the same WAL files directly from pg_wal.  It
+ * never waits for WAL: if the data it needs hasn't been flushed by the WAL
+ * receiver yet, or the segment isn't in pg_wal (for example because it is
+ * being restored from the archive one file at a time), it simply stops and
+ * tries again later.  Whenever replay catches up with the point where the
+ * prefetcher had to stop, the prefetcher restarts from the replay position.
+ *
+ * The prefetcher stays at most recovery_prefetch_distance bytes of WAL
+ * ahead of replay, and has at most maintenance_io_concurrency prefetches in
+ * flight.  A prefetch is considered to be complete when replay reaches the
+ * record that referenced the block.
+ *
+ * Blocks that are restored from a full page image, or initialized from
+ * scratch, don't need to be read in and are skipped.  So are blocks of
+ * relations that don't exist yet, or are created or truncated by a record
+ * that hasn't been replayed yet; for those, we install a temporary filter
+ * that is removed when replay passes the record.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "catalog/storage_xlog.h"
+#include "commands/dbcommands_xlog.h"
+#include "funcapi.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "replication/walreceiver.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+/* Number of recently prefetched blocks remembered, to skip repeats */
+#define XLOGPREFETCHER_SEQ_WINDOW_SIZE 4
+
+/* Size of the queue of prefetches in flight */
+#define XLOGPREFETCHER_QUEUE_SIZE	(MAX_IO_CONCURRENCY + 1)
+
+/* GUCs */
+int			recovery_prefetch = RECOVERY_PREFETCH_TRY;
+int			recovery_prefetch_distance = 512 * 1024;
+
+/*
+ * A temporary filter used to track block ranges that haven't been created
+ * yet, whole relations that haven't been created yet, and whole relations
+ * that we must assume have already been dropped.
+ */
+typedef struct XLogPrefetcherFilter
+{
+	RelFileNode rnode;
+	XLogRecPtr	filter_until_replayed;
+	BlockNumber filter_from_block;
+	dlist_node	link;
+} XLogPrefetcherFilter;
+
+/*
+ * Counters exposed in shared memory for pg_stat_recovery_prefetch.
+ */
+typedef struct XLogPrefetchStats
+{
+	pg_atomic_uint64 reset_time;	/* Time of last reset. */
+	pg_atomic_uint64 prefetch;	/* Prefetches initiated. */
+	pg_atomic_uint64 hit;		/* Blocks already in cache. */
+	pg_atomic_uint64 skip_init; /* Zero-inited blocks skipped. */
+	pg_atomic_uint64 skip_new;	/* New/missing blocks filtered. */
+	pg_atomic_uint64 skip_fpw;	/* FPWs skipped. */
+	pg_atomic_uint64 skip_rep;	/* Repeat accesses skipped. */
+
+	/* Dynamic values */
+	int			wal_distance;	/* Number of WAL bytes ahead. */
+	int			io_depth;		/* Number of I/Os in progress. */
+} XLogPrefetchStats;
+
+/*
+ * Private state of the prefetcher, which lives in the startup process.
+ */
+struct XLogPrefetcher
+{
+	/* Reader used to look ahead, and its state */
+	XLogReaderState *reader;
+	bool		reading;		/* has reader been positioned? */
+	bool		have_record;	/* reader has a record we're working on */
+	int			next_block_id;	/* next block of that record to look at */
+	bool		stalled;		/* couldn't read the next record */
+	bool		wal_pending;	/* ... because it hasn't been received yet */
+
+	/* WAL file being read by reader */
+	int			readFile;
+	XLogSegNo	readSegNo;
+	TimeLineID	tli;
+	bool		streaming;
+
+	/* Blocks we shouldn't prefetch, because they might not exist */
+	HTAB	   *filter_table;
+	dlist_head	filter_queue;
+
+	/* LSNs of the records whose prefetches are in flight */
+	XLogRecPtr	prefetch_queue[XLOGPREFETCHER_QUEUE_SIZE];
+	int			prefetch_head;
+	int			prefetch_tail;
+
+	/* Recently prefetched blocks, to skip repeated accesses */
+	RelFileNode recent_rnode[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
+	BlockNumber recent_block[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
+	int			recent_idx;
+};
+
+static XLogPrefetchStats *SharedStats;
+
+static int	XLogPrefetcherPageRead(XLogReaderState *state,
+								   XLogRecPtr targetPagePtr, int reqLen,
+								   XLogRecPtr targetRecPtr, char *readBuf);
+static void XLogPrefetcherRestart(XLogPrefetcher *prefetcher,
+								  XLogReaderState *replay_reader);
+static bool XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher,
+									 XLogRecPtr replaying_lsn);
+static void XLogPrefetcherScanRecord(XLogPrefetcher *prefetcher);
+static void XLogPrefetcherAddFilter(XLogPrefetcher *prefetcher,
+									RelFileNode rnode, BlockNumber blockno,
+									XLogRecPtr lsn);
+static void XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
+										  XLogRecPtr replaying_lsn);
+static bool XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher,
+									 RelFileNode rnode, BlockNumber blockno);
+static inline int XLogPrefetcherQueueDepth(XLogPrefetcher *prefetcher);
+
+/*
+ * Increment a counter in shared memory.  This is equivalent to *counter++ on
+ * a plain uint64 without any memory barrier or locking, except on platforms
+ * where readers can't read uint64 without possibly observing a torn value.
+ */
+static inline void
+XLogPrefetchIncrement(pg_atomic_uint64 *counter)
+{
+	Assert(AmStartupProcess() || !IsUnderPostmaster);
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + 1);
+}
+
+Size
+XLogPrefetchShmemSize(void)
+{
+	return sizeof(XLogPrefetchStats);
+}
+
+void
+XLogPrefetchShmemInit(void)
+{
+	bool		found;
+
+	SharedStats = (XLogPrefetchStats *)
+		ShmemInitStruct("XLogPrefetchStats",
+						sizeof(XLogPrefetchStats),
+						&found);
+
+	if (!found)
+	{
+		pg_atomic_init_u64(&SharedStats->reset_time, GetCurrentTimestamp());
+		pg_atomic_init_u64(&SharedStats->prefetch, 0);
+		pg_atomic_init_u64(&SharedStats->hit, 0);
+		pg_atomic_init_u64(&SharedStats->skip_init, 0);
+		pg_atomic_init_u64(&SharedStats->skip_new, 0);
+		pg_atomic_init_u64(&SharedStats->skip_fpw, 0);
+		pg_atomic_init_u64(&SharedStats->skip_rep, 0);
+		SharedStats->wal_distance = 0;
+		SharedStats->io_depth = 0;
+	}
+}
+
+/*
+ * Reset all counters to zero.
+ */
+void
+XLogPrefetchResetStats(void)
+{
+	pg_atomic_write_u64(&SharedStats->reset_time, GetCurrentTimestamp());
+	pg_atomic_write_u64(&SharedStats->prefetch, 0);
+	pg_atomic_write_u64(&SharedStats->hit, 0);
+	pg_atomic_write_u64(&SharedStats->skip_init, 0);
+	pg_atomic_write_u64(&SharedStats->skip_new, 0);
+	pg_atomic_write_u64(&SharedStats->skip_fpw, 0);
+	pg_atomic_write_u64(&SharedStats->skip_rep, 0);
+}
+
+/*
+ * Is prefetching enabled?  If recovery_prefetch is "try", it's enabled only
+ * where we have a way to issue prefetch hints.
+ */
+static inline bool
+RecoveryPrefetchEnabled(void)
+{
+#ifdef USE_PREFETCH
+	return recovery_prefetch != RECOVERY_PREFETCH_OFF &&
+		maintenance_io_concurrency > 0;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Create a prefetcher that is ready to begin prefetching blocks referenced
+ * by WAL records.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(void)
+{
+	XLogPrefetcher *prefetcher;
+	HASHCTL		hash_table_ctl;
+
+	prefetcher = palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(wal_segment_size, NULL,
+											XL_ROUTINE(.page_read = &XLogPrefetcherPageRead,
+													   .segment_open = NULL,
+													   .segment_close = NULL),
+											prefetcher);
+	if (!prefetcher->reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	prefetcher->readFile = -1;
+
+	memset(&hash_table_ctl, 0, sizeof(hash_table_ctl));
+	hash_table_ctl.keysize = sizeof(RelFileNode);
+	hash_table_ctl.entrysize = sizeof(XLogPrefetcherFilter);
+	prefetcher->filter_table = hash_create("XLogPrefetcherFilterTable", 1024,
+										   &hash_table_ctl,
+										   HASH_ELEM | HASH_BLOBS);
+	dlist_init(&prefetcher->filter_queue);
+
+	SharedStats->wal_distance = 0;
+	SharedStats->io_depth = 0;
+
+	return prefetcher;
+}
+
+/*
+ * Destroy a prefetcher and release all resources.
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->readFile >= 0)
+		close(prefetcher->readFile);
+	XLogReaderFree(prefetcher->reader);
+	hash_destroy(prefetcher->filter_table);
+	pfree(prefetcher);
+
+	SharedStats->wal_distance = 0;
+	SharedStats->io_depth = 0;
+}
+
+/*
+ * Called before replaying each record.  'replay_reader' is the reader used
+ * for replay, positioned at the record about to be replayed.  'tli' is the
+ * timeline of the WAL file it's being read from, and 'streaming' says
+ * whether WAL is currently being received from a primary.
+ *
+ * Reads ahead and issues prefetches until we're far enough ahead of replay,
+ * or have enough prefetches in flight.
+ */
+void
+XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher,
+						XLogReaderState *replay_reader,
+						TimeLineID tli, bool streaming)
+{
+	XLogRecPtr	replaying_lsn = replay_reader->ReadRecPtr;
+
+	/* Forget about prefetches whose records have been replayed */
+	while (prefetcher->prefetch_tail != prefetcher->prefetch_head &&
+		   prefetcher->prefetch_queue[prefetcher->prefetch_tail] < replaying_lsn)
+		prefetcher->prefetch_tail = (prefetcher->prefetch_tail + 1) %
+			XLOGPREFETCHER_QUEUE_SIZE;
+
+	/* Allow filtered blocks that have been created by now */
+	XLogPrefetcherCompleteFilters(prefetcher, replaying_lsn);
+
+	if (!RecoveryPrefetchEnabled())
+	{
+		/* start over from the replay position if re-enabled later */
+		prefetcher->reading = false;
+		SharedStats->wal_distance = 0;
+		SharedStats->io_depth = XLogPrefetcherQueueDepth(prefetcher);
+		return;
+	}
+
+	prefetcher->streaming = streaming;
+
+	/*
+	 * If we had to stop because the WAL we need isn't available, and replay
+	 * has now caught up with us, restart from the replay position.  That
+	 * takes care of timeline switches and WAL restored from the archive,
+	 * too.  If we're waiting for streamed WAL that has since arrived, just
+	 * try again.
+	 */
+	if (!prefetcher->reading ||
+		prefetcher->reader->EndRecPtr <= replaying_lsn ||
+		tli != prefetcher->tli)
+	{
+		prefetcher->tli = tli;
+		XLogPrefetcherRestart(prefetcher, replay_reader);
+	}
+	else if (prefetcher->stalled && prefetcher->wal_pending &&
+			 GetWalRcvFlushRecPtr(NULL, NULL) > prefetcher->reader->EndRecPtr)
+		prefetcher->stalled = false;
+
+	while (!prefetcher->stalled)
+	{
+		char	   *errormsg;
+
+		/* Finish looking at the blocks of the current record */
+		if (prefetcher->have_record &&
+			!XLogPrefetcherScanBlocks(prefetcher, replaying_lsn))
+			break;				/* too many prefetches in flight */
+		prefetcher->have_record = false;
+
+		/* Don't get too far ahead of replay */
+		if (prefetcher->reader->EndRecPtr - replaying_lsn >=
+			recovery_prefetch_distance)
+			break;
+
+		prefetcher->wal_pending = false;
+		if (XLogReadRecord(prefetcher->reader, &errormsg) == NULL)
+		{
+			prefetcher->stalled = true;
+			break;
+		}
+
+		XLogPrefetcherScanRecord(prefetcher);
+		prefetcher->have_record = true;
+		prefetcher->next_block_id = 0;
+	}
+
+	SharedStats->wal_distance = prefetcher->reader->EndRecPtr > replaying_lsn ?
+		prefetcher->reader->EndRecPtr - replaying_lsn : 0;
+	SharedStats->io_depth = XLogPrefetcherQueueDepth(prefetcher);
+}
+
+/*
+ * Start reading ahead from the record following the one being replayed.
+ */
+static void
+XLogPrefetcherRestart(XLogPrefetcher *prefetcher,
+					  XLogReaderState *replay_reader)
+{
+	XLogBeginRead(prefetcher->reader, replay_reader->EndRecPtr);
+	prefetcher->reading = true;
+	prefetcher->have_record = false;
+	prefetcher->stalled = false;
+	prefetcher->wal_pending = false;
+}
+
+/*
+ * Look at the block references of the record the reader is positioned on,
+ * starting at next_block_id, and issue prefetches as needed.  Returns false
+ * if we have to stop because there are too many prefetches in flight.
+ */
+static bool
+XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher, XLogRecPtr replaying_lsn)
+{
+	XLogReaderState *reader = prefetcher->reader;
+
+	/* Nothing to do for records that replay has already reached */
+	if (reader->ReadRecPtr <= replaying_lsn)
+		return true;
+
+	for (; prefetcher->next_block_id <= reader->max_block_id;
+		 prefetcher->next_block_id++)
+	{
+		DecodedBkpBlock *block = &reader->blocks[prefetcher->next_block_id];
+		PrefetchBufferResult result;
+		SMgrRelation reln;
+		int			i;
+
+		if (!block->in_use)
+			continue;
+
+		/*
+		 * Pages restored from a full page image don't need to be read, but
+		 * references to an earlier image do.
+		 */
+		if (block->has_image && block->apply_image &&
+			(block->bimg_info & BKPIMAGE_IS_REF) == 0)
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_fpw);
+			continue;
+		}
+
+		/* Pages that are zeroed by redo don't need to be read either */
+		if (block->flags & BKPBLOCK_WILL_INIT)
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_init);
+			continue;
+		}
+
+		/* Should we skip this block due to a filter? */
+		if (XLogPrefetcherIsFiltered(prefetcher, block->rnode, block->blkno))
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			continue;
+		}
+
+		/* Have we prefetched it recently? */
+		for (i = 0; i < XLOGPREFETCHER_SEQ_WINDOW_SIZE; i++)
+		{
+			if (block->blkno == prefetcher->recent_block[i] &&
+				RelFileNodeEquals(block->rnode, prefetcher->recent_rnode[i]))
+				break;
+		}
+		if (i < XLOGPREFETCHER_SEQ_WINDOW_SIZE)
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_rep);
+			continue;
+		}
+
+		/* We'll need a slot in the queue if an I/O is started */
+		if (XLogPrefetcherQueueDepth(prefetcher) >= maintenance_io_concurrency)
+			return false;
+
+		prefetcher->recent_rnode[prefetcher->recent_idx] = block->rnode;
+		prefetcher->recent_block[prefetcher->recent_idx] = block->blkno;
+		prefetcher->recent_idx =
+			(prefetcher->recent_idx + 1) % XLOGPREFETCHER_SEQ_WINDOW_SIZE;
+
+		/*
+		 * We could try to have a fast path for repeated references to the
+		 * same relation (with some scheme to handle invalidations safely),
+		 * but for now we'll call smgropen() every time.
+		 */
+		reln = smgropen(block->rnode, InvalidBackendId);
+
+		/*
+		 * If the relation file doesn't exist on disk, for example because
+		 * we're replaying after a crash and the file will be created and
+		 * then unlinked by WAL that hasn't been replayed yet, suppress
+		 * further prefetching in the relation until this record is
+		 * replayed.
+		 */
+		if (!smgrexists(reln, MAIN_FORKNUM))
+		{
+			XLogPrefetcherAddFilter(prefetcher, block->rnode, 0,
+									reader->ReadRecPtr);
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			continue;
+		}
+
+		/*
+		 * If the relation isn't big enough to contain the referenced block
+		 * yet, suppress prefetching of this block and higher until this
+		 * record is replayed.
+		 */
+		if (block->forknum != MAIN_FORKNUM &&
+			!smgrexists(reln, block->forknum))
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			continue;
+		}
+		if (block->blkno >= smgrnblocks(reln, block->forknum))
+		{
+			XLogPrefetcherAddFilter(prefetcher, block->rnode, block->blkno,
+									reader->ReadRecPtr);
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			continue;
+		}
+
+		/* Try to initiate prefetching. */
+		result = PrefetchSharedBuffer(reln, block->forknum, block->blkno);
+		if (BufferIsValid(result.recent_buffer))
+		{
+			/* It's already cached, so do nothing. */
+			XLogPrefetchIncrement(&SharedStats->hit);
+		}
+		else if (result.initiated_io)
+		{
+			/*
+			 * I/O has possibly been initiated (though we don't know if it
+			 * was already cached by the kernel, so we just have to assume
+			 * that it has due to lack of better information).  Record this
+			 * as an I/O in progress until eventually we replay this LSN.
+			 */
+			XLogPrefetchIncrement(&SharedStats->prefetch);
+			prefetcher->prefetch_queue[prefetcher->prefetch_head] =
+				reader->ReadRecPtr;
+			prefetcher->prefetch_head = (prefetcher->prefetch_head + 1) %
+				XLOGPREFETCHER_QUEUE_SIZE;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Install filters for relations that the record just read creates or
+ * truncates, so we don't try to prefetch blocks that won't exist until the
+ * record has been replayed.
+ */
+static void
+XLogPrefetcherScanRecord(XLogPrefetcher *prefetcher)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	uint8		rmid = XLogRecGetRmid(reader);
+	uint8		info = XLogRecGetInfo(reader) & ~XLR_INFO_MASK;
+
+	if (rmid == RM_SMGR_ID)
+	{
+		if (info == XLOG_SMGR_CREATE)
+		{
+			xl_smgr_create *xlrec = (xl_smgr_create *) XLogRecGetData(reader);
+
+			XLogPrefetcherAddFilter(prefetcher, xlrec->rnode, 0,
+									reader->ReadRecPtr);
+		}
+		else if (info == XLOG_SMGR_TRUNCATE)
+		{
+			xl_smgr_truncate *xlrec = (xl_smgr_truncate *) XLogRecGetData(reader);
+
+			XLogPrefetcherAddFilter(prefetcher, xlrec->rnode, xlrec->blkno,
+									reader->ReadRecPtr);
+		}
+	}
+	else if (rmid == RM_DBASE_ID && info == XLOG_DBASE_CREATE)
+	{
+		xl_dbase_create_rec *xlrec = (xl_dbase_create_rec *) XLogRecGetData(reader);
+		RelFileNode rnode = {InvalidOid, xlrec->db_id, InvalidOid};
+
+		/* the whole database is filtered until the copy has been replayed */
+		XLogPrefetcherAddFilter(prefetcher, rnode, 0, reader->ReadRecPtr);
+	}
+}
+
+/*
+ * Don't prefetch any blocks >= 'blockno' from a given 'rnode', until 'lsn'
+ * has been replayed.
+ */
+static void
+XLogPrefetcherAddFilter(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						BlockNumber blockno, XLogRecPtr lsn)
+{
+	XLogPrefetcherFilter *filter;
+	bool		found;
+
+	filter = hash_search(prefetcher->filter_table, &rnode, HASH_ENTER, &found);
+	if (!found)
+	{
+		/*
+		 * Don't allow any prefetching of this block or higher until
+		 * replayed.
+		 */
+		filter->filter_until_replayed = lsn;
+		filter->filter_from_block = blockno;
+		dlist_push_head(&prefetcher->filter_queue, &filter->link);
+	}
+	else
+	{
+		/*
+		 * We were already filtering this rnode.  Extend the filter's
+		 * lifetime to cover this WAL record, but leave the (presumably
+		 * lower) block number there because we don't want to have to track
+		 * individual blocks.
+		 */
+		filter->filter_until_replayed = lsn;
+		dlist_delete(&filter->link);
+		dlist_push_head(&prefetcher->filter_queue, &filter->link);
+		filter->filter_from_block = Min(filter->filter_from_block, blockno);
+	}
+}
+
+/*
+ * Have we replayed any records that caused us to begin filtering a block
+ * range?  That means that relations should have been created, extended or
+ * dropped as required, so we can stop filtering out accesses to a given
+ * relfilenode.
+ */
+static void
+XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
+							  XLogRecPtr replaying_lsn)
+{
+	while (unlikely(!dlist_is_empty(&prefetcher->filter_queue)))
+	{
+		XLogPrefetcherFilter *filter = dlist_tail_element(XLogPrefetcherFilter,
+														  link,
+														  &prefetcher->filter_queue);
+
+		if (filter->filter_until_replayed >= replaying_lsn)
+			break;
+
+		dlist_delete(&filter->link);
+		hash_search(prefetcher->filter_table, filter, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * Check if a given block should be skipped due to a filter.
+ */
+static bool
+XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						 BlockNumber blockno)
+{
+	/*
+	 * Test for empty queue first, because we expect it to be empty most of
+	 * the time and we can avoid the hash table lookup in that case.
+	 */
+	if (unlikely(!dlist_is_empty(&prefetcher->filter_queue)))
+	{
+		XLogPrefetcherFilter *filter;
+
+		/* See if the block range is filtered. */
+		filter = hash_search(prefetcher->filter_table, &rnode, HASH_FIND, NULL);
+		if (filter && filter->filter_from_block <= blockno)
+			return true;
+
+		/* See if the whole database is filtered. */
+		rnode.relNode = InvalidOid;
+		rnode.spcNode = InvalidOid;
+		filter = hash_search(prefetcher->filter_table, &rnode, HASH_FIND, NULL);
+		if (filter)
+			return true;
+	}
+
+	return false;
+}
+
+static inline int
+XLogPrefetcherQueueDepth(XLogPrefetcher *prefetcher)
+{
+	return (prefetcher->prefetch_head - prefetcher->prefetch_tail +
+			XLOGPREFETCHER_QUEUE_SIZE) % XLOGPREFETCHER_QUEUE_SIZE;
+}
+
+/*
+ * XLogReaderRoutine->page_read callback for the prefetcher's reader.
+ *
+ * Unlike XLogPageRead(), this never waits for WAL to arrive and never
+ * restores files from the archive; it just reports failure if the page
+ * isn't available in pg_wal yet.
+ */
+static int
+XLogPrefetcherPageRead(XLogReaderState *state, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) state->private_data;
+	XLogSegNo	segno;
+	uint32		offset;
+	int			count = XLOG_BLCKSZ;
+	int			r;
+
+	/* Don't look at WAL that the WAL receiver hasn't flushed yet */
+	if (prefetcher->streaming)
+	{
+		XLogRecPtr	flushed = GetWalRcvFlushRecPtr(NULL, NULL);
+
+		if (targetPagePtr + reqLen > flushed)
+		{
+			prefetcher->wal_pending = true;
+			return -1;
+		}
+		if (targetPagePtr + XLOG_BLCKSZ > flushed)
+			count = flushed - targetPagePtr;
+	}
+
+	XLByteToSeg(targetPagePtr, segno, wal_segment_size);
+	if (prefetcher->readFile < 0 || segno != prefetcher->readSegNo)
+	{
+		char		path[MAXPGPATH];
+
+		if (prefetcher->readFile >= 0)
+			close(prefetcher->readFile);
+
+		XLogFilePath(path, prefetcher->tli, segno, wal_segment_size);
+		prefetcher->readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+		if (prefetcher->readFile < 0)
+			return -1;
+		prefetcher->readSegNo = segno;
+	}
+
+	offset = XLogSegmentOffset(targetPagePtr, wal_segment_size);
+	pgstat_report_wait_start(WAIT_EVENT_WAL_READ);
+	r = pg_pread(prefetcher->readFile, readBuf, XLOG_BLCKSZ, (off_t) offset);
+	pgstat_report_wait_end();
+	if (r != XLOG_BLCKSZ)
+		return -1;
+
+	return count;
+}
+
+/*
+ * Expose statistics about recovery prefetching.
+ */
+Datum
+pg_stat_get_recovery_prefetch(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_RECOVERY_PREFETCH_COLS 9
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+	bool		nulls[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	values[0] = TimestampTzGetDatum(pg_atomic_read_u64(&SharedStats->reset_time));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->prefetch));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->hit));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_init));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_new));
+	values[5] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_fpw));
+	values[6] = Int64GetDatum(pg_atomic_read_u64(&SharedStats->skip_rep));
+	values[7] = Int32GetDatum(SharedStats->wal_distance);
+	values[8] = Int32GetDatum(SharedStats->io_depth);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -18,6 +18,12 @@
 #include "postgres.h"
 
 #include <unistd.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "access/transam.h"
 #include "access/xlog_internal.h"
@@ -1295,7 +1301,9 @@ DecodeXLogRecord(XLogReaderState *state, XLogRecord *record, char **errormsg)
 
 				blk->apply_image = ((blk->bimg_info & BKPIMAGE_APPLY) != 0);
 
-				if (blk->bimg_info & BKPIMAGE_IS_COMPRESSED)
+				if (blk->bimg_info & BKPIMAGE_IS_REF)
+					blk->hole_length = 0;
+				else if (BKPIMAGE_COMPRESSED(blk->bimg_info))
 				{
 					if (blk->bimg_info & BKPIMAGE_HAS_HOLE)
 						COPY_HEADER_FIELD(&blk->hole_length, sizeof(uint16));
@@ -1306,6 +1314,24 @@ DecodeXLogRecord(XLogReaderState *state, XLogRecord *record, char **errormsg)
 					blk->hole_length = BLCKSZ - blk->bimg_len;
 				datatotal += blk->bimg_len;
 
+				/*
+				 * cross-check that an image reference is applied, carries
+				 * just an LSN, and has no hole or compression.
+				 */
+				if ((blk->bimg_info & BKPIMAGE_IS_REF) &&
+					(blk->bimg_info != (BKPIMAGE_IS_REF | BKPIMAGE_APPLY) ||
+					 blk->bimg_len != sizeof(XLogRecPtr) ||
+					 blk->hole_offset != 0))
+				{
+					report_invalid_record(state,
+										  "BKPIMAGE_IS_REF set, but block image flags %u offset %u length %u at %X/%X",
+										  (unsigned int) blk->bimg_info,
+										  (unsigned int) blk->hole_offset,
+										  (unsigned int) blk->bimg_len,
+										  (uint32) (state->ReadRecPtr >> 32), (uint32) state->ReadRecPtr);
+					goto err;
+				}
+
 				/*
 				 * cross-check that hole_offset > 0, hole_length > 0 and
 				 * bimg_len < BLCKSZ if the HAS_HOLE flag is set.
@@ -1340,29 +1366,28 @@ DecodeXLogRecord(XLogReaderState *state, XLogRecord *record, char **errormsg)
 				}
 
 				/*
-				 * cross-check that bimg_len < BLCKSZ if the IS_COMPRESSED
-				 * flag is set.
+				 * cross-check that bimg_len < BLCKSZ if it is compressed.
 				 */
-				if ((blk->bimg_info & BKPIMAGE_IS_COMPRESSED) &&
+				if (BKPIMAGE_COMPRESSED(blk->bimg_info) &&
 					blk->bimg_len == BLCKSZ)
 				{
 					report_invalid_record(state,
-										  "BKPIMAGE_IS_COMPRESSED set, but block image length %u at %X/%X",
+										  "BKPIMAGE_COMPRESSED set, but block image length %u at %X/%X",
 										  (unsigned int) blk->bimg_len,
 										  (uint32) (state->ReadRecPtr >> 32), (uint32) state->ReadRecPtr);
 					goto err;
 				}
 
 				/*
-				 * cross-check that bimg_len = BLCKSZ if neither HAS_HOLE nor
-				 * IS_COMPRESSED flag is set.
+				 * cross-check that bimg_len = BLCKSZ if neither HAS_HOLE is
+				 * set nor COMPRESSED(), unless this is a reference.
 				 */
-				if (!(blk->bimg_info & BKPIMAGE_HAS_HOLE) &&
-					!(blk->bimg_info & BKPIMAGE_IS_COMPRESSED) &&
+				if (!(blk->bimg_info & (BKPIMAGE_HAS_HOLE | BKPIMAGE_IS_REF)) &&
+					!BKPIMAGE_COMPRESSED(blk->bimg_info) &&
 					blk->bimg_len != BLCKSZ)
 				{
 					report_invalid_record(state,
-										  "neither BKPIMAGE_HAS_HOLE nor BKPIMAGE_IS_COMPRESSED set, but block image length is %u at %X/%X",
+										  "neither BKPIMAGE_HAS_HOLE nor BKPIMAGE_COMPRESSED set, but block image length is %u at %X/%X",
 										  (unsigned int) blk->data_len,
 										  (uint32) (state->ReadRecPtr >> 32), (uint32) state->ReadRecPtr);
 					goto err;
@@ -1562,11 +1587,72 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 	bkpb = &record->blocks[block_id];
 	ptr = bkpb->bkp_image;
 
-	if (bkpb->bimg_info & BKPIMAGE_IS_COMPRESSED)
+	if (bkpb->bimg_info & BKPIMAGE_IS_REF)
+	{
+		report_invalid_record(record, "could not restore image at %X/%X, block %d is a reference to an earlier image",
+							  (uint32) (record->ReadRecPtr >> 32),
+							  (uint32) record->ReadRecPtr,
+							  block_id);
+		return false;
+	}
+
+	if (BKPIMAGE_COMPRESSED(bkpb->bimg_info))
 	{
 		/* If a backup block image is compressed, decompress it */
-		if (pglz_decompress(ptr, bkpb->bimg_len, tmp.data,
-							BLCKSZ - bkpb->hole_length, true) < 0)
+		bool		decomp_success = true;
+
+		if ((bkpb->bimg_info & BKPIMAGE_COMPRESS_PGLZ) != 0)
+		{
+			if (pglz_decompress(ptr, bkpb->bimg_len, tmp.data,
+								BLCKSZ - bkpb->hole_length, true) < 0)
+				decomp_success = false;
+		}
+		else if ((bkpb->bimg_info & BKPIMAGE_COMPRESS_LZ4) != 0)
+		{
+#ifdef USE_LZ4
+			if (LZ4_decompress_safe(ptr, tmp.data,
+									bkpb->bimg_len,
+									BLCKSZ - bkpb->hole_length) !=
+				BLCKSZ - bkpb->hole_length)
+				decomp_success = false;
+#else
+			report_invalid_record(record, "could not restore image at %X/%X compressed with %s not supported by build, block %d",
+								  (uint32) (record->ReadRecPtr >> 32),
+								  (uint32) record->ReadRecPtr,
+								  "LZ4",
+								  block_id);
+			return false;
+#endif
+		}
+		else if ((bkpb->bimg_info & BKPIMAGE_COMPRESS_ZSTD) != 0)
+		{
+#ifdef USE_ZSTD
+			size_t		decomp_result = ZSTD_decompress(tmp.data,
+														BLCKSZ - bkpb->hole_length,
+														ptr, bkpb->bimg_len);
+
+			if (ZSTD_isError(decomp_result) ||
+				decomp_result != BLCKSZ - bkpb->hole_length)
+				decomp_success = false;
+#else
+			report_invalid_record(record, "could not restore image at %X/%X compressed with %s not supported by build, block %d",
+								  (uint32) (record->ReadRecPtr >> 32),
+								  (uint32) record->ReadRecPtr,
+								  "zstd",
+								  block_id);
+			return false;
+#endif
+		}
+		else
+		{
+			report_invalid_record(record, "could not restore image at %X/%X compressed with unknown method, block %d",
+								  (uint32) (record->ReadRecPtr >> 32),
+								  (uint32) record->ReadRecPtr,
+								  block_id);
+			return false;
+		}
+
+		if (!decomp_success)
 		{
 			report_invalid_record(record, "invalid compressed image at %X/%X, block %d",
 								  (uint32) (record->ReadRecPtr >> 32),
@@ -1595,6 +1681,31 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 	return true;
 }
 
+/*
+ * Returns the LSN that an image reference points to, i.e. the LSN the page
+ * must carry for the reference to be applied.  Returns InvalidXLogRecPtr if
+ * the block has no image, or a real image rather than a reference.
+ */
+XLogRecPtr
+XLogRecGetBlockImageRef(XLogReaderState *record, uint8 block_id)
+{
+	DecodedBkpBlock *bkpb;
+	XLogRecPtr	ref_lsn;
+
+	if (!record->blocks[block_id].in_use)
+		return InvalidXLogRecPtr;
+	if (!record->blocks[block_id].has_image)
+		return InvalidXLogRecPtr;
+
+	bkpb = &record->blocks[block_id];
+	if (!(bkpb->bimg_info & BKPIMAGE_IS_REF))
+		return InvalidXLogRecPtr;
+
+	/* the image data is not necessarily aligned */
+	memcpy(&ref_lsn, bkpb->bkp_image, sizeof(XLogRecPtr));
+	return ref_lsn;
+}
+
 #ifndef FRONTEND
 
 /*
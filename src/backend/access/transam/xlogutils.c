@@ -22,9 +22,11 @@
 #include "access/timeline.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
 #include "access/xlogutils.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/lwlock.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
@@ -85,6 +87,16 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	xl_invalid_page *hentry;
 	bool		found;
 
+	/*
+	 * A parallel redo worker hands the reference over to the startup
+	 * process, which owns the table.
+	 */
+	if (am_parallel_redo_worker)
+	{
+		ParallelRedoForwardInvalidPage(node, forkno, blkno, present);
+		return;
+	}
+
 	/*
 	 * Once recovery has reached a consistent state, the invalid-page table
 	 * should be empty and remain so. If a reference to an invalid page is
@@ -209,6 +221,14 @@ forget_invalid_pages_db(Oid dbid)
 	}
 }
 
+/* Log a reference to an invalid page found by a parallel redo worker */
+void
+XLogRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+						BlockNumber blkno, bool present)
+{
+	log_invalid_page(node, forkno, blkno, present);
+}
+
 /* Are there any unresolved references to invalid pages? */
 bool
 XLogHaveInvalidPages(void)
@@ -357,6 +377,45 @@ XLogReadBufferForRedoExtended(XLogReaderState *record,
 	if (!willinit && zeromode)
 		elog(PANIC, "block to be initialized in redo routine must be marked with WILL_INIT flag in the WAL record");
 
+	/*
+	 * If the image is only a reference to an earlier image of the block,
+	 * the page must still be exactly as that image left it; just advance its
+	 * LSN.
+	 */
+	if (XLogRecBlockImageApply(record, block_id) &&
+		XLogRecBlockImageIsRef(record, block_id))
+	{
+		XLogRecPtr	ref_lsn = XLogRecGetBlockImageRef(record, block_id);
+
+		*buf = XLogReadBufferExtended(rnode, forknum, blkno, RBM_NORMAL);
+		if (!BufferIsValid(*buf))
+			return BLK_NOTFOUND;
+		if (get_cleanup_lock)
+			LockBufferForCleanup(*buf);
+		else
+			LockBuffer(*buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(*buf);
+
+		if (PageGetLSN(page) != ref_lsn)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("page LSN %X/%X of block %u of relation %s does not match image reference %X/%X",
+									 (uint32) (PageGetLSN(page) >> 32),
+									 (uint32) PageGetLSN(page),
+									 blkno,
+									 relpathperm(rnode, forknum),
+									 (uint32) (ref_lsn >> 32),
+									 (uint32) ref_lsn)));
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(*buf);
+
+		if (forknum == INIT_FORKNUM)
+			FlushOneBuffer(*buf);
+
+		return BLK_RESTORED;
+	}
+
 	/* If it has a full-page image and it should be restored, do it. */
 	if (XLogRecBlockImageApply(record, block_id))
 	{
@@ -365,7 +424,9 @@ XLogReadBufferForRedoExtended(XLogReaderState *record,
 									  get_cleanup_lock ? RBM_ZERO_AND_CLEANUP_LOCK : RBM_ZERO_AND_LOCK);
 		page = BufferGetPage(*buf);
 		if (!RestoreBlockImage(record, block_id, page))
-			elog(ERROR, "failed to restore block image");
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg_internal("%s", record->errormsg_buf)));
 
 		/*
 		 * The page may be uninitialized. If so, we can't set the LSN because
@@ -444,6 +505,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	bool		extension_locked = false;
 
 	Assert(blkno != P_NEW);
 
@@ -462,6 +524,18 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 
 	lastblock = smgrnblocks(smgr, forknum);
 
+	/*
+	 * Parallel redo workers can race each other to extend the same relation,
+	 * so they take a lock and look again before doing so.
+	 */
+	if (blkno >= lastblock && am_parallel_redo_worker &&
+		mode != RBM_NORMAL && mode != RBM_NORMAL_NO_LOG)
+	{
+		LWLockAcquire(ParallelRedoExtensionLock, LW_EXCLUSIVE);
+		extension_locked = true;
+		lastblock = smgrnblocks(smgr, forknum);
+	}
+
 	if (blkno < lastblock)
 	{
 		/* page exists in file */
@@ -479,7 +553,10 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		if (mode == RBM_NORMAL_NO_LOG)
 			return InvalidBuffer;
 		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
+		/*
+		 * we do this in recovery only - no rel-extension lock needed, except
+		 * by parallel redo workers (see above)
+		 */
 		Assert(InRecovery);
 		buffer = InvalidBuffer;
 		do
@@ -505,6 +582,9 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		}
 	}
 
+	if (extension_locked)
+		LWLockRelease(ParallelRedoExtensionLock);
+
 	if (mode == RBM_NORMAL)
 	{
 		/* check that page has been initialized */
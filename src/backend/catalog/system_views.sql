@@ -821,6 +821,27 @@ CREATE VIEW pg_stat_slru AS
             s.stats_reset
     FROM pg_stat_get_slru() s;
 
+CREATE VIEW pg_stat_buffer_replacement AS
+    SELECT
+            s.policy,
+            s.victims,
+            s.demotions,
+            s.hot_skips,
+            s.ghost_entries,
+            s.ghost_hits,
+            s.ghost_misses
+    FROM pg_stat_get_buffer_replacement() s;
+
+CREATE VIEW pg_stat_numa AS
+    SELECT
+            s.node,
+            s.buffers,
+            s.hits,
+            s.remote_hits,
+            s.victims,
+            s.remote_victims
+    FROM pg_stat_get_numa() s;
+
 CREATE VIEW pg_stat_wal_receiver AS
     SELECT
             s.pid,
@@ -997,9 +1018,25 @@ CREATE VIEW pg_stat_wal AS
         w.wal_fpi,
         w.wal_bytes,
         w.wal_buffers_full,
+        w.wal_group_commit_sizes,
+        w.wal_segments_foreground,
+        w.wal_segments_background,
         w.stats_reset
     FROM pg_stat_get_wal() w;
 
+CREATE VIEW pg_stat_recovery_prefetch AS
+    SELECT
+            s.stats_reset,
+            s.prefetch,
+            s.hit,
+            s.skip_init,
+            s.skip_new,
+            s.skip_fpw,
+            s.skip_rep,
+            s.wal_distance,
+            s.io_depth
+    FROM pg_stat_get_recovery_prefetch() s;
+
 CREATE VIEW pg_stat_progress_analyze AS
     SELECT
         S.pid AS pid, S.datid AS datid, D.datname AS datname,
@@ -63,6 +63,7 @@
 #include "utils/pg_rusage.h"
 #include "utils/sampling.h"
 #include "utils/sortsupport.h"
+#include "utils/spccache.h"
 #include "utils/syscache.h"
 #include "utils/timestamp.h"
 
@@ -98,6 +99,9 @@ static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 static int	acquire_sample_rows(Relation onerel, int elevel,
 								HeapTuple *rows, int targrows,
 								double *totalrows, double *totaldeadrows);
+static BlockNumber acquire_sample_rows_stream_next(ReadStream *stream,
+												   void *callback_private_data,
+												   void *per_block_data);
 static int	compare_rows(const void *a, const void *b);
 static int	acquire_inherited_sample_rows(Relation onerel, int elevel,
 										  HeapTuple *rows, int targrows,
@@ -988,6 +992,19 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 	return stats;
 }
 
+/*
+ * Read stream callback for acquire_sample_rows: returns the sampled blocks.
+ */
+static BlockNumber
+acquire_sample_rows_stream_next(ReadStream *stream,
+								void *callback_private_data,
+								void *per_block_data)
+{
+	BlockSampler bs = (BlockSampler) callback_private_data;
+
+	return BlockSampler_HasMore(bs) ? BlockSampler_Next(bs) : InvalidBlockNumber;
+}
+
 /*
  * acquire_sample_rows -- acquire a random sample of rows from the table
  *
@@ -1037,8 +1054,10 @@ acquire_sample_rows(Relation onerel, int elevel,
 	ReservoirStateData rstate;
 	TupleTableSlot *slot;
 	TableScanDesc scan;
+	ReadStream *stream;
 	BlockNumber nblocks;
 	BlockNumber blksdone = 0;
+	BlockNumber targblock;
 
 	Assert(targrows > 0);
 
@@ -1060,11 +1079,18 @@ acquire_sample_rows(Relation onerel, int elevel,
 	scan = table_beginscan_analyze(onerel);
 	slot = table_slot_create(onerel, NULL);
 
+	/*
+	 * The sampled blocks are in ascending order, but far enough apart that
+	 * kernel readahead won't help us.  Have a read stream issue the reads
+	 * ahead of the table AM, which still reads each block itself.
+	 */
+	stream = ReadStreamBegin(onerel, MAIN_FORKNUM, vac_strategy,
+							 get_tablespace_maintenance_io_concurrency(onerel->rd_rel->reltablespace),
+							 acquire_sample_rows_stream_next, &bs, 0);
+
 	/* Outer loop over blocks to sample */
-	while (BlockSampler_HasMore(&bs))
+	while ((targblock = ReadStreamNextBlock(stream, NULL)) != InvalidBlockNumber)
 	{
-		BlockNumber targblock = BlockSampler_Next(&bs);
-
 		vacuum_delay_point();
 
 		if (!table_scan_analyze_next_block(scan, targblock, vac_strategy))
@@ -1119,6 +1145,8 @@ acquire_sample_rows(Relation onerel, int elevel,
 									 ++blksdone);
 	}
 
+	ReadStreamEnd(stream);
+
 	ExecDropSingleTupleTableSlot(slot);
 	table_endscan(scan);
 
@@ -20,6 +20,7 @@
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
@@ -106,10 +107,14 @@ void
 CopyFromErrorCallback(void *arg)
 {
 	CopyFromState	cstate = (CopyFromState) arg;
+	uint64		lineno = cstate->cur_lineno;
 	char		curlineno_str[32];
 
-	snprintf(curlineno_str, sizeof(curlineno_str), UINT64_FORMAT,
-			 cstate->cur_lineno);
+	/* a parallel COPY worker only sees part of the input */
+	if (IsParallelWorker())
+		lineno = ParallelCopyWorkerLineNo(lineno);
+
+	snprintf(curlineno_str, sizeof(curlineno_str), UINT64_FORMAT, lineno);
 
 	if (cstate->opts.binary)
 	{
@@ -532,7 +537,7 @@ CopyFrom(CopyFromState cstate)
 
 	PartitionTupleRouting *proute = NULL;
 	ErrorContextCallback errcallback;
-	CommandId	mycid = GetCurrentCommandId(true);
+	CommandId	mycid;
 	int			ti_options = 0; /* start with default options for insert */
 	BulkInsertState bistate = NULL;
 	CopyInsertMethod insertMethod;
@@ -545,6 +550,19 @@ CopyFrom(CopyFromState cstate)
 	Assert(cstate->rel);
 	Assert(list_length(cstate->range_table) == 1);
 
+	/*
+	 * In a parallel COPY worker, the leader has already marked the command
+	 * ID as used, and made sure that the insertions are safe to perform in a
+	 * worker; see ParallelCopyFrom().
+	 */
+	if (IsParallelWorker())
+	{
+		mycid = GetCurrentCommandId(false);
+		ti_options |= TABLE_INSERT_PARALLEL;
+	}
+	else
+		mycid = GetCurrentCommandId(true);
+
 	/*
 	 * The target must be a plain, foreign, or partitioned relation, or have
 	 * an INSTEAD OF INSERT row trigger.  (Currently, such triggers are only
@@ -0,0 +1,995 @@
+/*-------------------------------------------------------------------------
+ *
+ * copyparallel.c
+ *		Parallel COPY FROM file/program/client
+ *
+ * When the PARALLEL option is given to COPY FROM, the leader backend reads
+ * the input and splits it into chunks that end at record boundaries.  The
+ * chunks are placed in a ring of slots in dynamic shared memory, from where
+ * parallel workers pick them up one at a time.  Each worker runs an
+ * ordinary CopyFrom(), with a data source callback that reads from the
+ * chunks it has taken, so all the parsing, input conversion, constraint
+ * checking and insertion work is spread across the workers.
+ *
+ * The leader's scanner only needs to understand enough of the input format
+ * to find record boundaries: the end-of-line characters, CSV quoting, text
+ * mode backslash escapes and the end-of-copy marker.  That is the same
+ * subset that CopyReadLineText() deals with.  A record that doesn't fit in
+ * a single chunk is marked as continued, and the next chunk is then handed
+ * to the same worker.
+ *
+ * All the workers insert with the leader's transaction ID and command ID,
+ * so parallel COPY is only used when the insertions cannot fire triggers,
+ * evaluate parallel-unsafe functions, or otherwise need anything that a
+ * parallel worker cannot do.  Otherwise we quietly fall back to a serial
+ * COPY, like CREATE INDEX does when no workers can be launched.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/commands/copyparallel.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/parallel.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "commands/copy.h"
+#include "commands/copyfrom_internal.h"
+#include "executor/instrument.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/parse_relation.h"
+#include "pgstat.h"
+#include "rewrite/rewriteHandler.h"
+#include "storage/condition_variable.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/relcache.h"
+#include "utils/typcache.h"
+
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_COPY_SHARED		UINT64CONST(0xC000000000000001)
+#define PARALLEL_KEY_COPY_CHUNKS		UINT64CONST(0xC000000000000002)
+#define PARALLEL_KEY_COPY_OPTIONS		UINT64CONST(0xC000000000000003)
+#define PARALLEL_KEY_COPY_ATTNAMELIST	UINT64CONST(0xC000000000000004)
+#define PARALLEL_KEY_COPY_WHERE			UINT64CONST(0xC000000000000005)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xC000000000000006)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xC000000000000007)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xC000000000000008)
+
+/* Size of one chunk of input, and number of chunk slots per worker */
+#define PARALLEL_COPY_CHUNK_SIZE		(256 * 1024)
+#define PARALLEL_COPY_CHUNKS_PER_WORKER	4
+
+/* Number of chunks whose line numbers a worker remembers */
+#define PARALLEL_COPY_LINEMAP_SIZE		1024
+
+/*
+ * Description of one chunk slot.  The data of slot i lives at offset
+ * i * PARALLEL_COPY_CHUNK_SIZE in the PARALLEL_KEY_COPY_CHUNKS area.
+ */
+typedef struct ParallelCopyChunk
+{
+	bool		inuse;			/* filled by leader, not yet released */
+	bool		continued;		/* last record continues in next chunk */
+	int			len;			/* number of valid bytes */
+	uint64		lines_before;	/* input lines before the start of chunk */
+	uint64		nlines;			/* input lines started within chunk */
+} ParallelCopyChunk;
+
+/*
+ * Status for a parallel COPY FROM.  This is allocated in a dynamic shared
+ * memory segment.
+ */
+typedef struct ParallelCopyShared
+{
+	/*
+	 * These fields are not modified during the copy.  They primarily exist
+	 * for the benefit of worker processes that need to set up their own
+	 * COPY state.
+	 */
+	Oid			relid;
+	int			nchunks;
+
+	/* Condition variables for waiting on chunk slots */
+	ConditionVariable chunk_ready_cv;
+	ConditionVariable chunk_free_cv;
+
+	/* mutex protects all the fields below, and the chunk descriptors */
+	slock_t		mutex;
+
+	/*
+	 * Chunks are numbered in input order.  Chunk number n is stored in slot
+	 * n % nchunks.  The leader has filled chunks up to nfilled, and workers
+	 * have taken chunks up to ntaken.  While a worker is in the middle of a
+	 * continued record, take_locked is set and only lock_holder may take
+	 * the next chunk.
+	 */
+	uint64		nfilled;
+	uint64		ntaken;
+	bool		take_locked;
+	int			lock_holder;
+	bool		input_done;		/* leader has filled its last chunk */
+
+	uint64		processed;		/* tuples inserted by all workers */
+
+	ParallelCopyChunk chunks[FLEXIBLE_ARRAY_MEMBER];
+} ParallelCopyShared;
+
+/*
+ * Within a worker, remembers where a chunk begins in the worker's own
+ * stream of input lines, and where it begins in the whole input.
+ */
+typedef struct ParallelCopyLineMap
+{
+	uint64		stream_base;
+	uint64		file_base;
+} ParallelCopyLineMap;
+
+/*
+ * Worker-local state for reading chunks.  There can only be one parallel
+ * COPY in progress in a worker, and the data source callback has no way to
+ * pass state, so this is a static.
+ */
+typedef struct ParallelCopyWorkerState
+{
+	ParallelCopyShared *shared;
+	char	   *chunkdata;
+	int			cur_slot;		/* slot being read, or -1 */
+	int			cur_pos;		/* next byte to return from cur_slot */
+	uint64		stream_lines;	/* lines in chunks taken so far */
+	uint64		nlinemap;		/* entries ever added to linemap */
+	ParallelCopyLineMap linemap[PARALLEL_COPY_LINEMAP_SIZE];
+} ParallelCopyWorkerState;
+
+static ParallelCopyWorkerState *pcworker = NULL;
+
+/*
+ * Leader-local state for splitting the input.
+ */
+typedef struct ParallelCopyLeaderState
+{
+	ParallelCopyShared *shared;
+	char	   *chunkdata;
+	char	   *buf;			/* chunk being assembled */
+	int			len;			/* bytes in buf */
+	int			boundary;		/* end of last complete record in buf */
+	uint64		lineno;			/* lines started so far */
+	uint64		boundary_lineno;	/* lines started before boundary */
+	uint64		chunk_lineno;	/* lines started before buf */
+} ParallelCopyLeaderState;
+
+static bool parallel_copy_is_safe(CopyFromState cstate);
+static bool parallel_copy_unsafe_walker(Node *node, void *context);
+static void parallel_copy_split_input(CopyFromState cstate,
+									  ParallelCopyLeaderState *pcleader);
+static void parallel_copy_publish(ParallelCopyLeaderState *pcleader,
+								  int len, bool continued, uint64 nlines);
+static int	parallel_copy_read_data(void *outbuf, int minread, int maxread);
+static bool parallel_copy_take_chunk(void);
+static void parallel_copy_release_chunk(void);
+
+/*
+ * ParallelCopyFrom -- perform COPY FROM using parallel workers
+ *
+ * 'cstate' has been set up by BeginCopyFrom() in the leader, and is used to
+ * read the input.  'attnamelist' and 'options' are the original column list
+ * and options of the COPY statement, which are passed to the workers so
+ * they can set up their own COPY state.
+ *
+ * Returns false, without having read any input, if parallel COPY was not
+ * requested or cannot be used; the caller should then do a serial COPY.
+ * Otherwise, returns true and sets *processed to the number of tuples
+ * inserted.
+ */
+bool
+ParallelCopyFrom(CopyFromState cstate, List *attnamelist, List *options,
+				 uint64 *processed)
+{
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	ParallelCopyLeaderState pcleader;
+	Size		estshared;
+	Size		estchunks;
+	List	   *workeroptions = NIL;
+	char	   *optionsstr;
+	char	   *attnamestr;
+	char	   *wherestr;
+	char	   *ptr;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	ListCell   *lc;
+	int			nchunks;
+	int			querylen;
+	int			i;
+
+	if (cstate->opts.nworkers == 0)
+		return false;
+
+	if (!parallel_copy_is_safe(cstate))
+		return false;
+
+	/*
+	 * The workers insert with our transaction ID and command ID, so make
+	 * sure we have them before entering parallel mode.
+	 */
+	(void) GetCurrentTransactionId();
+	(void) GetCurrentCommandId(true);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "ParallelCopyMain",
+								 cstate->opts.nworkers);
+
+	/*
+	 * The workers parse the input themselves, so they need the options.  But
+	 * the leader has already consumed the header line, if any.
+	 */
+	foreach(lc, options)
+	{
+		DefElem    *defel = lfirst_node(DefElem, lc);
+
+		if (strcmp(defel->defname, "header") == 0 ||
+			strcmp(defel->defname, "parallel") == 0)
+			continue;
+		workeroptions = lappend(workeroptions, defel);
+	}
+	optionsstr = nodeToString(workeroptions);
+	attnamestr = nodeToString(attnamelist);
+	wherestr = nodeToString(cstate->whereClause);
+
+	/* Estimate space for the shared state and the chunks */
+	nchunks = pcxt->nworkers * PARALLEL_COPY_CHUNKS_PER_WORKER;
+	estshared = add_size(offsetof(ParallelCopyShared, chunks),
+						 mul_size(sizeof(ParallelCopyChunk), nchunks));
+	shm_toc_estimate_chunk(&pcxt->estimator, estshared);
+	estchunks = mul_size(PARALLEL_COPY_CHUNK_SIZE, nchunks);
+	shm_toc_estimate_chunk(&pcxt->estimator, estchunks);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(optionsstr) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(attnamestr) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(wherestr) + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 5);
+
+	/* Estimate space for WalUsage and BufferUsage */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial copy) */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	shared = (ParallelCopyShared *) shm_toc_allocate(pcxt->toc, estshared);
+	shared->relid = RelationGetRelid(cstate->rel);
+	shared->nchunks = nchunks;
+	ConditionVariableInit(&shared->chunk_ready_cv);
+	ConditionVariableInit(&shared->chunk_free_cv);
+	SpinLockInit(&shared->mutex);
+	shared->nfilled = 0;
+	shared->ntaken = 0;
+	shared->take_locked = false;
+	shared->lock_holder = -1;
+	shared->input_done = false;
+	shared->processed = 0;
+	for (i = 0; i < nchunks; i++)
+		shared->chunks[i].inuse = false;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_SHARED, shared);
+
+	pcleader.shared = shared;
+	pcleader.chunkdata = shm_toc_allocate(pcxt->toc, estchunks);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_CHUNKS, pcleader.chunkdata);
+
+	ptr = shm_toc_allocate(pcxt->toc, strlen(optionsstr) + 1);
+	strcpy(ptr, optionsstr);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_OPTIONS, ptr);
+	ptr = shm_toc_allocate(pcxt->toc, strlen(attnamestr) + 1);
+	strcpy(ptr, attnamestr);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_ATTNAMELIST, ptr);
+	ptr = shm_toc_allocate(pcxt->toc, strlen(wherestr) + 1);
+	strcpy(ptr, wherestr);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_WHERE, ptr);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	LaunchParallelWorkers(pcxt);
+
+	/* If no workers were successfully launched, back out (do serial copy) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		WaitForParallelWorkersToFinish(pcxt);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	/*
+	 * Make sure that the failure-to-start case will not make us wait
+	 * forever for a free chunk.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+
+	/* Feed the input to the workers */
+	pcleader.buf = palloc(PARALLEL_COPY_CHUNK_SIZE);
+	pcleader.len = 0;
+	pcleader.boundary = 0;
+	pcleader.lineno = 0;
+	pcleader.boundary_lineno = 0;
+	pcleader.chunk_lineno = 0;
+	parallel_copy_split_input(cstate, &pcleader);
+	pfree(pcleader.buf);
+
+	SpinLockAcquire(&shared->mutex);
+	shared->input_done = true;
+	SpinLockRelease(&shared->mutex);
+	ConditionVariableBroadcast(&shared->chunk_ready_cv);
+
+	WaitForParallelWorkersToFinish(pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&bufferusage[i], &walusage[i]);
+
+	*processed = shared->processed;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return true;
+}
+
+/*
+ * Can the insertions of this COPY be performed by parallel workers?
+ */
+static bool
+parallel_copy_is_safe(CopyFromState cstate)
+{
+	Relation	rel = cstate->rel;
+	TupleDesc	tupDesc = RelationGetDescr(rel);
+	TriggerDesc *trigdesc = rel->trigdesc;
+	List	   *indexoidlist;
+	ListCell   *lc;
+	bool		unsafe = false;
+	int			i;
+
+	/* We must be able to read ahead, and scan the input for ASCII bytes */
+	if (cstate->copy_src == COPY_OLD_FE ||
+		cstate->copy_src == COPY_CALLBACK ||
+		cstate->encoding_embeds_ascii)
+		return false;
+
+	/* Can't start parallel workers if we're one already */
+	if (IsInParallelMode())
+		return false;
+
+	/*
+	 * Only plain tables are supported.  Temporary tables live in our local
+	 * buffers, which the workers can't see.  A table created or truncated in
+	 * this (sub)transaction may have relcache state the workers can't
+	 * reproduce, and FREEZE depends on it.
+	 */
+	if (rel->rd_rel->relkind != RELKIND_RELATION ||
+		RelationUsesLocalBuffers(rel) ||
+		rel->rd_createSubid != InvalidSubTransactionId ||
+		rel->rd_firstRelfilenodeSubid != InvalidSubTransactionId ||
+		cstate->opts.freeze)
+		return false;
+
+	/*
+	 * Triggers could do anything, and foreign key and deferred uniqueness
+	 * checks are implemented as triggers too.
+	 */
+	if (trigdesc &&
+		(trigdesc->trig_insert_before_row ||
+		 trigdesc->trig_insert_after_row ||
+		 trigdesc->trig_insert_instead_row ||
+		 trigdesc->trig_insert_new_table ||
+		 trigdesc->trig_insert_before_statement ||
+		 trigdesc->trig_insert_after_statement))
+		return false;
+
+	/* All the input functions must be parallel safe */
+	for (i = 0; i < tupDesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupDesc, i);
+
+		if (att->attisdropped)
+			continue;
+
+		if (OidIsValid(cstate->in_functions[i].fn_oid) &&
+			func_parallel(cstate->in_functions[i].fn_oid) != PROPARALLEL_SAFE)
+			return false;
+
+		if (get_typtype(att->atttypid) == TYPTYPE_DOMAIN &&
+			DomainHasConstraints(att->atttypid))
+			return false;
+
+		/*
+		 * Defaults are evaluated for columns that aren't in the input, and
+		 * generated columns are always computed.
+		 */
+		if (att->attgenerated ||
+			!list_member_int(cstate->attnumlist, att->attnum))
+		{
+			Node	   *defexpr = build_column_default(rel, att->attnum);
+
+			if (parallel_copy_unsafe_walker(defexpr, NULL))
+				return false;
+		}
+	}
+
+	/* CHECK constraints */
+	if (tupDesc->constr)
+	{
+		for (i = 0; i < tupDesc->constr->num_check; i++)
+		{
+			Node	   *ccbin = (Node *) stringToNode(tupDesc->constr->check[i].ccbin);
+
+			if (parallel_copy_unsafe_walker(ccbin, NULL))
+				return false;
+		}
+	}
+
+	/* The WHERE clause */
+	if (parallel_copy_unsafe_walker(cstate->whereClause, NULL))
+		return false;
+
+	/* Index expressions and predicates, and exclusion constraints */
+	indexoidlist = RelationGetIndexList(rel);
+	foreach(lc, indexoidlist)
+	{
+		Relation	indexRel = index_open(lfirst_oid(lc), RowExclusiveLock);
+
+		if (indexRel->rd_index->indisexclusion ||
+			parallel_copy_unsafe_walker((Node *) RelationGetIndexExpressions(indexRel),
+										NULL) ||
+			parallel_copy_unsafe_walker((Node *) RelationGetIndexPredicate(indexRel),
+										NULL))
+			unsafe = true;
+
+		index_close(indexRel, NoLock);
+
+		if (unsafe)
+			break;
+	}
+	list_free(indexoidlist);
+
+	return !unsafe;
+}
+
+/* check_functions_in_node callback */
+static bool
+parallel_copy_unsafe_checker(Oid func_id, void *context)
+{
+	return (func_parallel(func_id) != PROPARALLEL_SAFE);
+}
+
+/*
+ * Does the expression contain anything a parallel worker can't evaluate?
+ *
+ * This is a stripped-down version of max_parallel_hazard_walker(), which
+ * needs planner state that we don't have.  We're stricter than it in that
+ * parallel restricted is not good enough.
+ */
+static bool
+parallel_copy_unsafe_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (check_functions_in_node(node, parallel_copy_unsafe_checker, context))
+		return true;
+
+	/* nextval() on an identity column's sequence, domain checks */
+	if (IsA(node, NextValueExpr) ||
+		IsA(node, CoerceToDomain) ||
+		IsA(node, SubLink) ||
+		IsA(node, Param))
+		return true;
+
+	return expression_tree_walker(node, parallel_copy_unsafe_walker, context);
+}
+
+/*
+ * Read all of the input through 'cstate', and pass it to the workers in
+ * chunks that end at record boundaries.
+ */
+static void
+parallel_copy_split_input(CopyFromState cstate,
+						  ParallelCopyLeaderState *pcleader)
+{
+	bool		csv_mode = cstate->opts.csv_mode;
+	bool		skip_header = cstate->opts.header_line;
+	bool		at_line_start = true;
+	bool		in_quote = false;
+	bool		last_was_esc = false;
+	bool		hit_eof = false;
+	bool		done = false;
+	EolType		eol_type = EOL_UNKNOWN;
+	char		quotec = '\0';
+	char		escapec = '\0';
+
+	if (csv_mode)
+	{
+		quotec = cstate->opts.quote[0];
+		escapec = cstate->opts.escape[0];
+		/* ignore special escape processing if it's the same as quotec */
+		if (quotec == escapec)
+			escapec = '\0';
+	}
+
+	while (!done)
+	{
+		char	   *raw_buf;
+		char		c;
+		int			ncopy = 1;
+		bool		end_of_record = false;
+
+		/*
+		 * Make sure we can look a few bytes ahead.  The buffer is padded
+		 * with a '\0' at raw_buf_len, so looking past the end at EOF is OK.
+		 */
+		if (RAW_BUF_BYTES(cstate) < 4 && !hit_eof)
+		{
+			if (!CopyLoadRawBuf(cstate))
+				hit_eof = true;
+			CHECK_FOR_INTERRUPTS();
+		}
+		if (RAW_BUF_BYTES(cstate) <= 0)
+			break;
+
+		raw_buf = cstate->raw_buf + cstate->raw_buf_index;
+		c = raw_buf[0];
+
+		if (at_line_start)
+		{
+			pcleader->lineno++;
+			at_line_start = false;
+
+			/* the first line is the header; it goes nowhere */
+			if (skip_header && pcleader->lineno > 1)
+			{
+				skip_header = false;
+				pcleader->chunk_lineno = pcleader->lineno - 1;
+				pcleader->boundary_lineno = pcleader->lineno - 1;
+			}
+
+			/*
+			 * In CSV mode, we only recognize \. alone on a line.  In text
+			 * mode, \. is recognized anywhere; see below.
+			 */
+			if (csv_mode && c == '\\' && raw_buf[1] == '.' &&
+				(raw_buf[2] == '\r' || raw_buf[2] == '\n'))
+			{
+				ncopy = (raw_buf[2] == '\r' && raw_buf[3] == '\n') ? 4 : 3;
+				end_of_record = done = true;
+			}
+		}
+
+		if (done)
+		{
+			/* end-of-copy marker, found above */
+		}
+		else if (csv_mode)
+		{
+			if (in_quote && c == escapec)
+				last_was_esc = !last_was_esc;
+			if (c == quotec && !last_was_esc)
+				in_quote = !in_quote;
+			if (c != escapec)
+				last_was_esc = false;
+
+			/* count embedded newlines the same way CopyReadLineText does */
+			if (in_quote && c == (eol_type == EOL_NL ? '\n' : '\r'))
+				pcleader->lineno++;
+		}
+		else if (c == '\\')
+		{
+			if (raw_buf[1] == '.' &&
+				(raw_buf[2] == '\r' || raw_buf[2] == '\n'))
+			{
+				ncopy = (raw_buf[2] == '\r' && raw_buf[3] == '\n') ? 4 : 3;
+				end_of_record = done = true;
+			}
+			else if (RAW_BUF_BYTES(cstate) > 1)
+				ncopy = 2;		/* skip the backslashed character */
+		}
+
+		if (!done && (c == '\r' || c == '\n') && (!csv_mode || !in_quote))
+		{
+			if (c == '\r' && raw_buf[1] == '\n' && RAW_BUF_BYTES(cstate) > 1)
+			{
+				ncopy = 2;
+				if (eol_type == EOL_UNKNOWN)
+					eol_type = EOL_CRNL;
+			}
+			else if (eol_type == EOL_UNKNOWN)
+				eol_type = (c == '\r') ? EOL_CR : EOL_NL;
+			end_of_record = true;
+		}
+
+		/* Transfer the bytes to the chunk being assembled */
+		if (!skip_header)
+		{
+			if (pcleader->len + ncopy > PARALLEL_COPY_CHUNK_SIZE)
+			{
+				if (pcleader->boundary > 0)
+				{
+					/* pass on the complete records, keep the rest */
+					parallel_copy_publish(pcleader, pcleader->boundary, false,
+										  pcleader->boundary_lineno -
+										  pcleader->chunk_lineno);
+					memmove(pcleader->buf, pcleader->buf + pcleader->boundary,
+							pcleader->len - pcleader->boundary);
+					pcleader->len -= pcleader->boundary;
+					pcleader->chunk_lineno = pcleader->boundary_lineno;
+				}
+				else
+				{
+					/* a single record doesn't fit; pass on what we have */
+					parallel_copy_publish(pcleader, pcleader->len, true,
+										  pcleader->lineno -
+										  pcleader->chunk_lineno);
+					pcleader->len = 0;
+					pcleader->chunk_lineno = pcleader->lineno;
+				}
+				pcleader->boundary = 0;
+				pcleader->boundary_lineno = pcleader->chunk_lineno;
+			}
+			if (ncopy == 1)
+				pcleader->buf[pcleader->len++] = c;
+			else
+			{
+				memcpy(pcleader->buf + pcleader->len, raw_buf, ncopy);
+				pcleader->len += ncopy;
+			}
+		}
+		cstate->raw_buf_index += ncopy;
+
+		if (end_of_record)
+		{
+			at_line_start = true;
+			if (!skip_header)
+			{
+				pcleader->boundary = pcleader->len;
+				pcleader->boundary_lineno = pcleader->lineno;
+			}
+		}
+	}
+
+	/* Pass on the last chunk */
+	if (pcleader->len > 0)
+		parallel_copy_publish(pcleader, pcleader->len, false,
+							  pcleader->lineno - pcleader->chunk_lineno);
+
+	/*
+	 * If we stopped at the end-of-copy marker, the frontend may still send
+	 * more data, which we must read and discard, like CopyReadLine() does.
+	 */
+	if (done && cstate->copy_src == COPY_NEW_FE)
+	{
+		do
+		{
+			cstate->raw_buf_index = cstate->raw_buf_len;
+		} while (CopyLoadRawBuf(cstate));
+	}
+}
+
+/*
+ * Copy the first 'len' bytes of the chunk being assembled to the next slot,
+ * waiting for the slot to be released by a worker first if necessary.
+ */
+static void
+parallel_copy_publish(ParallelCopyLeaderState *pcleader, int len,
+					  bool continued, uint64 nlines)
+{
+	ParallelCopyShared *shared = pcleader->shared;
+	ParallelCopyChunk *chunk;
+	uint64		seqno = shared->nfilled;	/* only we advance it */
+	int			slot = seqno % shared->nchunks;
+
+	chunk = &shared->chunks[slot];
+
+	for (;;)
+	{
+		bool		inuse;
+
+		SpinLockAcquire(&shared->mutex);
+		inuse = chunk->inuse;
+		SpinLockRelease(&shared->mutex);
+
+		if (!inuse)
+			break;
+		ConditionVariableSleep(&shared->chunk_free_cv,
+							   WAIT_EVENT_PARALLEL_COPY_CHUNK_FREE);
+	}
+	ConditionVariableCancelSleep();
+
+	memcpy(pcleader->chunkdata + (Size) slot * PARALLEL_COPY_CHUNK_SIZE,
+		   pcleader->buf, len);
+
+	SpinLockAcquire(&shared->mutex);
+	chunk->len = len;
+	chunk->continued = continued;
+	chunk->lines_before = pcleader->chunk_lineno;
+	chunk->nlines = nlines;
+	chunk->inuse = true;
+	shared->nfilled = seqno + 1;
+	SpinLockRelease(&shared->mutex);
+
+	ConditionVariableBroadcast(&shared->chunk_ready_cv);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+ParallelCopyMain(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCopyShared *shared;
+	CopyFromState cstate;
+	ParseState *pstate;
+	Relation	rel;
+	List	   *options;
+	List	   *attnamelist;
+	Node	   *whereClause;
+	char	   *sharedquery;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	uint64		processed;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up shared state */
+	shared = shm_toc_lookup(toc, PARALLEL_KEY_COPY_SHARED, false);
+	options = (List *) stringToNode(shm_toc_lookup(toc, PARALLEL_KEY_COPY_OPTIONS,
+												   false));
+	attnamelist = (List *) stringToNode(shm_toc_lookup(toc,
+													   PARALLEL_KEY_COPY_ATTNAMELIST,
+													   false));
+	whereClause = stringToNode(shm_toc_lookup(toc, PARALLEL_KEY_COPY_WHERE,
+											  false));
+
+	pcworker = palloc0(sizeof(ParallelCopyWorkerState));
+	pcworker->shared = shared;
+	pcworker->chunkdata = shm_toc_lookup(toc, PARALLEL_KEY_COPY_CHUNKS, false);
+	pcworker->cur_slot = -1;
+
+	/* Open the table with the same lock mode as the leader */
+	rel = table_open(shared->relid, RowExclusiveLock);
+
+	pstate = make_parsestate(NULL);
+	pstate->p_sourcetext = debug_query_string;
+	(void) addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										 NULL, false, false);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	cstate = BeginCopyFrom(pstate, rel, whereClause, NULL, false,
+						   parallel_copy_read_data, attnamelist, options);
+	processed = CopyFrom(cstate);
+	EndCopyFrom(cstate);
+
+	/* We might have stopped at the end-of-copy marker with a chunk taken */
+	parallel_copy_release_chunk();
+
+	SpinLockAcquire(&shared->mutex);
+	shared->processed += processed;
+	SpinLockRelease(&shared->mutex);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	table_close(rel, RowExclusiveLock);
+	free_parsestate(pstate);
+}
+
+/*
+ * Data source callback for the COPY running in a worker.  Returns bytes
+ * from the chunks this worker has taken, taking a new chunk when the
+ * current one runs out.  Like CopyGetData(), returns at least 'minread'
+ * bytes unless the input ends, but avoids waiting for a new chunk if it
+ * already has some data to return.
+ */
+static int
+parallel_copy_read_data(void *outbuf, int minread, int maxread)
+{
+	int			bytesread = 0;
+
+	while (bytesread < maxread)
+	{
+		ParallelCopyChunk *chunk;
+		int			avail;
+
+		if (pcworker->cur_slot < 0)
+		{
+			if (bytesread >= minread)
+				break;
+			if (!parallel_copy_take_chunk())
+				break;			/* no more input */
+		}
+
+		/* The leader doesn't touch a chunk while it's in use */
+		chunk = &pcworker->shared->chunks[pcworker->cur_slot];
+		avail = Min(chunk->len - pcworker->cur_pos, maxread - bytesread);
+		memcpy((char *) outbuf + bytesread,
+			   pcworker->chunkdata +
+			   (Size) pcworker->cur_slot * PARALLEL_COPY_CHUNK_SIZE +
+			   pcworker->cur_pos,
+			   avail);
+		pcworker->cur_pos += avail;
+		bytesread += avail;
+
+		if (pcworker->cur_pos >= chunk->len)
+			parallel_copy_release_chunk();
+	}
+
+	return bytesread;
+}
+
+/*
+ * Take the next chunk of input.  Returns false if there are no more.
+ */
+static bool
+parallel_copy_take_chunk(void)
+{
+	ParallelCopyShared *shared = pcworker->shared;
+	ParallelCopyChunk *chunk = NULL;
+	ParallelCopyLineMap *map;
+	int			slot = -1;
+	bool		no_more = false;
+	bool		unlocked = false;
+
+	Assert(pcworker->cur_slot < 0);
+
+	for (;;)
+	{
+		SpinLockAcquire(&shared->mutex);
+		if (shared->ntaken < shared->nfilled &&
+			(!shared->take_locked ||
+			 shared->lock_holder == ParallelWorkerNumber))
+		{
+			slot = shared->ntaken % shared->nchunks;
+			chunk = &shared->chunks[slot];
+			shared->ntaken++;
+
+			/* keep the pieces of a continued record together */
+			unlocked = shared->take_locked && !chunk->continued;
+			shared->take_locked = chunk->continued;
+			shared->lock_holder = ParallelWorkerNumber;
+		}
+		else if (shared->input_done && shared->ntaken == shared->nfilled)
+			no_more = true;
+		SpinLockRelease(&shared->mutex);
+
+		if (chunk != NULL || no_more)
+			break;
+		ConditionVariableSleep(&shared->chunk_ready_cv,
+							   WAIT_EVENT_PARALLEL_COPY_CHUNK_READY);
+	}
+	ConditionVariableCancelSleep();
+
+	if (chunk == NULL)
+		return false;
+
+	/* Others may have been waiting for us to finish a continued record */
+	if (unlocked)
+		ConditionVariableBroadcast(&shared->chunk_ready_cv);
+
+	pcworker->cur_slot = slot;
+	pcworker->cur_pos = 0;
+
+	/* Remember where the chunk's lines are in the whole input */
+	map = &pcworker->linemap[pcworker->nlinemap % PARALLEL_COPY_LINEMAP_SIZE];
+	map->stream_base = pcworker->stream_lines;
+	map->file_base = chunk->lines_before;
+	pcworker->nlinemap++;
+	pcworker->stream_lines += chunk->nlines;
+
+	return true;
+}
+
+/*
+ * Give the current chunk, if any, back to the leader.
+ */
+static void
+parallel_copy_release_chunk(void)
+{
+	ParallelCopyShared *shared = pcworker->shared;
+
+	if (pcworker->cur_slot < 0)
+		return;
+
+	SpinLockAcquire(&shared->mutex);
+	shared->chunks[pcworker->cur_slot].inuse = false;
+	SpinLockRelease(&shared->mutex);
+	pcworker->cur_slot = -1;
+
+	ConditionVariableBroadcast(&shared->chunk_free_cv);
+}
+
+/*
+ * Translate a line number in this worker's input into a line number in the
+ * whole input, for error messages.
+ */
+uint64
+ParallelCopyWorkerLineNo(uint64 lineno)
+{
+	uint64		n;
+
+	if (pcworker == NULL)
+		return lineno;
+
+	/* Find the newest chunk that starts before the line */
+	for (n = pcworker->nlinemap;
+		 n > 0 && pcworker->nlinemap - n < PARALLEL_COPY_LINEMAP_SIZE;
+		 n--)
+	{
+		ParallelCopyLineMap *map;
+
+		map = &pcworker->linemap[(n - 1) % PARALLEL_COPY_LINEMAP_SIZE];
+		if (map->stream_base < lineno)
+			return map->file_base + (lineno - map->stream_base);
+	}
+
+	return lineno;
+}
@@ -0,0 +1,322 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Support for batch-at-a-time execution of plan nodes.
+ *
+ * Instead of passing one tuple per ExecProcNode call, a node running in
+ * batch mode fills a TupleBatch with up to executor_batch_size rows, stored
+ * column by column.  Its parent can then process every row of a column in
+ * a tight loop, rather than going through the expression interpreter once
+ * per row.  See ExecProcNodeBatch for the node-level protocol.
+ *
+ * Simple qual clauses comparing a column with a constant are evaluated here
+ * over a whole batch, narrowing the batch's selection vector.  The work is
+ * done by a kernel chosen when the qual is set up; see execBatchKernels.c.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/execBatch.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
+#include "utils/memutils.h"
+
+/* GUC parameter */
+int			executor_batch_size = 0;
+
+/*
+ * The comparison functions we know how to evaluate over a batch.  The
+ * argument types tell us how to interpret the column and the constant.
+ */
+typedef struct BatchQualFunc
+{
+	Oid			funcid;
+	BatchQualType lefttype;
+	BatchQualType righttype;
+	BatchQualOp op;
+} BatchQualFunc;
+
+static const BatchQualFunc batch_qual_funcs[] =
+{
+	{F_INT4EQ, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_EQ},
+	{F_INT4NE, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_NE},
+	{F_INT4LT, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_LT},
+	{F_INT4LE, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_LE},
+	{F_INT4GT, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_GT},
+	{F_INT4GE, BATCH_QUAL_INT4, BATCH_QUAL_INT4, BATCH_QUAL_GE},
+	{F_INT8EQ, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_EQ},
+	{F_INT8NE, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_NE},
+	{F_INT8LT, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_LT},
+	{F_INT8LE, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_LE},
+	{F_INT8GT, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_GT},
+	{F_INT8GE, BATCH_QUAL_INT8, BATCH_QUAL_INT8, BATCH_QUAL_GE},
+	{F_INT48EQ, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_EQ},
+	{F_INT48NE, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_NE},
+	{F_INT48LT, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_LT},
+	{F_INT48LE, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_LE},
+	{F_INT48GT, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_GT},
+	{F_INT48GE, BATCH_QUAL_INT4, BATCH_QUAL_INT8, BATCH_QUAL_GE},
+	{F_INT84EQ, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_EQ},
+	{F_INT84NE, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_NE},
+	{F_INT84LT, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_LT},
+	{F_INT84LE, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_LE},
+	{F_INT84GT, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_GT},
+	{F_INT84GE, BATCH_QUAL_INT8, BATCH_QUAL_INT4, BATCH_QUAL_GE},
+	{F_FLOAT8EQ, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_EQ},
+	{F_FLOAT8NE, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_NE},
+	{F_FLOAT8LT, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_LT},
+	{F_FLOAT8LE, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_LE},
+	{F_FLOAT8GT, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_GT},
+	{F_FLOAT8GE, BATCH_QUAL_FLOAT8, BATCH_QUAL_FLOAT8, BATCH_QUAL_GE}
+};
+
+/*
+ * MakeTupleBatch
+ *
+ * Create an empty batch able to hold maxrows rows of the given descriptor.
+ * Only the attributes listed in attnos (1-based) are stored.
+ *
+ * The batch is allocated in the current memory context.
+ */
+TupleBatch *
+MakeTupleBatch(TupleDesc tupdesc, int maxrows, Bitmapset *attnos)
+{
+	TupleBatch *batch;
+	int			attno;
+
+	Assert(maxrows > 0 && maxrows <= MAX_EXECUTOR_BATCH_SIZE);
+
+	batch = palloc0(sizeof(TupleBatch));
+	batch->tupdesc = tupdesc;
+	batch->maxrows = maxrows;
+	batch->values = palloc0(sizeof(Datum *) * tupdesc->natts);
+	batch->isnull = palloc0(sizeof(bool *) * tupdesc->natts);
+	batch->sel = palloc(sizeof(uint16) * maxrows);
+
+	attno = -1;
+	while ((attno = bms_next_member(attnos, attno)) >= 0)
+	{
+		Assert(attno > 0 && attno <= tupdesc->natts);
+		batch->values[attno - 1] = palloc(sizeof(Datum) * maxrows);
+		batch->isnull[attno - 1] = palloc(sizeof(bool) * maxrows);
+		batch->natts = Max(batch->natts, attno);
+	}
+
+	batch->context = AllocSetContextCreate(CurrentMemoryContext,
+										   "TupleBatch",
+										   ALLOCSET_DEFAULT_SIZES);
+
+	return batch;
+}
+
+/*
+ * ResetTupleBatch
+ *
+ * Empty the batch, releasing any pass-by-reference values copied into it.
+ */
+void
+ResetTupleBatch(TupleBatch *batch)
+{
+	batch->nrows = 0;
+	batch->nselected = 0;
+	MemoryContextReset(batch->context);
+}
+
+/*
+ * TupleBatchAddSlot
+ *
+ * Append the tuple in the slot to the batch, which must not be full.  The
+ * new row is selected.
+ *
+ * Pass-by-reference values are copied, since the slot's contents (and any
+ * buffer pin keeping them valid) only last until the next tuple is fetched.
+ */
+void
+TupleBatchAddSlot(TupleBatch *batch, TupleTableSlot *slot)
+{
+	int			row = batch->nrows;
+	int			i;
+
+	Assert(!TupleBatchIsFull(batch));
+
+	slot_getsomeattrs(slot, batch->natts);
+
+	for (i = 0; i < batch->natts; i++)
+	{
+		Form_pg_attribute attr;
+
+		if (batch->values[i] == NULL)
+			continue;
+
+		batch->isnull[i][row] = slot->tts_isnull[i];
+		if (slot->tts_isnull[i])
+		{
+			batch->values[i][row] = (Datum) 0;
+			continue;
+		}
+
+		attr = TupleDescAttr(batch->tupdesc, i);
+		if (attr->attbyval)
+			batch->values[i][row] = slot->tts_values[i];
+		else
+		{
+			MemoryContext oldcontext = MemoryContextSwitchTo(batch->context);
+
+			batch->values[i][row] = datumCopy(slot->tts_values[i], false,
+											  attr->attlen);
+			MemoryContextSwitchTo(oldcontext);
+		}
+	}
+
+	batch->sel[batch->nselected++] = row;
+	batch->nrows++;
+}
+
+/*
+ * ExecBatchQualSupported
+ *
+ * Check whether a qual clause of a scan of range table entry varno can be
+ * evaluated by ExecBatchQual, and if so fill in *bqual.
+ *
+ * We accept only comparisons of a column with a non-null constant using
+ * one of the operators in batch_qual_funcs.  Those can't fail, so it
+ * doesn't matter in which order they're applied relative to other quals.
+ */
+bool
+ExecBatchQualSupported(Expr *clause, Index varno, BatchQual *bqual)
+{
+	OpExpr	   *opexpr;
+	Node	   *leftop;
+	Node	   *rightop;
+	Var		   *var;
+	Const	   *con;
+	BatchQualType consttype;
+	const BatchKernels *kernels;
+	bool		commuted;
+	int			i;
+
+	if (!IsA(clause, OpExpr))
+		return false;
+	opexpr = (OpExpr *) clause;
+	if (list_length(opexpr->args) != 2)
+		return false;
+
+	leftop = linitial(opexpr->args);
+	rightop = lsecond(opexpr->args);
+	if (IsA(leftop, Var) && IsA(rightop, Const))
+	{
+		var = (Var *) leftop;
+		con = (Const *) rightop;
+		commuted = false;
+	}
+	else if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		var = (Var *) rightop;
+		con = (Const *) leftop;
+		commuted = true;
+	}
+	else
+		return false;
+
+	if (var->varno != varno || var->varlevelsup != 0 || var->varattno <= 0)
+		return false;
+	if (con->constisnull)
+		return false;
+
+	set_opfuncid(opexpr);
+	for (i = 0; i < lengthof(batch_qual_funcs); i++)
+	{
+		if (batch_qual_funcs[i].funcid == opexpr->opfuncid)
+			break;
+	}
+	if (i >= lengthof(batch_qual_funcs))
+		return false;
+
+	bqual->attno = var->varattno;
+	bqual->op = batch_qual_funcs[i].op;
+	if (!commuted)
+	{
+		bqual->type = batch_qual_funcs[i].lefttype;
+		consttype = batch_qual_funcs[i].righttype;
+	}
+	else
+	{
+		/* "const op column" is the same as "column commutator const" */
+		bqual->type = batch_qual_funcs[i].righttype;
+		consttype = batch_qual_funcs[i].lefttype;
+		switch (bqual->op)
+		{
+			case BATCH_QUAL_LT:
+				bqual->op = BATCH_QUAL_GT;
+				break;
+			case BATCH_QUAL_LE:
+				bqual->op = BATCH_QUAL_GE;
+				break;
+			case BATCH_QUAL_GT:
+				bqual->op = BATCH_QUAL_LT;
+				break;
+			case BATCH_QUAL_GE:
+				bqual->op = BATCH_QUAL_LE;
+				break;
+			default:
+				break;
+		}
+	}
+
+	switch (consttype)
+	{
+		case BATCH_QUAL_INT4:
+			bqual->intval = DatumGetInt32(con->constvalue);
+			break;
+		case BATCH_QUAL_INT8:
+			bqual->intval = DatumGetInt64(con->constvalue);
+			break;
+		case BATCH_QUAL_FLOAT8:
+			bqual->floatval = DatumGetFloat8(con->constvalue);
+			break;
+	}
+
+	/* choose the kernel now, so that ExecBatchQual needn't */
+	kernels = GetBatchKernels();
+	switch (bqual->type)
+	{
+		case BATCH_QUAL_INT4:
+			bqual->filter = kernels->filter_int4[bqual->op];
+			break;
+		case BATCH_QUAL_INT8:
+			bqual->filter = kernels->filter_int8[bqual->op];
+			break;
+		case BATCH_QUAL_FLOAT8:
+			bqual->filter = kernels->filter_float8[bqual->op];
+			break;
+	}
+
+	return true;
+}
+
+/*
+ * ExecBatchQual
+ *
+ * Remove the rows that don't satisfy the qual from the batch's selection
+ * vector.
+ */
+void
+ExecBatchQual(TupleBatch *batch, BatchQual *bqual)
+{
+	Datum	   *values = batch->values[bqual->attno - 1];
+	bool	   *isnull = batch->isnull[bqual->attno - 1];
+
+	Assert(values != NULL);
+
+	batch->nselected = bqual->filter(values, isnull, batch->sel,
+									 batch->nselected, bqual);
+}
@@ -0,0 +1,256 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatchKernels.c
+ *	  Portable kernels for batch execution, and selection of the kernels
+ *	  to use on the current processor.
+ *
+ * The kernels evaluate quals and aggregate transitions over one column of
+ * a TupleBatch.  The versions here are plain loops; execBatchKernels_avx2.c
+ * has versions using the x86 AVX2 instructions, which GetBatchKernels()
+ * picks instead if the processor supports them, in the same way as
+ * pg_crc32c_sse42_choose.c picks the CRC-32C implementation.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatchKernels.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+#ifdef HAVE__GET_CPUID
+#include <cpuid.h>
+#endif
+#ifdef HAVE__CPUID
+#include <intrin.h>
+#endif
+#endif
+
+#include "executor/execBatch.h"
+#include "utils/float.h"
+
+/*
+ * Filter the selected rows of a column with a comparison.  A NULL never
+ * satisfies the (strict) comparison.
+ */
+#define BATCH_FILTER_FUNC(name, getval, cmp, consttype, constfield) \
+static int \
+name(const Datum *values, const bool *isnull, uint16 *sel, int nselected, \
+	 const BatchQual *bqual) \
+{ \
+	consttype	c = bqual->constfield; \
+	int			n = 0; \
+	int			i; \
+	\
+	for (i = 0; i < nselected; i++) \
+	{ \
+		int			row = sel[i]; \
+		\
+		if (!isnull[row] && cmp(getval(values[row]), c)) \
+			sel[n++] = row; \
+	} \
+	return n; \
+}
+
+#define BATCH_INT_EQ(a, b) ((a) == (b))
+#define BATCH_INT_NE(a, b) ((a) != (b))
+#define BATCH_INT_LT(a, b) ((a) < (b))
+#define BATCH_INT_LE(a, b) ((a) <= (b))
+#define BATCH_INT_GT(a, b) ((a) > (b))
+#define BATCH_INT_GE(a, b) ((a) >= (b))
+
+#define BATCH_INT4_GETVAL(d) ((int64) DatumGetInt32(d))
+
+BATCH_FILTER_FUNC(filter_int4_eq, BATCH_INT4_GETVAL, BATCH_INT_EQ, int64, intval)
+BATCH_FILTER_FUNC(filter_int4_ne, BATCH_INT4_GETVAL, BATCH_INT_NE, int64, intval)
+BATCH_FILTER_FUNC(filter_int4_lt, BATCH_INT4_GETVAL, BATCH_INT_LT, int64, intval)
+BATCH_FILTER_FUNC(filter_int4_le, BATCH_INT4_GETVAL, BATCH_INT_LE, int64, intval)
+BATCH_FILTER_FUNC(filter_int4_gt, BATCH_INT4_GETVAL, BATCH_INT_GT, int64, intval)
+BATCH_FILTER_FUNC(filter_int4_ge, BATCH_INT4_GETVAL, BATCH_INT_GE, int64, intval)
+
+BATCH_FILTER_FUNC(filter_int8_eq, DatumGetInt64, BATCH_INT_EQ, int64, intval)
+BATCH_FILTER_FUNC(filter_int8_ne, DatumGetInt64, BATCH_INT_NE, int64, intval)
+BATCH_FILTER_FUNC(filter_int8_lt, DatumGetInt64, BATCH_INT_LT, int64, intval)
+BATCH_FILTER_FUNC(filter_int8_le, DatumGetInt64, BATCH_INT_LE, int64, intval)
+BATCH_FILTER_FUNC(filter_int8_gt, DatumGetInt64, BATCH_INT_GT, int64, intval)
+BATCH_FILTER_FUNC(filter_int8_ge, DatumGetInt64, BATCH_INT_GE, int64, intval)
+
+/* use the float8 comparison semantics, in which NaN is largest */
+BATCH_FILTER_FUNC(filter_float8_eq, DatumGetFloat8, float8_eq, float8, floatval)
+BATCH_FILTER_FUNC(filter_float8_ne, DatumGetFloat8, float8_ne, float8, floatval)
+BATCH_FILTER_FUNC(filter_float8_lt, DatumGetFloat8, float8_lt, float8, floatval)
+BATCH_FILTER_FUNC(filter_float8_le, DatumGetFloat8, float8_le, float8, floatval)
+BATCH_FILTER_FUNC(filter_float8_gt, DatumGetFloat8, float8_gt, float8, floatval)
+BATCH_FILTER_FUNC(filter_float8_ge, DatumGetFloat8, float8_ge, float8, floatval)
+
+/*
+ * Count the non-null selected rows.
+ */
+static int
+agg_count(const Datum *values, const bool *isnull, const uint16 *sel,
+		  int nselected, int64 *result)
+{
+	int			n = nselected;
+	int			i;
+
+	for (i = 0; i < nselected; i++)
+		n -= isnull[sel[i]];
+	return n;
+}
+
+/*
+ * Sum an int4 column.  The sum of a batch can't overflow an int64.
+ */
+static int
+agg_sum_int4(const Datum *values, const bool *isnull, const uint16 *sel,
+			 int nselected, int64 *result)
+{
+	int64		sum = 0;
+	int			n = 0;
+	int			i;
+
+	for (i = 0; i < nselected; i++)
+	{
+		int			row = sel[i];
+
+		if (!isnull[row])
+		{
+			sum += DatumGetInt32(values[row]);
+			n++;
+		}
+	}
+	if (n > 0)
+		*result = sum;
+	return n;
+}
+
+/*
+ * Find the smallest or largest value of an integer column.
+ */
+#define BATCH_MINMAX_FUNC(name, getval, cmp) \
+static int \
+name(const Datum *values, const bool *isnull, const uint16 *sel, \
+	 int nselected, int64 *result) \
+{ \
+	int64		m = 0; \
+	int			n = 0; \
+	int			i; \
+	\
+	for (i = 0; i < nselected; i++) \
+	{ \
+		int			row = sel[i]; \
+		int64		val; \
+		\
+		if (isnull[row]) \
+			continue; \
+		val = getval(values[row]); \
+		if (n++ == 0 || cmp(val, m)) \
+			m = val; \
+	} \
+	if (n > 0) \
+		*result = m; \
+	return n; \
+}
+
+BATCH_MINMAX_FUNC(agg_min_int4, BATCH_INT4_GETVAL, BATCH_INT_LT)
+BATCH_MINMAX_FUNC(agg_max_int4, BATCH_INT4_GETVAL, BATCH_INT_GT)
+BATCH_MINMAX_FUNC(agg_min_int8, DatumGetInt64, BATCH_INT_LT)
+BATCH_MINMAX_FUNC(agg_max_int8, DatumGetInt64, BATCH_INT_GT)
+
+const BatchKernels batch_kernels_portable =
+{
+	{filter_int4_eq, filter_int4_ne, filter_int4_lt,
+	 filter_int4_le, filter_int4_gt, filter_int4_ge},
+	{filter_int8_eq, filter_int8_ne, filter_int8_lt,
+	 filter_int8_le, filter_int8_gt, filter_int8_ge},
+	{filter_float8_eq, filter_float8_ne, filter_float8_lt,
+	 filter_float8_le, filter_float8_gt, filter_float8_ge},
+	agg_count,
+	agg_sum_int4,
+	agg_min_int4,
+	agg_max_int4,
+	agg_min_int8,
+	agg_max_int8
+};
+
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+
+static void
+batch_cpuid(int leaf, unsigned int *exx)
+{
+#if defined(HAVE__GET_CPUID)
+	__cpuid_count(leaf, 0, exx[0], exx[1], exx[2], exx[3]);
+#elif defined(HAVE__CPUID)
+	__cpuidex((int *) exx, leaf, 0);
+#else
+#error cpuid instruction not available
+#endif
+}
+
+/*
+ * Can we use the AVX2 instructions?  Besides the processor supporting them,
+ * the operating system must save the 256-bit YMM registers across context
+ * switches, which it advertises in the XCR0 register.
+ */
+static bool
+batch_avx2_available(void)
+{
+	unsigned int exx[4] = {0, 0, 0, 0};
+	uint64		xcr0;
+
+	batch_cpuid(0, exx);
+	if (exx[0] < 7)
+		return false;
+
+	batch_cpuid(1, exx);
+	if ((exx[2] & (1 << 27)) == 0 ||	/* OSXSAVE */
+		(exx[2] & (1 << 28)) == 0)	/* AVX */
+		return false;
+
+#if defined(_MSC_VER)
+	xcr0 = _xgetbv(0);
+#else
+	{
+		uint32		eax,
+					edx;
+
+		__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		xcr0 = ((uint64) edx << 32) | eax;
+	}
+#endif
+	if ((xcr0 & 0x6) != 0x6)	/* XMM and YMM state */
+		return false;
+
+	batch_cpuid(7, exx);
+	return (exx[1] & (1 << 5)) != 0;	/* AVX2 */
+}
+
+#endif							/* USE_AVX2_WITH_RUNTIME_CHECK */
+
+/*
+ * GetBatchKernels
+ *
+ * Return the fastest set of kernels that works on this processor.  The
+ * choice is made on the first call.
+ */
+const BatchKernels *
+GetBatchKernels(void)
+{
+	static const BatchKernels *kernels = NULL;
+
+	if (kernels == NULL)
+	{
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+		if (batch_avx2_available())
+			kernels = &batch_kernels_avx2;
+		else
+#endif
+			kernels = &batch_kernels_portable;
+	}
+
+	return kernels;
+}
@@ -0,0 +1,523 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatchKernels_avx2.c
+ *	  Batch execution kernels using the x86 AVX2 instructions.
+ *
+ * These process four selected rows at a time, one per 64-bit lane.  When
+ * every row of the batch is still selected, the column arrays are loaded
+ * directly; otherwise the values of the selected rows are gathered.
+ *
+ * int4 datums are sign-extended to the width of Datum by Int32GetDatum(),
+ * so int4 columns can be compared and summed as if they were int8.  Since
+ * Datums are 64 bits wide, float8 values are stored in the column arrays
+ * by value, and can be loaded as doubles.
+ *
+ * This file is compiled with CFLAGS_AVX2, and its kernels are only used
+ * after GetBatchKernels() has checked that the processor supports AVX2.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatchKernels_avx2.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+
+#include <immintrin.h>
+
+#include "executor/execBatch.h"
+#include "utils/float.h"
+
+/*
+ * Are the selected rows exactly the first nselected rows of the batch?
+ * As sel is in ascending order, it's enough to look at the last entry.
+ */
+#define SEL_IS_DENSE(sel, nselected) \
+	((nselected) > 0 && (sel)[(nselected) - 1] == (nselected) - 1)
+
+/* Load the indexes of four selected rows, for a gather */
+#define LOAD_SEL4(sel) \
+	_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (sel)))
+
+/*
+ * Return a mask with every bit of a lane set if that row is null, given
+ * the null flags of four rows packed into the bytes of an integer.
+ */
+static inline __m256i
+null_mask(uint32 flags)
+{
+	return _mm256_cmpgt_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128((int) flags)),
+							  _mm256_setzero_si256());
+}
+
+/* The null flags of rows i .. i + 3 of the batch */
+static inline uint32
+null_flags_dense(const bool *isnull, int i)
+{
+	uint32		flags;
+
+	memcpy(&flags, &isnull[i], sizeof(flags));
+	return flags;
+}
+
+/* The null flags of the four rows listed in sel */
+static inline uint32
+null_flags_sparse(const bool *isnull, const uint16 *sel)
+{
+	return (uint32) isnull[sel[0]] |
+		((uint32) isnull[sel[1]] << 8) |
+		((uint32) isnull[sel[2]] << 16) |
+		((uint32) isnull[sel[3]] << 24);
+}
+
+/*
+ * Append the rows whose bit is set in bits to sel[*n].  The rows have
+ * already been read from sel, and we never write past the last of them,
+ * so this is safe to do in place.
+ */
+static inline void
+append_rows(uint16 *sel, int *n, const int *rows, int bits)
+{
+	int			k;
+
+	for (k = 0; k < 4; k++)
+	{
+		sel[*n] = rows[k];
+		*n += (bits >> k) & 1;
+	}
+}
+
+/*
+ * Filter an integer column.  op is a constant in each caller, so the
+ * switches are resolved at compile time.
+ */
+static pg_attribute_always_inline int
+filter_int(const Datum *values, const bool *isnull, uint16 *sel,
+		   int nselected, int64 c, BatchQualOp op)
+{
+	__m256i		cv = _mm256_set1_epi64x(c);
+	bool		dense = SEL_IS_DENSE(sel, nselected);
+	int			n = 0;
+	int			i;
+
+	for (i = 0; i + 4 <= nselected; i += 4)
+	{
+		int			rows[4];
+		__m256i		v;
+		__m256i		m;
+		uint32		flags;
+		int			bits;
+		int			k;
+
+		if (dense)
+		{
+			for (k = 0; k < 4; k++)
+				rows[k] = i + k;
+			v = _mm256_loadu_si256((const __m256i *) &values[i]);
+			flags = null_flags_dense(isnull, i);
+		}
+		else
+		{
+			for (k = 0; k < 4; k++)
+				rows[k] = sel[i + k];
+			v = _mm256_i32gather_epi64((const long long *) values,
+									   LOAD_SEL4(&sel[i]), 8);
+			flags = null_flags_sparse(isnull, &sel[i]);
+		}
+
+		switch (op)
+		{
+			case BATCH_QUAL_EQ:
+			case BATCH_QUAL_NE:
+				m = _mm256_cmpeq_epi64(v, cv);
+				break;
+			case BATCH_QUAL_LT:
+			case BATCH_QUAL_GE:
+				m = _mm256_cmpgt_epi64(cv, v);
+				break;
+			case BATCH_QUAL_GT:
+			case BATCH_QUAL_LE:
+			default:
+				m = _mm256_cmpgt_epi64(v, cv);
+				break;
+		}
+		bits = _mm256_movemask_pd(_mm256_castsi256_pd(m));
+		if (op == BATCH_QUAL_NE || op == BATCH_QUAL_GE || op == BATCH_QUAL_LE)
+			bits ^= 0xF;
+		bits &= ~_mm256_movemask_pd(_mm256_castsi256_pd(null_mask(flags)));
+
+		append_rows(sel, &n, rows, bits);
+	}
+
+	for (; i < nselected; i++)
+	{
+		int			row = sel[i];
+		int64		val = DatumGetInt64(values[row]);
+		bool		match;
+
+		switch (op)
+		{
+			case BATCH_QUAL_EQ:
+				match = (val == c);
+				break;
+			case BATCH_QUAL_NE:
+				match = (val != c);
+				break;
+			case BATCH_QUAL_LT:
+				match = (val < c);
+				break;
+			case BATCH_QUAL_LE:
+				match = (val <= c);
+				break;
+			case BATCH_QUAL_GT:
+				match = (val > c);
+				break;
+			case BATCH_QUAL_GE:
+			default:
+				match = (val >= c);
+				break;
+		}
+		if (!isnull[row] && match)
+			sel[n++] = row;
+	}
+
+	return n;
+}
+
+/*
+ * Filter a float8 column, with the float8 comparison semantics in which NaN
+ * equals NaN and is larger than any other value.  Given a constant that is
+ * not NaN, those are the ordered comparisons for =, <, <= and the unordered
+ * ones for <>, >, >=.  A NaN constant is rare enough to leave to the
+ * portable kernel.
+ */
+static pg_attribute_always_inline int
+filter_float8(const Datum *values, const bool *isnull, uint16 *sel,
+			  int nselected, const BatchQual *bqual, BatchQualOp op)
+{
+	float8		c = bqual->floatval;
+	__m256d		cv;
+	bool		dense = SEL_IS_DENSE(sel, nselected);
+	int			n = 0;
+	int			i;
+
+	if (isnan(c))
+		return batch_kernels_portable.filter_float8[op] (values, isnull, sel,
+														 nselected, bqual);
+
+	cv = _mm256_set1_pd(c);
+	for (i = 0; i + 4 <= nselected; i += 4)
+	{
+		int			rows[4];
+		__m256d		v;
+		__m256d		m;
+		uint32		flags;
+		int			bits;
+		int			k;
+
+		if (dense)
+		{
+			for (k = 0; k < 4; k++)
+				rows[k] = i + k;
+			v = _mm256_loadu_pd((const double *) &values[i]);
+			flags = null_flags_dense(isnull, i);
+		}
+		else
+		{
+			for (k = 0; k < 4; k++)
+				rows[k] = sel[i + k];
+			v = _mm256_i32gather_pd((const double *) values,
+									LOAD_SEL4(&sel[i]), 8);
+			flags = null_flags_sparse(isnull, &sel[i]);
+		}
+
+		switch (op)
+		{
+			case BATCH_QUAL_EQ:
+				m = _mm256_cmp_pd(v, cv, _CMP_EQ_OQ);
+				break;
+			case BATCH_QUAL_NE:
+				m = _mm256_cmp_pd(v, cv, _CMP_NEQ_UQ);
+				break;
+			case BATCH_QUAL_LT:
+				m = _mm256_cmp_pd(v, cv, _CMP_LT_OQ);
+				break;
+			case BATCH_QUAL_LE:
+				m = _mm256_cmp_pd(v, cv, _CMP_LE_OQ);
+				break;
+			case BATCH_QUAL_GT:
+				m = _mm256_cmp_pd(v, cv, _CMP_NLE_UQ);
+				break;
+			case BATCH_QUAL_GE:
+			default:
+				m = _mm256_cmp_pd(v, cv, _CMP_NLT_UQ);
+				break;
+		}
+		bits = _mm256_movemask_pd(m);
+		bits &= ~_mm256_movemask_pd(_mm256_castsi256_pd(null_mask(flags)));
+
+		append_rows(sel, &n, rows, bits);
+	}
+
+	for (; i < nselected; i++)
+	{
+		int			row = sel[i];
+		float8		val = DatumGetFloat8(values[row]);
+		bool		match;
+
+		switch (op)
+		{
+			case BATCH_QUAL_EQ:
+				match = float8_eq(val, c);
+				break;
+			case BATCH_QUAL_NE:
+				match = float8_ne(val, c);
+				break;
+			case BATCH_QUAL_LT:
+				match = float8_lt(val, c);
+				break;
+			case BATCH_QUAL_LE:
+				match = float8_le(val, c);
+				break;
+			case BATCH_QUAL_GT:
+				match = float8_gt(val, c);
+				break;
+			case BATCH_QUAL_GE:
+			default:
+				match = float8_ge(val, c);
+				break;
+		}
+		if (!isnull[row] && match)
+			sel[n++] = row;
+	}
+
+	return n;
+}
+
+#define AVX2_FILTER_INT_FUNC(name, op) \
+static int \
+name(const Datum *values, const bool *isnull, uint16 *sel, int nselected, \
+	 const BatchQual *bqual) \
+{ \
+	return filter_int(values, isnull, sel, nselected, bqual->intval, op); \
+}
+
+#define AVX2_FILTER_FLOAT8_FUNC(name, op) \
+static int \
+name(const Datum *values, const bool *isnull, uint16 *sel, int nselected, \
+	 const BatchQual *bqual) \
+{ \
+	return filter_float8(values, isnull, sel, nselected, bqual, op); \
+}
+
+AVX2_FILTER_INT_FUNC(filter_int_eq, BATCH_QUAL_EQ)
+AVX2_FILTER_INT_FUNC(filter_int_ne, BATCH_QUAL_NE)
+AVX2_FILTER_INT_FUNC(filter_int_lt, BATCH_QUAL_LT)
+AVX2_FILTER_INT_FUNC(filter_int_le, BATCH_QUAL_LE)
+AVX2_FILTER_INT_FUNC(filter_int_gt, BATCH_QUAL_GT)
+AVX2_FILTER_INT_FUNC(filter_int_ge, BATCH_QUAL_GE)
+
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_eq, BATCH_QUAL_EQ)
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_ne, BATCH_QUAL_NE)
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_lt, BATCH_QUAL_LT)
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_le, BATCH_QUAL_LE)
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_gt, BATCH_QUAL_GT)
+AVX2_FILTER_FLOAT8_FUNC(filter_float8_ge, BATCH_QUAL_GE)
+
+/*
+ * Count the non-null selected rows.  If all rows are selected, add up the
+ * null flags 32 at a time.
+ */
+static int
+agg_count(const Datum *values, const bool *isnull, const uint16 *sel,
+		  int nselected, int64 *result)
+{
+	int			nnull = 0;
+	int			i = 0;
+
+	if (SEL_IS_DENSE(sel, nselected))
+	{
+		__m256i		zero = _mm256_setzero_si256();
+		__m256i		acc = zero;
+		int64		lanes[4];
+
+		for (; i + 32 <= nselected; i += 32)
+		{
+			__m256i		flags = _mm256_loadu_si256((const __m256i *) &isnull[i]);
+
+			acc = _mm256_add_epi64(acc, _mm256_sad_epu8(flags, zero));
+		}
+		_mm256_storeu_si256((__m256i *) lanes, acc);
+		nnull = (int) (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+
+		for (; i < nselected; i++)
+			nnull += isnull[i];
+	}
+	else
+	{
+		for (; i < nselected; i++)
+			nnull += isnull[sel[i]];
+	}
+
+	return nselected - nnull;
+}
+
+typedef enum AggIntKind
+{
+	AGG_INT_SUM,
+	AGG_INT_MIN,
+	AGG_INT_MAX
+} AggIntKind;
+
+/*
+ * Sum, or find the minimum or maximum of, an integer column.  Null rows are
+ * replaced by a value that doesn't change the result.  kind is a constant
+ * in each caller.
+ */
+static pg_attribute_always_inline int
+agg_int(const Datum *values, const bool *isnull, const uint16 *sel,
+		int nselected, int64 *result, AggIntKind kind)
+{
+	bool		dense = SEL_IS_DENSE(sel, nselected);
+	int64		fillval;
+	__m256i		fill;
+	__m256i		acc;
+	__m256i		nnullv = _mm256_setzero_si256();
+	int64		lanes[4];
+	int64		m;
+	int			nnull;
+	int			i;
+	int			k;
+
+	switch (kind)
+	{
+		case AGG_INT_SUM:
+			fillval = 0;
+			break;
+		case AGG_INT_MIN:
+			fillval = PG_INT64_MAX;
+			break;
+		case AGG_INT_MAX:
+		default:
+			fillval = PG_INT64_MIN;
+			break;
+	}
+	fill = _mm256_set1_epi64x(fillval);
+	acc = fill;
+
+	for (i = 0; i + 4 <= nselected; i += 4)
+	{
+		__m256i		v;
+		__m256i		nulls;
+
+		if (dense)
+		{
+			v = _mm256_loadu_si256((const __m256i *) &values[i]);
+			nulls = null_mask(null_flags_dense(isnull, i));
+		}
+		else
+		{
+			v = _mm256_i32gather_epi64((const long long *) values,
+									   LOAD_SEL4(&sel[i]), 8);
+			nulls = null_mask(null_flags_sparse(isnull, &sel[i]));
+		}
+		v = _mm256_blendv_epi8(v, fill, nulls);
+		/* a null lane is -1 in the mask, so this counts the nulls */
+		nnullv = _mm256_sub_epi64(nnullv, nulls);
+
+		switch (kind)
+		{
+			case AGG_INT_SUM:
+				acc = _mm256_add_epi64(acc, v);
+				break;
+			case AGG_INT_MIN:
+				acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+				break;
+			case AGG_INT_MAX:
+			default:
+				acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+				break;
+		}
+	}
+
+	_mm256_storeu_si256((__m256i *) lanes, nnullv);
+	nnull = (int) (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+	m = fillval;
+	for (k = 0; k < 4; k++)
+	{
+		if (kind == AGG_INT_SUM)
+			m += lanes[k];
+		else if (kind == AGG_INT_MIN ? lanes[k] < m : lanes[k] > m)
+			m = lanes[k];
+	}
+
+	for (; i < nselected; i++)
+	{
+		int			row = sel[i];
+		int64		val = DatumGetInt64(values[row]);
+
+		if (isnull[row])
+		{
+			nnull++;
+			continue;
+		}
+		if (kind == AGG_INT_SUM)
+			m += val;
+		else if (kind == AGG_INT_MIN ? val < m : val > m)
+			m = val;
+	}
+
+	if (nselected > nnull)
+		*result = m;
+	return nselected - nnull;
+}
+
+static int
+agg_sum_int(const Datum *values, const bool *isnull, const uint16 *sel,
+			int nselected, int64 *result)
+{
+	return agg_int(values, isnull, sel, nselected, result, AGG_INT_SUM);
+}
+
+static int
+agg_min_int(const Datum *values, const bool *isnull, const uint16 *sel,
+			int nselected, int64 *result)
+{
+	return agg_int(values, isnull, sel, nselected, result, AGG_INT_MIN);
+}
+
+static int
+agg_max_int(const Datum *values, const bool *isnull, const uint16 *sel,
+			int nselected, int64 *result)
+{
+	return agg_int(values, isnull, sel, nselected, result, AGG_INT_MAX);
+}
+
+/*
+ * int4 and int8 columns share the integer kernels.  Summing is only used
+ * for int4, whose sum over a batch can't overflow.
+ */
+const BatchKernels batch_kernels_avx2 =
+{
+	{filter_int_eq, filter_int_ne, filter_int_lt,
+	 filter_int_le, filter_int_gt, filter_int_ge},
+	{filter_int_eq, filter_int_ne, filter_int_lt,
+	 filter_int_le, filter_int_gt, filter_int_ge},
+	{filter_float8_eq, filter_float8_ne, filter_float8_lt,
+	 filter_float8_le, filter_float8_gt, filter_float8_ge},
+	agg_count,
+	agg_sum_int,
+	agg_min_int,
+	agg_max_int,
+	agg_min_int,
+	agg_max_int
+};
+
+#endif							/* USE_AVX2_WITH_RUNTIME_CHECK */
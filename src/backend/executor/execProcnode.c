@@ -72,6 +72,7 @@
  */
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
 #include "executor/nodeAppend.h"
@@ -528,6 +529,102 @@ MultiExecProcNode(PlanState *node)
 }
 
 
+/* ----------------------------------------------------------------
+ *		ExecSupportsBatchMode
+ *
+ *		Can the node return its tuples through ExecProcNodeBatch?
+ * ----------------------------------------------------------------
+ */
+bool
+ExecSupportsBatchMode(PlanState *node)
+{
+	switch (nodeTag(node))
+	{
+			/*
+			 * Only node types that actually support batch mode will be
+			 * listed
+			 */
+
+		case T_SeqScanState:
+			return ExecSeqScanSupportsBatch((SeqScanState *) node);
+
+		default:
+			return false;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEnableBatchMode
+ *
+ *		Switch a node for which ExecSupportsBatchMode returned true to
+ *		batch mode, with batches of up to maxrows tuples.  attnos lists
+ *		the columns of the node's output that the caller will read.
+ *		Once this is done, the caller must fetch tuples with
+ *		ExecProcNodeBatch rather than ExecProcNode.
+ * ----------------------------------------------------------------
+ */
+void
+ExecEnableBatchMode(PlanState *node, int maxrows, Bitmapset *attnos)
+{
+	switch (nodeTag(node))
+	{
+		case T_SeqScanState:
+			ExecSeqScanEnableBatch((SeqScanState *) node, maxrows, attnos);
+			break;
+
+		default:
+			elog(ERROR, "unrecognized node type: %d", (int) nodeTag(node));
+			break;
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecProcNodeBatch
+ *
+ *		Return the next batch of tuples from a node in batch mode, or
+ *		NULL when there are no more.  Only the rows listed in the
+ *		batch's selection vector are part of the result, and the batch
+ *		is only valid until the next call.
+ *
+ *		Unlike MultiExecProcNode, we do the instrumentation here,
+ *		counting each selected row as a tuple.
+ * ----------------------------------------------------------------
+ */
+TupleBatch *
+ExecProcNodeBatch(PlanState *node)
+{
+	TupleBatch *result;
+
+	check_stack_depth();
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (node->chgParam != NULL) /* something changed */
+		ExecReScan(node);		/* let ReScan handle this */
+
+	if (node->instrument)
+		InstrStartNode(node->instrument);
+
+	switch (nodeTag(node))
+	{
+		case T_SeqScanState:
+			result = ExecSeqScanBatch((SeqScanState *) node);
+			break;
+
+		default:
+			elog(ERROR, "unrecognized node type: %d", (int) nodeTag(node));
+			result = NULL;
+			break;
+	}
+
+	if (node->instrument)
+		InstrStopNode(node->instrument,
+					  result != NULL ? (double) result->nselected : 0.0);
+
+	return result;
+}
+
+
 /* ----------------------------------------------------------------
  *		ExecEndNode
  *
@@ -19,6 +19,7 @@
 #include "postgres.h"
 
 #include "executor/executor.h"
+#include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
 #include "utils/memutils.h"
 
@@ -173,10 +174,11 @@ ExecScan(ScanState *node,
 	/* interrupt checks are in ExecScanFetch */
 
 	/*
-	 * If we have neither a qual to check nor a projection to do, just skip
-	 * all the overhead and return the raw scan tuple.
+	 * If we have neither a qual to check nor a projection to do, nor a
+	 * runtime join filter to apply, just skip all the overhead and return the
+	 * raw scan tuple.
 	 */
-	if (!qual && !projInfo)
+	if (!qual && !projInfo && !node->ss_JoinFilter)
 	{
 		ResetExprContext(econtext);
 		return ExecScanFetch(node, accessMtd, recheckMtd);
@@ -227,29 +229,29 @@ ExecScan(ScanState *node,
 		if (qual == NULL || ExecQual(qual, econtext))
 		{
 			/*
-			 * Found a satisfactory scan tuple.
+			 * Found a satisfactory scan tuple.  If we're projecting, form a
+			 * projection tuple and store it in the result tuple slot;
+			 * otherwise return the scan tuple.
 			 */
 			if (projInfo)
-			{
-				/*
-				 * Form a projection tuple, store it in the result tuple slot
-				 * and return it.
-				 */
-				return ExecProject(projInfo);
-			}
-			else
-			{
-				/*
-				 * Here, we aren't projecting, so just return scan tuple.
-				 */
+				slot = ExecProject(projInfo);
+
+			/*
+			 * A hash join above us may have asked us to discard tuples that
+			 * can't have a join partner.  The filter may uninstall itself,
+			 * so fetch it afresh for each tuple.
+			 */
+			if (node->ss_JoinFilter == NULL ||
+				ExecHashJoinFilterTuple(node->ss_JoinFilter, econtext, slot))
 				return slot;
-			}
+
+			InstrCountFiltered2(node, 1);
 		}
 		else
 			InstrCountFiltered1(node, 1);
 
 		/*
-		 * Tuple fails qual, so free per-tuple memory and try again.
+		 * Tuple fails qual or filter, so free per-tuple memory and try again.
 		 */
 		ResetExprContext(econtext);
 	}
@@ -228,6 +228,18 @@
  *    to filter expressions having to be evaluated early, and allows to JIT
  *    the entire expression into one native function.
  *
+ *    Batch mode:
+ *
+ *    For a plain aggregate whose input comes straight from a node that
+ *    supports batch execution (see execBatch.c), and whose transitions each
+ *    take at most one plain input column, we instead read the input a batch
+ *    at a time with ExecProcNodeBatch() and call each transition function
+ *    over the batch's column array directly, skipping the per-row
+ *    interpretation of the evaltrans expression.  count(), sum() of int4,
+ *    and min() and max() of int4 and int8 don't call their transition
+ *    functions at all: a kernel from execBatchKernels.c, chosen when the
+ *    node is initialized, processes the whole column instead.
+ *
  * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -246,6 +258,8 @@
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "common/hashfn.h"
+#include "common/int.h"
+#include "executor/execBatch.h"
 #include "executor/execExpr.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -261,6 +275,7 @@
 #include "utils/datum.h"
 #include "utils/dynahash.h"
 #include "utils/expandeddatum.h"
+#include "utils/fmgroids.h"
 #include "utils/logtape.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
@@ -389,6 +404,11 @@ static void advance_transition_function(AggState *aggstate,
 										AggStatePerTrans pertrans,
 										AggStatePerGroup pergroupstate);
 static void advance_aggregates(AggState *aggstate);
+static void advance_transition_kernel(AggStatePerTrans pertrans,
+									  AggStatePerGroup pergroupstate,
+									  TupleBatch *batch, Datum *values,
+									  bool *isnull);
+static void advance_aggregates_batch(AggState *aggstate, TupleBatch *batch);
 static void process_ordered_aggregate_single(AggState *aggstate,
 											 AggStatePerTrans pertrans,
 											 AggStatePerGroup pergroupstate);
@@ -432,6 +452,10 @@ static void initialize_hash_entry(AggState *aggstate,
 								  TupleHashEntry entry);
 static void lookup_hash_entries(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_batch(AggState *aggstate);
+static bool agg_batch_mode_supported(AggState *aggstate, Bitmapset **attnos);
+static void agg_batch_choose_kernel(AggStatePerTrans pertrans,
+									const BatchKernels *kernels);
 static void agg_fill_hash_table(AggState *aggstate);
 static bool agg_refill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
@@ -844,6 +868,154 @@ advance_aggregates(AggState *aggstate)
 							  &dummynull);
 }
 
+/*
+ * Advance a transition state over the selected rows of a batch using the
+ * kernel chosen by agg_batch_choose_kernel, giving the same result as
+ * calling the transition function on each row would.
+ */
+static void
+advance_transition_kernel(AggStatePerTrans pertrans,
+						  AggStatePerGroup pergroupstate,
+						  TupleBatch *batch, Datum *values, bool *isnull)
+{
+	int64		result;
+	int64		newval;
+	int			n;
+
+	/*
+	 * count(*) and count(x) just add the number of (non-null) rows to the
+	 * count, which is never null since the initial value is 0.
+	 */
+	if (pertrans->batch_kind == AGG_BATCH_COUNT)
+	{
+		int64		count = batch->nselected;
+
+		Assert(!pergroupstate->transValueIsNull);
+
+		if (isnull != NULL)
+			count = pertrans->batch_func(values, isnull, batch->sel,
+										 batch->nselected, NULL);
+
+		if (unlikely(pg_add_s64_overflow(DatumGetInt64(pergroupstate->transValue),
+										 count, &result)))
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("bigint out of range")));
+		pergroupstate->transValue = Int64GetDatum(result);
+		return;
+	}
+
+	/* The transition functions ignore null inputs */
+	n = pertrans->batch_func(values, isnull, batch->sel, batch->nselected,
+							 &result);
+	if (n == 0)
+		return;
+
+	if (pergroupstate->noTransValue ||
+		(pertrans->batch_kind == AGG_BATCH_SUM &&
+		 pergroupstate->transValueIsNull))
+	{
+		/*
+		 * The first non-null input becomes the state of min() and max(), as
+		 * for any strict transition function with a null initial value.
+		 * int4_sum does the same.
+		 */
+		newval = result;
+	}
+	else if (pergroupstate->transValueIsNull)
+	{
+		/* a strict transition function never changes a null state */
+		return;
+	}
+	else
+	{
+		int64		oldval;
+
+		if (pertrans->transtypeLen == sizeof(int32))
+			oldval = DatumGetInt32(pergroupstate->transValue);
+		else
+			oldval = DatumGetInt64(pergroupstate->transValue);
+
+		switch (pertrans->batch_kind)
+		{
+			case AGG_BATCH_SUM:
+				/* like int4_sum, don't check for overflow */
+				newval = oldval + result;
+				break;
+			case AGG_BATCH_MIN:
+				newval = Min(oldval, result);
+				break;
+			case AGG_BATCH_MAX:
+				newval = Max(oldval, result);
+				break;
+			default:
+				elog(ERROR, "unrecognized batch aggregate kind: %d",
+					 (int) pertrans->batch_kind);
+				newval = 0;		/* keep compiler quiet */
+				break;
+		}
+	}
+
+	if (pertrans->transtypeLen == sizeof(int32))
+		pergroupstate->transValue = Int32GetDatum((int32) newval);
+	else
+		pergroupstate->transValue = Int64GetDatum(newval);
+	pergroupstate->transValueIsNull = false;
+	pergroupstate->noTransValue = false;
+}
+
+/*
+ * Advance each aggregate transition state for the selected rows of a batch
+ * of input.  This is only used for plain aggregation, so there is a single
+ * grouping set.
+ *
+ * When called, CurrentMemoryContext should be the per-query context.
+ */
+static void
+advance_aggregates_batch(AggState *aggstate, TupleBatch *batch)
+{
+	AggStatePerGroup pergroup = aggstate->pergroups[0];
+	int			transno;
+
+	select_current_set(aggstate, 0, false);
+
+	for (transno = 0; transno < aggstate->numtrans; transno++)
+	{
+		AggStatePerTrans pertrans = &aggstate->pertrans[transno];
+		AggStatePerGroup pergroupstate = &pergroup[transno];
+		FunctionCallInfo fcinfo = pertrans->transfn_fcinfo;
+		AttrNumber	attno = aggstate->batch_attnos[transno];
+		Datum	   *values = NULL;
+		bool	   *isnull = NULL;
+		int			i;
+
+		if (attno > 0)
+		{
+			values = batch->values[attno - 1];
+			isnull = batch->isnull[attno - 1];
+		}
+
+		if (pertrans->batch_kind != AGG_BATCH_GENERIC)
+		{
+			advance_transition_kernel(pertrans, pergroupstate, batch,
+									  values, isnull);
+			continue;
+		}
+
+		for (i = 0; i < batch->nselected; i++)
+		{
+			if (values != NULL)
+			{
+				int			row = batch->sel[i];
+
+				fcinfo->args[1].value = values[row];
+				fcinfo->args[1].isnull = isnull[row];
+			}
+			advance_transition_function(aggstate, pertrans, pergroupstate);
+		}
+	}
+}
+
 /*
  * Run the transition function for a DISTINCT or ORDER BY aggregate
  * with only one input.  This is called after we have completed
@@ -2159,6 +2331,12 @@ ExecAgg(PlanState *pstate)
 				result = agg_retrieve_hash_table(node);
 				break;
 			case AGG_PLAIN:
+				if (node->batch_mode)
+				{
+					result = agg_retrieve_batch(node);
+					break;
+				}
+				/* FALLTHROUGH */
 			case AGG_SORTED:
 				result = agg_retrieve_direct(node);
 				break;
@@ -2517,6 +2695,163 @@ agg_retrieve_direct(AggState *aggstate)
 	return NULL;
 }
 
+/*
+ * ExecAgg for plain aggregation with batch-mode input
+ *
+ * This produces the single output row, like agg_retrieve_direct would, but
+ * consumes the input a batch at a time.
+ */
+static TupleTableSlot *
+agg_retrieve_batch(AggState *aggstate)
+{
+	ExprContext *econtext = aggstate->ss.ps.ps_ExprContext;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	TupleBatch *batch;
+
+	ReScanExprContext(econtext);
+	ReScanExprContext(aggstate->aggcontexts[0]);
+
+	initialize_aggregates(aggstate, aggstate->pergroups, 1);
+
+	while ((batch = ExecProcNodeBatch(outerstate)) != NULL)
+	{
+		advance_aggregates_batch(aggstate, batch);
+
+		/* Reset per-input-tuple context after each batch */
+		ResetExprContext(aggstate->tmpcontext);
+	}
+
+	aggstate->agg_done = true;
+
+	/*
+	 * As in agg_retrieve_direct with no input, the representative input
+	 * tuple is empty; without grouping there can't be any references to
+	 * non-aggregated input columns.
+	 */
+	econtext->ecxt_outertuple = ExecClearTuple(aggstate->ss.ss_ScanTupleSlot);
+
+	prepare_projection_slot(aggstate, econtext->ecxt_outertuple, 0);
+
+	select_current_set(aggstate, 0, false);
+
+	finalize_aggregates(aggstate, aggstate->peragg, aggstate->pergroups[0]);
+
+	return project_aggregates(aggstate);
+}
+
+/*
+ * Can we read the input of this Agg node in batch mode?
+ *
+ * That requires plain aggregation over a child that supports batch mode,
+ * with no DISTINCT, ORDER BY or FILTER in any aggregate, and each
+ * transition function taking either no input or a single column of the
+ * child's output.  On success, store the columns needed in *attnos and
+ * the input column of each transition in aggstate->batch_attnos.
+ */
+static bool
+agg_batch_mode_supported(AggState *aggstate, Bitmapset **attnos)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	AttrNumber *batch_attnos;
+	int			transno;
+
+	if (executor_batch_size <= 0)
+		return false;
+	if (aggstate->aggstrategy != AGG_PLAIN || node->groupingSets != NIL)
+		return false;
+	if (DO_AGGSPLIT_COMBINE(aggstate->aggsplit))
+		return false;
+	if (outerstate == NULL || !ExecSupportsBatchMode(outerstate))
+		return false;
+
+	batch_attnos = palloc0(sizeof(AttrNumber) * Max(aggstate->numtrans, 1));
+	*attnos = NULL;
+
+	for (transno = 0; transno < aggstate->numtrans; transno++)
+	{
+		AggStatePerTrans pertrans = &aggstate->pertrans[transno];
+		Aggref	   *aggref = pertrans->aggref;
+		TargetEntry *tle;
+		Var		   *var;
+
+		if (aggref->aggkind != AGGKIND_NORMAL ||
+			aggref->aggfilter != NULL ||
+			pertrans->numSortCols > 0 ||
+			pertrans->numInputs > 1 ||
+			pertrans->numTransInputs != pertrans->numInputs)
+			return false;
+
+		if (pertrans->numInputs == 0)
+			continue;
+
+		tle = linitial_node(TargetEntry, aggref->args);
+		if (!IsA(tle->expr, Var))
+			return false;
+		var = (Var *) tle->expr;
+		if (var->varno != OUTER_VAR || var->varattno <= 0)
+			return false;
+
+		batch_attnos[transno] = var->varattno;
+		*attnos = bms_add_member(*attnos, var->varattno);
+	}
+
+	for (transno = 0; transno < aggstate->numtrans; transno++)
+		agg_batch_choose_kernel(&aggstate->pertrans[transno],
+								GetBatchKernels());
+
+	aggstate->batch_attnos = batch_attnos;
+	return true;
+}
+
+/*
+ * Choose how advance_aggregates_batch should advance a transition: with a
+ * kernel, if there's one that computes the same thing as the transition
+ * function, or else by calling the transition function for each row.
+ */
+static void
+agg_batch_choose_kernel(AggStatePerTrans pertrans,
+						const BatchKernels *kernels)
+{
+	pertrans->batch_kind = AGG_BATCH_GENERIC;
+	pertrans->batch_func = NULL;
+
+	/* the kernels' results are all pass-by-value integers */
+	if (!pertrans->transtypeByVal)
+		return;
+
+	switch (pertrans->transfn_oid)
+	{
+		case F_INT8INC:
+		case F_INT8INC_ANY:
+			pertrans->batch_kind = AGG_BATCH_COUNT;
+			pertrans->batch_func = kernels->count;
+			break;
+		case F_INT4_SUM:
+			pertrans->batch_kind = AGG_BATCH_SUM;
+			pertrans->batch_func = kernels->sum_int4;
+			break;
+		case F_INT4SMALLER:
+			pertrans->batch_kind = AGG_BATCH_MIN;
+			pertrans->batch_func = kernels->min_int4;
+			break;
+		case F_INT4LARGER:
+			pertrans->batch_kind = AGG_BATCH_MAX;
+			pertrans->batch_func = kernels->max_int4;
+			break;
+		case F_INT8SMALLER:
+			pertrans->batch_kind = AGG_BATCH_MIN;
+			pertrans->batch_func = kernels->min_int8;
+			break;
+		case F_INT8LARGER:
+			pertrans->batch_kind = AGG_BATCH_MAX;
+			pertrans->batch_func = kernels->max_int8;
+			break;
+		default:
+			break;
+	}
+}
+
 /*
  * ExecAgg for hashed case: read input and build hash table
  */
@@ -4016,6 +4351,21 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		phase->evaltrans_cache[0][0] = phase->evaltrans;
 	}
 
+	/*
+	 * Switch the input to batch mode, if possible.  The transition
+	 * expression built above then goes unused.
+	 */
+	{
+		Bitmapset  *attnos;
+
+		if (agg_batch_mode_supported(aggstate, &attnos))
+		{
+			ExecEnableBatchMode(outerPlanState(aggstate),
+								executor_batch_size, attnos);
+			aggstate->batch_mode = true;
+		}
+	}
+
 	return aggstate;
 }
 
@@ -34,6 +34,7 @@
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
+#include "lib/bloomfilter.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/atomics.h"
@@ -174,6 +175,12 @@ MultiExecPrivateHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			/* Remember the hash value for the runtime join filter, if any */
+			if (hashtable->bloom)
+				bloom_add_element(hashtable->bloom,
+								  (unsigned char *) &hashvalue,
+								  sizeof(hashvalue));
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -497,6 +504,7 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	hashtable->nbatch_original = nbatch;
 	hashtable->nbatch_outstart = nbatch;
 	hashtable->growEnabled = true;
+	hashtable->bloom = NULL;
 	hashtable->totalTuples = 0;
 	hashtable->partialTuples = 0;
 	hashtable->skewTuples = 0;
@@ -878,6 +886,37 @@ ExecHashTableDestroy(HashJoinTable hashtable)
 	pfree(hashtable);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecHashTableCreateFilter
+ *
+ *		arrange for the hash values of the inner tuples to be collected
+ *		in a Bloom filter while the hash table is built, for use as a
+ *		runtime join filter.  ntuples is the expected number of inner
+ *		tuples.  Only supported for backend-private hash tables.
+ * ----------------------------------------------------------------
+ */
+void
+ExecHashTableCreateFilter(HashJoinTable hashtable, double ntuples)
+{
+	MemoryContext oldcxt;
+
+	Assert(hashtable->parallel_state == NULL);
+	Assert(hashtable->bloom == NULL);
+
+	/* Force a plausible relation size if no info */
+	if (ntuples <= 0.0)
+		ntuples = 1000.0;
+	ntuples = Min(ntuples, (double) PG_INT32_MAX);
+
+	/*
+	 * The filter is not counted in spaceUsed: it doesn't grow with the data
+	 * and couldn't be shrunk by increasing the number of batches anyway.
+	 */
+	oldcxt = MemoryContextSwitchTo(hashtable->hashCxt);
+	hashtable->bloom = bloom_create((int64) ntuples, work_mem, 0);
+	MemoryContextSwitchTo(oldcxt);
+}
+
 /*
  * ExecHashIncreaseNumBatches
  *		increase the original number of batches in order to reduce
@@ -112,6 +112,7 @@
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
+#include "lib/bloomfilter.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "utils/memutils.h"
@@ -133,6 +134,17 @@
 /* Returns true if doing null-fill on inner relation */
 #define HJ_FILL_INNER(hjstate)	((hjstate)->hj_NullOuterTupleSlot != NULL)
 
+/*
+ * A runtime join filter is only used if the outer relation is expected to
+ * have at least HJ_FILTER_SAMPLE tuples, and is given up on if it rejects
+ * less than HJ_FILTER_MIN_REJECT of the first HJ_FILTER_SAMPLE tuples.
+ */
+#define HJ_FILTER_SAMPLE		4096
+#define HJ_FILTER_MIN_REJECT	0.25
+
+/* GUC parameter */
+bool		enable_hashjoin_filter = true;
+
 static TupleTableSlot *ExecHashJoinOuterGetTuple(PlanState *outerNode,
 												 HashJoinState *hjstate,
 												 uint32 *hashvalue);
@@ -146,6 +158,10 @@ static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
 static bool ExecHashJoinNewBatch(HashJoinState *hjstate);
 static bool ExecParallelHashJoinNewBatch(HashJoinState *hjstate);
 static void ExecParallelHashJoinPartitionOuter(HashJoinState *node);
+static void ExecHashJoinInitFilter(HashJoinState *hjstate);
+static List *ExecHashJoinFindFilterScans(PlanState *planstate, List *scans);
+static void ExecHashJoinInstallFilter(HashJoinState *hjstate);
+static void ExecHashJoinRemoveFilter(HashJoinFilter filter);
 
 
 /* ----------------------------------------------------------------
@@ -288,6 +304,9 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 				 * arrived too late.
 				 */
 				hashNode->hashtable = hashtable;
+				if (node->hj_Filter && node->hj_Filter->enabled)
+					ExecHashTableCreateFilter(hashtable,
+											  hashNode->ps.plan->plan_rows);
 				(void) MultiExecProcNode((PlanState *) hashNode);
 
 				/*
@@ -298,6 +317,12 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 				if (hashtable->totalTuples == 0 && !HJ_FILL_OUTER(node))
 					return NULL;
 
+				/*
+				 * Let the outer scans discard tuples that can't have a match.
+				 */
+				if (hashtable->bloom)
+					ExecHashJoinInstallFilter(node);
+
 				/*
 				 * need to remember whether nbatch has increased since we
 				 * began scanning the outer relation
@@ -752,6 +777,8 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
 
+	ExecHashJoinInitFilter(hjstate);
+
 	return hjstate;
 }
 
@@ -769,6 +796,8 @@ ExecEndHashJoin(HashJoinState *node)
 	 */
 	if (node->hj_HashTable)
 	{
+		if (node->hj_Filter)
+			ExecHashJoinRemoveFilter(node->hj_Filter);
 		ExecHashTableDestroy(node->hj_HashTable);
 		node->hj_HashTable = NULL;
 	}
@@ -1342,6 +1371,10 @@ ExecReScanHashJoin(HashJoinState *node)
 			/* for safety, be sure to clear child plan node's pointer too */
 			hashNode->hashtable = NULL;
 
+			/* the runtime filter is about to go away along with the table */
+			if (node->hj_Filter)
+				ExecHashJoinRemoveFilter(node->hj_Filter);
+
 			ExecHashTableDestroy(node->hj_HashTable);
 			node->hj_HashTable = NULL;
 			node->hj_JoinState = HJ_BUILD_HASHTABLE;
@@ -1433,6 +1466,160 @@ ExecParallelHashJoinPartitionOuter(HashJoinState *hjstate)
 		sts_end_write(hashtable->batches[i].outer_tuples);
 }
 
+/*
+ * ExecHashJoinInitFilter
+ *		Decide whether to use a runtime join filter, and which scans on the
+ *		outer side it applies to.
+ *
+ * The filter can only be used if outer tuples without a match are discarded.
+ * It isn't used with Parallel Hash, because each participant only sees its
+ * share of the inner tuples.  Below a parallel-oblivious hash join, though,
+ * a Parallel Seq Scan in each participant discards tuples before they cross
+ * the Gather.
+ */
+static void
+ExecHashJoinInitFilter(HashJoinState *hjstate)
+{
+	PlanState  *outerState = outerPlanState(hjstate);
+	HashJoinFilter filter;
+	List	   *scans;
+
+	hjstate->hj_Filter = NULL;
+
+	if (!enable_hashjoin_filter ||
+		HJ_FILL_OUTER(hjstate) ||
+		hjstate->js.ps.plan->parallel_aware ||
+		outerState->plan->plan_rows < HJ_FILTER_SAMPLE)
+		return;
+
+	scans = ExecHashJoinFindFilterScans(outerState, NIL);
+	if (scans == NIL)
+		return;
+
+	filter = (HashJoinFilter) palloc0(sizeof(HashJoinFilterData));
+	filter->hashkeys = hjstate->hj_OuterHashKeys;
+	filter->scans = scans;
+	filter->enabled = true;
+	hjstate->hj_Filter = filter;
+}
+
+/*
+ * ExecHashJoinFindFilterScans
+ *		Add the scans that return the output of planstate unchanged to
+ *		scans, and return the list.
+ *
+ * That's a Seq Scan, or the Seq Scans below an Append, such as the scans of
+ * the partitions of a partitioned table that weren't pruned.
+ */
+static List *
+ExecHashJoinFindFilterScans(PlanState *planstate, List *scans)
+{
+	switch (nodeTag(planstate))
+	{
+		case T_SeqScanState:
+			scans = lappend(scans, planstate);
+			break;
+		case T_AppendState:
+			{
+				AppendState *astate = (AppendState *) planstate;
+
+				for (int i = 0; i < astate->as_nplans; i++)
+					scans = ExecHashJoinFindFilterScans(astate->appendplans[i],
+														scans);
+			}
+			break;
+		default:
+			break;
+	}
+
+	return scans;
+}
+
+/*
+ * ExecHashJoinInstallFilter
+ *		Make the outer scans use the Bloom filter built along with the
+ *		hash table.
+ */
+static void
+ExecHashJoinInstallFilter(HashJoinState *hjstate)
+{
+	HashJoinFilter filter = hjstate->hj_Filter;
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	ListCell   *lc;
+
+	Assert(filter != NULL && filter->enabled);
+	Assert(hashtable->bloom != NULL);
+
+	/*
+	 * If there were many more inner tuples than estimated, the filter is too
+	 * full to reject much.
+	 */
+	if (bloom_prop_bits_set(hashtable->bloom) > 0.75)
+		return;
+
+	filter->hashtable = hashtable;
+	foreach(lc, filter->scans)
+		((ScanState *) lfirst(lc))->ss_JoinFilter = filter;
+}
+
+/*
+ * ExecHashJoinRemoveFilter
+ *		Stop the outer scans from using the filter.
+ */
+static void
+ExecHashJoinRemoveFilter(HashJoinFilter filter)
+{
+	ListCell   *lc;
+
+	foreach(lc, filter->scans)
+		((ScanState *) lfirst(lc))->ss_JoinFilter = NULL;
+	filter->hashtable = NULL;
+}
+
+/*
+ * ExecHashJoinFilterTuple
+ *		Check a tuple returned by a scan against the runtime join filter
+ *		installed in the scan.
+ *
+ * Returns false if the tuple can't have a match, in which case the scan
+ * should discard it.  The tuple must be in the form the scan returns it,
+ * after projection.
+ */
+bool
+ExecHashJoinFilterTuple(HashJoinFilter filter, ExprContext *econtext,
+						TupleTableSlot *slot)
+{
+	uint32		hashvalue;
+	bool		result;
+
+	Assert(filter->hashtable != NULL);
+
+	/* Tuples with NULL keys can't match either, as in the join itself */
+	econtext->ecxt_outertuple = slot;
+	result = ExecHashGetHashValue(filter->hashtable, econtext,
+								  filter->hashkeys,
+								  true, /* outer tuple */
+								  false,	/* discard nulls */
+								  &hashvalue) &&
+		!bloom_lacks_element(filter->hashtable->bloom,
+							 (unsigned char *) &hashvalue,
+							 sizeof(hashvalue));
+
+	filter->nprobes++;
+	if (!result)
+		filter->nrejected++;
+
+	/* Give up on the filter if it isn't worth its cost */
+	if (filter->nprobes == HJ_FILTER_SAMPLE &&
+		filter->nrejected < HJ_FILTER_SAMPLE * HJ_FILTER_MIN_REJECT)
+	{
+		filter->enabled = false;
+		ExecHashJoinRemoveFilter(filter);
+	}
+
+	return result;
+}
+
 void
 ExecHashJoinEstimate(HashJoinState *state, ParallelContext *pcxt)
 {
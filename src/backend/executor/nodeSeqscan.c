@@ -20,6 +20,10 @@
  *		ExecEndSeqScan			releases any storage allocated.
  *		ExecReScanSeqScan		rescans the relation
  *
+ *		ExecSeqScanSupportsBatch checks whether batch mode can be used
+ *		ExecSeqScanEnableBatch	switches the node to batch mode
+ *		ExecSeqScanBatch		returns the next batch of qualifying tuples
+ *
  *		ExecSeqScanEstimate		estimates DSM space needed for parallel scan
  *		ExecSeqScanInitializeDSM initialize DSM for parallel scan
  *		ExecSeqScanReInitializeDSM reinitialize DSM for fresh parallel scan
@@ -29,8 +33,10 @@
 
 #include "access/relscan.h"
 #include "access/tableam.h"
+#include "executor/execBatch.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
+#include "miscadmin.h"
 #include "utils/rel.h"
 
 static TupleTableSlot *SeqNext(SeqScanState *node);
@@ -231,9 +237,138 @@ ExecReScanSeqScan(SeqScanState *node)
 		table_rescan(scan,		/* scan desc */
 					 NULL);		/* new scan keys */
 
+	node->batch_done = false;
+
 	ExecScanReScan((ScanState *) node);
 }
 
+/* ----------------------------------------------------------------
+ *						Batch Mode Support
+ * ----------------------------------------------------------------
+ */
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanSupportsBatch
+ *
+ *		A batch holds the columns of the scan tuple, so we can only
+ *		run in batch mode if the node doesn't project.  EvalPlanQual
+ *		rechecks substitute test tuples for the scan, which only
+ *		ExecScan knows how to do.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecSeqScanSupportsBatch(SeqScanState *node)
+{
+	return node->ss.ps.ps_ProjInfo == NULL &&
+		node->ss.ps.state->es_epq_active == NULL;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanEnableBatch
+ *
+ *		Prepare to return batches of up to maxrows tuples, containing
+ *		at least the columns in attnos.  The quals that can be
+ *		evaluated a batch at a time are split off from the rest.
+ * ----------------------------------------------------------------
+ */
+void
+ExecSeqScanEnableBatch(SeqScanState *node, int maxrows, Bitmapset *attnos)
+{
+	SeqScan    *plan = (SeqScan *) node->ss.ps.plan;
+	List	   *residual = NIL;
+	ListCell   *lc;
+
+	Assert(ExecSeqScanSupportsBatch(node));
+
+	node->batchquals = palloc(sizeof(BatchQual) * list_length(plan->plan.qual));
+	node->nbatchquals = 0;
+	attnos = bms_copy(attnos);
+
+	foreach(lc, plan->plan.qual)
+	{
+		Expr	   *clause = (Expr *) lfirst(lc);
+		BatchQual  *bqual = &node->batchquals[node->nbatchquals];
+
+		if (ExecBatchQualSupported(clause, plan->scanrelid, bqual))
+		{
+			attnos = bms_add_member(attnos, bqual->attno);
+			node->nbatchquals++;
+		}
+		else
+			residual = lappend(residual, clause);
+	}
+
+	node->batchresidual = ExecInitQual(residual, (PlanState *) node);
+	node->batch = MakeTupleBatch(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+								 maxrows, attnos);
+	node->batch_done = false;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatch
+ *
+ *		Returns the next batch of tuples satisfying the quals, or NULL
+ *		at the end of the scan.  The batch is only valid until the
+ *		next call.
+ *
+ *		Quals that ExecBatchQual can't handle are checked as each
+ *		tuple is fetched, before it's added to the batch; the others
+ *		are then applied to the whole batch.
+ * ----------------------------------------------------------------
+ */
+TupleBatch *
+ExecSeqScanBatch(SeqScanState *node)
+{
+	TupleBatch *batch = node->batch;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	ExprState  *residual = node->batchresidual;
+	int			i;
+
+	Assert(batch != NULL);
+
+	while (!node->batch_done)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		ResetTupleBatch(batch);
+
+		while (!TupleBatchIsFull(batch))
+		{
+			TupleTableSlot *slot = SeqNext(node);
+
+			if (slot == NULL)
+			{
+				node->batch_done = true;
+				break;
+			}
+
+			if (residual != NULL)
+			{
+				bool		pass;
+
+				econtext->ecxt_scantuple = slot;
+				pass = ExecQualAndReset(residual, econtext);
+				if (!pass)
+				{
+					InstrCountFiltered1(node, 1);
+					continue;
+				}
+			}
+
+			TupleBatchAddSlot(batch, slot);
+		}
+
+		for (i = 0; i < node->nbatchquals && batch->nselected > 0; i++)
+			ExecBatchQual(batch, &node->batchquals[i]);
+		InstrCountFiltered1(node, batch->nrows - batch->nselected);
+
+		if (batch->nselected > 0)
+			return batch;
+	}
+
+	return NULL;
+}
+
 /* ----------------------------------------------------------------
  *						Parallel Scan Support
  * ----------------------------------------------------------------
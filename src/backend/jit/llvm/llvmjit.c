@@ -34,13 +34,19 @@
 #include <llvm-c/Transforms/Utils.h>
 #endif
 
+#include "common/cryptohash.h"
+#include "common/sha2.h"
 #include "jit/llvmjit.h"
 #include "jit/llvmjit_emit.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "portability/instr_time.h"
 #include "storage/ipc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
+#include "utils/syscache.h"
 
 /* Handle of a module emitted via ORC JIT */
 typedef struct LLVMJitHandle
@@ -54,6 +60,39 @@ typedef struct LLVMJitHandle
 #endif
 } LLVMJitHandle;
 
+/*
+ * Can we look up a symbol in the code of a particular handle?  The code
+ * cache needs that, as its entries outlive the contexts that created them.
+ */
+#if LLVM_VERSION_MAJOR > 11 || \
+	defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
+#define LLVMJIT_HANDLE_LOOKUP
+#endif
+
+/*
+ * Entry of the per-backend cache of emitted code, see llvm_cache_function().
+ *
+ * An entry stays allocated while any JIT context uses its code, even after
+ * having been evicted from the cache or invalidated.
+ */
+typedef struct LLVMJitCacheEntry
+{
+	uint8		key[PG_SHA256_DIGEST_LENGTH];
+	LLVMJitHandle *handle;		/* emitted code */
+	void	   *func;			/* the expression's function in that code */
+	int			nfuncs;			/* # of functions in the code */
+	int			refcount;		/* # of JIT contexts using the code */
+	bool		valid;			/* still in the cache? */
+	dlist_node	lru_node;		/* position in LRU list, if valid */
+} LLVMJitCacheEntry;
+
+/* hash table entry of the code cache */
+typedef struct LLVMJitCacheHashEntry
+{
+	uint8		key[PG_SHA256_DIGEST_LENGTH];	/* hash key, must be first */
+	LLVMJitCacheEntry *entry;
+} LLVMJitCacheHashEntry;
+
 
 /* types & functions commonly needed for JITing */
 LLVMTypeRef TypeSizeT;
@@ -106,12 +145,38 @@ static LLVMOrcJITStackRef llvm_opt0_orc;
 static LLVMOrcJITStackRef llvm_opt3_orc;
 #endif							/* LLVM_VERSION_MAJOR > 11 */
 
+/* code cache, keyed by hash of the IR, and its entries in LRU order */
+static HTAB *llvm_code_cache = NULL;
+static dlist_head llvm_code_cache_lru = DLIST_STATIC_INIT(llvm_code_cache_lru);
+static int	llvm_code_cache_entries = 0;
+static bool llvm_code_cache_flush_pending = false;
+static size_t llvm_code_cache_generation = 0;
+
 
 static void llvm_release_context(JitContext *context);
+static void llvm_release_handle(LLVMJitHandle *handle);
 static void llvm_session_initialize(void);
 static void llvm_shutdown(int code, Datum arg);
 static void llvm_compile_module(LLVMJitContext *context);
+static LLVMJitHandle *llvm_emit_module(LLVMJitContext *context,
+									   LLVMModuleRef module,
+									   size_t module_generation);
 static void llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module);
+#ifdef LLVMJIT_HANDLE_LOOKUP
+static void *llvm_handle_lookup(LLVMJitContext *context,
+								LLVMJitHandle *handle,
+								const char *funcname);
+static int	llvm_cache_rename_functions(LLVMModuleRef module,
+										const char *prefix,
+										const char *funcname,
+										int *nfuncs);
+#endif
+static void llvm_cache_release_entry(LLVMJitCacheEntry *entry);
+static void llvm_cache_remove_entry(LLVMJitCacheEntry *entry);
+static void llvm_cache_evict(void);
+static void llvm_cache_flush(void);
+static void llvm_cache_invalidate_callback(Datum arg, int cacheid,
+										   uint32 hashvalue);
 
 static void llvm_create_types(void);
 static uint64_t llvm_resolve_symbol(const char *name, void *ctx);
@@ -195,32 +260,55 @@ llvm_release_context(JitContext *context)
 		jit_handle = (LLVMJitHandle *) linitial(llvm_context->handles);
 		llvm_context->handles = list_delete_first(llvm_context->handles);
 
+		llvm_release_handle(jit_handle);
+	}
+
+	/* let go of the cached code used by the context */
+	while (llvm_context->cache_entries != NIL)
+	{
+		LLVMJitCacheEntry *entry;
+
+		entry = (LLVMJitCacheEntry *) linitial(llvm_context->cache_entries);
+		llvm_context->cache_entries =
+			list_delete_first(llvm_context->cache_entries);
+
+		Assert(entry->refcount > 0);
+		if (--entry->refcount == 0 && !entry->valid)
+			llvm_cache_release_entry(entry);
+	}
+	llvm_cache_evict();
+}
+
+/*
+ * Remove emitted code from the JIT, and free the handle.
+ */
+static void
+llvm_release_handle(LLVMJitHandle *jit_handle)
+{
 #if LLVM_VERSION_MAJOR > 11
-		{
-			LLVMOrcExecutionSessionRef ee;
-			LLVMOrcSymbolStringPoolRef sp;
-
-			LLVMOrcResourceTrackerRemove(jit_handle->resource_tracker);
-			LLVMOrcReleaseResourceTracker(jit_handle->resource_tracker);
-
-			/*
-			 * Without triggering cleanup of the string pool, we'd leak
-			 * memory. It'd be sufficient to do this far less often, but in
-			 * experiments the required time was small enough to just always
-			 * do it.
-			 */
-			ee = LLVMOrcLLJITGetExecutionSession(jit_handle->lljit);
-			sp = LLVMOrcExecutionSessionGetSymbolStringPool(ee);
-			LLVMOrcSymbolStringPoolClearDeadEntries(sp);
-		}
+	{
+		LLVMOrcExecutionSessionRef ee;
+		LLVMOrcSymbolStringPoolRef sp;
+
+		LLVMOrcResourceTrackerRemove(jit_handle->resource_tracker);
+		LLVMOrcReleaseResourceTracker(jit_handle->resource_tracker);
+
+		/*
+		 * Without triggering cleanup of the string pool, we'd leak memory.
+		 * It'd be sufficient to do this far less often, but in experiments
+		 * the required time was small enough to just always do it.
+		 */
+		ee = LLVMOrcLLJITGetExecutionSession(jit_handle->lljit);
+		sp = LLVMOrcExecutionSessionGetSymbolStringPool(ee);
+		LLVMOrcSymbolStringPoolClearDeadEntries(sp);
+	}
 #else							/* LLVM_VERSION_MAJOR > 11 */
-		{
-			LLVMOrcRemoveModule(jit_handle->stack, jit_handle->orc_handle);
-		}
+	{
+		LLVMOrcRemoveModule(jit_handle->stack, jit_handle->orc_handle);
+	}
 #endif							/* LLVM_VERSION_MAJOR > 11 */
 
-		pfree(jit_handle);
-	}
+	pfree(jit_handle);
 }
 
 /*
@@ -275,8 +363,7 @@ llvm_expand_funcname(struct LLVMJitContext *context, const char *basename)
 void *
 llvm_get_function(LLVMJitContext *context, const char *funcname)
 {
-#if LLVM_VERSION_MAJOR > 11 || \
-	defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
+#ifdef LLVMJIT_HANDLE_LOOKUP
 	ListCell   *lc;
 #endif
 
@@ -296,47 +383,15 @@ llvm_get_function(LLVMJitContext *context, const char *funcname)
 	 * to mangle here.
 	 */
 
-#if LLVM_VERSION_MAJOR > 11
+#ifdef LLVMJIT_HANDLE_LOOKUP
 	foreach(lc, context->handles)
 	{
 		LLVMJitHandle *handle = (LLVMJitHandle *) lfirst(lc);
-		instr_time	starttime;
-		instr_time	endtime;
-		LLVMErrorRef error;
-		LLVMOrcJITTargetAddress addr;
-
-		INSTR_TIME_SET_CURRENT(starttime);
-
-		addr = 0;
-		error = LLVMOrcLLJITLookup(handle->lljit, &addr, funcname);
-		if (error)
-			elog(ERROR, "failed to look up symbol \"%s\": %s",
-				 funcname, llvm_error_message(error));
-
-		/*
-		 * LLJIT only actually emits code the first time a symbol is
-		 * referenced. Thus add lookup time to emission time. That's counting
-		 * a bit more than with older LLVM versions, but unlikely to ever
-		 * matter.
-		 */
-		INSTR_TIME_SET_CURRENT(endtime);
-		INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
-							  endtime, starttime);
+		void	   *addr;
 
+		addr = llvm_handle_lookup(context, handle, funcname);
 		if (addr)
-			return (void *) (uintptr_t) addr;
-	}
-#elif defined(HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN) && HAVE_DECL_LLVMORCGETSYMBOLADDRESSIN
-	foreach(lc, context->handles)
-	{
-		LLVMOrcTargetAddress addr;
-		LLVMJitHandle *handle = (LLVMJitHandle *) lfirst(lc);
-
-		addr = 0;
-		if (LLVMOrcGetSymbolAddressIn(handle->stack, &addr, handle->orc_handle, funcname))
-			elog(ERROR, "failed to look up symbol \"%s\"", funcname);
-		if (addr)
-			return (void *) (uintptr_t) addr;
+			return addr;
 	}
 #elif LLVM_VERSION_MAJOR < 5
 	{
@@ -367,6 +422,318 @@ llvm_get_function(LLVMJitContext *context, const char *funcname)
 	return NULL;
 }
 
+#ifdef LLVMJIT_HANDLE_LOOKUP
+/*
+ * Return pointer to function funcname if it is defined in the code of
+ * handle, or NULL otherwise.
+ */
+static void *
+llvm_handle_lookup(LLVMJitContext *context, LLVMJitHandle *handle,
+				   const char *funcname)
+{
+#if LLVM_VERSION_MAJOR > 11
+	instr_time	starttime;
+	instr_time	endtime;
+	LLVMErrorRef error;
+	LLVMOrcJITTargetAddress addr;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	addr = 0;
+	error = LLVMOrcLLJITLookup(handle->lljit, &addr, funcname);
+	if (error)
+		elog(ERROR, "failed to look up symbol \"%s\": %s",
+			 funcname, llvm_error_message(error));
+
+	/*
+	 * LLJIT only actually emits code the first time a symbol is referenced.
+	 * Thus add lookup time to emission time. That's counting a bit more than
+	 * with older LLVM versions, but unlikely to ever matter.
+	 */
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
+						  endtime, starttime);
+
+	return (void *) (uintptr_t) addr;
+#else
+	LLVMOrcTargetAddress addr;
+
+	addr = 0;
+	if (LLVMOrcGetSymbolAddressIn(handle->stack, &addr, handle->orc_handle, funcname))
+		elog(ERROR, "failed to look up symbol \"%s\"", funcname);
+
+	return (void *) (uintptr_t) addr;
+#endif
+}
+#endif							/* LLVMJIT_HANDLE_LOOKUP */
+
+/*
+ * Is the code cache in use?  It requires looking up symbols in the code of
+ * a single handle, which old LLVM versions can't do.
+ */
+bool
+llvm_cache_enabled(void)
+{
+#ifdef LLVMJIT_HANDLE_LOOKUP
+	return jit_cache_size > 0;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Emit module, which has to contain all the code of one expression, through
+ * the per-backend code cache, and return a pointer to function funcname in
+ * it.  The JIT takes ownership of the module.
+ *
+ * Cached code is found by a SHA-256 hash of the module's IR, after renaming
+ * the functions defined in it by position, so expressions that were compiled
+ * alike share code.  For that to be worthwhile the IR must not embed
+ * pointers to the state of one particular expression; llvmjit_expr.c loads
+ * those from a relocation table instead.
+ *
+ * The code stays in use until the context is released, even if it is
+ * evicted from the cache in the meantime.
+ */
+void *
+llvm_cache_function(LLVMJitContext *context, LLVMModuleRef module,
+					size_t module_generation, const char *funcname)
+{
+#ifdef LLVMJIT_HANDLE_LOOKUP
+	uint8		key[PG_SHA256_DIGEST_LENGTH];
+	pg_cryptohash_ctx *ctx;
+	LLVMJitCacheHashEntry *hentry;
+	LLVMJitCacheEntry *entry;
+	MemoryContext oldcontext;
+	char	   *ir;
+	int			flags;
+	int			nfuncs;
+	int			mainfunc;
+
+	llvm_assert_in_fatal_section();
+
+	if (llvm_code_cache_flush_pending)
+		llvm_cache_flush();
+
+	if (llvm_code_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = PG_SHA256_DIGEST_LENGTH;
+		ctl.entrysize = sizeof(LLVMJitCacheHashEntry);
+		llvm_code_cache = hash_create("LLVM JIT code cache", 64, &ctl,
+									  HASH_ELEM | HASH_BLOBS);
+	}
+
+	/* give the functions names that don't depend on the context */
+	mainfunc = llvm_cache_rename_functions(module, "cached_", funcname,
+										   &nfuncs);
+	if (mainfunc < 0)
+		elog(ERROR, "failed to JIT: %s", funcname);
+
+	/* the options used for emitting the code are part of the key */
+	ir = LLVMPrintModuleToString(module);
+	flags = context->base.flags & (PGJIT_OPT3 | PGJIT_INLINE);
+
+	ctx = pg_cryptohash_create(PG_SHA256);
+	if (pg_cryptohash_init(ctx) < 0)
+		elog(ERROR, "could not initialize %s context", "SHA256");
+	if (pg_cryptohash_update(ctx, (uint8 *) ir, strlen(ir)) < 0 ||
+		pg_cryptohash_update(ctx, (uint8 *) &flags, sizeof(flags)) < 0)
+		elog(ERROR, "could not update %s context", "SHA256");
+	if (pg_cryptohash_final(ctx, key) < 0)
+		elog(ERROR, "could not finalize %s context", "SHA256");
+	pg_cryptohash_free(ctx);
+	LLVMDisposeMessage(ir);
+
+	hentry = (LLVMJitCacheHashEntry *)
+		hash_search(llvm_code_cache, key, HASH_FIND, NULL);
+	if (hentry != NULL)
+	{
+		entry = hentry->entry;
+		dlist_move_head(&llvm_code_cache_lru, &entry->lru_node);
+		LLVMDisposeModule(module);
+
+		context->base.instr.cached_functions += entry->nfuncs;
+	}
+	else
+	{
+		LLVMJitHandle *handle;
+		char	   *prefix;
+		char	   *cachedname;
+		void	   *func;
+		bool		found;
+
+		/*
+		 * All code shares one symbol namespace, so the names have to be
+		 * unique after all.
+		 */
+		prefix = psprintf("cached_%zu_", llvm_code_cache_generation++);
+		llvm_cache_rename_functions(module, prefix, NULL, &nfuncs);
+		cachedname = psprintf("%s%d", prefix, mainfunc);
+
+		handle = llvm_emit_module(context, module, module_generation);
+
+		func = llvm_handle_lookup(context, handle, cachedname);
+		if (func == NULL)
+		{
+			llvm_release_handle(handle);
+			elog(ERROR, "failed to JIT: %s", funcname);
+		}
+
+		entry = (LLVMJitCacheEntry *)
+			MemoryContextAllocZero(TopMemoryContext, sizeof(LLVMJitCacheEntry));
+		memcpy(entry->key, key, PG_SHA256_DIGEST_LENGTH);
+		entry->handle = handle;
+		entry->func = func;
+		entry->nfuncs = nfuncs;
+		entry->valid = true;
+
+		hentry = (LLVMJitCacheHashEntry *)
+			hash_search(llvm_code_cache, key, HASH_ENTER, &found);
+		Assert(!found);
+		hentry->entry = entry;
+		dlist_push_head(&llvm_code_cache_lru, &entry->lru_node);
+		llvm_code_cache_entries++;
+
+		pfree(prefix);
+		pfree(cachedname);
+	}
+
+	/* the context keeps the code alive until it's released */
+	entry->refcount++;
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	context->cache_entries = lappend(context->cache_entries, entry);
+	MemoryContextSwitchTo(oldcontext);
+
+	llvm_cache_evict();
+
+	return entry->func;
+#else
+	elog(ERROR, "JIT code cache is not supported by this LLVM version");
+	return NULL;
+#endif
+}
+
+#ifdef LLVMJIT_HANDLE_LOOKUP
+/*
+ * Rename the functions defined in module to prefix followed by their
+ * position.  Returns the position of function funcname, or -1 if there is
+ * none, and sets *nfuncs to the number of functions renamed.
+ */
+static int
+llvm_cache_rename_functions(LLVMModuleRef module, const char *prefix,
+							const char *funcname, int *nfuncs)
+{
+	LLVMValueRef func;
+	int			result = -1;
+	int			n = 0;
+
+	for (func = LLVMGetFirstFunction(module);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		char	   *name;
+
+		if (LLVMIsDeclaration(func))
+			continue;
+
+		if (funcname != NULL && strcmp(LLVMGetValueName(func), funcname) == 0)
+			result = n;
+
+		name = psprintf("%s%d", prefix, n++);
+#if LLVM_VERSION_MAJOR > 6
+		LLVMSetValueName2(func, name, strlen(name));
+#else
+		LLVMSetValueName(func, name);
+#endif
+		pfree(name);
+	}
+
+	*nfuncs = n;
+	return result;
+}
+#endif							/* LLVMJIT_HANDLE_LOOKUP */
+
+/*
+ * Evict the least recently used code while the cache holds more entries
+ * than allowed by jit_cache_size.
+ */
+static void
+llvm_cache_evict(void)
+{
+	while (llvm_code_cache_entries > jit_cache_size)
+	{
+		LLVMJitCacheEntry *entry;
+
+		entry = dlist_container(LLVMJitCacheEntry, lru_node,
+								dlist_tail_node(&llvm_code_cache_lru));
+		llvm_cache_remove_entry(entry);
+	}
+}
+
+/*
+ * Remove all entries from the cache.
+ */
+static void
+llvm_cache_flush(void)
+{
+	while (!dlist_is_empty(&llvm_code_cache_lru))
+	{
+		LLVMJitCacheEntry *entry;
+
+		entry = dlist_container(LLVMJitCacheEntry, lru_node,
+								dlist_head_node(&llvm_code_cache_lru));
+		llvm_cache_remove_entry(entry);
+	}
+	Assert(llvm_code_cache_entries == 0);
+
+	llvm_code_cache_flush_pending = false;
+}
+
+/*
+ * Remove an entry from the cache, and release its code unless a context
+ * still uses it.
+ */
+static void
+llvm_cache_remove_entry(LLVMJitCacheEntry *entry)
+{
+	Assert(entry->valid);
+
+	hash_search(llvm_code_cache, entry->key, HASH_REMOVE, NULL);
+	dlist_delete(&entry->lru_node);
+	llvm_code_cache_entries--;
+	entry->valid = false;
+
+	if (entry->refcount == 0)
+		llvm_cache_release_entry(entry);
+}
+
+/*
+ * Release the code of an entry that is no longer in the cache nor in use.
+ */
+static void
+llvm_cache_release_entry(LLVMJitCacheEntry *entry)
+{
+	Assert(!entry->valid && entry->refcount == 0);
+
+	llvm_release_handle(entry->handle);
+	pfree(entry);
+}
+
+/*
+ * Syscache callback for pg_proc and pg_type.  Cached code can refer to
+ * functions by name or address and depend on the layout of types, so start
+ * over when any of them changes.  The cache is only flushed when it is next
+ * used, as releasing code isn't safe outside the JIT's OOM handling.
+ */
+static void
+llvm_cache_invalidate_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	if (llvm_code_cache_entries > 0)
+		llvm_code_cache_flush_pending = true;
+}
+
 /*
  * Return declaration for a function referenced in llvmjit_types.c, adding it
  * to the module if necessary.
@@ -555,7 +922,7 @@ llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
 	 * functions are emitted, to reduce memory usage a bit.
 	 */
 	LLVMInitializeFunctionPassManager(llvm_fpm);
-	for (func = LLVMGetFirstFunction(context->module);
+	for (func = LLVMGetFirstFunction(module);
 		 func != NULL;
 		 func = LLVMGetNextFunction(func))
 		LLVMRunFunctionPassManager(llvm_fpm, func);
@@ -576,7 +943,7 @@ llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
 	if (context->base.flags & PGJIT_INLINE
 		&& !(context->base.flags & PGJIT_OPT3))
 		LLVMAddFunctionInliningPass(llvm_mpm);
-	LLVMRunPassManager(llvm_mpm, context->module);
+	LLVMRunPassManager(llvm_mpm, module);
 	LLVMDisposePassManager(llvm_mpm);
 
 	LLVMPassManagerBuilderDispose(llvm_pmb);
@@ -590,6 +957,38 @@ llvm_compile_module(LLVMJitContext *context)
 {
 	LLVMJitHandle *handle;
 	MemoryContext oldcontext;
+
+	handle = llvm_emit_module(context, context->module,
+							  context->module_generation);
+
+	/* the module is now owned by the JIT */
+	context->module = NULL;
+	context->compiled = true;
+
+	/* remember emitted code for cleanup and lookups */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	context->handles = lappend(context->handles, handle);
+	MemoryContextSwitchTo(oldcontext);
+
+	ereport(DEBUG1,
+			(errmsg("time to inline: %.3fs, opt: %.3fs, emit: %.3fs",
+					INSTR_TIME_GET_DOUBLE(context->base.instr.inlining_counter),
+					INSTR_TIME_GET_DOUBLE(context->base.instr.optimization_counter),
+					INSTR_TIME_GET_DOUBLE(context->base.instr.emission_counter)),
+			 errhidestmt(true),
+			 errhidecontext(true)));
+}
+
+/*
+ * Inline, optimize and emit a module, according to the settings of context.
+ * The JIT takes ownership of the module.  Returns a handle for the emitted
+ * code, allocated in TopMemoryContext, which the caller must keep track of.
+ */
+static LLVMJitHandle *
+llvm_emit_module(LLVMJitContext *context, LLVMModuleRef module,
+				 size_t module_generation)
+{
+	LLVMJitHandle *handle;
 	instr_time	starttime;
 	instr_time	endtime;
 #if LLVM_VERSION_MAJOR > 11
@@ -607,7 +1006,7 @@ llvm_compile_module(LLVMJitContext *context)
 	if (context->base.flags & PGJIT_INLINE)
 	{
 		INSTR_TIME_SET_CURRENT(starttime);
-		llvm_inline(context->module);
+		llvm_inline(module);
 		INSTR_TIME_SET_CURRENT(endtime);
 		INSTR_TIME_ACCUM_DIFF(context->base.instr.inlining_counter,
 							  endtime, starttime);
@@ -619,15 +1018,15 @@ llvm_compile_module(LLVMJitContext *context)
 
 		filename = psprintf("%u.%zu.bc",
 							MyProcPid,
-							context->module_generation);
-		LLVMWriteBitcodeToFile(context->module, filename);
+							module_generation);
+		LLVMWriteBitcodeToFile(module, filename);
 		pfree(filename);
 	}
 
 
 	/* optimize according to the chosen optimization settings */
 	INSTR_TIME_SET_CURRENT(starttime);
-	llvm_optimize_module(context, context->module);
+	llvm_optimize_module(context, module);
 	INSTR_TIME_SET_CURRENT(endtime);
 	INSTR_TIME_ACCUM_DIFF(context->base.instr.optimization_counter,
 						  endtime, starttime);
@@ -638,8 +1037,8 @@ llvm_compile_module(LLVMJitContext *context)
 
 		filename = psprintf("%u.%zu.optimized.bc",
 							MyProcPid,
-							context->module_generation);
-		LLVMWriteBitcodeToFile(context->module, filename);
+							module_generation);
+		LLVMWriteBitcodeToFile(module, filename);
 		pfree(filename);
 	}
 
@@ -659,7 +1058,7 @@ llvm_compile_module(LLVMJitContext *context)
 		LLVMErrorRef error;
 		LLVMOrcJITDylibRef jd = LLVMOrcLLJITGetMainJITDylib(compile_orc);
 
-		ts_module = LLVMOrcCreateNewThreadSafeModule(context->module, llvm_ts_context);
+		ts_module = LLVMOrcCreateNewThreadSafeModule(module, llvm_ts_context);
 
 		handle->lljit = compile_orc;
 		handle->resource_tracker = LLVMOrcJITDylibCreateResourceTracker(jd);
@@ -670,7 +1069,6 @@ llvm_compile_module(LLVMJitContext *context)
 		 * llvm_get_function() also accounts for emission time.
 		 */
 
-		context->module = NULL; /* will be owned by LLJIT */
 		error = LLVMOrcLLJITAddLLVMIRModuleWithRT(compile_orc,
 												  handle->resource_tracker,
 												  ts_module);
@@ -686,7 +1084,7 @@ llvm_compile_module(LLVMJitContext *context)
 #elif LLVM_VERSION_MAJOR > 6
 	{
 		handle->stack = compile_orc;
-		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &handle->orc_handle, context->module,
+		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &handle->orc_handle, module,
 										llvm_resolve_symbol, NULL))
 			elog(ERROR, "failed to JIT module");
 
@@ -696,7 +1094,7 @@ llvm_compile_module(LLVMJitContext *context)
 	{
 		LLVMSharedModuleRef smod;
 
-		smod = LLVMOrcMakeSharedModule(context->module);
+		smod = LLVMOrcMakeSharedModule(module);
 		handle->stack = compile_orc;
 		if (LLVMOrcAddEagerlyCompiledIR(compile_orc, &handle->orc_handle, smod,
 										llvm_resolve_symbol, NULL))
@@ -707,10 +1105,10 @@ llvm_compile_module(LLVMJitContext *context)
 #else							/* LLVM 4.0 and 3.9 */
 	{
 		handle->stack = compile_orc;
-		handle->orc_handle = LLVMOrcAddEagerlyCompiledIR(compile_orc, context->module,
+		handle->orc_handle = LLVMOrcAddEagerlyCompiledIR(compile_orc, module,
 														 llvm_resolve_symbol, NULL);
 
-		LLVMDisposeModule(context->module);
+		LLVMDisposeModule(module);
 	}
 #endif
 
@@ -718,21 +1116,7 @@ llvm_compile_module(LLVMJitContext *context)
 	INSTR_TIME_ACCUM_DIFF(context->base.instr.emission_counter,
 						  endtime, starttime);
 
-	context->module = NULL;
-	context->compiled = true;
-
-	/* remember emitted code for cleanup and lookups */
-	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
-	context->handles = lappend(context->handles, handle);
-	MemoryContextSwitchTo(oldcontext);
-
-	ereport(DEBUG1,
-			(errmsg("time to inline: %.3fs, opt: %.3fs, emit: %.3fs",
-					INSTR_TIME_GET_DOUBLE(context->base.instr.inlining_counter),
-					INSTR_TIME_GET_DOUBLE(context->base.instr.optimization_counter),
-					INSTR_TIME_GET_DOUBLE(context->base.instr.emission_counter)),
-			 errhidestmt(true),
-			 errhidecontext(true)));
+	return handle;
 }
 
 /*
@@ -836,6 +1220,11 @@ llvm_session_initialize(void)
 
 	on_proc_exit(llvm_shutdown, 0);
 
+	CacheRegisterSyscacheCallback(PROCOID, llvm_cache_invalidate_callback,
+								  (Datum) 0);
+	CacheRegisterSyscacheCallback(TYPEOID, llvm_cache_invalidate_callback,
+								  (Datum) 0);
+
 	llvm_session_initialized = true;
 
 	MemoryContextSwitchTo(oldcontext);
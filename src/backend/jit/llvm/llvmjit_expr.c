@@ -47,10 +47,30 @@
 
 typedef struct CompiledExprState
 {
+	Datum	   *relocs;			/* relocation table, must be first */
 	LLVMJitContext *context;
 	const char *funcname;
+	ExprStateEvalFunc func;		/* function, if taken from the code cache */
 } CompiledExprState;
 
+/*
+ * Pointers to the state of the expression being compiled, and the values of
+ * Const nodes, are usually embedded in the generated code.  When the code is
+ * to go into the code cache, that would prevent it from being reused for any
+ * other expression, so they are instead loaded at runtime from a relocation
+ * table, which the code finds through the ExprState's evalfunc_private.
+ */
+typedef struct ExprRelocs
+{
+	bool		enabled;		/* use relocation table? */
+	LLVMValueRef v_relocs;		/* the table, in the function being built */
+	Datum	   *values;
+	int			nvalues;
+	int			maxvalues;
+} ExprRelocs;
+
+static ExprRelocs relocs;
+
 
 static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull);
 
@@ -63,6 +83,9 @@ static LLVMValueRef build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod,
 									   ExprEvalStep *op,
 									   int natts, LLVMValueRef v_args[]);
 static LLVMValueRef create_LifetimeEnd(LLVMModuleRef mod);
+static LLVMValueRef l_reloc_sizet(LLVMBuilderRef b, Datum value);
+static LLVMValueRef l_reloc_ptr(LLVMBuilderRef b, void *ptr,
+								LLVMTypeRef type);
 
 /* macro making it easier to call ExecEval* functions */
 #define build_EvalXFunc(b, mod, funcname, v_state, op, ...) \
@@ -121,6 +144,11 @@ llvm_compile_expr(ExprState *state)
 	LLVMValueRef v_aggvalues;
 	LLVMValueRef v_aggnulls;
 
+	/* pending module of the context, while building a private one */
+	LLVMModuleRef saved_module = NULL;
+	bool		saved_compiled = false;
+	size_t		saved_generation = 0;
+
 	instr_time	starttime;
 	instr_time	endtime;
 
@@ -143,6 +171,23 @@ llvm_compile_expr(ExprState *state)
 
 	INSTR_TIME_SET_CURRENT(starttime);
 
+	/*
+	 * Code that goes into the code cache has to be emitted on its own, so
+	 * build it in a private module rather than the context's pending one.
+	 */
+	relocs.enabled = llvm_cache_enabled();
+	if (relocs.enabled)
+	{
+		saved_module = context->module;
+		saved_compiled = context->compiled;
+		saved_generation = context->module_generation;
+		context->module = NULL;
+
+		relocs.nvalues = 0;
+		relocs.maxvalues = 64;
+		relocs.values = palloc(sizeof(Datum) * relocs.maxvalues);
+	}
+
 	mod = llvm_mutable_module(context);
 
 	b = LLVMCreateBuilder();
@@ -185,6 +230,19 @@ llvm_compile_expr(ExprState *state)
 								 FIELDNO_EXPRSTATE_PARENT,
 								 "v.state.parent");
 
+	/* the relocation table is the first member of CompiledExprState */
+	if (relocs.enabled)
+	{
+		LLVMValueRef v_private;
+
+		v_private = l_load_struct_gep(b, v_state,
+									  FIELDNO_EXPRSTATE_EVALFUNC_PRIVATE,
+									  "v.state.evalfunc_private");
+		v_private = LLVMBuildBitCast(b, v_private,
+									 l_ptr(l_ptr(TypeSizeT)), "");
+		relocs.v_relocs = LLVMBuildLoad(b, v_private, "v.relocs");
+	}
+
 	/* build global slots */
 	v_scanslot = l_load_struct_gep(b, v_econtext,
 								   FIELDNO_EXPRCONTEXT_SCANTUPLE,
@@ -253,8 +311,8 @@ llvm_compile_expr(ExprState *state)
 		op = &state->steps[opno];
 		opcode = ExecEvalStepOp(state, op);
 
-		v_resvaluep = l_ptr_const(op->resvalue, l_ptr(TypeSizeT));
-		v_resnullp = l_ptr_const(op->resnull, l_ptr(TypeStorageBool));
+		v_resvaluep = l_reloc_ptr(b, op->resvalue, l_ptr(TypeSizeT));
+		v_resnullp = l_reloc_ptr(b, op->resnull, l_ptr(TypeStorageBool));
 
 		switch (opcode)
 		{
@@ -535,7 +593,7 @@ llvm_compile_expr(ExprState *state)
 					LLVMValueRef v_constvalue,
 								v_constnull;
 
-					v_constvalue = l_sizet_const(op->d.constval.value);
+					v_constvalue = l_reloc_sizet(b, op->d.constval.value);
 					v_constnull = l_sbool_const(op->d.constval.isnull);
 
 					LLVMBuildStore(b, v_constvalue, v_resvaluep);
@@ -570,7 +628,7 @@ llvm_compile_expr(ExprState *state)
 							elog(ERROR, "argumentless strict functions are pointless");
 
 						v_fcinfo =
-							l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+							l_reloc_ptr(b, fcinfo, l_ptr(StructFunctionCallInfoData));
 
 						/*
 						 * set resnull to true, if the function is actually
@@ -672,7 +730,7 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[opno + 1],
 											   "b.%d.boolcont", opno);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
+					v_boolanynullp = l_reloc_ptr(b, op->d.boolexpr.anynull,
 												 l_ptr(TypeStorageBool));
 
 					if (opcode == EEOP_BOOL_AND_STEP_FIRST)
@@ -769,7 +827,7 @@ llvm_compile_expr(ExprState *state)
 					b_boolcont = l_bb_before_v(opblocks[opno + 1],
 											   "b.%d.boolcont", opno);
 
-					v_boolanynullp = l_ptr_const(op->d.boolexpr.anynull,
+					v_boolanynullp = l_reloc_ptr(b, op->d.boolexpr.anynull,
 												 l_ptr(TypeStorageBool));
 
 					if (opcode == EEOP_BOOL_OR_STEP_FIRST)
@@ -1101,11 +1159,11 @@ llvm_compile_expr(ExprState *state)
 												  param_types,
 												  lengthof(param_types),
 												  false);
-					v_func = l_ptr_const(op->d.cparam.paramfunc,
+					v_func = l_reloc_ptr(b, op->d.cparam.paramfunc,
 										 l_ptr(v_functype));
 
 					v_params[0] = v_state;
-					v_params[1] = l_ptr_const(op, l_ptr(TypeSizeT));
+					v_params[1] = l_reloc_ptr(b, op, l_ptr(TypeSizeT));
 					v_params[2] = v_econtext;
 					LLVMBuildCall(b,
 								  v_func,
@@ -1148,9 +1206,9 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[opno + 1],
 											   "op.%d.notavail", opno);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
+					v_casevaluep = l_reloc_ptr(b, op->d.casetest.value,
 											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
+					v_casenullp = l_reloc_ptr(b, op->d.casetest.isnull,
 											  l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
@@ -1196,7 +1254,7 @@ llvm_compile_expr(ExprState *state)
 					b_notnull = l_bb_before_v(opblocks[opno + 1],
 											  "op.%d.readonly.notnull", opno);
 
-					v_nullp = l_ptr_const(op->d.make_readonly.isnull,
+					v_nullp = l_reloc_ptr(b, op->d.make_readonly.isnull,
 										  l_ptr(TypeStorageBool));
 
 					v_null = LLVMBuildLoad(b, v_nullp, "");
@@ -1213,7 +1271,7 @@ llvm_compile_expr(ExprState *state)
 					/* if value is not null, convert to RO datum */
 					LLVMPositionBuilderAtEnd(b, b_notnull);
 
-					v_valuep = l_ptr_const(op->d.make_readonly.value,
+					v_valuep = l_reloc_ptr(b, op->d.make_readonly.value,
 										   l_ptr(TypeSizeT));
 
 					v_value = LLVMBuildLoad(b, v_valuep, "");
@@ -1264,8 +1322,8 @@ llvm_compile_expr(ExprState *state)
 
 					v_fn_out = llvm_function_reference(context, b, mod, fcinfo_out);
 					v_fn_in = llvm_function_reference(context, b, mod, fcinfo_in);
-					v_fcinfo_out = l_ptr_const(fcinfo_out, l_ptr(StructFunctionCallInfoData));
-					v_fcinfo_in = l_ptr_const(fcinfo_in, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo_out = l_reloc_ptr(b, fcinfo_out, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo_in = l_reloc_ptr(b, fcinfo_in, l_ptr(StructFunctionCallInfoData));
 
 					v_fcinfo_in_isnullp =
 						LLVMBuildStructGEP(b, v_fcinfo_in,
@@ -1387,7 +1445,7 @@ llvm_compile_expr(ExprState *state)
 					b_bothargnull = l_bb_before_v(opblocks[opno + 1], "op.%d.bothargnull", opno);
 					b_anyargnull = l_bb_before_v(opblocks[opno + 1], "op.%d.anyargnull", opno);
 
-					v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo = l_reloc_ptr(b, fcinfo, l_ptr(StructFunctionCallInfoData));
 
 					/* load args[0|1].isnull for both arguments */
 					v_argnull0 = l_funcnull(b, v_fcinfo, 0);
@@ -1482,7 +1540,7 @@ llvm_compile_expr(ExprState *state)
 					b_argsequal = l_bb_before_v(opblocks[opno + 1],
 												"b.%d.argsequal", opno);
 
-					v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+					v_fcinfo = l_reloc_ptr(b, fcinfo, l_ptr(StructFunctionCallInfoData));
 
 					/* if either argument is NULL they can't be equal */
 					v_argnull0 = l_funcnull(b, v_fcinfo, 0);
@@ -1603,7 +1661,7 @@ llvm_compile_expr(ExprState *state)
 						LLVMValueRef v_argnull1;
 						LLVMValueRef v_anyargisnull;
 
-						v_fcinfo = l_ptr_const(fcinfo,
+						v_fcinfo = l_reloc_ptr(b, fcinfo,
 											   l_ptr(StructFunctionCallInfoData));
 
 						v_argnull0 = l_funcnull(b, v_fcinfo, 0);
@@ -1778,9 +1836,9 @@ llvm_compile_expr(ExprState *state)
 					b_notavail = l_bb_before_v(opblocks[opno + 1],
 											   "op.%d.notavail", opno);
 
-					v_casevaluep = l_ptr_const(op->d.casetest.value,
+					v_casevaluep = l_reloc_ptr(b, op->d.casetest.value,
 											   l_ptr(TypeSizeT));
-					v_casenullp = l_ptr_const(op->d.casetest.isnull,
+					v_casenullp = l_reloc_ptr(b, op->d.casetest.isnull,
 											  l_ptr(TypeStorageBool));
 
 					v_casevaluenull =
@@ -1886,7 +1944,7 @@ llvm_compile_expr(ExprState *state)
 					 * up in ExecInitWindowAgg() after initializing the
 					 * expression). So load it from memory each time round.
 					 */
-					v_wfuncnop = l_ptr_const(&wfunc->wfuncno,
+					v_wfuncnop = l_reloc_ptr(b, &wfunc->wfuncno,
 											 l_ptr(LLVMInt32Type()));
 					v_wfuncno = LLVMBuildLoad(b, v_wfuncnop, "v_wfuncno");
 
@@ -1929,7 +1987,7 @@ llvm_compile_expr(ExprState *state)
 						b_deserialize = l_bb_before_v(opblocks[opno + 1],
 													  "op.%d.deserialize", opno);
 
-						v_fcinfo = l_ptr_const(fcinfo,
+						v_fcinfo = l_reloc_ptr(b, fcinfo,
 											   l_ptr(StructFunctionCallInfoData));
 						v_argnull0 = l_funcnull(b, v_fcinfo, 0);
 
@@ -1948,7 +2006,7 @@ llvm_compile_expr(ExprState *state)
 					fcinfo = op->d.agg_deserialize.fcinfo_data;
 
 					v_tmpcontext =
-						l_ptr_const(aggstate->tmpcontext->ecxt_per_tuple_memory,
+						l_reloc_ptr(b, aggstate->tmpcontext->ecxt_per_tuple_memory,
 									l_ptr(StructMemoryContextData));
 					v_oldcontext = l_mcxt_switch(mod, b, v_tmpcontext);
 					v_retval = BuildV1Call(context, b, mod, fcinfo,
@@ -1977,8 +2035,8 @@ llvm_compile_expr(ExprState *state)
 					Assert(nargs > 0);
 
 					jumpnull = op->d.agg_strict_input_check.jumpnull;
-					v_argsp = l_ptr_const(args, l_ptr(StructNullableDatum));
-					v_nullsp = l_ptr_const(nulls, l_ptr(TypeStorageBool));
+					v_argsp = l_reloc_ptr(b, args, l_ptr(StructNullableDatum));
+					v_nullsp = l_reloc_ptr(b, nulls, l_ptr(TypeStorageBool));
 
 					/* create blocks for checking args */
 					b_checknulls = palloc(sizeof(LLVMBasicBlockRef *) * nargs);
@@ -2109,7 +2167,7 @@ llvm_compile_expr(ExprState *state)
 
 					v_aggstatep =
 						LLVMBuildBitCast(b, v_parent, l_ptr(StructAggState), "");
-					v_pertransp = l_ptr_const(pertrans,
+					v_pertransp = l_reloc_ptr(b, pertrans,
 											  l_ptr(StructAggStatePerTransData));
 
 					/*
@@ -2158,7 +2216,7 @@ llvm_compile_expr(ExprState *state)
 
 							LLVMPositionBuilderAtEnd(b, b_init);
 
-							v_aggcontext = l_ptr_const(op->d.agg_trans.aggcontext,
+							v_aggcontext = l_reloc_ptr(b, op->d.agg_trans.aggcontext,
 													   l_ptr(StructExprContext));
 
 							params[0] = v_aggstatep;
@@ -2203,9 +2261,9 @@ llvm_compile_expr(ExprState *state)
 					}
 
 
-					v_fcinfo = l_ptr_const(fcinfo,
+					v_fcinfo = l_reloc_ptr(b, fcinfo,
 										   l_ptr(StructFunctionCallInfoData));
-					v_aggcontext = l_ptr_const(op->d.agg_trans.aggcontext,
+					v_aggcontext = l_reloc_ptr(b, op->d.agg_trans.aggcontext,
 											   l_ptr(StructExprContext));
 
 					v_current_setp =
@@ -2232,7 +2290,7 @@ llvm_compile_expr(ExprState *state)
 
 					/* invoke transition function in per-tuple context */
 					v_tmpcontext =
-						l_ptr_const(aggstate->tmpcontext->ecxt_per_tuple_memory,
+						l_reloc_ptr(b, aggstate->tmpcontext->ecxt_per_tuple_memory,
 									l_ptr(StructMemoryContextData));
 					v_oldcontext = l_mcxt_switch(mod, b, v_tmpcontext);
 
@@ -2368,6 +2426,28 @@ llvm_compile_expr(ExprState *state)
 		cstate->context = context;
 		cstate->funcname = funcname;
 
+		/*
+		 * Code for the cache is emitted right away, in the hope of finding
+		 * it there already.
+		 */
+		if (relocs.enabled)
+		{
+			LLVMModuleRef cache_mod = context->module;
+			size_t		cache_generation = context->module_generation;
+
+			context->module = saved_module;
+			context->compiled = saved_compiled;
+			context->module_generation = saved_generation;
+
+			cstate->relocs = relocs.values;
+			cstate->func = (ExprStateEvalFunc)
+				llvm_cache_function(context, cache_mod, cache_generation,
+									funcname);
+
+			relocs.enabled = false;
+			relocs.values = NULL;
+		}
+
 		state->evalfunc = ExecRunCompiledExpr;
 		state->evalfunc_private = cstate;
 	}
@@ -2397,10 +2477,15 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 
 	CheckExprStillValid(state, econtext);
 
-	llvm_enter_fatal_on_oom();
-	func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
-												 cstate->funcname);
-	llvm_leave_fatal_on_oom();
+	if (cstate->func)
+		func = cstate->func;
+	else
+	{
+		llvm_enter_fatal_on_oom();
+		func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
+													 cstate->funcname);
+		llvm_leave_fatal_on_oom();
+	}
 	Assert(func);
 
 	/* remove indirection via this function for future calls */
@@ -2421,7 +2506,7 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 
 	v_fn = llvm_function_reference(context, b, mod, fcinfo);
 
-	v_fcinfo = l_ptr_const(fcinfo, l_ptr(StructFunctionCallInfoData));
+	v_fcinfo = l_reloc_ptr(b, fcinfo, l_ptr(StructFunctionCallInfoData));
 	v_fcinfo_isnullp = LLVMBuildStructGEP(b, v_fcinfo,
 										  FIELDNO_FUNCTIONCALLINFODATA_ISNULL,
 										  "v_fcinfo_isnull");
@@ -2441,11 +2526,11 @@ BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 		LLVMValueRef params[2];
 
 		params[0] = l_int64_const(sizeof(NullableDatum) * fcinfo->nargs);
-		params[1] = l_ptr_const(fcinfo->args, l_ptr(LLVMInt8Type()));
+		params[1] = l_reloc_ptr(b, fcinfo->args, l_ptr(LLVMInt8Type()));
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 
 		params[0] = l_int64_const(sizeof(fcinfo->isnull));
-		params[1] = l_ptr_const(&fcinfo->isnull, l_ptr(LLVMInt8Type()));
+		params[1] = l_reloc_ptr(b, &fcinfo->isnull, l_ptr(LLVMInt8Type()));
 		LLVMBuildCall(b, v_lifetime, params, lengthof(params), "");
 	}
 
@@ -2473,7 +2558,7 @@ build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
 	params = palloc(sizeof(LLVMValueRef) * (2 + nargs));
 
 	params[argno++] = v_state;
-	params[argno++] = l_ptr_const(op, l_ptr(StructExprEvalStep));
+	params[argno++] = l_reloc_ptr(b, op, l_ptr(StructExprEvalStep));
 
 	for (int i = 0; i < nargs; i++)
 		params[argno++] = v_args[i];
@@ -2485,6 +2570,53 @@ build_EvalXFuncInt(LLVMBuilderRef b, LLVMModuleRef mod, const char *funcname,
 	return v_ret;
 }
 
+/*
+ * Emit a Datum that depends on the expression being compiled, see
+ * ExprRelocs.
+ */
+static LLVMValueRef
+l_reloc_sizet(LLVMBuilderRef b, Datum value)
+{
+	LLVMValueRef v_offset;
+	LLVMValueRef v_value;
+
+	if (!relocs.enabled)
+		return l_sizet_const(value);
+
+	if (relocs.nvalues >= relocs.maxvalues)
+	{
+		relocs.maxvalues *= 2;
+		relocs.values = repalloc(relocs.values,
+								 sizeof(Datum) * relocs.maxvalues);
+	}
+
+	v_offset = l_int32_const(relocs.nvalues);
+	relocs.values[relocs.nvalues++] = value;
+
+	v_value = LLVMBuildLoad(b,
+							LLVMBuildGEP(b, relocs.v_relocs, &v_offset, 1, ""),
+							"");
+
+	/* the table doesn't change, which allows LLVM to hoist the load */
+	LLVMSetMetadata(v_value, LLVMGetMDKindID("invariant.load", 14),
+					LLVMMDNode(NULL, 0));
+
+	return v_value;
+}
+
+/*
+ * Emit a pointer to state of the expression being compiled, see ExprRelocs.
+ */
+static LLVMValueRef
+l_reloc_ptr(LLVMBuilderRef b, void *ptr, LLVMTypeRef type)
+{
+	if (!relocs.enabled)
+		return l_ptr_const(ptr, type);
+
+	return LLVMBuildIntToPtr(b, l_reloc_sizet(b, PointerGetDatum(ptr)),
+							 type, "");
+}
+
 static LLVMValueRef
 create_LifetimeEnd(LLVMModuleRef mod)
 {
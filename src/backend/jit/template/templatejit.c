@@ -0,0 +1,87 @@
+/*-------------------------------------------------------------------------
+ *
+ * templatejit.c
+ *	  Core part of the template JIT provider.
+ *
+ * The template provider doesn't generate code.  Instead it "compiles" an
+ * expression by choosing, among routines precompiled for common kinds of
+ * expressions and tuple layouts, the one that fits, and filling in its
+ * parameters (column numbers, constants, offsets).  Compilation therefore
+ * takes microseconds rather than the milliseconds LLVM needs, which makes it
+ * worthwhile for much cheaper queries.  Expressions that don't fit any of the
+ * templates are left to the interpreter.
+ *
+ * Copyright (c) 2016-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/template/templatejit.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "jit/templatejit.h"
+#include "utils/memutils.h"
+#include "utils/resowner_private.h"
+
+PG_MODULE_MAGIC;
+
+
+static void template_reset_after_error(void);
+static void template_release_context(JitContext *context);
+
+
+/*
+ * Initialize template JIT provider.
+ */
+void
+_PG_jit_provider_init(JitProviderCallbacks *cb)
+{
+	cb->reset_after_error = template_reset_after_error;
+	cb->release_context = template_release_context;
+	cb->compile_expr = template_compile_expr;
+}
+
+/*
+ * Create a context for JITing work.
+ *
+ * Everything a compiled expression needs is allocated in the memory context
+ * of the expression, so the context only serves to collect instrumentation.
+ */
+TemplateJitContext *
+template_create_context(int jitFlags)
+{
+	TemplateJitContext *context;
+
+	ResourceOwnerEnlargeJIT(CurrentResourceOwner);
+
+	context = MemoryContextAllocZero(TopMemoryContext,
+									 sizeof(TemplateJitContext));
+	context->base.flags = jitFlags;
+
+	/* ensure cleanup */
+	context->base.resowner = CurrentResourceOwner;
+	ResourceOwnerRememberJIT(CurrentResourceOwner, PointerGetDatum(context));
+
+	return context;
+}
+
+/*
+ * Release resources required by one template JIT context.
+ */
+static void
+template_release_context(JitContext *context)
+{
+	/* nothing to do, the context itself is freed by jit_release_context() */
+}
+
+/*
+ * Reset error handling state after an error.  Compiling can't leave any
+ * state behind, so there's nothing to do.
+ */
+static void
+template_reset_after_error(void)
+{
+}
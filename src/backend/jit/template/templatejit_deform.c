@@ -0,0 +1,264 @@
+/*-------------------------------------------------------------------------
+ *
+ * templatejit_deform.c
+ *	  Tuple deforming specialized for a tuple descriptor.
+ *
+ * Like LLVM's deforming code, this relies on knowing the tuple descriptor
+ * and the type of the slot at compile time: the offsets of the columns up
+ * to the first one that can be NULL or has variable width are the same in
+ * every tuple, even when a later column is NULL, and the NULL bitmap needn't
+ * be consulted for NOT NULL columns.  The decisions that
+ * slot_deform_heap_tuple() makes for every column of every tuple, such as
+ * how to align and fetch it, are made once at compile time.
+ *
+ * Copyright (c) 2016-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/template/templatejit_deform.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/tupdesc_details.h"
+#include "jit/templatejit.h"
+
+
+/*
+ * Create the deforming program for the first natts columns of tuples with
+ * descriptor desc, stored in slots of type ops.
+ *
+ * Returns NULL if the slot type isn't supported.
+ */
+TemplateDeform *
+template_compile_deform(TupleDesc desc, const TupleTableSlotOps *ops,
+						int natts)
+{
+	TemplateDeform *deform;
+	int			guaranteed_column_number = -1;
+	int32		off = 0;
+	bool		known_off = true;
+
+	/* virtual slots are deformed already, other types are unknown */
+	if (ops != &TTSOpsHeapTuple && ops != &TTSOpsBufferHeapTuple &&
+		ops != &TTSOpsMinimalTuple)
+		return NULL;
+
+	Assert(natts > 0 && natts <= desc->natts);
+
+	/*
+	 * Find the last column that every tuple is guaranteed to have a non-NULL
+	 * value for.  Columns added later with a default may be missing from
+	 * older tuples.
+	 */
+	for (int attnum = 0; attnum < desc->natts; attnum++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, attnum);
+
+		if (att->attnotnull && !att->atthasmissing && !att->attisdropped)
+			guaranteed_column_number = attnum;
+	}
+
+	deform = palloc(offsetof(TemplateDeform, cols) +
+					sizeof(TemplateDeformColumn) * natts);
+	deform->ops = ops;
+	deform->natts = natts;
+
+	for (int attnum = 0; attnum < natts; attnum++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, attnum);
+		TemplateDeformColumn *col = &deform->cols[attnum];
+
+		col->attlen = att->attlen;
+		col->notnull = attnum <= guaranteed_column_number &&
+			att->attnotnull && !att->attisdropped;
+
+		switch (att->attalign)
+		{
+			case TYPALIGN_CHAR:
+				col->alignby = 1;
+				break;
+			case TYPALIGN_SHORT:
+				col->alignby = ALIGNOF_SHORT;
+				break;
+			case TYPALIGN_INT:
+				col->alignby = ALIGNOF_INT;
+				break;
+			case TYPALIGN_DOUBLE:
+				col->alignby = ALIGNOF_DOUBLE;
+				break;
+			default:
+				elog(ERROR, "unknown alignment %c", att->attalign);
+		}
+
+		if (att->attbyval)
+		{
+			switch (att->attlen)
+			{
+				case sizeof(char):
+					col->kind = TEMPLATE_FETCH_CHAR;
+					break;
+				case sizeof(int16):
+					col->kind = TEMPLATE_FETCH_INT16;
+					break;
+				case sizeof(int32):
+					col->kind = TEMPLATE_FETCH_INT32;
+					break;
+#if SIZEOF_DATUM == 8
+				case sizeof(Datum):
+					col->kind = TEMPLATE_FETCH_INT64;
+					break;
+#endif
+				default:
+					elog(ERROR, "unsupported byval length: %d",
+						 (int) att->attlen);
+			}
+		}
+		else if (att->attlen > 0)
+			col->kind = TEMPLATE_FETCH_FIXED;
+		else if (att->attlen == -1)
+			col->kind = TEMPLATE_FETCH_VARLENA;
+		else
+			col->kind = TEMPLATE_FETCH_CSTRING;
+
+		/*
+		 * The offset is known as long as all preceding columns have a fixed
+		 * width and can't be NULL.
+		 */
+		if (known_off && att->attlen > 0)
+		{
+			off = TYPEALIGN(col->alignby, off);
+			col->fixedoff = off;
+			off += att->attlen;
+		}
+		else
+			col->fixedoff = -1;
+
+		if (att->attlen <= 0 || !col->notnull)
+			known_off = false;
+	}
+
+	return deform;
+}
+
+/*
+ * Deform the columns of the tuple in slot that the program covers.
+ */
+void
+template_deform(TemplateDeform *deform, TupleTableSlot *slot)
+{
+	Datum	   *values = slot->tts_values;
+	bool	   *isnull = slot->tts_isnull;
+	HeapTuple	tuple;
+	HeapTupleHeader tup;
+	uint32	   *offp;
+	bool		hasnulls;
+	bits8	   *bp;
+	char	   *tp;
+	uint32		off;
+	int			natts;
+	int			attnum;
+
+	Assert(slot->tts_ops == deform->ops);
+	Assert(!TTS_EMPTY(slot));
+
+	if (deform->ops == &TTSOpsMinimalTuple)
+	{
+		MinimalTupleTableSlot *mslot = (MinimalTupleTableSlot *) slot;
+
+		tuple = mslot->tuple;
+		offp = &mslot->off;
+	}
+	else
+	{
+		/* TTSOpsHeapTuple or TTSOpsBufferHeapTuple */
+		HeapTupleTableSlot *hslot = (HeapTupleTableSlot *) slot;
+
+		tuple = hslot->tuple;
+		offp = &hslot->off;
+	}
+
+	tup = tuple->t_data;
+	hasnulls = HeapTupleHasNulls(tuple);
+	bp = tup->t_bits;
+	tp = (char *) tup + tup->t_hoff;
+
+	/* we can only fetch as many attributes as the tuple has */
+	natts = Min(HeapTupleHeaderGetNatts(tup), deform->natts);
+
+	/* continue where a previous call, possibly not ours, stopped */
+	attnum = slot->tts_nvalid;
+	off = attnum == 0 ? 0 : *offp;
+
+	for (; attnum < natts; attnum++)
+	{
+		TemplateDeformColumn *col = &deform->cols[attnum];
+		char	   *attptr;
+
+		if (!col->notnull && hasnulls && att_isnull(attnum, bp))
+		{
+			values[attnum] = (Datum) 0;
+			isnull[attnum] = true;
+			continue;
+		}
+
+		isnull[attnum] = false;
+
+		if (col->fixedoff >= 0)
+			off = col->fixedoff;
+		else if (col->kind != TEMPLATE_FETCH_VARLENA ||
+				 !VARATT_NOT_PAD_BYTE(tp + off))
+			off = TYPEALIGN(col->alignby, off);
+
+		attptr = tp + off;
+
+		switch ((TemplateFetchKind) col->kind)
+		{
+			case TEMPLATE_FETCH_CHAR:
+				values[attnum] = CharGetDatum(*attptr);
+				off += 1;
+				break;
+			case TEMPLATE_FETCH_INT16:
+				values[attnum] = Int16GetDatum(*(int16 *) attptr);
+				off += 2;
+				break;
+			case TEMPLATE_FETCH_INT32:
+				values[attnum] = Int32GetDatum(*(int32 *) attptr);
+				off += 4;
+				break;
+			case TEMPLATE_FETCH_INT64:
+				values[attnum] = *(Datum *) attptr;
+				off += sizeof(Datum);
+				break;
+			case TEMPLATE_FETCH_FIXED:
+				values[attnum] = PointerGetDatum(attptr);
+				off += col->attlen;
+				break;
+			case TEMPLATE_FETCH_VARLENA:
+				values[attnum] = PointerGetDatum(attptr);
+				off += VARSIZE_ANY(attptr);
+				break;
+			case TEMPLATE_FETCH_CSTRING:
+				values[attnum] = PointerGetDatum(attptr);
+				off += strlen(attptr) + 1;
+				break;
+		}
+	}
+
+	/*
+	 * Save the state for slot_deform_heap_tuple().  As we didn't maintain
+	 * attcacheoff, it mustn't rely on that.
+	 */
+	slot->tts_nvalid = attnum;
+	*offp = off;
+	slot->tts_flags |= TTS_FLAG_SLOW;
+
+	/* the columns the tuple doesn't have take their default */
+	if (unlikely(attnum < deform->natts))
+	{
+		slot_getmissingattrs(slot, attnum, deform->natts);
+		slot->tts_nvalid = deform->natts;
+	}
+}
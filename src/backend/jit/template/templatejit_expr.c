@@ -0,0 +1,515 @@
+/*-------------------------------------------------------------------------
+ *
+ * templatejit_expr.c
+ *	  JIT compile expressions by instantiating templates.
+ *
+ * Two kinds of templates are currently available:
+ *
+ * - Quals consisting of "Var op Const" clauses, where op is one of the
+ *   comparison functions of a common fixed-width type.  There's a routine
+ *   for every such function that evaluates a single clause with the
+ *   comparison inlined, and one evaluating any number of clauses, calling a
+ *   precompiled comparison routine for each.
+ *
+ * - For all other expressions, if they fetch columns from a slot whose tuple
+ *   descriptor and type are known, the columns are deformed by a routine
+ *   specialized for the descriptor (see templatejit_deform.c) before the
+ *   expression is handed to the interpreter.  The interpreter's own
+ *   FETCHSOME steps then find the columns deformed already.
+ *
+ * Copyright (c) 2016-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/template/templatejit_expr.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execExpr.h"
+#include "jit/templatejit.h"
+#include "portability/instr_time.h"
+#include "utils/date.h"
+#include "utils/fmgroids.h"
+#include "utils/float.h"
+#include "utils/timestamp.h"
+
+
+/* slot a FETCHSOME or VAR step refers to */
+#define TEMPLATE_INNER_SLOT		0
+#define TEMPLATE_OUTER_SLOT		1
+#define TEMPLATE_SCAN_SLOT		2
+
+typedef bool (*TemplateCmpFunc) (Datum a, Datum b);
+
+/* columns to deform in one slot before evaluating the expression */
+typedef struct TemplateFetch
+{
+	int			slotno;			/* TEMPLATE_*_SLOT */
+	int			last_var;		/* number of columns to deform */
+	TemplateDeform *deform;		/* specialized deforming, or NULL */
+} TemplateFetch;
+
+/* a "Var op Const" clause of a qual */
+typedef struct TemplateQualClause
+{
+	int			slotno;			/* TEMPLATE_*_SLOT of the Var */
+	int			attnum;			/* column of the Var, zero based */
+	Datum		constval;		/* value of the Const */
+	TemplateCmpFunc cmp;		/* comparison, with the Var on the left */
+} TemplateQualClause;
+
+/* private state of a compiled expression */
+typedef struct TemplateExprState
+{
+	ExprStateEvalFunc func;		/* template to run after the first call */
+	ExprStateEvalFunc interp;	/* interpreter, for template_eval_interp */
+	int			nfetches;
+	TemplateFetch fetches[3];
+	int			nclauses;
+	TemplateQualClause *clauses;
+} TemplateExprState;
+
+static Datum template_eval_first(ExprState *state, ExprContext *econtext,
+								 bool *isnull);
+static Datum template_eval_interp(ExprState *state, ExprContext *econtext,
+								  bool *isnull);
+static Datum template_eval_qual(ExprState *state, ExprContext *econtext,
+								bool *isnull);
+static bool template_match_qual(ExprState *state, int opno,
+								TemplateExprState *tstate,
+								ExprStateEvalFunc *func);
+static bool template_find_cmp(Oid funcid, bool commute, TemplateCmpFunc *cmp,
+							  ExprStateEvalFunc *qual);
+
+
+/*
+ * Deform the columns the expression needs.
+ */
+static pg_attribute_always_inline void
+template_fetch(TemplateExprState *tstate, ExprContext *econtext)
+{
+	for (int i = 0; i < tstate->nfetches; i++)
+	{
+		TemplateFetch *fetch = &tstate->fetches[i];
+		TupleTableSlot *slot;
+
+		if (fetch->slotno == TEMPLATE_INNER_SLOT)
+			slot = econtext->ecxt_innertuple;
+		else if (fetch->slotno == TEMPLATE_OUTER_SLOT)
+			slot = econtext->ecxt_outertuple;
+		else
+			slot = econtext->ecxt_scantuple;
+
+		if (slot->tts_nvalid < fetch->last_var)
+		{
+			if (fetch->deform)
+				template_deform(fetch->deform, slot);
+			else
+				slot_getsomeattrs_int(slot, fetch->last_var);
+		}
+	}
+}
+
+static pg_attribute_always_inline TupleTableSlot *
+template_slot(ExprContext *econtext, int slotno)
+{
+	if (slotno == TEMPLATE_SCAN_SLOT)
+		return econtext->ecxt_scantuple;
+	else if (slotno == TEMPLATE_OUTER_SLOT)
+		return econtext->ecxt_outertuple;
+	else
+		return econtext->ecxt_innertuple;
+}
+
+/*
+ * Comparison templates.  For every comparison function of the supported
+ * types, TEMPLATE_CMP defines a routine comparing two Datums, for use in
+ * quals of several clauses, and an evaluation routine for a qual of just
+ * one clause.
+ */
+#define TEMPLATE_EQ(a, b) ((a) == (b))
+#define TEMPLATE_NE(a, b) ((a) != (b))
+#define TEMPLATE_LT(a, b) ((a) < (b))
+#define TEMPLATE_LE(a, b) ((a) <= (b))
+#define TEMPLATE_GT(a, b) ((a) > (b))
+#define TEMPLATE_GE(a, b) ((a) >= (b))
+
+#define TEMPLATE_CMP(name, getval, cmp) \
+static bool \
+name##_cmp(Datum a, Datum b) \
+{ \
+	return cmp(getval(a), getval(b)); \
+} \
+\
+static Datum \
+name##_qual(ExprState *state, ExprContext *econtext, bool *isnull) \
+{ \
+	TemplateExprState *tstate = (TemplateExprState *) state->evalfunc_private; \
+	TemplateQualClause *clause = &tstate->clauses[0]; \
+	TupleTableSlot *slot; \
+	\
+	template_fetch(tstate, econtext); \
+	slot = template_slot(econtext, clause->slotno); \
+	\
+	*isnull = false; \
+	if (slot->tts_isnull[clause->attnum]) \
+		return BoolGetDatum(false); \
+	return BoolGetDatum(cmp(getval(slot->tts_values[clause->attnum]), \
+							getval(clause->constval))); \
+}
+
+#define TEMPLATE_CMP_TYPE(type, getval, cmpeq, cmpne, cmplt, cmple, cmpgt, cmpge) \
+	TEMPLATE_CMP(type##_eq, getval, cmpeq) \
+	TEMPLATE_CMP(type##_ne, getval, cmpne) \
+	TEMPLATE_CMP(type##_lt, getval, cmplt) \
+	TEMPLATE_CMP(type##_le, getval, cmple) \
+	TEMPLATE_CMP(type##_gt, getval, cmpgt) \
+	TEMPLATE_CMP(type##_ge, getval, cmpge)
+
+#define TEMPLATE_CMP_INTEGER(type, getval) \
+	TEMPLATE_CMP_TYPE(type, getval, TEMPLATE_EQ, TEMPLATE_NE, TEMPLATE_LT, \
+					  TEMPLATE_LE, TEMPLATE_GT, TEMPLATE_GE)
+
+TEMPLATE_CMP_INTEGER(int2, DatumGetInt16)
+TEMPLATE_CMP_INTEGER(int4, DatumGetInt32)
+TEMPLATE_CMP_INTEGER(int8, DatumGetInt64)
+TEMPLATE_CMP_INTEGER(oid, DatumGetObjectId)
+TEMPLATE_CMP_INTEGER(date, DatumGetDateADT)
+TEMPLATE_CMP_INTEGER(timestamp, DatumGetTimestamp)
+TEMPLATE_CMP_INTEGER(timestamptz, DatumGetTimestampTz)
+
+/* use the float8 comparison semantics, in which NaN is largest */
+TEMPLATE_CMP_TYPE(float8, DatumGetFloat8, float8_eq, float8_ne, float8_lt,
+				  float8_le, float8_gt, float8_ge)
+
+/* the comparisons of one type, in this order */
+#define TEMPLATE_OP_EQ	0
+#define TEMPLATE_OP_NE	1
+#define TEMPLATE_OP_LT	2
+#define TEMPLATE_OP_LE	3
+#define TEMPLATE_OP_GT	4
+#define TEMPLATE_OP_GE	5
+#define TEMPLATE_NUM_OPS 6
+
+typedef struct TemplateCmpType
+{
+	Oid			funcids[TEMPLATE_NUM_OPS];
+	TemplateCmpFunc cmps[TEMPLATE_NUM_OPS];
+	ExprStateEvalFunc quals[TEMPLATE_NUM_OPS];
+} TemplateCmpType;
+
+#define TEMPLATE_CMP_ENTRY(type, FUNC) \
+	{ \
+		{F_##FUNC##EQ, F_##FUNC##NE, F_##FUNC##LT, \
+		 F_##FUNC##LE, F_##FUNC##GT, F_##FUNC##GE}, \
+		{type##_eq_cmp, type##_ne_cmp, type##_lt_cmp, \
+		 type##_le_cmp, type##_gt_cmp, type##_ge_cmp}, \
+		{type##_eq_qual, type##_ne_qual, type##_lt_qual, \
+		 type##_le_qual, type##_gt_qual, type##_ge_qual} \
+	}
+
+static const TemplateCmpType template_cmp_types[] =
+{
+	TEMPLATE_CMP_ENTRY(int2, INT2),
+	TEMPLATE_CMP_ENTRY(int4, INT4),
+	TEMPLATE_CMP_ENTRY(int8, INT8),
+	TEMPLATE_CMP_ENTRY(oid, OID),
+	TEMPLATE_CMP_ENTRY(date, DATE_),
+	TEMPLATE_CMP_ENTRY(timestamp, TIMESTAMP_),
+	TEMPLATE_CMP_ENTRY(timestamptz, TIMESTAMPTZ_),
+	TEMPLATE_CMP_ENTRY(float8, FLOAT8)
+};
+
+/* comparison with the arguments swapped */
+static const int template_commute_op[TEMPLATE_NUM_OPS] =
+{
+	TEMPLATE_OP_EQ, TEMPLATE_OP_NE, TEMPLATE_OP_GT,
+	TEMPLATE_OP_GE, TEMPLATE_OP_LT, TEMPLATE_OP_LE
+};
+
+
+/*
+ * JIT compile expression.
+ */
+bool
+template_compile_expr(ExprState *state)
+{
+	PlanState  *parent = state->parent;
+	TemplateJitContext *context;
+	TemplateExprState *tstate;
+	ExprStateEvalFunc func = NULL;
+	bool		deform = false;
+	int			opno;
+	instr_time	starttime;
+	instr_time	endtime;
+
+	/* see jit_compile_expr() */
+	Assert(parent);
+
+	/* get or create JIT context */
+	if (parent->state->es_jit)
+		context = (TemplateJitContext *) parent->state->es_jit;
+	else
+	{
+		context = template_create_context(parent->state->es_jit_flags);
+		parent->state->es_jit = &context->base;
+	}
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	tstate = palloc0(sizeof(TemplateExprState));
+
+	/* the FETCHSOME steps, if any, come first */
+	for (opno = 0; opno < state->steps_len; opno++)
+	{
+		ExprEvalStep *op = &state->steps[opno];
+		ExprEvalOp	opcode = ExecEvalStepOp(state, op);
+		TemplateFetch *fetch;
+
+		if (opcode != EEOP_INNER_FETCHSOME &&
+			opcode != EEOP_OUTER_FETCHSOME &&
+			opcode != EEOP_SCAN_FETCHSOME)
+			break;
+		if (tstate->nfetches >= lengthof(tstate->fetches))
+			break;
+
+		fetch = &tstate->fetches[tstate->nfetches++];
+		if (opcode == EEOP_INNER_FETCHSOME)
+			fetch->slotno = TEMPLATE_INNER_SLOT;
+		else if (opcode == EEOP_OUTER_FETCHSOME)
+			fetch->slotno = TEMPLATE_OUTER_SLOT;
+		else
+			fetch->slotno = TEMPLATE_SCAN_SLOT;
+		fetch->last_var = op->d.fetch.last_var;
+
+		if ((context->base.flags & PGJIT_DEFORM) &&
+			op->d.fetch.fixed && op->d.fetch.known_desc &&
+			op->d.fetch.last_var <= op->d.fetch.known_desc->natts)
+		{
+			fetch->deform = template_compile_deform(op->d.fetch.known_desc,
+													op->d.fetch.kind,
+													op->d.fetch.last_var);
+			if (fetch->deform)
+				deform = true;
+		}
+	}
+
+	if ((state->flags & EEO_FLAG_IS_QUAL) &&
+		template_match_qual(state, opno, tstate, &func))
+	{
+		/* evaluated entirely by the template */
+	}
+	else if (deform)
+	{
+		/* deform, then let the interpreter do the rest */
+		ExecReadyInterpretedExpr(state);
+		tstate->interp = (ExprStateEvalFunc) state->evalfunc_private;
+		func = template_eval_interp;
+	}
+	else
+	{
+		/* nothing to gain */
+		pfree(tstate);
+		return false;
+	}
+
+	tstate->func = func;
+	state->evalfunc = template_eval_first;
+	state->evalfunc_private = tstate;
+
+	context->base.instr.created_functions++;
+
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(context->base.instr.generation_counter,
+						  endtime, starttime);
+
+	return true;
+}
+
+/*
+ * Check whether the steps of a qual, starting at opno, are all "Var op
+ * Const" clauses that a template can evaluate, and if so fill in the
+ * clauses and the template to use.
+ */
+static bool
+template_match_qual(ExprState *state, int opno, TemplateExprState *tstate,
+					ExprStateEvalFunc *func)
+{
+	int			maxclauses = (state->steps_len - opno) / 4;
+	ExprStateEvalFunc qualfunc = NULL;
+
+	if (maxclauses == 0)
+		return false;
+
+	tstate->clauses = palloc(sizeof(TemplateQualClause) * maxclauses);
+	tstate->nclauses = 0;
+
+	/* each clause is a VAR and a CONST step, a function call and a QUAL */
+	while (opno + 4 < state->steps_len)
+	{
+		ExprEvalStep *argops[2];
+		ExprEvalStep *funcop = &state->steps[opno + 2];
+		ExprEvalStep *qualop = &state->steps[opno + 3];
+		FunctionCallInfo fcinfo;
+		TemplateQualClause *clause;
+		ExprEvalStep *varop = NULL;
+		ExprEvalStep *constop = NULL;
+		int			constarg = -1;
+
+		argops[0] = &state->steps[opno];
+		argops[1] = &state->steps[opno + 1];
+
+		if (ExecEvalStepOp(state, funcop) != EEOP_FUNCEXPR_STRICT ||
+			ExecEvalStepOp(state, qualop) != EEOP_QUAL ||
+			funcop->d.func.nargs != 2)
+			return false;
+
+		fcinfo = funcop->d.func.fcinfo_data;
+
+		/* find out which argument is the Var, and which the Const */
+		for (int i = 0; i < 2; i++)
+		{
+			ExprEvalStep *argop = argops[i];
+			ExprEvalOp	argopcode = ExecEvalStepOp(state, argop);
+			int			argno;
+
+			if (argop->resvalue == &fcinfo->args[0].value &&
+				argop->resnull == &fcinfo->args[0].isnull)
+				argno = 0;
+			else if (argop->resvalue == &fcinfo->args[1].value &&
+					 argop->resnull == &fcinfo->args[1].isnull)
+				argno = 1;
+			else
+				return false;
+
+			if (argopcode == EEOP_INNER_VAR || argopcode == EEOP_OUTER_VAR ||
+				argopcode == EEOP_SCAN_VAR)
+				varop = argop;
+			else if (argopcode == EEOP_CONST && !argop->d.constval.isnull)
+			{
+				constop = argop;
+				constarg = argno;
+			}
+			else
+				return false;
+		}
+		if (varop == NULL || constop == NULL)
+			return false;
+
+		clause = &tstate->clauses[tstate->nclauses++];
+		switch (ExecEvalStepOp(state, varop))
+		{
+			case EEOP_INNER_VAR:
+				clause->slotno = TEMPLATE_INNER_SLOT;
+				break;
+			case EEOP_OUTER_VAR:
+				clause->slotno = TEMPLATE_OUTER_SLOT;
+				break;
+			default:
+				clause->slotno = TEMPLATE_SCAN_SLOT;
+				break;
+		}
+		clause->attnum = varop->d.var.attnum;
+		clause->constval = constop->d.constval.value;
+
+		/* the templates expect the Var on the left */
+		if (!template_find_cmp(funcop->d.func.finfo->fn_oid, constarg == 0,
+							   &clause->cmp, &qualfunc))
+			return false;
+
+		opno += 4;
+	}
+
+	/* that must have been all */
+	if (tstate->nclauses == 0 || opno != state->steps_len - 1 ||
+		ExecEvalStepOp(state, &state->steps[opno]) != EEOP_DONE)
+		return false;
+
+	*func = tstate->nclauses == 1 ? qualfunc : template_eval_qual;
+	return true;
+}
+
+/*
+ * Look for the templates implementing comparison function funcid, or if
+ * commute is true, funcid with the arguments swapped.
+ */
+static bool
+template_find_cmp(Oid funcid, bool commute, TemplateCmpFunc *cmp,
+				  ExprStateEvalFunc *qual)
+{
+	for (int t = 0; t < lengthof(template_cmp_types); t++)
+	{
+		const TemplateCmpType *cmptype = &template_cmp_types[t];
+
+		for (int op = 0; op < TEMPLATE_NUM_OPS; op++)
+		{
+			if (cmptype->funcids[op] == funcid)
+			{
+				if (commute)
+					op = template_commute_op[op];
+				*cmp = cmptype->cmps[op];
+				*qual = cmptype->quals[op];
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * First evaluation of a compiled expression.  Check that the expression is
+ * still valid, then switch to its template.
+ */
+static Datum
+template_eval_first(ExprState *state, ExprContext *econtext, bool *isnull)
+{
+	TemplateExprState *tstate = (TemplateExprState *) state->evalfunc_private;
+
+	CheckExprStillValid(state, econtext);
+
+	state->evalfunc = tstate->func;
+
+	return tstate->func(state, econtext, isnull);
+}
+
+/*
+ * Template for expressions evaluated by the interpreter, after deforming
+ * the columns they need.
+ */
+static Datum
+template_eval_interp(ExprState *state, ExprContext *econtext, bool *isnull)
+{
+	TemplateExprState *tstate = (TemplateExprState *) state->evalfunc_private;
+
+	template_fetch(tstate, econtext);
+
+	return tstate->interp(state, econtext, isnull);
+}
+
+/*
+ * Template for quals of several "Var op Const" clauses.  A NULL Var makes
+ * its (strict) clause NULL, and so the qual false.
+ */
+static Datum
+template_eval_qual(ExprState *state, ExprContext *econtext, bool *isnull)
+{
+	TemplateExprState *tstate = (TemplateExprState *) state->evalfunc_private;
+
+	template_fetch(tstate, econtext);
+
+	*isnull = false;
+	for (int i = 0; i < tstate->nclauses; i++)
+	{
+		TemplateQualClause *clause = &tstate->clauses[i];
+		TupleTableSlot *slot = template_slot(econtext, clause->slotno);
+
+		if (slot->tts_isnull[clause->attnum] ||
+			!clause->cmp(slot->tts_values[clause->attnum], clause->constval))
+			return BoolGetDatum(false);
+	}
+
+	return BoolGetDatum(true);
+}
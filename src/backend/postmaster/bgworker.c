@@ -13,6 +13,7 @@
 #include "postgres.h"
 
 #include "access/parallel.h"
+#include "access/xlogparallel.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -20,6 +21,7 @@
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/interrupt.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/walsummarizer.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalworker.h"
 #include "storage/dsm.h"
@@ -123,11 +125,17 @@ static const struct
 	{
 		"ParallelWorkerMain", ParallelWorkerMain
 	},
+	{
+		"ParallelRedoWorkerMain", ParallelRedoWorkerMain
+	},
 	{
 		"ApplyLauncherMain", ApplyLauncherMain
 	},
 	{
 		"ApplyWorkerMain", ApplyWorkerMain
+	},
+	{
+		"WalSummarizerMain", WalSummarizerMain
 	}
 };
 
@@ -38,6 +38,7 @@
 #include "access/transam.h"
 #include "access/twophase_rmgr.h"
 #include "access/xact.h"
+#include "access/xlogprefetch.h"
 #include "catalog/pg_database.h"
 #include "catalog/pg_proc.h"
 #include "common/ip.h"
@@ -1388,6 +1389,13 @@ pgstat_reset_shared_counters(const char *target)
 {
 	PgStat_MsgResetsharedcounter msg;
 
+	/* recovery prefetching keeps its counters in shared memory */
+	if (strcmp(target, "recovery_prefetch") == 0)
+	{
+		XLogPrefetchResetStats();
+		return;
+	}
+
 	if (pgStatSock == PGINVALID_SOCKET)
 		return;
 
@@ -1401,7 +1409,7 @@ pgstat_reset_shared_counters(const char *target)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("unrecognized reset target: \"%s\"", target),
-				 errhint("Target must be \"archiver\", \"bgwriter\" or \"wal\".")));
+				 errhint("Target must be \"archiver\", \"bgwriter\", \"wal\" or \"recovery_prefetch\".")));
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RESETSHAREDCOUNTER);
 	pgstat_send(&msg, sizeof(msg));
@@ -3833,6 +3841,9 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_LOGICAL_LAUNCHER_MAIN:
 			event_name = "LogicalLauncherMain";
 			break;
+		case WAIT_EVENT_PARALLEL_REDO_MAIN:
+			event_name = "ParallelRedoMain";
+			break;
 		case WAIT_EVENT_PGSTAT_MAIN:
 			event_name = "PgStatMain";
 			break;
@@ -3848,6 +3859,9 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_WAL_SENDER_MAIN:
 			event_name = "WalSenderMain";
 			break;
+		case WAIT_EVENT_WAL_SUMMARIZER_WAL:
+			event_name = "WalSummarizerWal";
+			break;
 		case WAIT_EVENT_WAL_WRITER_MAIN:
 			event_name = "WalWriterMain";
 			break;
@@ -3919,6 +3933,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE:
 			event_name = "BackupWaitWalArchive";
 			break;
+		case WAIT_EVENT_BASEBACKUP_WORKERS:
+			event_name = "BaseBackupWorkers";
+			break;
 		case WAIT_EVENT_BGWORKER_SHUTDOWN:
 			event_name = "BgWorkerShutdown";
 			break;
@@ -4003,12 +4020,24 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_PARALLEL_BITMAP_SCAN:
 			event_name = "ParallelBitmapScan";
 			break;
+		case WAIT_EVENT_PARALLEL_COPY_CHUNK_FREE:
+			event_name = "ParallelCopyChunkFree";
+			break;
+		case WAIT_EVENT_PARALLEL_COPY_CHUNK_READY:
+			event_name = "ParallelCopyChunkReady";
+			break;
 		case WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN:
 			event_name = "ParallelCreateIndexScan";
 			break;
 		case WAIT_EVENT_PARALLEL_FINISH:
 			event_name = "ParallelFinish";
 			break;
+		case WAIT_EVENT_PARALLEL_REDO_BARRIER:
+			event_name = "ParallelRedoBarrier";
+			break;
+		case WAIT_EVENT_PARALLEL_REDO_DISPATCH:
+			event_name = "ParallelRedoDispatch";
+			break;
 		case WAIT_EVENT_PROCARRAY_GROUP_UPDATE:
 			event_name = "ProcArrayGroupUpdate";
 			break;
@@ -4039,6 +4068,12 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_SYNC_REP:
 			event_name = "SyncRep";
 			break;
+		case WAIT_EVENT_WAL_GROUP_FLUSH:
+			event_name = "WALGroupFlush";
+			break;
+		case WAIT_EVENT_WAL_SUMMARY_READY:
+			event_name = "WALSummaryReady";
+			break;
 		case WAIT_EVENT_XACT_GROUP_UPDATE:
 			event_name = "XactGroupUpdate";
 			break;
@@ -4296,6 +4331,12 @@ pgstat_get_wait_io(WaitEventIO w)
 		case WAIT_EVENT_WAL_READ:
 			event_name = "WALRead";
 			break;
+		case WAIT_EVENT_WAL_SUMMARY_READ:
+			event_name = "WALSummaryRead";
+			break;
+		case WAIT_EVENT_WAL_SUMMARY_WRITE:
+			event_name = "WALSummaryWrite";
+			break;
 		case WAIT_EVENT_WAL_SYNC:
 			event_name = "WALSync";
 			break;
@@ -6801,6 +6842,10 @@ pgstat_recv_wal(PgStat_MsgWal *msg, int len)
 	walStats.wal_fpi += msg->m_wal_fpi;
 	walStats.wal_bytes += msg->m_wal_bytes;
 	walStats.wal_buffers_full += msg->m_wal_buffers_full;
+	for (int i = 0; i < PGSTAT_NUM_WAL_GROUP_SIZES; i++)
+		walStats.wal_group_sizes[i] += msg->m_wal_group_sizes[i];
+	walStats.wal_segments_foreground += msg->m_wal_segments_foreground;
+	walStats.wal_segments_background += msg->m_wal_segments_background;
 }
 
 /* ----------
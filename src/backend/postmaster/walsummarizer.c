@@ -0,0 +1,478 @@
+/*-------------------------------------------------------------------------
+ *
+ * walsummarizer.c
+ *
+ * The WAL summarizer is a background worker that reads the WAL generated
+ * on this server and, for each checkpoint cycle, writes a summary file
+ * listing the blocks of each relation fork that the WAL modified.  Those
+ * summaries are what allow BASE_BACKUP to send only the blocks changed
+ * since an earlier backup.  See replication/walsummary.c for the summary
+ * format.
+ *
+ * A summary ends just after a checkpoint record, and the next one starts
+ * where the previous one ended, so the summaries on a timeline form an
+ * unbroken chain for as long as the summarizer keeps up.  While it runs,
+ * the summarizer holds back removal of the WAL it has yet to read.  If the
+ * WAL it needs is nevertheless gone (say, it was not running when the WAL
+ * was recycled), it starts a new chain at the latest checkpoint's redo
+ * pointer, and incremental backups relative to backups taken before the
+ * gap are refused.
+ *
+ * The summarizer only runs on a server that is not in recovery; on a
+ * standby it starts at promotion.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/walsummarizer.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/stat.h>
+
+#include "access/timeline.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogreader.h"
+#include "access/xlogutils.h"
+#include "catalog/pg_control.h"
+#include "catalog/storage_xlog.h"
+#include "commands/dbcommands_xlog.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "postmaster/walsummarizer.h"
+#include "replication/walsummary.h"
+#include "storage/condition_variable.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/memutils.h"
+
+/* How often to check for newly flushed WAL, in milliseconds */
+#define WAL_SUMMARIZER_POLL_MS		200
+
+/*
+ * Shared memory state.
+ *
+ * summarized_tli and summarized_lsn identify the end of the latest summary
+ * written.  pending_lsn is where the summary being built starts; WAL from
+ * there on must not be removed.
+ */
+typedef struct
+{
+	slock_t		mutex;
+	TimeLineID	summarized_tli;
+	XLogRecPtr	summarized_lsn;
+	XLogRecPtr	pending_lsn;
+	ConditionVariable summary_file_cv;	/* broadcast after each summary */
+} WalSummarizerData;
+
+static WalSummarizerData *WalSummarizerCtl = NULL;
+
+/* GUC parameters */
+bool		summarize_wal = false;
+int			wal_summary_keep_time = 10 * 24 * 60;
+
+static XLogRecPtr GetSummarizerStartLSN(TimeLineID tli);
+static XLogRecPtr SummarizeWAL(XLogReaderState *reader, XLogRecPtr start_lsn,
+							   BlockRefTable *brtab);
+static void SummarizeRecord(XLogReaderState *reader, BlockRefTable *brtab);
+static int	summarizer_read_page(XLogReaderState *state,
+								 XLogRecPtr targetPagePtr, int reqLen,
+								 XLogRecPtr targetRecPtr, char *cur_page);
+
+/*
+ * Report shared-memory space needed by WalSummarizerShmemInit.
+ */
+Size
+WalSummarizerShmemSize(void)
+{
+	return sizeof(WalSummarizerData);
+}
+
+/*
+ * Allocate and initialize WAL summarizer shared memory.
+ */
+void
+WalSummarizerShmemInit(void)
+{
+	bool		found;
+
+	WalSummarizerCtl = (WalSummarizerData *)
+		ShmemInitStruct("WAL Summarizer Data", WalSummarizerShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		SpinLockInit(&WalSummarizerCtl->mutex);
+		WalSummarizerCtl->summarized_tli = 0;
+		WalSummarizerCtl->summarized_lsn = InvalidXLogRecPtr;
+		WalSummarizerCtl->pending_lsn = InvalidXLogRecPtr;
+		ConditionVariableInit(&WalSummarizerCtl->summary_file_cv);
+	}
+}
+
+/*
+ * Register the WAL summarizer background worker, if summarize_wal is on.
+ * Like ApplyLauncherRegister(), this must be called by the postmaster
+ * before InitializeMaxBackends().
+ */
+void
+WalSummarizerRegister(void)
+{
+	BackgroundWorker bgw;
+
+	if (!summarize_wal)
+		return;
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	bgw.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "WalSummarizerMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN, "WAL summarizer");
+	snprintf(bgw.bgw_type, BGW_MAXLEN, "WAL summarizer");
+	bgw.bgw_restart_time = 5;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = (Datum) 0;
+
+	RegisterBackgroundWorker(&bgw);
+}
+
+/*
+ * Return the oldest LSN that the WAL summarizer still needs to read, or
+ * InvalidXLogRecPtr if there's no such constraint.
+ */
+XLogRecPtr
+GetOldestUnsummarizedLSN(void)
+{
+	XLogRecPtr	result;
+
+	if (!summarize_wal)
+		return InvalidXLogRecPtr;
+
+	SpinLockAcquire(&WalSummarizerCtl->mutex);
+	result = WalSummarizerCtl->pending_lsn;
+	SpinLockRelease(&WalSummarizerCtl->mutex);
+
+	return result;
+}
+
+/*
+ * Wait until summary files covering all WAL on timeline 'tli' up to 'lsn'
+ * have been written.
+ */
+void
+WaitForWalSummarization(TimeLineID tli, XLogRecPtr lsn)
+{
+	if (!summarize_wal)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("WAL summarization is not enabled"),
+				 errhint("Set summarize_wal to on and restart the server.")));
+
+	ConditionVariablePrepareToSleep(&WalSummarizerCtl->summary_file_cv);
+	for (;;)
+	{
+		TimeLineID	summarized_tli;
+		XLogRecPtr	summarized_lsn;
+
+		SpinLockAcquire(&WalSummarizerCtl->mutex);
+		summarized_tli = WalSummarizerCtl->summarized_tli;
+		summarized_lsn = WalSummarizerCtl->summarized_lsn;
+		SpinLockRelease(&WalSummarizerCtl->mutex);
+
+		if (summarized_tli == tli && summarized_lsn >= lsn)
+			break;
+
+		ConditionVariableSleep(&WalSummarizerCtl->summary_file_cv,
+							   WAIT_EVENT_WAL_SUMMARY_READY);
+	}
+	ConditionVariableCancelSleep();
+}
+
+/*
+ * Main entry point for the WAL summarizer background worker.
+ */
+void
+WalSummarizerMain(Datum main_arg)
+{
+	XLogReaderState *reader;
+	MemoryContext summary_context;
+	TimeLineID	tli;
+	XLogRecPtr	start_lsn;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	BackgroundWorkerUnblockSignals();
+
+	/* This sets ThisTimeLineID, which can't change while we're running. */
+	if (RecoveryInProgress())
+		elog(ERROR, "WAL summarizer started during recovery");
+	tli = ThisTimeLineID;
+
+	if (MakePGDirectory(WAL_SUMMARY_DIR) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m",
+						WAL_SUMMARY_DIR)));
+
+	summary_context = AllocSetContextCreate(TopMemoryContext,
+											"WAL summarizer",
+											ALLOCSET_DEFAULT_SIZES);
+
+	start_lsn = GetSummarizerStartLSN(tli);
+	ereport(DEBUG1,
+			(errmsg("WAL summarizer starting at %X/%X on timeline %u",
+					(uint32) (start_lsn >> 32), (uint32) start_lsn, tli)));
+
+	reader = XLogReaderAllocate(wal_segment_size, NULL,
+								XL_ROUTINE(.page_read = &summarizer_read_page,
+										   .segment_open = &wal_segment_open,
+										   .segment_close = &wal_segment_close),
+								NULL);
+	if (!reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	for (;;)
+	{
+		MemoryContext oldcontext;
+		BlockRefTable *brtab;
+		XLogRecPtr	end_lsn;
+
+		SpinLockAcquire(&WalSummarizerCtl->mutex);
+		WalSummarizerCtl->pending_lsn = start_lsn;
+		SpinLockRelease(&WalSummarizerCtl->mutex);
+
+		oldcontext = MemoryContextSwitchTo(summary_context);
+
+		brtab = CreateBlockRefTable();
+		end_lsn = SummarizeWAL(reader, start_lsn, brtab);
+		WriteWalSummary(brtab, tli, start_lsn, end_lsn);
+
+		SpinLockAcquire(&WalSummarizerCtl->mutex);
+		WalSummarizerCtl->summarized_tli = tli;
+		WalSummarizerCtl->summarized_lsn = end_lsn;
+		WalSummarizerCtl->pending_lsn = end_lsn;
+		SpinLockRelease(&WalSummarizerCtl->mutex);
+		ConditionVariableBroadcast(&WalSummarizerCtl->summary_file_cv);
+
+		RemoveOldWalSummaries(wal_summary_keep_time);
+
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(summary_context);
+
+		start_lsn = end_lsn;
+	}
+}
+
+/*
+ * Decide where summarization should start: at the end of the latest
+ * summary for this timeline if the WAL after it still exists, otherwise at
+ * the redo pointer of a checkpoint taken on this timeline.
+ */
+static XLogRecPtr
+GetSummarizerStartLSN(TimeLineID tli)
+{
+	List	   *wslist;
+	ListCell   *lc;
+	XLogRecPtr	latest = InvalidXLogRecPtr;
+	List	   *history;
+
+	wslist = GetWalSummaries(tli, InvalidXLogRecPtr, InvalidXLogRecPtr);
+	foreach(lc, wslist)
+	{
+		WalSummaryFile *ws = (WalSummaryFile *) lfirst(lc);
+
+		latest = Max(latest, ws->end_lsn);
+	}
+	list_free_deep(wslist);
+
+	if (!XLogRecPtrIsInvalid(latest))
+	{
+		XLogSegNo	segno;
+		char		path[MAXPGPATH];
+		struct stat statbuf;
+
+		XLByteToSeg(latest, segno, wal_segment_size);
+		XLogFilePath(path, tli, segno, wal_segment_size);
+		if (stat(path, &statbuf) == 0)
+			return latest;
+
+		ereport(LOG,
+				(errmsg("WAL needed to continue summarization at %X/%X has been removed",
+						(uint32) (latest >> 32), (uint32) latest),
+				 errdetail("Incremental backups relative to backups taken before this point will not be possible.")));
+	}
+
+	/*
+	 * Right after promotion, the latest redo pointer can still belong to a
+	 * restartpoint on the previous timeline; wait for a checkpoint on ours.
+	 */
+	history = readTimeLineHistory(tli);
+	for (;;)
+	{
+		XLogRecPtr	redo = GetRedoRecPtr();
+
+		if (tliOfPointInHistory(redo, history) == tli)
+			return redo;
+
+		HandleMainLoopInterrupts();
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 1000L, WAIT_EVENT_WAL_SUMMARIZER_WAL);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Summarize WAL from start_lsn through the next checkpoint record, and
+ * return the LSN just past that record.
+ */
+static XLogRecPtr
+SummarizeWAL(XLogReaderState *reader, XLogRecPtr start_lsn,
+			 BlockRefTable *brtab)
+{
+	XLogRecPtr	first_lsn = start_lsn;
+
+	/* A record can't start on a page header; skip over it. */
+	if (XLogSegmentOffset(first_lsn, wal_segment_size) == 0)
+		first_lsn += SizeOfXLogLongPHD;
+	else if (first_lsn % XLOG_BLCKSZ == 0)
+		first_lsn += SizeOfXLogShortPHD;
+
+	XLogBeginRead(reader, first_lsn);
+
+	for (;;)
+	{
+		XLogRecord *record;
+		char	   *errormsg;
+		uint8		info;
+
+		record = XLogReadRecord(reader, &errormsg);
+		if (record == NULL)
+		{
+			if (errormsg)
+				ereport(ERROR,
+						(errmsg("could not read WAL at %X/%X: %s",
+								(uint32) (reader->EndRecPtr >> 32),
+								(uint32) reader->EndRecPtr, errormsg)));
+			else
+				ereport(ERROR,
+						(errmsg("could not read WAL at %X/%X",
+								(uint32) (reader->EndRecPtr >> 32),
+								(uint32) reader->EndRecPtr)));
+		}
+
+		SummarizeRecord(reader, brtab);
+
+		info = XLogRecGetInfo(reader) & ~XLR_INFO_MASK;
+		if (XLogRecGetRmid(reader) == RM_XLOG_ID &&
+			(info == XLOG_CHECKPOINT_ONLINE ||
+			 info == XLOG_CHECKPOINT_SHUTDOWN))
+			return reader->EndRecPtr;
+	}
+}
+
+/*
+ * Add the blocks modified by one WAL record to the block reference table.
+ *
+ * Every block reference counts as a modification.  In addition, relation
+ * fork creation and truncation set the fork's limit block, and creating a
+ * database marks every relation in it as entirely new.  Free space map and
+ * visibility map forks are always backed up in full (the former isn't
+ * WAL-logged, and the latter is modified during redo of heap records that
+ * don't reference it), so their truncations aren't tracked here.
+ */
+static void
+SummarizeRecord(XLogReaderState *reader, BlockRefTable *brtab)
+{
+	uint8		rmid = XLogRecGetRmid(reader);
+	uint8		info = XLogRecGetInfo(reader) & ~XLR_INFO_MASK;
+	int			block_id;
+
+	if (rmid == RM_SMGR_ID && info == XLOG_SMGR_CREATE)
+	{
+		xl_smgr_create *xlrec = (xl_smgr_create *) XLogRecGetData(reader);
+
+		BlockRefTableSetLimitBlock(brtab, &xlrec->rnode, xlrec->forkNum, 0);
+	}
+	else if (rmid == RM_SMGR_ID && info == XLOG_SMGR_TRUNCATE)
+	{
+		xl_smgr_truncate *xlrec = (xl_smgr_truncate *) XLogRecGetData(reader);
+
+		if ((xlrec->flags & SMGR_TRUNCATE_HEAP) != 0)
+			BlockRefTableSetLimitBlock(brtab, &xlrec->rnode, MAIN_FORKNUM,
+									   xlrec->blkno);
+	}
+	else if (rmid == RM_DBASE_ID && info == XLOG_DBASE_CREATE)
+	{
+		xl_dbase_create_rec *xlrec =
+		(xl_dbase_create_rec *) XLogRecGetData(reader);
+		RelFileNode rnode;
+
+		rnode.spcNode = xlrec->tablespace_id;
+		rnode.dbNode = xlrec->db_id;
+		rnode.relNode = InvalidOid;
+		BlockRefTableSetLimitBlock(brtab, &rnode, MAIN_FORKNUM, 0);
+	}
+
+	for (block_id = 0; block_id <= reader->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+
+		if (!XLogRecGetBlockTag(reader, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		BlockRefTableMarkBlockModified(brtab, &rnode, forknum, blkno);
+	}
+}
+
+/*
+ * XLogReaderRoutine->page_read callback.  Like read_local_xlog_page(), but
+ * sleeps on our latch while waiting for WAL to be flushed, so that we can
+ * respond to reload and shutdown requests.
+ */
+static int
+summarizer_read_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
+					 int reqLen, XLogRecPtr targetRecPtr, char *cur_page)
+{
+	XLogRecPtr	flush_lsn;
+	WALReadError errinfo;
+
+	for (;;)
+	{
+		flush_lsn = GetFlushRecPtr();
+		if (targetPagePtr + reqLen <= flush_lsn)
+			break;
+
+		HandleMainLoopInterrupts();
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 WAL_SUMMARIZER_POLL_MS,
+						 WAIT_EVENT_WAL_SUMMARIZER_WAL);
+		ResetLatch(MyLatch);
+	}
+
+	/*
+	 * Read the whole page even if only part of it has been flushed; it's
+	 * zero-padded up to the page boundary.
+	 */
+	if (!WALRead(state, cur_page, targetPagePtr, XLOG_BLCKSZ, ThisTimeLineID,
+				 &errinfo))
+		WALReadRaiseError(&errinfo);
+
+	return Min(flush_lsn - targetPagePtr, XLOG_BLCKSZ);
+}
@@ -16,9 +16,10 @@
  *
  * Because the walwriter's cycle is directly linked to the maximum delay
  * before async-commit transactions are guaranteed committed, it's probably
- * unwise to load additional functionality onto it.  For instance, if you've
- * got a yen to create xlog segments further in advance, that'd be better done
- * in bgwriter than in walwriter.
+ * unwise to load additional functionality onto it.  The one exception is
+ * creating xlog segments further in advance (see XLogBackgroundPrealloc()),
+ * which is closely tied to the WAL write position; it creates at most one
+ * segment per cycle to keep the added delay bounded.
  *
  * The walwriter is started by the postmaster as soon as the startup subprocess
  * finishes.  It remains alive until the postmaster commands it to terminate.
@@ -253,6 +254,13 @@ WalWriterMain(void)
 		else if (left_till_hibernate > 0)
 			left_till_hibernate--;
 
+		/* Keep future WAL segments ready; that counts as useful work too */
+		if (XLogBackgroundPrealloc())
+			left_till_hibernate = LOOPS_UNTIL_HIBERNATE;
+
+		/* Send WAL statistics, e.g. for segments created, to the collector */
+		pgstat_send_wal();
+
 		/*
 		 * Sleep until we are signaled or WalWriterDelay has elapsed.  If we
 		 * haven't done anything useful for quite some time, lengthen the
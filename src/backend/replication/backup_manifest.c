@@ -81,6 +81,65 @@ InitializeBackupManifest(backup_manifest_info *manifest,
 						 "\"Files\": [");
 }
 
+/*
+ * Initialize state so that we can collect the manifest entries for the
+ * files sent by one worker of a parallel backup.
+ *
+ * The entries are written to the given file, which the leader later passes
+ * to AppendBackupManifestFragment.  Every entry is preceded by a separating
+ * comma, and the fragment is not checksummed; the leader checksums it as
+ * part of the whole manifest.  If buffile is NULL, no entries are collected.
+ */
+void
+InitializeBackupManifestFragment(backup_manifest_info *manifest,
+								 BufFile *buffile,
+								 backup_manifest_option want_manifest,
+								 pg_checksum_type manifest_checksum_type)
+{
+	memset(manifest, 0, sizeof(backup_manifest_info));
+	manifest->checksum_type = manifest_checksum_type;
+	manifest->buffile = buffile;
+	manifest->manifest_ctx = NULL;
+	manifest->manifest_size = UINT64CONST(0);
+	manifest->force_encode = (want_manifest == MANIFEST_OPTION_FORCE_ENCODE);
+	manifest->first_file = false;
+	manifest->still_checksumming = false;
+}
+
+/*
+ * Add the entries collected in a manifest fragment to the backup manifest.
+ */
+void
+AppendBackupManifestFragment(backup_manifest_info *manifest, BufFile *fragment)
+{
+	char		buf[BLCKSZ + 1];
+	size_t		nread;
+
+	if (!IsManifestEnabled(manifest))
+		return;
+
+	if (BufFileSeek(fragment, 0, 0L, SEEK_SET))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not rewind temporary file")));
+
+	while ((nread = BufFileRead(fragment, buf, BLCKSZ)) > 0)
+	{
+		char	   *s = buf;
+
+		buf[nread] = '\0';
+
+		/* The fragment's first entry needs no comma if it's our first. */
+		if (manifest->first_file)
+		{
+			Assert(buf[0] == ',');
+			s++;
+			manifest->first_file = false;
+		}
+		AppendStringToManifest(manifest, s);
+	}
+}
+
 /*
  * Free resources assigned to a backup manifest constructed.
  */
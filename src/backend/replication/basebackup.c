@@ -15,8 +15,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "access/xlog_internal.h"	/* for pg_start/stop_backup */
+#include "catalog/pg_tablespace_d.h"
 #include "catalog/pg_type.h"
 #include "common/file_perm.h"
 #include "commands/progress.h"
@@ -29,22 +39,37 @@
 #include "pgtar.h"
 #include "port.h"
 #include "postmaster/syslogger.h"
+#include "postmaster/walsummarizer.h"
 #include "replication/basebackup.h"
 #include "replication/backup_manifest.h"
+#include "replication/incremental.h"
 #include "replication/walsender.h"
 #include "replication/walsender_private.h"
+#include "replication/walsummary.h"
 #include "storage/bufpage.h"
 #include "storage/checksum.h"
+#include "storage/condition_variable.h"
+#include "storage/dsm.h"
 #include "storage/dsm_impl.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/reinit.h"
+#include "storage/sharedfileset.h"
+#include "storage/spin.h"
 #include "utils/builtins.h"
 #include "utils/ps_status.h"
 #include "utils/relcache.h"
 #include "utils/resowner.h"
 #include "utils/timestamp.h"
 
+typedef enum
+{
+	BACKUP_COMPRESSION_NONE,
+	BACKUP_COMPRESSION_GZIP,
+	BACKUP_COMPRESSION_LZ4,
+	BACKUP_COMPRESSION_ZSTD
+} backup_compression_type;
+
 typedef struct
 {
 	const char *label;
@@ -56,8 +81,75 @@ typedef struct
 	bool		sendtblspcmapfile;
 	backup_manifest_option manifest;
 	pg_checksum_type manifest_checksum_type;
+	XLogRecPtr	incremental_lsn;	/* prior backup's start, if incremental */
+	TimeLineID	incremental_tli;
+	backup_compression_type compression;
+	int			compression_level;
+	bool		parallel;		/* other tablespaces sent by workers? */
+	bool		join;			/* is this a worker of a parallel backup? */
+	const char *join_backup;	/* ID of the backup, as given by the client */
+	char		join_id[PARALLEL_BACKUP_ID_LEN];	/* ... decoded */
+	Oid			join_tablespace;
 } basebackup_options;
 
+/*
+ * State of a parallel base backup, shared between the connection that
+ * started it (the leader) and the worker connections that join it to send
+ * tablespaces other than the main data directory.  It lives in a DSM
+ * segment.
+ *
+ * The backup's ID is a random string rather than the segment's handle, so
+ * that a connection can only join a backup whose ID it has been told.  The
+ * leader advertises the ID and the handle in its WalSnd slot; a worker looks
+ * the ID up there, and then checks that the segment it attached to really
+ * is the backup it asked for before touching anything in it.
+ */
+#define PARALLEL_BACKUP_MAGIC		0x50424b50
+#define PARALLEL_BACKUP_VERSION		1
+
+typedef enum
+{
+	PB_TABLESPACE_PENDING,
+	PB_TABLESPACE_SENDING,
+	PB_TABLESPACE_DONE,
+	PB_TABLESPACE_FAILED
+} ParallelBackupTablespaceState;
+
+typedef struct ParallelBackupTablespace
+{
+	Oid			oid;
+	char		path[MAXPGPATH];
+	ParallelBackupTablespaceState state;	/* protected by mutex */
+} ParallelBackupTablespace;
+
+typedef struct ParallelBackupShared
+{
+	uint32		magic;			/* PARALLEL_BACKUP_MAGIC */
+	uint32		version;		/* PARALLEL_BACKUP_VERSION */
+	char		id[PARALLEL_BACKUP_ID_LEN];
+	Oid			leader_role;	/* only this role may join */
+
+	slock_t		mutex;
+	ConditionVariable cv;		/* signaled when a tablespace is done */
+	SharedFileSet fileset;		/* manifest entries written by workers */
+
+	/* Settings the workers need to send files as the leader would */
+	XLogRecPtr	startptr;
+	TimeLineID	starttli;
+	bool		started_in_recovery;
+	bool		noverify_checksums;
+	XLogRecPtr	incremental_lsn;
+	uint32		maxrate;
+	backup_compression_type compression;
+	int			compression_level;
+	backup_manifest_option manifest;
+	pg_checksum_type manifest_checksum_type;
+
+	int64		checksum_failures;	/* protected by mutex */
+	int			ntablespaces;
+	ParallelBackupTablespace tablespaces[FLEXIBLE_ARRAY_MEMBER];
+} ParallelBackupShared;
+
 static int64 sendTablespace(char *path, char *oid, bool sizeonly,
 							struct backup_manifest_info *manifest);
 static int64 sendDir(const char *path, int basepathlen, bool sizeonly,
@@ -66,6 +158,22 @@ static int64 sendDir(const char *path, int basepathlen, bool sizeonly,
 static bool sendFile(const char *readfilename, const char *tarfilename,
 					 struct stat *statbuf, bool missing_ok, Oid dboid,
 					 backup_manifest_info *manifest, const char *spcoid);
+static bool sendIncrementalFile(const char *readfilename,
+								const char *tarfilename,
+								struct stat *statbuf, const RelFileNode *rnode,
+								ForkNumber forknum, unsigned segno, Oid dboid,
+								backup_manifest_info *manifest,
+								const char *spcoid);
+static bool get_relation_file_identity(const char *path, const char *filename,
+									   bool isDbDir, const char *spcoid,
+									   RelFileNode *rnode, ForkNumber *forknum,
+									   unsigned *segno);
+static BlockRefTable *LoadIncrementalBlockRefTable(TimeLineID tli,
+												   XLogRecPtr start_lsn,
+												   XLogRecPtr end_lsn);
+static void PrepareIncrementalBackup(basebackup_options *opt,
+									 TimeLineID starttli,
+									 StringInfo labelfile);
 static void sendFileWithContent(const char *filename, const char *content,
 								backup_manifest_info *manifest);
 static int64 _tarWriteHeader(const char *filename, const char *linktarget,
@@ -75,6 +183,21 @@ static int64 _tarWriteDir(const char *pathbuf, int basepathlen, struct stat *sta
 static void send_int8_string(StringInfoData *buf, int64 intval);
 static void SendBackupHeader(List *tablespaces);
 static void perform_base_backup(basebackup_options *opt);
+static void perform_base_backup_worker(basebackup_options *opt);
+static ParallelBackupShared *InitializeParallelBackup(basebackup_options *opt,
+													  TimeLineID starttli,
+													  List *tablespaces,
+													  dsm_segment **segp);
+static void WaitForParallelBackupWorkers(ParallelBackupShared *shared,
+										 backup_manifest_info *manifest);
+static void parallel_backup_leader_detach(dsm_segment *seg, Datum arg);
+static void parallel_backup_worker_detach(dsm_segment *seg, Datum arg);
+static dsm_segment *AttachParallelBackup(basebackup_options *opt);
+static void SendParallelBackupId(ParallelBackupShared *shared);
+static void begin_archive(void);
+static void send_archive_data(const char *data, size_t len);
+static void put_archive_data(const char *data, size_t len);
+static void end_archive(void);
 static void parse_basebackup_options(List *options, basebackup_options *opt);
 static void SendXlogRecPtrResult(XLogRecPtr ptr, TimeLineID tli);
 static int	compareWalFileNames(const ListCell *a, const ListCell *b);
@@ -90,11 +213,48 @@ static bool backup_started_in_recovery = false;
 /* Relative path of temporary statistics directory */
 static char *statrelpath = NULL;
 
+/* Blocks modified since the prior backup, if this backup is incremental */
+static BlockRefTable *incremental_brtab = NULL;
+
+/*
+ * A relation segment with more than this fraction of its blocks modified
+ * is sent in full, even in an incremental backup.
+ */
+#define INCREMENTAL_MAX_CHANGED_FRACTION	0.9
+
 /*
  * Size of each block sent into the tar stream for larger files.
  */
 #define TAR_SEND_SIZE 32768
 
+/* Compression applied to the tar streams of this backup */
+static backup_compression_type archive_compression = BACKUP_COMPRESSION_NONE;
+static int	archive_compression_level;
+
+#ifdef HAVE_LIBZ
+/* Compressor for the tar stream being sent, if compressing with gzip */
+static z_stream *archive_zstream = NULL;
+static char *archive_zbuf = NULL;
+
+#define ARCHIVE_ZBUF_SIZE 65536
+#endif
+
+#ifdef USE_LZ4
+/* ... with LZ4, which is fed at most ARCHIVE_LZ4_CHUNK bytes at a time */
+static LZ4F_cctx *archive_lz4ctx = NULL;
+static char *archive_lz4buf = NULL;
+static size_t archive_lz4bufsize;
+
+#define ARCHIVE_LZ4_CHUNK 65536
+#endif
+
+#ifdef USE_ZSTD
+/* ... with zstd */
+static ZSTD_CCtx *archive_zstdctx = NULL;
+static char *archive_zstdbuf = NULL;
+static size_t archive_zstdbufsize;
+#endif
+
 /*
  * How frequently to throttle, as a fraction of the specified rate-second.
  */
@@ -264,8 +424,14 @@ perform_base_backup(basebackup_options *opt)
 	int			datadirpathlen;
 	List	   *tablespaces = NIL;
 
+	ParallelBackupShared *pbshared = NULL;
+	dsm_segment *pbseg = NULL;
+
 	backup_total = 0;
 	backup_streamed = 0;
+	incremental_brtab = NULL;
+	archive_compression = opt->compression;
+	archive_compression_level = opt->compression_level;
 	pgstat_progress_start_command(PROGRESS_COMMAND_BASEBACKUP, InvalidOid);
 
 	/*
@@ -326,6 +492,14 @@ perform_base_backup(basebackup_options *opt)
 		else
 			statrelpath = pgstat_stat_directory;
 
+		/*
+		 * For an incremental backup, work out which blocks have changed
+		 * since the prior backup.  This must happen before the backup_label
+		 * is sent, since it records the prior backup.
+		 */
+		if (!XLogRecPtrIsInvalid(opt->incremental_lsn))
+			PrepareIncrementalBackup(opt, starttli, labelfile);
+
 		/* Add a node for the base directory at the end */
 		ti = palloc0(sizeof(tablespaceinfo));
 		ti->size = -1;
@@ -369,9 +543,21 @@ perform_base_backup(basebackup_options *opt)
 			pgstat_progress_update_multi_param(3, index, val);
 		}
 
+		/*
+		 * In a parallel backup, publish what the workers need to send the
+		 * other tablespaces.
+		 */
+		if (opt->parallel)
+			pbshared = InitializeParallelBackup(opt, starttli, tablespaces,
+												&pbseg);
+
 		/* Send the starting position of the backup */
 		SendXlogRecPtrResult(startptr, starttli);
 
+		/* ... and the ID workers use to join a parallel backup */
+		if (pbshared != NULL)
+			SendParallelBackupId(pbshared);
+
 		/* Send tablespace header */
 		SendBackupHeader(tablespaces);
 
@@ -403,13 +589,12 @@ perform_base_backup(basebackup_options *opt)
 		foreach(lc, tablespaces)
 		{
 			tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
-			StringInfoData buf;
 
-			/* Send CopyOutResponse message */
-			pq_beginmessage(&buf, 'H');
-			pq_sendbyte(&buf, 0);	/* overall format */
-			pq_sendint16(&buf, 0);	/* natts */
-			pq_endmessage(&buf);
+			/* In a parallel backup, workers send all but the main directory */
+			if (pbshared != NULL && ti->path != NULL)
+				continue;
+
+			begin_archive();
 
 			if (ti->path == NULL)
 			{
@@ -455,13 +640,21 @@ perform_base_backup(basebackup_options *opt)
 				Assert(lnext(tablespaces, lc) == NULL);
 			}
 			else
-				pq_putemptymessage('c');	/* CopyDone */
+				end_archive();
 
 			tblspc_streamed++;
 			pgstat_progress_update_param(PROGRESS_BASEBACKUP_TBLSPC_STREAMED,
 										 tblspc_streamed);
 		}
 
+		/* The backup isn't complete until the workers have finished. */
+		if (pbshared != NULL)
+		{
+			WaitForParallelBackupWorkers(pbshared, &manifest);
+			pgstat_progress_update_param(PROGRESS_BASEBACKUP_TBLSPC_STREAMED,
+										 list_length(tablespaces));
+		}
+
 		pgstat_progress_update_param(PROGRESS_BASEBACKUP_PHASE,
 									 PROGRESS_BASEBACKUP_PHASE_WAIT_WAL_ARCHIVE);
 		endptr = do_pg_stop_backup(labelfile->data, !opt->nowait, &endtli);
@@ -638,10 +831,8 @@ perform_base_backup(basebackup_options *opt)
 											   len, pathbuf, true)) > 0)
 			{
 				CheckXLogRemoved(segno, tli);
-				/* Send the chunk as a CopyData message */
-				if (pq_putmessage('d', buf, cnt))
-					ereport(ERROR,
-							(errmsg("base backup could not send data, aborting backup")));
+				/* Send the chunk into the tar stream */
+				send_archive_data(buf, cnt);
 				update_basebackup_progress(cnt);
 
 				len += cnt;
@@ -706,7 +897,7 @@ perform_base_backup(basebackup_options *opt)
 		}
 
 		/* Send CopyDone message for the last tar file */
-		pq_putemptymessage('c');
+		end_archive();
 	}
 
 	AddWALInfoToBackupManifest(&manifest, startptr, starttli, endptr, endtli);
@@ -736,12 +927,403 @@ perform_base_backup(basebackup_options *opt)
 	 */
 	FreeBackupManifest(&manifest);
 
+	if (pbseg != NULL)
+		dsm_detach(pbseg);
+
 	/* clean up the resource owner we created */
 	WalSndResourceCleanup(true);
 
 	pgstat_progress_end_command();
 }
 
+/*
+ * Send one tablespace of a parallel base backup, on behalf of the leader
+ * connection that started the backup.
+ *
+ * The tablespace is sent as a single tar stream, just as the leader would
+ * have sent it; its manifest entries are handed to the leader through a
+ * shared file.
+ */
+static void
+perform_base_backup_worker(basebackup_options *opt)
+{
+	dsm_segment *seg;
+	ParallelBackupShared *shared;
+	ParallelBackupTablespace *pbt = NULL;
+	ParallelBackupTablespaceState state = PB_TABLESPACE_PENDING;
+	backup_manifest_info manifest;
+	BufFile    *fragment = NULL;
+	char		spcoid[12];
+	int			i;
+
+	/* we're going to use a BufFile and a DSM segment, so we need a ResourceOwner */
+	Assert(CurrentResourceOwner == NULL);
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "base backup");
+
+	seg = AttachParallelBackup(opt);
+	shared = dsm_segment_address(seg);
+
+	/* Claim the tablespace, so that nobody else sends it too. */
+	SpinLockAcquire(&shared->mutex);
+	for (i = 0; i < shared->ntablespaces; i++)
+	{
+		if (shared->tablespaces[i].oid == opt->join_tablespace)
+		{
+			pbt = &shared->tablespaces[i];
+			state = pbt->state;
+			if (state == PB_TABLESPACE_PENDING)
+				pbt->state = PB_TABLESPACE_SENDING;
+			break;
+		}
+	}
+	SpinLockRelease(&shared->mutex);
+
+	if (pbt == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("tablespace %u is not part of parallel base backup \"%s\"",
+						opt->join_tablespace, opt->join_backup)));
+	if (state != PB_TABLESPACE_PENDING)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("tablespace %u of parallel base backup \"%s\" has already been sent",
+						opt->join_tablespace, opt->join_backup)));
+
+	/* From here on, tell the leader if we fail. */
+	on_dsm_detach(seg, parallel_backup_worker_detach, PointerGetDatum(pbt));
+
+	startptr = shared->startptr;
+	backup_started_in_recovery = shared->started_in_recovery;
+	noverify_checksums = shared->noverify_checksums;
+	archive_compression = shared->compression;
+	archive_compression_level = shared->compression_level;
+	total_checksum_failures = 0;
+	backup_total = -1;
+	backup_streamed = 0;
+
+	incremental_brtab = NULL;
+	if (!XLogRecPtrIsInvalid(shared->incremental_lsn))
+		incremental_brtab = LoadIncrementalBlockRefTable(shared->starttli,
+														 shared->incremental_lsn,
+														 startptr);
+
+	if (shared->manifest != MANIFEST_OPTION_NO)
+	{
+		char		name[MAXPGPATH];
+
+		SharedFileSetAttach(&shared->fileset, seg);
+		snprintf(name, sizeof(name), "manifest.%u", pbt->oid);
+		fragment = BufFileCreateShared(&shared->fileset, name);
+	}
+	InitializeBackupManifestFragment(&manifest, fragment, shared->manifest,
+									 shared->manifest_checksum_type);
+
+	pgstat_progress_start_command(PROGRESS_COMMAND_BASEBACKUP, InvalidOid);
+	{
+		const int	index[] = {
+			PROGRESS_BASEBACKUP_PHASE,
+			PROGRESS_BASEBACKUP_BACKUP_TOTAL,
+			PROGRESS_BASEBACKUP_TBLSPC_TOTAL
+		};
+		const int64 val[] = {
+			PROGRESS_BASEBACKUP_PHASE_STREAM_BACKUP,
+			backup_total, 1
+		};
+
+		pgstat_progress_update_multi_param(3, index, val);
+	}
+
+	if (shared->maxrate > 0)
+	{
+		throttling_sample =
+			(int64) shared->maxrate * (int64) 1024 / THROTTLING_FREQUENCY;
+		elapsed_min_unit = USECS_PER_SEC / THROTTLING_FREQUENCY;
+		throttling_counter = 0;
+		throttled_last = GetCurrentTimestamp();
+	}
+	else
+		throttling_counter = -1;
+
+	snprintf(spcoid, sizeof(spcoid), "%u", pbt->oid);
+	begin_archive();
+	sendTablespace(pbt->path, spcoid, false, &manifest);
+	end_archive();
+
+	if (fragment != NULL)
+	{
+		BufFileExportShared(fragment);
+		BufFileClose(fragment);
+	}
+
+	SpinLockAcquire(&shared->mutex);
+	shared->checksum_failures += total_checksum_failures;
+	pbt->state = PB_TABLESPACE_DONE;
+	SpinLockRelease(&shared->mutex);
+	ConditionVariableBroadcast(&shared->cv);
+
+	pgstat_progress_update_param(PROGRESS_BASEBACKUP_TBLSPC_STREAMED, 1);
+
+	dsm_detach(seg);
+	WalSndResourceCleanup(true);
+
+	pgstat_progress_end_command();
+}
+
+/*
+ * Find and attach to the parallel base backup a worker asked to join.
+ *
+ * Anything could be behind a handle found in a WalSnd slot by the time we
+ * attach to it: the leader may have finished and its segment's handle been
+ * reused.  So check that the segment is large enough, carries our magic
+ * number and the ID we were given, before believing anything else in it.
+ */
+static dsm_segment *
+AttachParallelBackup(basebackup_options *opt)
+{
+	dsm_handle	handle = DSM_HANDLE_INVALID;
+	dsm_segment *seg = NULL;
+	ParallelBackupShared *shared;
+	Size		len;
+	int			i;
+
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		WalSnd	   *walsnd = &WalSndCtl->walsnds[i];
+
+		SpinLockAcquire(&walsnd->mutex);
+		if (walsnd->pid != 0 &&
+			walsnd->parallelBackupHandle != DSM_HANDLE_INVALID &&
+			memcmp(walsnd->parallelBackupId, opt->join_id,
+				   PARALLEL_BACKUP_ID_LEN) == 0)
+			handle = walsnd->parallelBackupHandle;
+		SpinLockRelease(&walsnd->mutex);
+
+		if (handle != DSM_HANDLE_INVALID)
+			break;
+	}
+
+	if (handle != DSM_HANDLE_INVALID)
+		seg = dsm_attach(handle);
+	if (seg != NULL)
+	{
+		shared = dsm_segment_address(seg);
+		len = dsm_segment_map_length(seg);
+
+		if (len < offsetof(ParallelBackupShared, tablespaces) ||
+			shared->magic != PARALLEL_BACKUP_MAGIC ||
+			shared->version != PARALLEL_BACKUP_VERSION ||
+			memcmp(shared->id, opt->join_id, PARALLEL_BACKUP_ID_LEN) != 0 ||
+			shared->ntablespaces < 0 ||
+			len < add_size(offsetof(ParallelBackupShared, tablespaces),
+						   mul_size(shared->ntablespaces,
+									sizeof(ParallelBackupTablespace))))
+		{
+			dsm_detach(seg);
+			seg = NULL;
+		}
+	}
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("parallel base backup \"%s\" does not exist",
+						opt->join_backup)));
+
+	if (shared->leader_role != GetUserId())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be the role that started parallel base backup \"%s\" to join it",
+						opt->join_backup)));
+
+	return seg;
+}
+
+/*
+ * on_dsm_detach callback for the leader of a parallel backup: stop
+ * advertising the backup, so that no more workers can find it.
+ */
+static void
+parallel_backup_leader_detach(dsm_segment *seg, Datum arg)
+{
+	WalSnd	   *walsnd = MyWalSnd;
+
+	if (walsnd == NULL)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->parallelBackupHandle = DSM_HANDLE_INVALID;
+	SpinLockRelease(&walsnd->mutex);
+}
+
+/*
+ * on_dsm_detach callback for a parallel backup worker: if we're leaving
+ * before our tablespace has been sent completely, let the leader know that
+ * the backup has failed.
+ */
+static void
+parallel_backup_worker_detach(dsm_segment *seg, Datum arg)
+{
+	ParallelBackupShared *shared = dsm_segment_address(seg);
+	ParallelBackupTablespace *pbt = (ParallelBackupTablespace *) DatumGetPointer(arg);
+
+	SpinLockAcquire(&shared->mutex);
+	if (pbt->state == PB_TABLESPACE_SENDING)
+		pbt->state = PB_TABLESPACE_FAILED;
+	SpinLockRelease(&shared->mutex);
+	ConditionVariableBroadcast(&shared->cv);
+}
+
+/*
+ * Set up the shared state of a parallel backup, listing every tablespace
+ * other than the main data directory as waiting for a worker.
+ */
+static ParallelBackupShared *
+InitializeParallelBackup(basebackup_options *opt, TimeLineID starttli,
+						 List *tablespaces, dsm_segment **segp)
+{
+	ParallelBackupShared *shared;
+	dsm_segment *seg;
+	ListCell   *lc;
+	int			ntablespaces = 0;
+
+	foreach(lc, tablespaces)
+	{
+		if (((tablespaceinfo *) lfirst(lc))->path != NULL)
+			ntablespaces++;
+	}
+
+	seg = dsm_create(add_size(offsetof(ParallelBackupShared, tablespaces),
+							  mul_size(ntablespaces,
+									   sizeof(ParallelBackupTablespace))),
+					 0);
+	shared = dsm_segment_address(seg);
+
+	shared->magic = PARALLEL_BACKUP_MAGIC;
+	shared->version = PARALLEL_BACKUP_VERSION;
+	if (!pg_strong_random(shared->id, PARALLEL_BACKUP_ID_LEN))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("could not generate random parallel base backup ID")));
+	shared->leader_role = GetUserId();
+	SpinLockInit(&shared->mutex);
+	ConditionVariableInit(&shared->cv);
+	if (opt->manifest != MANIFEST_OPTION_NO)
+		SharedFileSetInit(&shared->fileset, seg);
+	shared->startptr = startptr;
+	shared->starttli = starttli;
+	shared->started_in_recovery = backup_started_in_recovery;
+	shared->noverify_checksums = noverify_checksums;
+	shared->incremental_lsn = opt->incremental_lsn;
+	shared->maxrate = opt->maxrate;
+	shared->compression = opt->compression;
+	shared->compression_level = opt->compression_level;
+	shared->manifest = opt->manifest;
+	shared->manifest_checksum_type = opt->manifest_checksum_type;
+	shared->checksum_failures = 0;
+	shared->ntablespaces = 0;
+
+	foreach(lc, tablespaces)
+	{
+		tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
+		ParallelBackupTablespace *pbt;
+
+		if (ti->path == NULL)
+			continue;
+		pbt = &shared->tablespaces[shared->ntablespaces++];
+		pbt->oid = atooid(ti->oid);
+		strlcpy(pbt->path, ti->path, sizeof(pbt->path));
+		pbt->state = PB_TABLESPACE_PENDING;
+	}
+
+	/* Everything's in place; let workers find the backup. */
+	on_dsm_detach(seg, parallel_backup_leader_detach, (Datum) 0);
+	SpinLockAcquire(&MyWalSnd->mutex);
+	MyWalSnd->parallelBackupHandle = dsm_segment_handle(seg);
+	memcpy(MyWalSnd->parallelBackupId, shared->id, PARALLEL_BACKUP_ID_LEN);
+	SpinLockRelease(&MyWalSnd->mutex);
+
+	*segp = seg;
+	return shared;
+}
+
+/*
+ * Wait until the workers of a parallel backup have sent every tablespace,
+ * then merge their manifest entries into ours.
+ *
+ * If tablespaces remain unclaimed while no worker has been sending anything
+ * for wal_sender_timeout, we take it to mean that the client has failed.
+ */
+static void
+WaitForParallelBackupWorkers(ParallelBackupShared *shared,
+							 backup_manifest_info *manifest)
+{
+	TimestampTz wait_start = GetCurrentTimestamp();
+	int			i;
+
+	for (;;)
+	{
+		int			npending = 0;
+		int			nsending = 0;
+		Oid			failed = InvalidOid;
+		Oid			pending = InvalidOid;
+
+		SpinLockAcquire(&shared->mutex);
+		for (i = 0; i < shared->ntablespaces; i++)
+		{
+			switch (shared->tablespaces[i].state)
+			{
+				case PB_TABLESPACE_PENDING:
+					npending++;
+					pending = shared->tablespaces[i].oid;
+					break;
+				case PB_TABLESPACE_SENDING:
+					nsending++;
+					break;
+				case PB_TABLESPACE_DONE:
+					break;
+				case PB_TABLESPACE_FAILED:
+					failed = shared->tablespaces[i].oid;
+					break;
+			}
+		}
+		SpinLockRelease(&shared->mutex);
+
+		if (OidIsValid(failed))
+			ereport(ERROR,
+					(errmsg("parallel base backup worker failed while sending tablespace %u",
+							failed)));
+		if (npending == 0 && nsending == 0)
+			break;
+		if (nsending > 0)
+			wait_start = GetCurrentTimestamp();
+		else if (wal_sender_timeout > 0 &&
+				 TimestampDifferenceExceeds(wait_start, GetCurrentTimestamp(),
+											wal_sender_timeout))
+			ereport(ERROR,
+					(errmsg("timed out waiting for a parallel base backup worker to send tablespace %u",
+							pending)));
+
+		(void) ConditionVariableTimedSleep(&shared->cv, 1000L,
+										   WAIT_EVENT_BASEBACKUP_WORKERS);
+	}
+	ConditionVariableCancelSleep();
+
+	total_checksum_failures += shared->checksum_failures;
+
+	if (shared->manifest == MANIFEST_OPTION_NO)
+		return;
+
+	for (i = 0; i < shared->ntablespaces; i++)
+	{
+		char		name[MAXPGPATH];
+		BufFile    *fragment;
+
+		snprintf(name, sizeof(name), "manifest.%u", shared->tablespaces[i].oid);
+		fragment = BufFileOpenShared(&shared->fileset, name, O_RDONLY);
+		AppendBackupManifestFragment(manifest, fragment);
+		BufFileClose(fragment);
+	}
+}
+
 /*
  * list_sort comparison function, to compare log/seg portion of WAL segment
  * filenames, ignoring the timeline portion.
@@ -755,6 +1337,81 @@ compareWalFileNames(const ListCell *a, const ListCell *b)
 	return strcmp(fna + 8, fnb + 8);
 }
 
+/*
+ * Load the blocks modified on timeline tli between start_lsn and end_lsn
+ * from the WAL summaries, which must cover that whole range.
+ */
+static BlockRefTable *
+LoadIncrementalBlockRefTable(TimeLineID tli, XLogRecPtr start_lsn,
+							 XLogRecPtr end_lsn)
+{
+	BlockRefTable *brtab;
+	List	   *wslist;
+	ListCell   *lc;
+	XLogRecPtr	missing_lsn;
+
+	wslist = GetWalSummaries(tli, start_lsn, end_lsn);
+	missing_lsn = WalSummariesCoverRange(wslist, start_lsn, end_lsn);
+	if (!XLogRecPtrIsInvalid(missing_lsn))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("WAL summaries are required on timeline %u from %X/%X to %X/%X, but there is no summary for %X/%X",
+						tli,
+						(uint32) (start_lsn >> 32), (uint32) start_lsn,
+						(uint32) (end_lsn >> 32), (uint32) end_lsn,
+						(uint32) (missing_lsn >> 32), (uint32) missing_lsn),
+				 errhint("Take a full backup instead.")));
+
+	brtab = CreateBlockRefTable();
+	foreach(lc, wslist)
+		ReadWalSummary((WalSummaryFile *) lfirst(lc), brtab);
+
+	return brtab;
+}
+
+/*
+ * Set up an incremental backup relative to the backup that started at
+ * opt->incremental_lsn: check that WAL summaries cover everything from
+ * there to the start of this backup, load them, and record the prior
+ * backup in the backup_label.
+ */
+static void
+PrepareIncrementalBackup(basebackup_options *opt, TimeLineID starttli,
+						 StringInfo labelfile)
+{
+	if (backup_started_in_recovery)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("incremental backups cannot be taken during recovery")));
+
+	if (opt->incremental_tli != starttli)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("prior backup is on timeline %u, but this backup starts on timeline %u",
+						opt->incremental_tli, starttli),
+				 errdetail("Incremental backups across timeline switches are not supported.")));
+
+	if (opt->incremental_lsn > startptr)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("prior backup starts at %X/%X, after the start of this backup at %X/%X",
+						(uint32) (opt->incremental_lsn >> 32),
+						(uint32) opt->incremental_lsn,
+						(uint32) (startptr >> 32), (uint32) startptr)));
+
+	WaitForWalSummarization(starttli, startptr);
+
+	incremental_brtab = LoadIncrementalBlockRefTable(starttli,
+													 opt->incremental_lsn,
+													 startptr);
+
+	appendStringInfo(labelfile, INCREMENTAL_LSN_LABEL "%X/%X\n",
+					 (uint32) (opt->incremental_lsn >> 32),
+					 (uint32) opt->incremental_lsn);
+	appendStringInfo(labelfile, INCREMENTAL_TLI_LABEL "%u\n",
+					 opt->incremental_tli);
+}
+
 /*
  * Parse the base backup options passed down by the parser
  */
@@ -772,10 +1429,19 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 	bool		o_noverify_checksums = false;
 	bool		o_manifest = false;
 	bool		o_manifest_checksums = false;
+	bool		o_incremental = false;
+	bool		o_timeline = false;
+	bool		o_compression = false;
+	bool		o_compression_level = false;
+	bool		o_parallel = false;
+	bool		o_join = false;
+	bool		o_tablespace = false;
 
 	MemSet(opt, 0, sizeof(*opt));
 	opt->manifest = MANIFEST_OPTION_NO;
 	opt->manifest_checksum_type = CHECKSUM_TYPE_CRC32C;
+	opt->compression = BACKUP_COMPRESSION_NONE;
+	opt->compression_level = -1;	/* library default */
 
 	foreach(lopt, options)
 	{
@@ -900,14 +1566,181 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 										&opt->manifest_checksum_type))
 				ereport(ERROR,
 						(errcode(ERRCODE_SYNTAX_ERROR),
-						 errmsg("unrecognized checksum algorithm: \"%s\"",
-								optval)));
-			o_manifest_checksums = true;
+						 errmsg("unrecognized checksum algorithm: \"%s\"",
+								optval)));
+			o_manifest_checksums = true;
+		}
+		else if (strcmp(defel->defname, "incremental") == 0)
+		{
+			char	   *optval = strVal(defel->arg);
+			uint32		hi,
+						lo;
+
+			if (o_incremental)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			if (sscanf(optval, "%X/%X", &hi, &lo) != 2 ||
+				(hi == 0 && lo == 0))
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("invalid prior backup start location: \"%s\"",
+								optval)));
+			opt->incremental_lsn = ((uint64) hi) << 32 | lo;
+			o_incremental = true;
+		}
+		else if (strcmp(defel->defname, "timeline") == 0)
+		{
+			if (o_timeline)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->incremental_tli = intVal(defel->arg);
+			if (opt->incremental_tli == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("invalid timeline %u", opt->incremental_tli)));
+			o_timeline = true;
+		}
+		else if (strcmp(defel->defname, "compression") == 0)
+		{
+			char	   *optval = strVal(defel->arg);
+
+			if (o_compression)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			if (pg_strcasecmp(optval, "none") == 0)
+				opt->compression = BACKUP_COMPRESSION_NONE;
+			else if (pg_strcasecmp(optval, "gzip") == 0)
+			{
+#ifdef HAVE_LIBZ
+				opt->compression = BACKUP_COMPRESSION_GZIP;
+#else
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("gzip compression is not supported by this build")));
+#endif
+			}
+			else if (pg_strcasecmp(optval, "lz4") == 0)
+			{
+#ifdef USE_LZ4
+				opt->compression = BACKUP_COMPRESSION_LZ4;
+#else
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("LZ4 compression is not supported by this build")));
+#endif
+			}
+			else if (pg_strcasecmp(optval, "zstd") == 0)
+			{
+#ifdef USE_ZSTD
+				opt->compression = BACKUP_COMPRESSION_ZSTD;
+#else
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("zstd compression is not supported by this build")));
+#endif
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("unrecognized compression method: \"%s\"",
+								optval)));
+			o_compression = true;
+		}
+		else if (strcmp(defel->defname, "compression_level") == 0)
+		{
+			if (o_compression_level)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->compression_level = intVal(defel->arg);
+			o_compression_level = true;
+		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			if (o_parallel)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->parallel = true;
+			o_parallel = true;
+		}
+		else if (strcmp(defel->defname, "join") == 0)
+		{
+			if (o_join)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->join = true;
+			opt->join_backup = strVal(defel->arg);
+			if (strlen(opt->join_backup) != 2 * PARALLEL_BACKUP_ID_LEN ||
+				strspn(opt->join_backup, "0123456789abcdefABCDEF") !=
+				2 * PARALLEL_BACKUP_ID_LEN)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid parallel base backup ID \"%s\"",
+								opt->join_backup)));
+			hex_decode(opt->join_backup, 2 * PARALLEL_BACKUP_ID_LEN,
+					   opt->join_id);
+			o_join = true;
+		}
+		else if (strcmp(defel->defname, "tablespace") == 0)
+		{
+			if (o_tablespace)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->join_tablespace = (Oid) intVal(defel->arg);
+			o_tablespace = true;
 		}
 		else
 			elog(ERROR, "option \"%s\" not recognized",
 				 defel->defname);
 	}
+	if (o_incremental != o_timeline)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("INCREMENTAL and TIMELINE must be specified together")));
+	if (o_compression_level)
+	{
+		int			max_level = 0;
+
+		switch (opt->compression)
+		{
+			case BACKUP_COMPRESSION_NONE:
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("COMPRESSION_LEVEL requires COMPRESSION")));
+				break;
+			case BACKUP_COMPRESSION_GZIP:
+				max_level = 9;
+				break;
+			case BACKUP_COMPRESSION_LZ4:
+				max_level = 12;
+				break;
+			case BACKUP_COMPRESSION_ZSTD:
+				max_level = 22;
+				break;
+		}
+		if (opt->compression_level < 1 || opt->compression_level > max_level)
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("%d is outside the valid range for parameter \"%s\" (%d .. %d)",
+							opt->compression_level, "COMPRESSION_LEVEL",
+							1, max_level)));
+	}
+	if (o_join != o_tablespace)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("JOIN and TABLESPACE must be specified together")));
+
+	/* A worker takes all its settings from the backup it joins. */
+	if (o_join && list_length(options) != 2)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("JOIN cannot be combined with options other than TABLESPACE")));
 	if (opt->label == NULL)
 		opt->label = "base backup";
 	if (opt->manifest == MANIFEST_OPTION_NO)
@@ -941,12 +1774,55 @@ SendBaseBackup(BaseBackupCmd *cmd)
 	{
 		char		activitymsg[50];
 
-		snprintf(activitymsg, sizeof(activitymsg), "sending backup \"%s\"",
-				 opt.label);
+		if (opt.join)
+			snprintf(activitymsg, sizeof(activitymsg),
+					 "sending tablespace %u of parallel backup",
+					 opt.join_tablespace);
+		else
+			snprintf(activitymsg, sizeof(activitymsg), "sending backup \"%s\"",
+					 opt.label);
 		set_ps_display(activitymsg);
 	}
 
-	perform_base_backup(&opt);
+	if (opt.join)
+		perform_base_backup_worker(&opt);
+	else
+		perform_base_backup(&opt);
+}
+
+/*
+ * Send a single-row result set carrying the ID of a parallel backup, which
+ * its workers pass to BASE_BACKUP JOIN.
+ */
+static void
+SendParallelBackupId(ParallelBackupShared *shared)
+{
+	StringInfoData buf;
+	char		str[2 * PARALLEL_BACKUP_ID_LEN];
+	Size		len;
+
+	pq_beginmessage(&buf, 'T'); /* RowDescription */
+	pq_sendint16(&buf, 1);		/* 1 field */
+
+	pq_sendstring(&buf, "backup_id");
+	pq_sendint32(&buf, 0);		/* table oid */
+	pq_sendint16(&buf, 0);		/* attnum */
+	pq_sendint32(&buf, TEXTOID);	/* type oid */
+	pq_sendint16(&buf, -1);
+	pq_sendint32(&buf, 0);
+	pq_sendint16(&buf, 0);
+	pq_endmessage(&buf);
+
+	/* Data row */
+	pq_beginmessage(&buf, 'D');
+	pq_sendint16(&buf, 1);		/* number of columns */
+	len = hex_encode(shared->id, PARALLEL_BACKUP_ID_LEN, str);
+	pq_sendint32(&buf, len);
+	pq_sendbytes(&buf, str, len);
+	pq_endmessage(&buf);
+
+	/* Send a CommandComplete message */
+	pq_puttextmessage('C', "SELECT");
 }
 
 static void
@@ -1125,7 +2001,7 @@ sendFileWithContent(const char *filename, const char *content,
 
 	_tarWriteHeader(filename, NULL, &statbuf, false);
 	/* Send the contents as a CopyData message */
-	pq_putmessage('d', content, len);
+	send_archive_data(content, len);
 	update_basebackup_progress(len);
 
 	/* Pad to a multiple of the tar block size. */
@@ -1135,7 +2011,7 @@ sendFileWithContent(const char *filename, const char *content,
 		char		buf[TAR_BLOCK_SIZE];
 
 		MemSet(buf, 0, pad);
-		pq_putmessage('d', buf, pad);
+		send_archive_data(buf, pad);
 		update_basebackup_progress(pad);
 	}
 
@@ -1496,11 +2372,25 @@ sendDir(const char *path, int basepathlen, bool sizeonly, List *tablespaces,
 		else if (S_ISREG(statbuf.st_mode))
 		{
 			bool		sent = false;
+			Oid			dboid = isDbDir ? atooid(lastDir + 1) : InvalidOid;
+			RelFileNode rnode;
+			ForkNumber	forknum;
+			unsigned	segno;
 
 			if (!sizeonly)
-				sent = sendFile(pathbuf, pathbuf + basepathlen + 1, &statbuf,
-								true, isDbDir ? atooid(lastDir + 1) : InvalidOid,
-								manifest, spcoid);
+			{
+				if (incremental_brtab != NULL &&
+					get_relation_file_identity(path, de->d_name, isDbDir,
+											   spcoid, &rnode, &forknum,
+											   &segno))
+					sent = sendIncrementalFile(pathbuf,
+											   pathbuf + basepathlen + 1,
+											   &statbuf, &rnode, forknum,
+											   segno, dboid, manifest, spcoid);
+				else
+					sent = sendFile(pathbuf, pathbuf + basepathlen + 1,
+									&statbuf, true, dboid, manifest, spcoid);
+			}
 
 			if (sent || sizeonly)
 			{
@@ -1556,6 +2446,47 @@ is_checksummed_file(const char *fullpath, const char *filename)
 		return false;
 }
 
+/*
+ * If 'filename' in directory 'path' is a relation segment that can be sent
+ * incrementally, identify it and return true.
+ *
+ * Free space map and visibility map forks are always sent in full; see
+ * SummarizeRecord().
+ */
+static bool
+get_relation_file_identity(const char *path, const char *filename,
+						   bool isDbDir, const char *spcoid,
+						   RelFileNode *rnode, ForkNumber *forknum,
+						   unsigned *segno)
+{
+	int			oidchars;
+	const char *segstr;
+
+	if (!parse_filename_for_nontemp_relation(filename, &oidchars, forknum))
+		return false;
+	if (*forknum == FSM_FORKNUM || *forknum == VISIBILITYMAP_FORKNUM)
+		return false;
+
+	if (isDbDir)
+	{
+		rnode->spcNode = spcoid != NULL ? atooid(spcoid) : DEFAULTTABLESPACE_OID;
+		rnode->dbNode = atooid(last_dir_separator(path) + 1);
+	}
+	else if (strcmp(path, "./global") == 0)
+	{
+		rnode->spcNode = GLOBALTABLESPACE_OID;
+		rnode->dbNode = InvalidOid;
+	}
+	else
+		return false;
+
+	rnode->relNode = atooid(filename);
+	segstr = strchr(filename, '.');
+	*segno = segstr != NULL ? atoi(segstr + 1) : 0;
+
+	return true;
+}
+
 /*****
  * Functions for handling tar file format
  *
@@ -1563,6 +2494,315 @@ is_checksummed_file(const char *fullpath, const char *filename)
  */
 
 
+#ifdef HAVE_LIBZ
+/* Allocation callbacks, so that zlib's memory goes away with our context */
+static void *
+gzip_palloc(void *opaque, unsigned items, unsigned size)
+{
+	return palloc((Size) items * size);
+}
+
+static void
+gzip_pfree(void *opaque, void *address)
+{
+	pfree(address);
+}
+
+/*
+ * Feed the pending input of archive_zstream to the compressor, sending
+ * whatever comes out.
+ */
+static void
+compress_archive_data(int flush)
+{
+	do
+	{
+		archive_zstream->next_out = (Bytef *) archive_zbuf;
+		archive_zstream->avail_out = ARCHIVE_ZBUF_SIZE;
+		if (deflate(archive_zstream, flush) == Z_STREAM_ERROR)
+			ereport(ERROR,
+					(errmsg("could not compress data: %s",
+							archive_zstream->msg ? archive_zstream->msg :
+							"unknown error")));
+		put_archive_data(archive_zbuf,
+						 ARCHIVE_ZBUF_SIZE - archive_zstream->avail_out);
+	} while (archive_zstream->avail_out == 0);
+}
+#endif
+
+/*
+ * Start sending a tar stream: send a CopyOutResponse message and, if
+ * compressing, set up the compressor.
+ */
+static void
+begin_archive(void)
+{
+	StringInfoData buf;
+
+	/* Send CopyOutResponse message */
+	pq_beginmessage(&buf, 'H');
+	pq_sendbyte(&buf, 0);		/* overall format */
+	pq_sendint16(&buf, 0);		/* natts */
+	pq_endmessage(&buf);
+
+	/*
+	 * Forget any compressor left behind by a backup that failed halfway.  Its
+	 * palloc'd memory went away with the replication command's memory
+	 * context, but the LZ4 and zstd libraries allocate theirs with malloc.
+	 */
+#ifdef HAVE_LIBZ
+	archive_zstream = NULL;
+	archive_zbuf = NULL;
+#endif
+#ifdef USE_LZ4
+	if (archive_lz4ctx != NULL)
+		LZ4F_freeCompressionContext(archive_lz4ctx);
+	archive_lz4ctx = NULL;
+	archive_lz4buf = NULL;
+#endif
+#ifdef USE_ZSTD
+	if (archive_zstdctx != NULL)
+		ZSTD_freeCCtx(archive_zstdctx);
+	archive_zstdctx = NULL;
+	archive_zstdbuf = NULL;
+#endif
+
+#ifdef HAVE_LIBZ
+	if (archive_compression == BACKUP_COMPRESSION_GZIP)
+	{
+		archive_zstream = palloc0(sizeof(z_stream));
+		archive_zstream->zalloc = gzip_palloc;
+		archive_zstream->zfree = gzip_pfree;
+		archive_zbuf = palloc(ARCHIVE_ZBUF_SIZE);
+
+		/*
+		 * Adding 16 to the window bits asks for a gzip header and trailer,
+		 * so that the stream can be stored as-is in a .tar.gz file.  A level
+		 * of -1 is Z_DEFAULT_COMPRESSION.
+		 */
+		if (deflateInit2(archive_zstream, archive_compression_level,
+						 Z_DEFLATED, MAX_WBITS + 16, 8,
+						 Z_DEFAULT_STRATEGY) != Z_OK)
+			ereport(ERROR,
+					(errmsg("could not initialize compression library: %s",
+							archive_zstream->msg ? archive_zstream->msg :
+							"unknown error")));
+	}
+#endif
+
+#ifdef USE_LZ4
+	if (archive_compression == BACKUP_COMPRESSION_LZ4)
+	{
+		LZ4F_preferences_t prefs;
+		size_t		len;
+
+		/* A level of 0 is LZ4's default */
+		memset(&prefs, 0, sizeof(prefs));
+		prefs.compressionLevel = Max(archive_compression_level, 0);
+
+		len = LZ4F_createCompressionContext(&archive_lz4ctx, LZ4F_VERSION);
+		if (LZ4F_isError(len))
+			ereport(ERROR,
+					(errmsg("could not initialize compression library: %s",
+							LZ4F_getErrorName(len))));
+
+		/* Room for the frame header, or the output of any one chunk */
+		archive_lz4bufsize = Max(LZ4F_compressBound(ARCHIVE_LZ4_CHUNK, &prefs),
+								 LZ4F_HEADER_SIZE_MAX);
+		archive_lz4buf = palloc(archive_lz4bufsize);
+
+		len = LZ4F_compressBegin(archive_lz4ctx, archive_lz4buf,
+								 archive_lz4bufsize, &prefs);
+		if (LZ4F_isError(len))
+			ereport(ERROR,
+					(errmsg("could not compress data: %s",
+							LZ4F_getErrorName(len))));
+		put_archive_data(archive_lz4buf, len);
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (archive_compression == BACKUP_COMPRESSION_ZSTD)
+	{
+		archive_zstdctx = ZSTD_createCCtx();
+		if (archive_zstdctx == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+		if (archive_compression_level > 0)
+		{
+			size_t		ret;
+
+			ret = ZSTD_CCtx_setParameter(archive_zstdctx,
+										 ZSTD_c_compressionLevel,
+										 archive_compression_level);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						(errmsg("could not set compression level %d: %s",
+								archive_compression_level,
+								ZSTD_getErrorName(ret))));
+		}
+		archive_zstdbufsize = ZSTD_CStreamOutSize();
+		archive_zstdbuf = palloc(archive_zstdbufsize);
+	}
+#endif
+}
+
+/*
+ * Send data into the current tar stream, compressing it if requested.
+ */
+static void
+send_archive_data(const char *data, size_t len)
+{
+#ifdef HAVE_LIBZ
+	if (archive_zstream != NULL)
+	{
+		archive_zstream->next_in = (Bytef *) data;
+		archive_zstream->avail_in = len;
+		compress_archive_data(Z_NO_FLUSH);
+		return;
+	}
+#endif
+
+#ifdef USE_LZ4
+	if (archive_lz4ctx != NULL)
+	{
+		while (len > 0)
+		{
+			size_t		chunk = Min(len, ARCHIVE_LZ4_CHUNK);
+			size_t		out;
+
+			out = LZ4F_compressUpdate(archive_lz4ctx,
+									  archive_lz4buf, archive_lz4bufsize,
+									  data, chunk, NULL);
+			if (LZ4F_isError(out))
+				ereport(ERROR,
+						(errmsg("could not compress data: %s",
+								LZ4F_getErrorName(out))));
+			put_archive_data(archive_lz4buf, out);
+			data += chunk;
+			len -= chunk;
+		}
+		return;
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (archive_zstdctx != NULL)
+	{
+		ZSTD_inBuffer in = {data, len, 0};
+
+		while (in.pos < in.size)
+		{
+			ZSTD_outBuffer out = {archive_zstdbuf, archive_zstdbufsize, 0};
+			size_t		ret;
+
+			ret = ZSTD_compressStream2(archive_zstdctx, &out, &in,
+									   ZSTD_e_continue);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						(errmsg("could not compress data: %s",
+								ZSTD_getErrorName(ret))));
+			put_archive_data(archive_zstdbuf, out.pos);
+		}
+		return;
+	}
+#endif
+
+	put_archive_data(data, len);
+}
+
+/*
+ * Send data, compressed or not, as a CopyData message.
+ */
+static void
+put_archive_data(const char *data, size_t len)
+{
+	if (len > 0 && pq_putmessage('d', data, len))
+		ereport(ERROR,
+				(errmsg("base backup could not send data, aborting backup")));
+}
+
+/*
+ * Finish the current tar stream and send CopyDone.
+ *
+ * An uncompressed stream ends without the two empty blocks that terminate
+ * a tar archive; the client adds them.  It can't do that to a compressed
+ * stream, so in that case we add them ourselves.
+ */
+static void
+end_archive(void)
+{
+	if (archive_compression != BACKUP_COMPRESSION_NONE)
+	{
+		char		zerobuf[2 * TAR_BLOCK_SIZE];
+
+		MemSet(zerobuf, 0, sizeof(zerobuf));
+		send_archive_data(zerobuf, sizeof(zerobuf));
+	}
+
+#ifdef HAVE_LIBZ
+	if (archive_zstream != NULL)
+	{
+		compress_archive_data(Z_FINISH);
+		deflateEnd(archive_zstream);
+
+		pfree(archive_zstream);
+		pfree(archive_zbuf);
+		archive_zstream = NULL;
+		archive_zbuf = NULL;
+	}
+#endif
+
+#ifdef USE_LZ4
+	if (archive_lz4ctx != NULL)
+	{
+		size_t		out;
+
+		out = LZ4F_compressEnd(archive_lz4ctx,
+							   archive_lz4buf, archive_lz4bufsize, NULL);
+		if (LZ4F_isError(out))
+			ereport(ERROR,
+					(errmsg("could not compress data: %s",
+							LZ4F_getErrorName(out))));
+		put_archive_data(archive_lz4buf, out);
+		LZ4F_freeCompressionContext(archive_lz4ctx);
+
+		pfree(archive_lz4buf);
+		archive_lz4ctx = NULL;
+		archive_lz4buf = NULL;
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (archive_zstdctx != NULL)
+	{
+		ZSTD_inBuffer in = {NULL, 0, 0};
+		size_t		ret;
+
+		do
+		{
+			ZSTD_outBuffer out = {archive_zstdbuf, archive_zstdbufsize, 0};
+
+			ret = ZSTD_compressStream2(archive_zstdctx, &out, &in,
+									   ZSTD_e_end);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						(errmsg("could not compress data: %s",
+								ZSTD_getErrorName(ret))));
+			put_archive_data(archive_zstdbuf, out.pos);
+		} while (ret != 0);
+		ZSTD_freeCCtx(archive_zstdctx);
+
+		pfree(archive_zstdbuf);
+		archive_zstdctx = NULL;
+		archive_zstdbuf = NULL;
+	}
+#endif
+
+	pq_putemptymessage('c');	/* CopyDone */
+}
+
 /*
  * Given the member, write the TAR header & send the file.
  *
@@ -1765,10 +3005,8 @@ sendFile(const char *readfilename, const char *tarfilename,
 			}
 		}
 
-		/* Send the chunk as a CopyData message */
-		if (pq_putmessage('d', buf, cnt))
-			ereport(ERROR,
-					(errmsg("base backup could not send data, aborting backup")));
+		/* Send the chunk into the tar stream */
+		send_archive_data(buf, cnt);
 		update_basebackup_progress(cnt);
 
 		/* Also feed it to the checksum machinery. */
@@ -1786,7 +3024,7 @@ sendFile(const char *readfilename, const char *tarfilename,
 		while (len < statbuf->st_size)
 		{
 			cnt = Min(sizeof(buf), statbuf->st_size - len);
-			pq_putmessage('d', buf, cnt);
+			send_archive_data(buf, cnt);
 			if (pg_checksum_update(&checksum_ctx, (uint8 *) buf, cnt) < 0)
 				elog(ERROR, "could not update checksum of base backup");
 			update_basebackup_progress(cnt);
@@ -1804,7 +3042,7 @@ sendFile(const char *readfilename, const char *tarfilename,
 	if (pad > 0)
 	{
 		MemSet(buf, 0, pad);
-		pq_putmessage('d', buf, pad);
+		send_archive_data(buf, pad);
 		update_basebackup_progress(pad);
 	}
 
@@ -1830,6 +3068,155 @@ sendFile(const char *readfilename, const char *tarfilename,
 }
 
 
+/*
+ * Send a relation segment as part of an incremental backup.
+ *
+ * Unless most of the segment has changed since the prior backup, we send an
+ * INCREMENTAL file holding only the modified blocks (see
+ * replication/incremental.h); otherwise we fall back to sendFile().  The
+ * return value is as for sendFile(), with missing_ok always true.
+ */
+static bool
+sendIncrementalFile(const char *readfilename, const char *tarfilename,
+					struct stat *statbuf, const RelFileNode *rnode,
+					ForkNumber forknum, unsigned segno, Oid dboid,
+					backup_manifest_info *manifest, const char *spcoid)
+{
+	int			fd;
+	char		buf[TAR_SEND_SIZE];
+	char		incrname[MAXPGPATH];
+	const char *basename;
+	struct stat incrstat;
+	IncrementalFileHeader hdr;
+	BlockNumber file_blocks;
+	BlockNumber start_blkno;
+	BlockNumber *blocks;
+	int			nblocks;
+	int			i;
+	size_t		pad;
+	pg_checksum_context checksum_ctx;
+
+	/* A partial block at the end means we can't reason about this file. */
+	if (statbuf->st_size % BLCKSZ != 0)
+		return sendFile(readfilename, tarfilename, statbuf, true, dboid,
+						manifest, spcoid);
+
+	file_blocks = statbuf->st_size / BLCKSZ;
+	start_blkno = segno * RELSEG_SIZE;
+	blocks = palloc(sizeof(BlockNumber) * Max(file_blocks, 1));
+	nblocks = BlockRefTableGetModifiedBlocks(incremental_brtab, rnode, forknum,
+											 start_blkno,
+											 start_blkno + file_blocks,
+											 blocks);
+	if (nblocks > file_blocks * INCREMENTAL_MAX_CHANGED_FRACTION)
+	{
+		pfree(blocks);
+		return sendFile(readfilename, tarfilename, statbuf, true, dboid,
+						manifest, spcoid);
+	}
+
+	fd = OpenTransientFile(readfilename, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		if (errno == ENOENT)
+		{
+			pfree(blocks);
+			return false;
+		}
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", readfilename)));
+	}
+
+	if (pg_checksum_init(&checksum_ctx, manifest->checksum_type) < 0)
+		elog(ERROR, "could not initialize checksum of file \"%s\"",
+			 readfilename);
+
+	/* Block numbers in the file are relative to the start of the segment. */
+	for (i = 0; i < nblocks; i++)
+		blocks[i] -= start_blkno;
+
+	basename = last_dir_separator(tarfilename);
+	if (basename == NULL)
+		snprintf(incrname, sizeof(incrname), "%s%s", INCREMENTAL_PREFIX,
+				 tarfilename);
+	else
+		snprintf(incrname, sizeof(incrname), "%.*s/%s%s",
+				 (int) (basename - tarfilename), tarfilename,
+				 INCREMENTAL_PREFIX, basename + 1);
+
+	hdr.magic = INCREMENTAL_MAGIC;
+	hdr.num_blocks = nblocks;
+	hdr.truncation_block_length = file_blocks;
+
+	incrstat = *statbuf;
+	incrstat.st_size = sizeof(hdr) + sizeof(BlockNumber) * nblocks +
+		(off_t) BLCKSZ * nblocks;
+	_tarWriteHeader(incrname, NULL, &incrstat, false);
+
+	/* Send the header and the block numbers ... */
+	send_archive_data((char *) &hdr, sizeof(hdr));
+	if (pg_checksum_update(&checksum_ctx, (uint8 *) &hdr, sizeof(hdr)) < 0)
+		elog(ERROR, "could not update checksum of base backup");
+	update_basebackup_progress(sizeof(hdr));
+	if (nblocks > 0)
+	{
+		send_archive_data((char *) blocks, sizeof(BlockNumber) * nblocks);
+		if (pg_checksum_update(&checksum_ctx, (uint8 *) blocks,
+							   sizeof(BlockNumber) * nblocks) < 0)
+			elog(ERROR, "could not update checksum of base backup");
+		update_basebackup_progress(sizeof(BlockNumber) * nblocks);
+	}
+
+	/* ... then the blocks, reading runs of consecutive blocks at once. */
+	for (i = 0; i < nblocks;)
+	{
+		int			run = 1;
+		size_t		len;
+		int			cnt;
+
+		while (i + run < nblocks && run < TAR_SEND_SIZE / BLCKSZ &&
+			   blocks[i + run] == blocks[i] + run)
+			run++;
+		len = (size_t) run * BLCKSZ;
+
+		cnt = basebackup_read_file(fd, buf, len, (off_t) blocks[i] * BLCKSZ,
+								   readfilename, true);
+
+		/*
+		 * If the file was truncated concurrently, pad with zeros; WAL replay
+		 * will fix things up.
+		 */
+		if (cnt < len)
+			MemSet(buf + cnt, 0, len - cnt);
+
+		send_archive_data(buf, len);
+		update_basebackup_progress(len);
+		if (pg_checksum_update(&checksum_ctx, (uint8 *) buf, len) < 0)
+			elog(ERROR, "could not update checksum of base backup");
+		throttle(len);
+
+		i += run;
+	}
+
+	/* Pad to a block boundary, per tar format requirements. */
+	pad = tarPaddingBytesRequired(incrstat.st_size);
+	if (pad > 0)
+	{
+		MemSet(buf, 0, pad);
+		send_archive_data(buf, pad);
+		update_basebackup_progress(pad);
+	}
+
+	CloseTransientFile(fd);
+	pfree(blocks);
+
+	AddFileToBackupManifest(manifest, spcoid, incrname, incrstat.st_size,
+							(pg_time_t) incrstat.st_mtime, &checksum_ctx);
+
+	return true;
+}
+
 static int64
 _tarWriteHeader(const char *filename, const char *linktarget,
 				struct stat *statbuf, bool sizeonly)
@@ -1862,7 +3249,7 @@ _tarWriteHeader(const char *filename, const char *linktarget,
 				elog(ERROR, "unrecognized tar error: %d", rc);
 		}
 
-		pq_putmessage('d', h, sizeof(h));
+		send_archive_data(h, sizeof(h));
 		update_basebackup_progress(sizeof(h));
 	}
 
@@ -89,6 +89,12 @@ static SQLCmd *make_sqlcmd(void);
 %token K_USE_SNAPSHOT
 %token K_MANIFEST
 %token K_MANIFEST_CHECKSUMS
+%token K_INCREMENTAL
+%token K_COMPRESSION
+%token K_COMPRESSION_LEVEL
+%token K_PARALLEL
+%token K_JOIN
+%token K_TABLESPACE
 
 %type <node>	command
 %type <node>	base_backup start_replication start_logical_replication
@@ -158,7 +164,9 @@ var_name:	IDENT	{ $$ = $1; }
 /*
  * BASE_BACKUP [LABEL '<label>'] [PROGRESS] [FAST] [WAL] [NOWAIT]
  * [MAX_RATE %d] [TABLESPACE_MAP] [NOVERIFY_CHECKSUMS]
- * [MANIFEST %s] [MANIFEST_CHECKSUMS %s]
+ * [MANIFEST %s] [MANIFEST_CHECKSUMS %s] [INCREMENTAL %s TIMELINE %d]
+ * [COMPRESSION %s] [COMPRESSION_LEVEL %d] [PARALLEL]
+ * [JOIN %s TABLESPACE %d]
  */
 base_backup:
 			K_BASE_BACKUP base_backup_opt_list
@@ -227,6 +235,41 @@ base_backup_opt:
 				  $$ = makeDefElem("manifest_checksums",
 								   (Node *)makeString($2), -1);
 				}
+			| K_INCREMENTAL SCONST
+				{
+				  $$ = makeDefElem("incremental",
+								   (Node *)makeString($2), -1);
+				}
+			| K_TIMELINE UCONST
+				{
+				  $$ = makeDefElem("timeline",
+								   (Node *)makeInteger($2), -1);
+				}
+			| K_COMPRESSION SCONST
+				{
+				  $$ = makeDefElem("compression",
+								   (Node *)makeString($2), -1);
+				}
+			| K_COMPRESSION_LEVEL UCONST
+				{
+				  $$ = makeDefElem("compression_level",
+								   (Node *)makeInteger($2), -1);
+				}
+			| K_PARALLEL
+				{
+				  $$ = makeDefElem("parallel",
+								   (Node *)makeInteger(true), -1);
+				}
+			| K_JOIN SCONST
+				{
+				  $$ = makeDefElem("join",
+								   (Node *)makeString($2), -1);
+				}
+			| K_TABLESPACE UCONST
+				{
+				  $$ = makeDefElem("tablespace",
+								   (Node *)makeInteger($2), -1);
+				}
 			;
 
 create_replication_slot:
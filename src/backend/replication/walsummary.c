@@ -0,0 +1,692 @@
+/*-------------------------------------------------------------------------
+ *
+ * walsummary.c
+ *	  Track the blocks modified by ranges of WAL, and store them on disk
+ *
+ * A block reference table records, for each relation fork, the blocks that
+ * some range of WAL has modified, plus a "limit block": every block at or
+ * above the limit block is considered modified, because the fork was
+ * created or truncated.  The WAL summarizer builds one table per checkpoint
+ * cycle and writes it out as a WAL summary file; incremental base backups
+ * merge the summaries covering the WAL since the prior backup and send only
+ * the blocks that appear in the result.
+ *
+ * A summary file consists of a WalSummaryFileHeader, then for each relation
+ * fork a WalSummaryEntryHeader followed by its modified blocks as sorted,
+ * non-overlapping WalSummaryRange items, and finally a CRC-32C of everything
+ * before it.
+ *
+ * Portions Copyright (c) 2010-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/walsummary.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pgstat.h"
+#include "port/pg_crc32c.h"
+#include "replication/walsummary.h"
+#include "storage/fd.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#define WAL_SUMMARY_MAGIC		0x57534d59	/* "WSMY" */
+#define WAL_SUMMARY_VERSION		1
+
+typedef struct WalSummaryFileHeader
+{
+	uint32		magic;
+	uint32		version;
+	TimeLineID	tli;
+	uint32		nentries;
+	XLogRecPtr	start_lsn;
+	XLogRecPtr	end_lsn;
+} WalSummaryFileHeader;
+
+typedef struct WalSummaryEntryHeader
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber limit_block;
+	uint32		nranges;
+} WalSummaryEntryHeader;
+
+typedef struct WalSummaryRange
+{
+	BlockNumber start;
+	uint32		count;
+} WalSummaryRange;
+
+typedef struct BlockRefTableKey
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+} BlockRefTableKey;
+
+/*
+ * Modified blocks of one relation fork.  New block numbers are appended to
+ * blocks[]; the array is sorted and deduplicated lazily, when it fills up
+ * or when somebody needs to look at it.
+ */
+typedef struct BlockRefTableEntry
+{
+	BlockRefTableKey key;		/* hash key; must be first */
+	BlockNumber limit_block;	/* all blocks >= this are modified */
+	bool		sorted;			/* blocks[] is sorted and duplicate-free */
+	uint32		nblocks;		/* number of entries used in blocks[] */
+	uint32		maxblocks;		/* number of entries allocated */
+	BlockNumber *blocks;
+} BlockRefTableEntry;
+
+struct BlockRefTable
+{
+	MemoryContext mcxt;
+	HTAB	   *hash;
+};
+
+static BlockRefTableEntry *BlockRefTableGetEntry(BlockRefTable *brtab,
+												 const RelFileNode *rnode,
+												 ForkNumber forknum,
+												 bool create);
+static void BlockRefTableCompactEntry(BlockRefTableEntry *entry);
+static int	blocknum_cmp(const void *a, const void *b);
+static void WalSummaryFilePath(char *path, TimeLineID tli,
+							   XLogRecPtr start_lsn, XLogRecPtr end_lsn);
+static void WalSummaryWrite(int fd, const char *path, const void *data,
+							size_t len, pg_crc32c *crc);
+static void WalSummaryRead(int fd, const char *path, void *data, size_t len,
+						   pg_crc32c *crc);
+
+/*
+ * Create an empty block reference table in the current memory context.
+ */
+BlockRefTable *
+CreateBlockRefTable(void)
+{
+	BlockRefTable *brtab = palloc(sizeof(BlockRefTable));
+	HASHCTL		ctl;
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(BlockRefTableKey);
+	ctl.entrysize = sizeof(BlockRefTableEntry);
+	ctl.hcxt = CurrentMemoryContext;
+
+	brtab->mcxt = CurrentMemoryContext;
+	brtab->hash = hash_create("block reference table", 1024, &ctl,
+							  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	return brtab;
+}
+
+/*
+ * Record that a block has been modified.
+ */
+void
+BlockRefTableMarkBlockModified(BlockRefTable *brtab, const RelFileNode *rnode,
+							   ForkNumber forknum, BlockNumber blknum)
+{
+	BlockRefTableEntry *entry;
+
+	entry = BlockRefTableGetEntry(brtab, rnode, forknum, true);
+
+	/* Nothing to do if the limit block already covers it. */
+	if (blknum >= entry->limit_block)
+		return;
+
+	/* Hot pages tend to be modified many times in a row; skip repeats. */
+	if (entry->nblocks > 0 && entry->blocks[entry->nblocks - 1] == blknum)
+		return;
+
+	if (entry->nblocks >= entry->maxblocks)
+	{
+		/* Try to make room by discarding duplicates before growing. */
+		BlockRefTableCompactEntry(entry);
+
+		if (entry->nblocks >= entry->maxblocks / 2)
+		{
+			uint32		newmax = Max(entry->maxblocks * 2, 16);
+
+			if (entry->blocks == NULL)
+				entry->blocks = (BlockNumber *)
+					MemoryContextAllocHuge(brtab->mcxt,
+										   newmax * sizeof(BlockNumber));
+			else
+				entry->blocks = (BlockNumber *)
+					repalloc_huge(entry->blocks,
+								  newmax * sizeof(BlockNumber));
+			entry->maxblocks = newmax;
+		}
+	}
+
+	if (entry->nblocks > 0 && blknum < entry->blocks[entry->nblocks - 1])
+		entry->sorted = false;
+	entry->blocks[entry->nblocks++] = blknum;
+}
+
+/*
+ * Record that all blocks at or above limit_block must be considered
+ * modified, because the fork was created or truncated.
+ *
+ * A RelFileNode with an invalid relNode stands for every relation in the
+ * given database; this is used when a whole database directory is copied.
+ */
+void
+BlockRefTableSetLimitBlock(BlockRefTable *brtab, const RelFileNode *rnode,
+						   ForkNumber forknum, BlockNumber limit_block)
+{
+	BlockRefTableEntry *entry;
+
+	entry = BlockRefTableGetEntry(brtab, rnode, forknum, true);
+	if (limit_block < entry->limit_block)
+		entry->limit_block = limit_block;
+}
+
+/*
+ * Fill 'blocks' with the modified blocks of a relation fork that lie in the
+ * range [start_blkno, stop_blkno), in ascending order, and return how many
+ * there are.  The caller must provide room for stop_blkno - start_blkno
+ * entries.
+ */
+int
+BlockRefTableGetModifiedBlocks(BlockRefTable *brtab, const RelFileNode *rnode,
+							   ForkNumber forknum, BlockNumber start_blkno,
+							   BlockNumber stop_blkno, BlockNumber *blocks)
+{
+	BlockRefTableEntry *entry;
+	BlockNumber limit_block = InvalidBlockNumber;
+	BlockNumber blkno;
+	int			nresults = 0;
+
+	/* Was the whole database created within the summarized WAL? */
+	if (rnode->relNode != InvalidOid)
+	{
+		RelFileNode dbnode = *rnode;
+
+		dbnode.relNode = InvalidOid;
+		entry = BlockRefTableGetEntry(brtab, &dbnode, MAIN_FORKNUM, false);
+		if (entry != NULL)
+			limit_block = entry->limit_block;
+	}
+
+	entry = BlockRefTableGetEntry(brtab, rnode, forknum, false);
+	if (entry != NULL)
+	{
+		uint32		lo = 0,
+					hi;
+
+		limit_block = Min(limit_block, entry->limit_block);
+		BlockRefTableCompactEntry(entry);
+
+		/* Binary search for the first block >= start_blkno. */
+		hi = entry->nblocks;
+		while (lo < hi)
+		{
+			uint32		mid = lo + (hi - lo) / 2;
+
+			if (entry->blocks[mid] < start_blkno)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (; lo < entry->nblocks; lo++)
+		{
+			blkno = entry->blocks[lo];
+			if (blkno >= stop_blkno || blkno >= limit_block)
+				break;
+			blocks[nresults++] = blkno;
+		}
+	}
+
+	for (blkno = Max(start_blkno, limit_block); blkno < stop_blkno; blkno++)
+		blocks[nresults++] = blkno;
+
+	return nresults;
+}
+
+/*
+ * Find the entry for a relation fork, optionally creating it.
+ */
+static BlockRefTableEntry *
+BlockRefTableGetEntry(BlockRefTable *brtab, const RelFileNode *rnode,
+					  ForkNumber forknum, bool create)
+{
+	BlockRefTableKey key;
+	BlockRefTableEntry *entry;
+	bool		found;
+
+	memset(&key, 0, sizeof(key));
+	key.rnode = *rnode;
+	key.forknum = forknum;
+
+	entry = hash_search(brtab->hash, &key, create ? HASH_ENTER : HASH_FIND,
+						&found);
+	if (create && !found)
+	{
+		entry->limit_block = InvalidBlockNumber;
+		entry->sorted = true;
+		entry->nblocks = 0;
+		entry->maxblocks = 0;
+		entry->blocks = NULL;
+	}
+
+	return entry;
+}
+
+/*
+ * Sort and deduplicate an entry's block list, and drop anything the limit
+ * block makes redundant.
+ */
+static void
+BlockRefTableCompactEntry(BlockRefTableEntry *entry)
+{
+	uint32		i,
+				n = 0;
+
+	if (!entry->sorted)
+	{
+		qsort(entry->blocks, entry->nblocks, sizeof(BlockNumber),
+			  blocknum_cmp);
+		entry->sorted = true;
+	}
+
+	for (i = 0; i < entry->nblocks; i++)
+	{
+		if (entry->blocks[i] >= entry->limit_block)
+			break;
+		if (n > 0 && entry->blocks[n - 1] == entry->blocks[i])
+			continue;
+		entry->blocks[n++] = entry->blocks[i];
+	}
+	entry->nblocks = n;
+}
+
+static int
+blocknum_cmp(const void *a, const void *b)
+{
+	BlockNumber ba = *(const BlockNumber *) a;
+	BlockNumber bb = *(const BlockNumber *) b;
+
+	if (ba < bb)
+		return -1;
+	if (ba > bb)
+		return 1;
+	return 0;
+}
+
+/*
+ * Return a list of WalSummaryFile for the summaries on disk that belong to
+ * timeline 'tli' and overlap the range [start_lsn, end_lsn).  A zero tli
+ * matches any timeline, and an invalid start_lsn or end_lsn leaves that
+ * side of the range open.
+ */
+List *
+GetWalSummaries(TimeLineID tli, XLogRecPtr start_lsn, XLogRecPtr end_lsn)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	List	   *result = NIL;
+
+	dir = AllocateDir(WAL_SUMMARY_DIR);
+	if (dir == NULL && errno == ENOENT)
+		return NIL;
+
+	while ((de = ReadDir(dir, WAL_SUMMARY_DIR)) != NULL)
+	{
+		WalSummaryFile *ws;
+		uint32		file_tli,
+					start_hi,
+					start_lo,
+					end_hi,
+					end_lo;
+
+		if (strlen(de->d_name) != 40 + strlen(".summary") ||
+			strspn(de->d_name, "0123456789ABCDEF") != 40 ||
+			strcmp(de->d_name + 40, ".summary") != 0)
+			continue;
+		if (sscanf(de->d_name, "%08X%08X%08X%08X%08X", &file_tli,
+				   &start_hi, &start_lo, &end_hi, &end_lo) != 5)
+			continue;
+
+		ws = palloc(sizeof(WalSummaryFile));
+		ws->tli = file_tli;
+		ws->start_lsn = ((uint64) start_hi) << 32 | start_lo;
+		ws->end_lsn = ((uint64) end_hi) << 32 | end_lo;
+
+		if ((tli != 0 && ws->tli != tli) ||
+			(!XLogRecPtrIsInvalid(start_lsn) && ws->end_lsn <= start_lsn) ||
+			(!XLogRecPtrIsInvalid(end_lsn) && ws->start_lsn >= end_lsn))
+		{
+			pfree(ws);
+			continue;
+		}
+
+		result = lappend(result, ws);
+	}
+	FreeDir(dir);
+
+	return result;
+}
+
+/*
+ * Check whether the summaries in 'wslist' together cover every LSN in
+ * [start_lsn, end_lsn).  Returns InvalidXLogRecPtr if so, otherwise the
+ * first LSN that no summary covers.
+ */
+XLogRecPtr
+WalSummariesCoverRange(List *wslist, XLogRecPtr start_lsn, XLogRecPtr end_lsn)
+{
+	XLogRecPtr	current = start_lsn;
+	bool		progress = true;
+
+	while (current < end_lsn && progress)
+	{
+		ListCell   *lc;
+
+		progress = false;
+		foreach(lc, wslist)
+		{
+			WalSummaryFile *ws = (WalSummaryFile *) lfirst(lc);
+
+			if (ws->start_lsn <= current && ws->end_lsn > current)
+			{
+				current = ws->end_lsn;
+				progress = true;
+			}
+		}
+	}
+
+	return current < end_lsn ? current : InvalidXLogRecPtr;
+}
+
+/*
+ * Merge the contents of a WAL summary file into a block reference table.
+ */
+void
+ReadWalSummary(WalSummaryFile *ws, BlockRefTable *brtab)
+{
+	char		path[MAXPGPATH];
+	int			fd;
+	WalSummaryFileHeader hdr;
+	pg_crc32c	crc;
+	pg_crc32c	file_crc;
+	uint32		i;
+
+	WalSummaryFilePath(path, ws->tli, ws->start_lsn, ws->end_lsn);
+
+	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+
+	INIT_CRC32C(crc);
+	WalSummaryRead(fd, path, &hdr, sizeof(hdr), &crc);
+	if (hdr.magic != WAL_SUMMARY_MAGIC || hdr.version != WAL_SUMMARY_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("WAL summary file \"%s\" has wrong magic number or version",
+						path)));
+
+	for (i = 0; i < hdr.nentries; i++)
+	{
+		WalSummaryEntryHeader ehdr;
+		WalSummaryRange *ranges;
+		uint32		j;
+
+		WalSummaryRead(fd, path, &ehdr, sizeof(ehdr), &crc);
+		if (ehdr.forknum < 0 || ehdr.forknum > MAX_FORKNUM)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("WAL summary file \"%s\" contains invalid fork number %d",
+							path, ehdr.forknum)));
+
+		if (ehdr.limit_block != InvalidBlockNumber)
+			BlockRefTableSetLimitBlock(brtab, &ehdr.rnode, ehdr.forknum,
+									   ehdr.limit_block);
+
+		if (ehdr.nranges == 0)
+			continue;
+
+		ranges = MemoryContextAllocHuge(CurrentMemoryContext,
+										ehdr.nranges * sizeof(WalSummaryRange));
+		WalSummaryRead(fd, path, ranges,
+					   ehdr.nranges * sizeof(WalSummaryRange), &crc);
+		for (j = 0; j < ehdr.nranges; j++)
+		{
+			uint32		k;
+
+			for (k = 0; k < ranges[j].count; k++)
+				BlockRefTableMarkBlockModified(brtab, &ehdr.rnode,
+											   ehdr.forknum,
+											   ranges[j].start + k);
+		}
+		pfree(ranges);
+	}
+
+	FIN_CRC32C(crc);
+	WalSummaryRead(fd, path, &file_crc, sizeof(file_crc), NULL);
+	if (!EQ_CRC32C(crc, file_crc))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("calculated CRC checksum does not match value stored in file \"%s\"",
+						path)));
+
+	if (CloseTransientFile(fd) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", path)));
+}
+
+/*
+ * Write out a block reference table as the WAL summary for the given
+ * timeline and LSN range.  The file is written under a temporary name and
+ * durably renamed into place, so readers never see a partial summary.
+ */
+void
+WriteWalSummary(BlockRefTable *brtab, TimeLineID tli, XLogRecPtr start_lsn,
+				XLogRecPtr end_lsn)
+{
+	char		path[MAXPGPATH];
+	char		tmppath[MAXPGPATH];
+	int			fd;
+	WalSummaryFileHeader hdr;
+	HASH_SEQ_STATUS status;
+	BlockRefTableEntry *entry;
+	WalSummaryRange *ranges = NULL;
+	uint32		maxranges = 0;
+	pg_crc32c	crc;
+
+	WalSummaryFilePath(path, tli, start_lsn, end_lsn);
+	snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+	fd = OpenTransientFile(tmppath, O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmppath)));
+
+	INIT_CRC32C(crc);
+	hdr.magic = WAL_SUMMARY_MAGIC;
+	hdr.version = WAL_SUMMARY_VERSION;
+	hdr.tli = tli;
+	hdr.nentries = hash_get_num_entries(brtab->hash);
+	hdr.start_lsn = start_lsn;
+	hdr.end_lsn = end_lsn;
+	WalSummaryWrite(fd, tmppath, &hdr, sizeof(hdr), &crc);
+
+	hash_seq_init(&status, brtab->hash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		WalSummaryEntryHeader ehdr;
+		uint32		nranges = 0;
+		uint32		i;
+
+		BlockRefTableCompactEntry(entry);
+
+		/* Worst case, every block is a range of its own. */
+		if (entry->nblocks > maxranges)
+		{
+			if (ranges != NULL)
+				pfree(ranges);
+			maxranges = entry->nblocks;
+			ranges = MemoryContextAllocHuge(CurrentMemoryContext,
+											maxranges * sizeof(WalSummaryRange));
+		}
+
+		for (i = 0; i < entry->nblocks; i++)
+		{
+			if (nranges > 0 &&
+				ranges[nranges - 1].start + ranges[nranges - 1].count ==
+				entry->blocks[i])
+				ranges[nranges - 1].count++;
+			else
+			{
+				ranges[nranges].start = entry->blocks[i];
+				ranges[nranges].count = 1;
+				nranges++;
+			}
+		}
+
+		memset(&ehdr, 0, sizeof(ehdr));
+		ehdr.rnode = entry->key.rnode;
+		ehdr.forknum = entry->key.forknum;
+		ehdr.limit_block = entry->limit_block;
+		ehdr.nranges = nranges;
+		WalSummaryWrite(fd, tmppath, &ehdr, sizeof(ehdr), &crc);
+		if (nranges > 0)
+			WalSummaryWrite(fd, tmppath, ranges,
+							nranges * sizeof(WalSummaryRange), &crc);
+	}
+
+	FIN_CRC32C(crc);
+	WalSummaryWrite(fd, tmppath, &crc, sizeof(crc), NULL);
+
+	if (ranges != NULL)
+		pfree(ranges);
+
+	if (CloseTransientFile(fd) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", tmppath)));
+
+	(void) durable_rename(tmppath, path, ERROR);
+}
+
+/*
+ * Remove summary files last modified more than keep_minutes ago.  The
+ * newest summary is always kept, because the summarizer resumes from its
+ * end.  Zero or less means keep everything.
+ */
+void
+RemoveOldWalSummaries(int keep_minutes)
+{
+	List	   *wslist;
+	ListCell   *lc;
+	XLogRecPtr	newest = InvalidXLogRecPtr;
+	time_t		cutoff;
+
+	if (keep_minutes <= 0)
+		return;
+
+	cutoff = time(NULL) - (time_t) keep_minutes * 60;
+	wslist = GetWalSummaries(0, InvalidXLogRecPtr, InvalidXLogRecPtr);
+
+	foreach(lc, wslist)
+	{
+		WalSummaryFile *ws = (WalSummaryFile *) lfirst(lc);
+
+		newest = Max(newest, ws->end_lsn);
+	}
+
+	foreach(lc, wslist)
+	{
+		WalSummaryFile *ws = (WalSummaryFile *) lfirst(lc);
+		char		path[MAXPGPATH];
+		struct stat statbuf;
+
+		if (ws->end_lsn == newest)
+			continue;
+
+		WalSummaryFilePath(path, ws->tli, ws->start_lsn, ws->end_lsn);
+		if (stat(path, &statbuf) != 0 || statbuf.st_mtime >= cutoff)
+			continue;
+
+		ereport(DEBUG1,
+				(errmsg("removing WAL summary file \"%s\"", path)));
+		if (unlink(path) != 0 && errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+	}
+
+	list_free_deep(wslist);
+}
+
+static void
+WalSummaryFilePath(char *path, TimeLineID tli, XLogRecPtr start_lsn,
+				   XLogRecPtr end_lsn)
+{
+	snprintf(path, MAXPGPATH, WAL_SUMMARY_DIR "/%08X%08X%08X%08X%08X.summary",
+			 tli,
+			 (uint32) (start_lsn >> 32), (uint32) start_lsn,
+			 (uint32) (end_lsn >> 32), (uint32) end_lsn);
+}
+
+/*
+ * Write to a summary file, folding the data into *crc if it's not NULL.
+ */
+static void
+WalSummaryWrite(int fd, const char *path, const void *data, size_t len,
+				pg_crc32c *crc)
+{
+	if (crc != NULL)
+		COMP_CRC32C(*crc, data, len);
+
+	errno = 0;
+	pgstat_report_wait_start(WAIT_EVENT_WAL_SUMMARY_WRITE);
+	if (write(fd, data, len) != len)
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		pgstat_report_wait_end();
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", path)));
+	}
+	pgstat_report_wait_end();
+}
+
+/*
+ * Read from a summary file, folding the data into *crc if it's not NULL.
+ */
+static void
+WalSummaryRead(int fd, const char *path, void *data, size_t len,
+			   pg_crc32c *crc)
+{
+	ssize_t		nread;
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_SUMMARY_READ);
+	nread = read(fd, data, len);
+	pgstat_report_wait_end();
+
+	if (nread < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", path)));
+	if (nread != len)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("could not read file \"%s\": read %zd of %zu",
+						path, nread, len)));
+
+	if (crc != NULL)
+		COMP_CRC32C(*crc, data, len);
+}
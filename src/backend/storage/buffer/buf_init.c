@@ -14,14 +14,27 @@
  */
 #include "postgres.h"
 
+#include "port/pg_numa.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/pg_shmem.h"
+
+/*
+ * Granularity of NUMA placement.  This is the size of a huge page on common
+ * platforms, so that placement also works when huge pages are in use.
+ */
+#define NUMA_PLACEMENT_ALIGN	(2 * 1024 * 1024)
 
 BufferDescPadded *BufferDescriptors;
 char	   *BufferBlocks;
 LWLockMinimallyPadded *BufferIOLWLockArray = NULL;
 WritebackContext BackendWritebackContext;
 CkptSortItem *CkptBufferIds;
+int			NumaNodes = 1;
+
+static void BufferNumaInit(void);
+static void PlaceBufferPool(void);
+static bool PlaceMemory(char *start, char *end, int node);
 
 
 /*
@@ -77,9 +90,12 @@ InitBufferPool(void)
 						NBuffers * sizeof(BufferDescPadded),
 						&foundDescs);
 
+	/* Align buffer pool on IO page size boundary, for direct I/O */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
+		TYPEALIGN(PG_IO_ALIGN_SIZE,
+				  ShmemInitStruct("Buffer Blocks",
+								  NBuffers * (Size) BLCKSZ + PG_IO_ALIGN_SIZE,
+								  &foundBufs));
 
 	/* Align lwlocks to cacheline boundary */
 	BufferIOLWLockArray = (LWLockMinimallyPadded *)
@@ -98,6 +114,8 @@ InitBufferPool(void)
 		ShmemInitStruct("Checkpoint BufferIds",
 						NBuffers * sizeof(CkptSortItem), &foundBufCkpt);
 
+	BufferNumaInit();
+
 	if (foundDescs || foundBufs || foundIOLocks || foundBufCkpt)
 	{
 		/* should find all of these, or none of them */
@@ -108,6 +126,10 @@ InitBufferPool(void)
 	{
 		int			i;
 
+		/* Place the buffer pool on NUMA nodes before anything touches it */
+		if (NumaNodes > 1)
+			PlaceBufferPool();
+
 		/*
 		 * Initialize all the buffer headers.
 		 */
@@ -147,6 +169,76 @@ InitBufferPool(void)
 						 &backend_flush_after);
 }
 
+/*
+ * Determine the number of NUMA nodes the buffer pool is spread over, if any
+ */
+static void
+BufferNumaInit(void)
+{
+	if (numa_mode == NUMA_OFF)
+		NumaNodes = 1;
+	else
+		NumaNodes = Min(pg_numa_init(), NBuffers);
+}
+
+/*
+ * Place the buffer descriptors and pages on NUMA nodes according to the numa
+ * setting: either interleave them across all nodes, or give each node a
+ * contiguous partition of the pool, as defined by BufferGetNumaNode().
+ */
+static void
+PlaceBufferPool(void)
+{
+	char	   *descs = (char *) BufferDescriptors;
+	bool		ok = true;
+
+	if (numa_mode == NUMA_INTERLEAVE)
+	{
+		ok &= PlaceMemory(BufferBlocks, BufferBlocks + NBuffers * (Size) BLCKSZ,
+						  -1);
+		ok &= PlaceMemory(descs, descs + NBuffers * sizeof(BufferDescPadded),
+						  -1);
+	}
+	else
+	{
+		for (int node = 0; node < NumaNodes; node++)
+		{
+			int			first = NumaNodeFirstBuffer(node);
+			int			last = NumaNodeFirstBuffer(node + 1);
+
+			ok &= PlaceMemory(BufferBlocks + first * (Size) BLCKSZ,
+							  BufferBlocks + last * (Size) BLCKSZ,
+							  node);
+			ok &= PlaceMemory(descs + first * sizeof(BufferDescPadded),
+							  descs + last * sizeof(BufferDescPadded),
+							  node);
+		}
+	}
+
+	if (!ok)
+		ereport(WARNING,
+				(errmsg("could not place shared buffers on NUMA nodes: %m")));
+}
+
+/*
+ * Place the memory between start and end on the given NUMA node, or
+ * interleave it across all nodes if node is -1.  Only whole placement units
+ * are affected, so that the neighbors' placement is left alone.
+ */
+static bool
+PlaceMemory(char *start, char *end, int node)
+{
+	start = (char *) TYPEALIGN(NUMA_PLACEMENT_ALIGN, start);
+	end = (char *) TYPEALIGN_DOWN(NUMA_PLACEMENT_ALIGN, end);
+	if (start >= end)
+		return true;
+
+	if (node < 0)
+		return pg_numa_interleave(start, end - start) == 0;
+	else
+		return pg_numa_prefer(start, end - start, node) == 0;
+}
+
 /*
  * BufferShmemSize
  *
@@ -158,12 +250,15 @@ BufferShmemSize(void)
 {
 	Size		size = 0;
 
+	BufferNumaInit();
+
 	/* size of buffer descriptors */
 	size = add_size(size, mul_size(NBuffers, sizeof(BufferDescPadded)));
 	/* to allow aligning buffer descriptors */
 	size = add_size(size, PG_CACHE_LINE_SIZE);
 
-	/* size of data pages */
+	/* size of data pages, plus alignment padding */
+	size = add_size(size, PG_IO_ALIGN_SIZE);
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
 
 	/* size of stuff controlled by freelist.c */
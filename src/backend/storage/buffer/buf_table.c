@@ -7,7 +7,17 @@
  * must hold a suitable lock on the appropriate BufMappingLock, as specified
  * in the comments.  We can't do the locking inside these functions because
  * in most cases the caller needs to adjust the buffer header contents
- * before the lock is released (see notes in README).
+ * before the lock is released (see notes in README).  The exception is
+ * BufTableLookupUnlocked(), which needs no lock at all, but whose result is
+ * only a hint.
+ *
+ * The table is a chained hash table of our own rather than a dynahash
+ * table, so that it can be searched safely while other backends modify it.
+ * Each bucket belongs to a single BufMappingLock partition, and modifications
+ * of a chain are made with stores that keep it traversable at every step.
+ * Entries are never freed back to a shared pool: each buffer owns two of
+ * them, which is enough because a buffer is mapped by at most two tags at a
+ * time (its old and new identity, while BufferAlloc() replaces it).
  *
  *
  * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
@@ -21,49 +31,105 @@
  */
 #include "postgres.h"
 
+#include "common/hashfn.h"
+#include "port/atomics.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/shmem.h"
+
+/*
+ * Maximum number of entries BufTableLookupUnlocked() visits.  Chains are
+ * short, so this is only reached if the entries we were following were
+ * recycled from under us many times over.
+ */
+#define BUFTABLE_MAX_UNLOCKED_STEPS	64
 
 /* entry for buffer lookup hashtable */
 typedef struct
 {
 	BufferTag	key;			/* Tag of a disk page */
-	int			id;				/* Associated buffer ID */
+	int			id;				/* Associated buffer ID, or -1 if unused */
+	pg_atomic_uint32 next;		/* Index of next entry in chain plus one, or
+								 * zero at the end of the chain */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+typedef struct
+{
+	uint32		mask;			/* number of buckets minus one */
+	pg_atomic_uint32 buckets[FLEXIBLE_ARRAY_MEMBER];	/* index of first
+														 * entry plus one */
+} BufferLookupHeader;
+
+static BufferLookupHeader *SharedBufHeader;
+static BufferLookupEnt *SharedBufEntries;
+
+static uint32 BufTableBuckets(int size);
 
 
+/*
+ * Number of buckets for a table for the given number of buffers
+ */
+static uint32
+BufTableBuckets(int size)
+{
+	uint32		nbuckets = NUM_BUFFER_PARTITIONS;
+
+	/* a power of 2, so that each bucket belongs to a single partition */
+	while (nbuckets < (uint32) size)
+		nbuckets <<= 1;
+
+	return nbuckets;
+}
+
 /*
  * Estimate space needed for mapping hashtable
- *		size is the desired hash table size (possibly more than NBuffers)
+ *		size is the number of shared buffers
  */
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	Size		sz;
+
+	sz = add_size(offsetof(BufferLookupHeader, buckets),
+				  mul_size(BufTableBuckets(size), sizeof(pg_atomic_uint32)));
+	sz = MAXALIGN(sz);
+	sz = add_size(sz, mul_size(mul_size(size, 2), sizeof(BufferLookupEnt)));
+
+	return sz;
 }
 
 /*
  * Initialize shmem hash table for mapping buffers
- *		size is the desired hash table size (possibly more than NBuffers)
+ *		size is the number of shared buffers
  */
 void
 InitBufTable(int size)
 {
-	HASHCTL		info;
+	uint32		nbuckets = BufTableBuckets(size);
+	bool		found;
 
 	/* assume no locking is needed yet */
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt);
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	SharedBufHeader = (BufferLookupHeader *)
+		ShmemInitStruct("Shared Buffer Lookup Table",
+						BufTableShmemSize(size), &found);
+	SharedBufEntries = (BufferLookupEnt *)
+		((char *) SharedBufHeader +
+		 MAXALIGN(offsetof(BufferLookupHeader, buckets) +
+				  nbuckets * sizeof(pg_atomic_uint32)));
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+	if (!found)
+	{
+		SharedBufHeader->mask = nbuckets - 1;
+		for (uint32 i = 0; i < nbuckets; i++)
+			pg_atomic_init_u32(&SharedBufHeader->buckets[i], 0);
+		for (int i = 0; i < size * 2; i++)
+		{
+			CLEAR_BUFFERTAG(SharedBufEntries[i].key);
+			SharedBufEntries[i].id = -1;
+			pg_atomic_init_u32(&SharedBufEntries[i].next, 0);
+		}
+	}
 }
 
 /*
@@ -78,7 +144,7 @@ InitBufTable(int size)
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr);
+	return hash_bytes((const unsigned char *) tagPtr, sizeof(BufferTag));
 }
 
 /*
@@ -90,19 +156,59 @@ BufTableHashCode(BufferTag *tagPtr)
 int
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	uint32		next;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+	next = pg_atomic_read_u32(&SharedBufHeader->buckets[hashcode & SharedBufHeader->mask]);
+	while (next != 0)
+	{
+		BufferLookupEnt *ent = &SharedBufEntries[next - 1];
 
-	if (!result)
-		return -1;
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
+		next = pg_atomic_read_u32(&ent->next);
+	}
 
-	return result->id;
+	return -1;
+}
+
+/*
+ * BufTableLookupUnlocked
+ *		Lookup the given BufferTag without any lock; return the buffer ID
+ *		it was probably mapped to, or -1
+ *
+ * Since the table may be modified concurrently, the result is only a hint:
+ * the buffer may not hold the block by the time the caller looks at it, or
+ * ever have held it, if we read a half-written entry; and we may fail to find
+ * a block that is mapped.  The caller must pin the buffer and check its tag
+ * before trusting it, and fall back to BufTableLookup() if need be.
+ */
+int
+BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode)
+{
+	uint32		next;
+	int			steps = 0;
+
+	next = pg_atomic_read_u32(&SharedBufHeader->buckets[hashcode & SharedBufHeader->mask]);
+	while (next != 0 && steps++ < BUFTABLE_MAX_UNLOCKED_STEPS)
+	{
+		BufferLookupEnt *ent = &SharedBufEntries[next - 1];
+
+		/* don't read the entry before the link that led us to it */
+		pg_read_barrier();
+
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+		{
+			int			id = *((volatile int *) &ent->id);
+
+			/* the entry may have been recycled since, so check the ID */
+			if (id >= 0 && id < NBuffers)
+				return id;
+			return -1;
+		}
+		next = pg_atomic_read_u32(&ent->next);
+	}
+
+	return -1;
 }
 
 /*
@@ -113,28 +219,45 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
  * Returns -1 on successful insertion.  If a conflicting entry exists
  * already, returns the buffer ID in that entry.
  *
- * Caller must hold exclusive lock on BufMappingLock for tag's partition
+ * Caller must hold exclusive lock on BufMappingLock for tag's partition, and
+ * must hold a pin on the buffer, so that no other backend can be changing
+ * its entries.
  */
 int
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	pg_atomic_uint32 *bucket;
+	BufferLookupEnt *ent;
+	int			existing;
+	uint32		entno;
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
+	existing = BufTableLookup(tagPtr, hashcode);
+	if (existing >= 0)			/* found something already in the table */
+		return existing;
 
-	if (found)					/* found something already in the table */
-		return result->id;
+	/* use whichever of the buffer's two entries is free */
+	entno = buf_id * 2;
+	if (SharedBufEntries[entno].id >= 0)
+		entno++;
+	ent = &SharedBufEntries[entno];
+	if (ent->id >= 0)			/* shouldn't happen */
+		elog(ERROR, "shared buffer hash table corrupted");
 
-	result->id = buf_id;
+	/*
+	 * Fill in the entry before making it reachable, so that concurrent
+	 * lookups that find it see it complete.  A lookup that still holds a
+	 * pointer to the entry from its previous life may see a mix of old and
+	 * new contents, but it will not trust those without checking.
+	 */
+	bucket = &SharedBufHeader->buckets[hashcode & SharedBufHeader->mask];
+	ent->key = *tagPtr;
+	ent->id = buf_id;
+	pg_atomic_write_u32(&ent->next, pg_atomic_read_u32(bucket));
+	pg_write_barrier();
+	pg_atomic_write_u32(bucket, entno + 1);
 
 	return -1;
 }
@@ -148,15 +271,28 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	pg_atomic_uint32 *link;
+	uint32		next;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+	link = &SharedBufHeader->buckets[hashcode & SharedBufHeader->mask];
+	while ((next = pg_atomic_read_u32(link)) != 0)
+	{
+		BufferLookupEnt *ent = &SharedBufEntries[next - 1];
 
-	if (!result)				/* shouldn't happen */
-		elog(ERROR, "shared buffer hash table corrupted");
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+		{
+			/*
+			 * Unlink the entry, but leave its own link alone, so that
+			 * concurrent lookups that are looking at it can carry on down the
+			 * chain.  Only then mark it free for reuse.
+			 */
+			pg_atomic_write_u32(link, pg_atomic_read_u32(&ent->next));
+			pg_write_barrier();
+			ent->id = -1;
+			return;
+		}
+		link = &ent->next;
+	}
+
+	elog(ERROR, "shared buffer hash table corrupted");
 }
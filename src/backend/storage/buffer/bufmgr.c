@@ -45,11 +45,13 @@
 #include "postmaster/bgwriter.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
 #include "utils/memdebug.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
@@ -149,9 +151,21 @@ int			checkpoint_flush_after = 0;
 int			bgwriter_flush_after = 0;
 int			backend_flush_after = 0;
 
-/* local state for StartBufferIO and related functions */
-static BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+/*
+ * local state for StartBufferIO and related functions
+ *
+ * A backend normally has at most one buffer I/O in progress, but ReadBuffers
+ * starts I/O on a whole run of buffers before reading them with one system
+ * call, and may have to write out a victim buffer while doing so.
+ */
+typedef struct InProgressIO
+{
+	BufferDesc *buf;
+	bool		forInput;
+} InProgressIO;
+
+static InProgressIO InProgressBufs[MAX_BUFFERS_PER_TRANSFER + 1];
+static int	NumInProgressBufs = 0;
 
 /* local state for LockBufferForCleanup */
 static BufferDesc *PinCountWaitBuf = NULL;
@@ -460,12 +474,19 @@ static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
 						  WritebackContext *wb_context);
+static int	SyncBufferRun(int *buf_ids, int nbufs,
+						  WritebackContext *wb_context);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
 							  uint32 set_flag_bits);
 static void shared_buffer_write_error_callback(void *arg);
 static void local_buffer_write_error_callback(void *arg);
+static void ReadBuffersRun(SMgrRelation smgr, ForkNumber forkNum,
+						   BufferDesc **run, int nrun);
+static BufferDesc *PinBufferByTag(BufferTag *tag, uint32 hashcode,
+									  BufferAccessStrategy strategy,
+									  bool *valid);
 static BufferDesc *BufferAlloc(SMgrRelation smgr,
 							   char relpersistence,
 							   ForkNumber forkNum,
@@ -473,6 +494,9 @@ static BufferDesc *BufferAlloc(SMgrRelation smgr,
 							   BufferAccessStrategy strategy,
 							   bool *foundPtr);
 static void FlushBuffer(BufferDesc *buf, SMgrRelation reln);
+static int	FlushBufferRun(BufferDesc **run, int nrun,
+						   WritebackContext *wb_context);
+static void FlushBufferRange(SMgrRelation reln, BufferDesc **bufs, int nbufs);
 static void AtProcExit_Buffers(int code, Datum arg);
 static void CheckForBufferLeaks(void);
 static int	rnode_comparator(const void *p1, const void *p2);
@@ -505,10 +529,18 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
-	LWLockRelease(newPartitionLock);
+	/*
+	 * See if the block is in the buffer pool already.  The answer is only a
+	 * hint for the caller anyway, so we needn't lock the mapping table unless
+	 * the block seems not to be there.
+	 */
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
+	if (buf_id < 0)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		LWLockRelease(newPartitionLock);
+	}
 
 	/* If not in buffers, initiate prefetch */
 	if (buf_id < 0)
@@ -516,9 +548,11 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 #ifdef USE_PREFETCH
 		/*
 		 * Try to initiate an asynchronous read.  This returns false in
-		 * recovery if the relation file doesn't exist.
+		 * recovery if the relation file doesn't exist.  Advice is pointless
+		 * with direct I/O, since the kernel won't cache the data for us.
 		 */
-		if (smgrprefetch(smgr_reln, forkNum, blockNum))
+		if ((io_direct_flags & IO_DIRECT_DATA) == 0 &&
+			smgrprefetch(smgr_reln, forkNum, blockNum))
 			result.initiated_io = true;
 #endif							/* USE_PREFETCH */
 	}
@@ -598,6 +632,351 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 	}
 }
 
+/*
+ * State of a read stream.  See ReadStreamBegin().
+ *
+ * Block numbers obtained from the callback, but not yet handed to the
+ * consumer, are kept in a circular queue.  Each of them had PrefetchBuffer()
+ * called on it when it entered the queue, except when the queue was empty at
+ * the time: such a block is about to be read synchronously anyway.
+ *
+ * When ReadStreamNextBuffer() reads the block at the head of the queue, it
+ * reads the following queued blocks along with it if they're consecutive, and
+ * keeps the extra buffers pinned in the queue until they're asked for.
+ */
+struct ReadStream
+{
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+	ReadStreamBlockNumberCB callback;
+	void	   *callback_private_data;
+
+	int			max_distance;	/* upper limit for look-ahead distance */
+	int			distance;		/* current look-ahead distance */
+	bool		exhausted;		/* callback has reported end of stream */
+
+	/* circular queue of queue_size entries */
+	int			queue_size;
+	int			head;			/* index of oldest queued block */
+	int			count;			/* number of queued blocks */
+	BlockNumber *blocks;
+	Buffer	   *buffers;		/* pinned buffers of blocks read early */
+	size_t		per_block_data_size;
+	char	   *per_block_data;
+};
+
+#define ReadStreamPerBlockData(stream, i) \
+	((stream)->per_block_data_size > 0 ? \
+	 (void *) ((stream)->per_block_data + (i) * (stream)->per_block_data_size) : \
+	 NULL)
+
+/*
+ * ReadStreamBegin -- set up a stream of reads of one fork of a relation
+ *
+ * The blocks to read are produced by "callback", which is called as many
+ * blocks ahead of the consumer as the stream currently thinks is useful, but
+ * never more than max_ios blocks ahead, or MAX_BUFFERS_PER_TRANSFER blocks if
+ * that's more, so that a full-sized combined read can be assembled.  Callers
+ * normally pass the relevant effective_io_concurrency or
+ * maintenance_io_concurrency setting for the relation's tablespace.  Zero
+ * disables look-ahead entirely, which makes the stream equivalent to reading
+ * the blocks one at a time.
+ *
+ * The look-ahead distance adapts to what we find: it doubles whenever a block
+ * misses shared buffers, and decays by one for each block that was already
+ * cached, so that a fully cached relation doesn't pay for advice calls it
+ * doesn't need.
+ *
+ * Consumers using ReadStreamNextBlock() never have buffers pinned on their
+ * behalf, so they may take cleanup locks or abandon the stream at any point.
+ * Consumers using ReadStreamNextBuffer() may have up to
+ * MAX_BUFFERS_PER_TRANSFER - 1 buffers pinned ahead of them until they call
+ * ReadStreamReset() or ReadStreamEnd(), fewer if shared_buffers is small
+ * (see LimitAdditionalPins()).
+ */
+ReadStream *
+ReadStreamBegin(Relation rel, ForkNumber forkNum,
+				BufferAccessStrategy strategy,
+				int max_ios,
+				ReadStreamBlockNumberCB callback,
+				void *callback_private_data,
+				size_t per_block_data_size)
+{
+	ReadStream *stream;
+
+	Assert(max_ios >= 0);
+
+	stream = (ReadStream *) palloc0(sizeof(ReadStream));
+	stream->rel = rel;
+	stream->forknum = forkNum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private_data = callback_private_data;
+	stream->max_distance = max_ios > 0 ? Max(max_ios, MAX_BUFFERS_PER_TRANSFER) : 0;
+	stream->queue_size = stream->max_distance + 1;
+	stream->blocks = (BlockNumber *)
+		palloc(sizeof(BlockNumber) * stream->queue_size);
+	stream->buffers = (Buffer *)
+		palloc0(sizeof(Buffer) * stream->queue_size);
+	stream->per_block_data_size = MAXALIGN(per_block_data_size);
+	if (per_block_data_size > 0)
+		stream->per_block_data =
+			palloc0(stream->per_block_data_size * stream->queue_size);
+
+	ReadStreamReset(stream);
+
+	return stream;
+}
+
+/*
+ * ReadStreamLookAhead -- top up the queue of a read stream
+ *
+ * Calls the callback until the queue holds the next block to be returned
+ * plus "distance" blocks of look-ahead, issuing prefetch advice for each of
+ * the look-ahead blocks.
+ */
+static void
+ReadStreamLookAhead(ReadStream *stream)
+{
+	while (!stream->exhausted && stream->count <= stream->distance)
+	{
+		int			slot = (stream->head + stream->count) % stream->queue_size;
+		BlockNumber blocknum;
+
+		blocknum = stream->callback(stream,
+									stream->callback_private_data,
+									ReadStreamPerBlockData(stream, slot));
+		if (!BlockNumberIsValid(blocknum))
+		{
+			stream->exhausted = true;
+			break;
+		}
+
+		stream->blocks[slot] = blocknum;
+
+		/*
+		 * Don't bother issuing advice for a block the consumer is going to
+		 * read next; it would just be an extra system call.
+		 */
+		if (stream->count++ > 0)
+		{
+			PrefetchBufferResult prefetch;
+
+			prefetch = PrefetchBuffer(stream->rel, stream->forknum, blocknum);
+			if (!BufferIsValid(prefetch.recent_buffer))
+				stream->distance = Min(stream->distance * 2,
+									   stream->max_distance);
+			else if (stream->distance > 1)
+				stream->distance--;
+		}
+	}
+}
+
+/*
+ * ReadStreamPop -- remove the head of a read stream's queue
+ *
+ * Returns the queue slot it occupied, or -1 at the end of the stream.
+ */
+static int
+ReadStreamPop(ReadStream *stream, void **per_block_data)
+{
+	int			slot;
+
+	ReadStreamLookAhead(stream);
+
+	if (stream->count == 0)
+	{
+		Assert(stream->exhausted);
+		if (per_block_data)
+			*per_block_data = NULL;
+		return -1;
+	}
+
+	slot = stream->head;
+	stream->head = (stream->head + 1) % stream->queue_size;
+	stream->count--;
+
+	if (per_block_data)
+		*per_block_data = ReadStreamPerBlockData(stream, slot);
+
+	return slot;
+}
+
+/*
+ * ReadStreamNextBlock -- return the next block number of a read stream
+ *
+ * This is for consumers that read the block themselves, typically through
+ * some other interface layer; the stream only arranges for the read to find
+ * the data already on its way.  Returns InvalidBlockNumber at the end of the
+ * stream.  If per_block_data is not NULL, *per_block_data is set to point to
+ * the data the callback stored for this block; it remains valid until the
+ * next call for this stream.
+ *
+ * Don't mix calls to this and ReadStreamNextBuffer() for the same stream,
+ * except after ReadStreamReset().
+ */
+BlockNumber
+ReadStreamNextBlock(ReadStream *stream, void **per_block_data)
+{
+	int			slot = ReadStreamPop(stream, per_block_data);
+
+	if (slot < 0)
+		return InvalidBlockNumber;
+
+	Assert(!BufferIsValid(stream->buffers[slot]));
+
+	return stream->blocks[slot];
+}
+
+/*
+ * LimitAdditionalPins -- limit the number of buffers to pin at once
+ *
+ * A backend that pins many buffers ahead of their use could leave others,
+ * or itself, without any buffer to evict when shared_buffers is small, or
+ * when many read streams are open at once, e.g. in cursors.  So don't let a
+ * backend pin more than its proportional share of the buffer pool.  We
+ * don't know exactly how many buffers this backend has pinned already, so
+ * assume the whole PrivateRefCountArray is in use.  One pin is always
+ * allowed, since the caller can't make progress without it.
+ */
+static void
+LimitAdditionalPins(int *additional_pins)
+{
+	int			max_proportional_pins;
+
+	if (*additional_pins <= 1)
+		return;
+
+	max_proportional_pins = NBuffers / (MaxBackends + NUM_AUXILIARY_PROCS);
+	max_proportional_pins -= PrivateRefCountOverflowed + REFCOUNT_ARRAY_ENTRIES;
+
+	if (max_proportional_pins <= 0)
+		max_proportional_pins = 1;
+
+	if (*additional_pins > max_proportional_pins)
+		*additional_pins = max_proportional_pins;
+}
+
+/*
+ * ReadStreamNextBuffer -- read and pin the next block of a read stream
+ *
+ * Like ReadStreamNextBlock, but also reads the block in RBM_NORMAL mode using
+ * the stream's access strategy.  Returns InvalidBuffer at the end of the
+ * stream.
+ *
+ * If the block isn't already pinned for us, we read it together with as many
+ * of the blocks queued after it as follow it consecutively, with a single
+ * ReadBuffers() call; the extra buffers stay pinned in the queue.
+ */
+Buffer
+ReadStreamNextBuffer(ReadStream *stream, void **per_block_data)
+{
+	Buffer		buffer;
+	int			slot;
+
+	/* take care of the head of the queue before it's popped */
+	ReadStreamLookAhead(stream);
+	if (stream->count > 0 && !BufferIsValid(stream->buffers[stream->head]))
+	{
+		Buffer		buffers[MAX_BUFFERS_PER_TRANSFER];
+		BlockNumber first = stream->blocks[stream->head];
+		int			nblocks = 1;
+		int			max_pins;
+
+		/*
+		 * Temporary relations are read a block at a time anyway, so there's
+		 * nothing to gain from pinning their blocks early.
+		 */
+		if (RelationUsesLocalBuffers(stream->rel))
+			max_pins = 1;
+		else
+		{
+			max_pins = MAX_BUFFERS_PER_TRANSFER;
+			LimitAdditionalPins(&max_pins);
+		}
+
+		while (nblocks < stream->count && nblocks < max_pins)
+		{
+			int			next = (stream->head + nblocks) % stream->queue_size;
+
+			if (stream->blocks[next] != first + nblocks ||
+				BufferIsValid(stream->buffers[next]))
+				break;
+			nblocks++;
+		}
+
+		ReadBuffers(stream->rel, stream->forknum, first, nblocks,
+					stream->strategy, buffers);
+
+		for (int i = 0; i < nblocks; i++)
+			stream->buffers[(stream->head + i) % stream->queue_size] = buffers[i];
+	}
+
+	slot = ReadStreamPop(stream, per_block_data);
+	if (slot < 0)
+		return InvalidBuffer;
+
+	buffer = stream->buffers[slot];
+	stream->buffers[slot] = InvalidBuffer;
+	Assert(BufferIsValid(buffer));
+
+	return buffer;
+}
+
+/*
+ * ReadStreamSetAccessStrategy -- change the strategy used for later reads
+ *
+ * Buffers the stream has already pinned are not affected.
+ */
+void
+ReadStreamSetAccessStrategy(ReadStream *stream, BufferAccessStrategy strategy)
+{
+	stream->strategy = strategy;
+}
+
+/*
+ * ReadStreamReset -- forget all queued blocks of a read stream
+ *
+ * Afterwards the callback will be called again for the next block, even if
+ * it had previously reported the end of the stream.  Callers use this when
+ * the callback's notion of the next block has changed, e.g. on rescan.
+ * Any buffers pinned ahead of the consumer are released.
+ */
+void
+ReadStreamReset(ReadStream *stream)
+{
+	for (int i = 0; i < stream->queue_size; i++)
+	{
+		if (BufferIsValid(stream->buffers[i]))
+		{
+			ReleaseBuffer(stream->buffers[i]);
+			stream->buffers[i] = InvalidBuffer;
+		}
+	}
+
+	stream->head = 0;
+	stream->count = 0;
+	stream->exhausted = false;
+	stream->distance = Min(1, stream->max_distance);
+}
+
+/*
+ * ReadStreamEnd -- release a read stream
+ *
+ * Any queued blocks are forgotten, and their buffers unpinned.
+ */
+void
+ReadStreamEnd(ReadStream *stream)
+{
+	ReadStreamReset(stream);
+	pfree(stream->blocks);
+	pfree(stream->buffers);
+	if (stream->per_block_data)
+		pfree(stream->per_block_data);
+	pfree(stream);
+}
+
 
 /*
  * ReadBuffer -- a shorthand for ReadBufferExtended, for reading from main
@@ -708,6 +1087,173 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 }
 
 
+/*
+ * ReadBuffers -- read and pin a range of consecutive blocks of a relation
+ *
+ * Pins the buffers for blocks blockNum through blockNum + nblocks - 1 of the
+ * given fork into buffers[], with the same effect as as many calls to
+ * ReadBufferExtended() in RBM_NORMAL mode.  The difference is that each run
+ * of blocks that aren't already in shared buffers is read with a single
+ * smgrreadv() call instead of one smgrread() call per block.  nblocks must
+ * not exceed MAX_BUFFERS_PER_TRANSFER.
+ *
+ * Temporary relations are simply read a block at a time.
+ */
+void
+ReadBuffers(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+			int nblocks, BufferAccessStrategy strategy, Buffer *buffers)
+{
+	BufferDesc *run[MAX_BUFFERS_PER_TRANSFER];
+	int			nrun = 0;
+
+	Assert(nblocks > 0 && nblocks <= MAX_BUFFERS_PER_TRANSFER);
+
+	if (RelationUsesLocalBuffers(reln))
+	{
+		for (int i = 0; i < nblocks; i++)
+			buffers[i] = ReadBufferExtended(reln, forkNum, blockNum + i,
+											RBM_NORMAL, strategy);
+		return;
+	}
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	for (int i = 0; i < nblocks; i++)
+	{
+		SMgrRelation smgr = reln->rd_smgr;
+		BufferDesc *bufHdr;
+		bool		found;
+
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNum + i,
+										   smgr->smgr_rnode.node.spcNode,
+										   smgr->smgr_rnode.node.dbNode,
+										   smgr->smgr_rnode.node.relNode,
+										   smgr->smgr_rnode.backend,
+										   false);
+
+		/*
+		 * Lookup the buffer.  IO_IN_PROGRESS is set if the requested block is
+		 * not currently in memory, and stays set until we've read it along
+		 * with the rest of its run.  Since every backend acquires these in
+		 * ascending block order, waiting for someone else's I/O here can't
+		 * deadlock against them waiting for ours.
+		 */
+		bufHdr = BufferAlloc(smgr, reln->rd_rel->relpersistence, forkNum,
+							 blockNum + i, strategy, &found);
+		buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+
+		pgstat_count_buffer_read(reln);
+		if (found)
+		{
+			pgstat_count_buffer_hit(reln);
+			pgBufferUsage.shared_blks_hit++;
+			VacuumPageHit++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+
+			TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum + i,
+											  smgr->smgr_rnode.node.spcNode,
+											  smgr->smgr_rnode.node.dbNode,
+											  smgr->smgr_rnode.node.relNode,
+											  smgr->smgr_rnode.backend,
+											  false,
+											  found);
+
+			/* a hit ends the current run of blocks to read */
+			if (nrun > 0)
+				ReadBuffersRun(smgr, forkNum, run, nrun);
+			nrun = 0;
+		}
+		else
+		{
+			pgBufferUsage.shared_blks_read++;
+			run[nrun++] = bufHdr;
+		}
+	}
+
+	if (nrun > 0)
+		ReadBuffersRun(reln->rd_smgr, forkNum, run, nrun);
+}
+
+/*
+ * ReadBuffersRun -- subroutine for ReadBuffers.  Reads the pages of a run
+ *		of shared buffers holding consecutive blocks, all marked as
+ *		IO_IN_PROGRESS by us, and marks them valid.
+ */
+static void
+ReadBuffersRun(SMgrRelation smgr, ForkNumber forkNum, BufferDesc **run,
+			   int nrun)
+{
+	char	   *pages[MAX_BUFFERS_PER_TRANSFER];
+	BlockNumber firstBlock = run[0]->tag.blockNum;
+	instr_time	io_start,
+				io_time;
+
+	for (int i = 0; i < nrun; i++)
+	{
+		Assert(run[i]->tag.blockNum == firstBlock + i);
+		pages[i] = (char *) BufHdrGetBlock(run[i]);
+	}
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	smgrreadv(smgr, forkNum, firstBlock, pages, nrun);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+	}
+
+	for (int i = 0; i < nrun; i++)
+	{
+		BlockNumber blockNum = firstBlock + i;
+
+		/* check for garbage data */
+		if (!PageIsVerifiedExtended((Page) pages[i], blockNum,
+									PIV_LOG_WARNING | PIV_REPORT_STAT))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blockNum,
+								relpath(smgr->smgr_rnode, forkNum))));
+				MemSet(pages[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blockNum,
+								relpath(smgr->smgr_rnode, forkNum))));
+		}
+
+		/* Set BM_VALID, terminate IO, and wake up any waiters */
+		TerminateBufferIO(run[i], false, BM_VALID);
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNum,
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  false);
+	}
+}
+
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
  *
@@ -985,6 +1531,45 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	return BufferDescriptorGetBuffer(bufHdr);
 }
 
+/*
+ * PinBufferByTag -- find and pin the buffer holding a block, if any,
+ *		without locking the buffer mapping table
+ *
+ * On success, returns the pinned buffer and sets *valid like PinBuffer()'s
+ * result.  Returns NULL if the block wasn't found, which can also happen
+ * spuriously when the mapping table is being changed concurrently; the
+ * caller must then look again with the mapping partition lock held.
+ *
+ * This works because a buffer's tag can only change while its header is
+ * locked and nobody else holds a pin on it.  So once we have pinned the
+ * buffer, a look at its tag tells whether it holds our block, and it will
+ * go on doing so until we unpin it.
+ */
+static BufferDesc *
+PinBufferByTag(BufferTag *tag, uint32 hashcode,
+			   BufferAccessStrategy strategy, bool *valid)
+{
+	BufferDesc *buf;
+	int			buf_id;
+	uint32		buf_state;
+
+	buf_id = BufTableLookupUnlocked(tag, hashcode);
+	if (buf_id < 0)
+		return NULL;
+
+	buf = GetBufferDescriptor(buf_id);
+	*valid = PinBuffer(buf, strategy);
+
+	/* PinBuffer() is a barrier, so we see the current tag */
+	buf_state = pg_atomic_read_u32(&buf->state);
+	if ((buf_state & BM_TAG_VALID) && BUFFERTAGS_EQUAL(buf->tag, *tag))
+		return buf;
+
+	/* the buffer was reassigned under us */
+	UnpinBuffer(buf, true);
+	return NULL;
+}
+
 /*
  * BufferAlloc -- subroutine for ReadBuffer.  Handles lookup of a shared
  *		buffer.  If no buffer exists already, selects a replacement
@@ -1021,6 +1606,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	BufferDesc *buf;
 	bool		valid;
 	uint32		buf_state;
+	uint32		new_usage = BUF_USAGECOUNT_ONE;
+	bool		remember_eviction;
 
 	/* create a tag so we can lookup the buffer */
 	INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node, forkNum, blockNum);
@@ -1029,25 +1616,39 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
-	if (buf_id >= 0)
+	/*
+	 * See if the block is in the buffer pool already.  Try first without
+	 * locking the mapping table, which is enough in the common case that the
+	 * block is there and isn't being evicted.
+	 */
+	buf = PinBufferByTag(&newTag, newHash, strategy, &valid);
+	if (buf == NULL)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
-		buf = GetBufferDescriptor(buf_id);
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool, and check to see if the correct data has been
+			 * loaded into the buffer.
+			 */
+			buf = GetBufferDescriptor(buf_id);
 
-		valid = PinBuffer(buf, strategy);
+			valid = PinBuffer(buf, strategy);
+		}
 
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
 
+	if (buf != NULL)
+	{
 		*foundPtr = true;
 
+		if (NumaNodes > 1)
+			StrategyCountNumaHit(buf->buf_id);
+
 		if (!valid)
 		{
 			/*
@@ -1072,9 +1673,18 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.  Remember to unlock the mapping lock while doing the work.
+	 * buffer.
 	 */
-	LWLockRelease(newPartitionLock);
+
+	/*
+	 * Under the 2Q policy, a block that was evicted recently is part of the
+	 * working set after all, so it starts out hot rather than cold.  Only
+	 * accesses without a strategy count, as in PinBuffer().
+	 */
+	remember_eviction = (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q &&
+						 strategy == NULL);
+	if (remember_eviction && StrategyRecentlyEvicted(newHash))
+		new_usage = 2 * BUF_USAGECOUNT_ONE;
 
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
@@ -1312,7 +1922,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	 * Clearing BM_VALID here is necessary, clearing the dirtybits is just
 	 * paranoia.  We also reset the usage_count since any recency of use of
 	 * the old content is no longer relevant.  (The usage_count starts out at
-	 * 1 so that the buffer can survive one clock-sweep pass.)
+	 * 1 so that the buffer can survive one clock-sweep pass, or at 2 for a
+	 * block that's hot under the 2Q policy.)
 	 *
 	 * Make sure BM_PERMANENT is set for buffers that must be written at every
 	 * checkpoint.  Unlogged buffers only need to be written at shutdown
@@ -1324,14 +1935,16 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 				   BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_PERMANENT |
 				   BUF_USAGECOUNT_MASK);
 	if (relpersistence == RELPERSISTENCE_PERMANENT || forkNum == INIT_FORKNUM)
-		buf_state |= BM_TAG_VALID | BM_PERMANENT | BUF_USAGECOUNT_ONE;
+		buf_state |= BM_TAG_VALID | BM_PERMANENT | new_usage;
 	else
-		buf_state |= BM_TAG_VALID | BUF_USAGECOUNT_ONE;
+		buf_state |= BM_TAG_VALID | new_usage;
 
 	UnlockBufHdr(buf, buf_state);
 
 	if (oldPartitionLock != NULL)
 	{
+		if (remember_eviction)
+			StrategyRememberEviction(oldHash);
 		BufTableDelete(&oldTag, oldHash);
 		if (oldPartitionLock != newPartitionLock)
 			LWLockRelease(oldPartitionLock);
@@ -1616,7 +2229,22 @@ PinBuffer(BufferDesc *buf, BufferAccessStrategy strategy)
 			/* increase refcount */
 			buf_state += BUF_REFCOUNT_ONE;
 
-			if (strategy == NULL)
+			if (strategy == NULL &&
+				buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+			{
+				/*
+				 * 2Q policy: a cold buffer only becomes hot if it's accessed
+				 * again after the clock sweep has aged it, so that a burst of
+				 * correlated accesses doesn't promote it.  Otherwise,
+				 * increase usagecount unless already max.
+				 */
+				if (BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+					buf_state += 2 * BUF_USAGECOUNT_ONE;
+				else if (BUF_STATE_GET_USAGECOUNT(buf_state) > 1 &&
+						 BUF_STATE_GET_USAGECOUNT(buf_state) < BM_MAX_USAGE_COUNT)
+					buf_state += BUF_USAGECOUNT_ONE;
+			}
+			else if (strategy == NULL)
 			{
 				/* Default case: increase usagecount unless already max. */
 				if (BUF_STATE_GET_USAGECOUNT(buf_state) < BM_MAX_USAGE_COUNT)
@@ -1845,9 +2473,6 @@ BufferSync(int flags)
 	int			mask = BM_DIRTY;
 	WritebackContext wb_context;
 
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
-
 	/*
 	 * Unless this is a shutdown checkpoint or we have been explicitly told,
 	 * we write only permanent, dirty buffers.  But at shutdown or end of
@@ -2019,46 +2644,44 @@ BufferSync(int flags)
 	num_written = 0;
 	while (!binaryheap_empty(ts_heap))
 	{
-		BufferDesc *bufHdr = NULL;
 		CkptTsStatus *ts_stat = (CkptTsStatus *)
 		DatumGetPointer(binaryheap_first(ts_heap));
-
-		buf_id = CkptBufferIds[ts_stat->index].buf_id;
-		Assert(buf_id != -1);
-
-		bufHdr = GetBufferDescriptor(buf_id);
-
-		num_processed++;
+		CkptSortItem *first = &CkptBufferIds[ts_stat->index];
+		int			buf_ids[MAX_BUFFERS_PER_TRANSFER];
+		int			nbufs = 0;
+		int			nwritten;
 
 		/*
-		 * We don't need to acquire the lock here, because we're only looking
-		 * at a single bit. It's possible that someone else writes the buffer
-		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
-		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires the lock,
-		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
-		 * write the buffer though we didn't need to.  It doesn't seem worth
-		 * guarding against this, though.
+		 * Take the next buffer of this tablespace, along with the following
+		 * ones that held the next consecutive blocks of the same relation
+		 * fork when we sorted them, so that they can be written with a single
+		 * I/O call.  (The sort key doesn't include the database, so these
+		 * might not be the same relation after all; SyncBufferRun checks.)
 		 */
-		if (pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED)
+		do
 		{
-			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
-			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				BgWriterStats.m_buf_written_checkpoints++;
-				num_written++;
-			}
-		}
+			buf_ids[nbufs] = CkptBufferIds[ts_stat->index + nbufs].buf_id;
+			Assert(buf_ids[nbufs] != -1);
+			nbufs++;
+		} while (nbufs < MAX_BUFFERS_PER_TRANSFER &&
+				 ts_stat->num_scanned + nbufs < ts_stat->num_to_scan &&
+				 CkptBufferIds[ts_stat->index + nbufs].relNode == first->relNode &&
+				 CkptBufferIds[ts_stat->index + nbufs].forkNum == first->forkNum &&
+				 CkptBufferIds[ts_stat->index + nbufs].blockNum == first->blockNum + nbufs);
+
+		num_processed += nbufs;
+
+		nwritten = SyncBufferRun(buf_ids, nbufs, &wb_context);
+		BgWriterStats.m_buf_written_checkpoints += nwritten;
+		num_written += nwritten;
 
 		/*
 		 * Measure progress independent of actually having to flush the buffer
 		 * - otherwise writing become unbalanced.
 		 */
-		ts_stat->progress += ts_stat->progress_slice;
-		ts_stat->num_scanned++;
-		ts_stat->index++;
+		ts_stat->progress += ts_stat->progress_slice * nbufs;
+		ts_stat->num_scanned += nbufs;
+		ts_stat->index += nbufs;
 
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
@@ -2469,6 +3092,108 @@ SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * SyncBufferRun -- process a run of buffers for BufferSync
+ *
+ * buf_ids[] are buffers that held consecutive blocks of one relation fork when
+ * the checkpoint started.  Each one that is still marked BM_CHECKPOINT_NEEDED
+ * is written out as SyncOneBuffer() would, except that buffers which still
+ * hold consecutive blocks are pinned and share-locked together, and written
+ * out by FlushBufferRun() with a single I/O call.
+ *
+ * Returns the number of buffers written.
+ */
+static int
+SyncBufferRun(int *buf_ids, int nbufs, WritebackContext *wb_context)
+{
+	BufferDesc *run[MAX_BUFFERS_PER_TRANSFER];
+	int			nrun = 0;
+	int			nwritten = 0;
+
+	Assert(nbufs <= MAX_BUFFERS_PER_TRANSFER);
+
+	for (int i = 0; i < nbufs; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(buf_ids[i]);
+		uint32		buf_state;
+
+		/*
+		 * We don't need to acquire the lock here, because we're only looking
+		 * at a single bit. It's possible that someone else writes the buffer
+		 * and clears the flag right after we check, but that doesn't matter
+		 * since FlushBufferRun will then do nothing.  However, there is a
+		 * further race condition: it's conceivable that between the time we
+		 * examine the bit here and the time we acquire the lock, someone else
+		 * not only wrote the buffer but replaced it with another page and
+		 * dirtied it.  In that improbable case, we will write the buffer
+		 * though we didn't need to.  It doesn't seem worth guarding against
+		 * this, though.
+		 */
+		if (!(pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED))
+			continue;
+
+		/* Make sure we can handle the pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
+
+		/* See SyncOneBuffer about checking this without the content lock */
+		buf_state = LockBufHdr(bufHdr);
+
+		if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+		{
+			/* It's clean, so nothing to do */
+			UnlockBufHdr(bufHdr, buf_state);
+			continue;
+		}
+
+		/*
+		 * If the buffer doesn't hold the block following the last one in the
+		 * run, write out the run first, and then start a new one with this
+		 * buffer.
+		 */
+		if (nrun > 0 &&
+			!(RelFileNodeEquals(bufHdr->tag.rnode, run[0]->tag.rnode) &&
+			  bufHdr->tag.forkNum == run[0]->tag.forkNum &&
+			  bufHdr->tag.blockNum == run[nrun - 1]->tag.blockNum + 1))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			nwritten += FlushBufferRun(run, nrun, wb_context);
+			nrun = 0;
+			i--;
+			continue;
+		}
+
+		PinBuffer_Locked(bufHdr);
+
+		/*
+		 * Backends may lock several buffers at once in an order that has
+		 * nothing to do with block numbers, for instance when following
+		 * sibling links in an index.  So while we hold content locks on the
+		 * earlier buffers of the run, we must not wait for the next one;
+		 * instead, write out what we have and then retry this buffer on its
+		 * own.
+		 */
+		if (nrun == 0)
+			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+		else if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+										   LW_SHARED))
+		{
+			UnpinBuffer(bufHdr, true);
+			nwritten += FlushBufferRun(run, nrun, wb_context);
+			nrun = 0;
+			i--;
+			continue;
+		}
+
+		run[nrun++] = bufHdr;
+	}
+
+	if (nrun > 0)
+		nwritten += FlushBufferRun(run, nrun, wb_context);
+
+	return nwritten;
+}
+
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
  *
@@ -2518,14 +3243,16 @@ InitBufferPoolAccess(void)
  *
  * This is called after we have acquired a PGPROC and so can safely get
  * LWLocks.  We don't currently need to do anything at this stage ...
- * except register a shmem-exit callback.  AtProcExit_Buffers needs LWLock
+ * except register shmem-exit callbacks.  AtProcExit_Buffers needs LWLock
  * access, and thereby has to be called at the corresponding phase of
- * backend shutdown.
+ * backend shutdown; freelist.c flushes its statistics at exit.
  */
 void
 InitBufferPoolBackend(void)
 {
 	on_shmem_exit(AtProcExit_Buffers, 0);
+
+	StrategyInitBackend();
 }
 
 /*
@@ -2838,6 +3565,190 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	error_context_stack = errcallback.previous;
 }
 
+/*
+ * FlushBufferRun
+ *		Write out a run of buffers for SyncBufferRun, then release them.
+ *
+ * The buffers must be pinned and share-locked by the caller, and hold
+ * consecutive blocks of one relation fork.  Those that are still dirty once
+ * we've started I/O on them are written out as by FlushBuffer(), with one
+ * smgrwritev() call per range of consecutive such buffers.  Afterwards, all
+ * the buffers are unlocked, unpinned and scheduled for writeback.
+ *
+ * Returns the number of buffers written.
+ */
+static int
+FlushBufferRun(BufferDesc **run, int nrun, WritebackContext *wb_context)
+{
+	SMgrRelation reln = smgropen(run[0]->tag.rnode, InvalidBackendId);
+	bool		started[MAX_BUFFERS_PER_TRANSFER];
+	int			nwritten = 0;
+	int			i,
+				j;
+
+	/*
+	 * Acquire the buffers' io_in_progress locks.  If StartBufferIO returns
+	 * false, then someone else flushed the buffer before we could, so we need
+	 * not write it.  Waiting for another process's I/O here while we hold
+	 * the earlier buffers' locks is safe: the only other processes that hold
+	 * several io_in_progress locks at once are ReadBuffers() callers, and
+	 * they only wait for buffers that aren't valid yet.
+	 */
+	for (i = 0; i < nrun; i++)
+		started[i] = StartBufferIO(run[i], false);
+
+	for (i = 0; i < nrun; i = j)
+	{
+		if (!started[i])
+		{
+			j = i + 1;
+			continue;
+		}
+
+		for (j = i + 1; j < nrun && started[j]; j++)
+			;
+
+		FlushBufferRange(reln, &run[i], j - i);
+		nwritten += j - i;
+
+		for (int k = i; k < j; k++)
+			TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(run[k]->buf_id);
+	}
+
+	for (i = 0; i < nrun; i++)
+	{
+		BufferTag	tag;
+
+		LWLockRelease(BufferDescriptorGetContentLock(run[i]));
+
+		tag = run[i]->tag;
+
+		UnpinBuffer(run[i], true);
+
+		ScheduleBufferTagForWriteback(wb_context, &tag);
+	}
+
+	return nwritten;
+}
+
+/*
+ * FlushBufferRange
+ *		Subroutine for FlushBufferRun: write out buffers holding consecutive
+ *		blocks, on which we hold io_in_progress locks, with a single
+ *		smgrwritev() call.  See FlushBuffer() for the details.
+ */
+static void
+FlushBufferRange(SMgrRelation reln, BufferDesc **bufs, int nbufs)
+{
+	static char *pageCopies = NULL;
+	char	   *pages[MAX_BUFFERS_PER_TRANSFER];
+	XLogRecPtr	recptr = InvalidXLogRecPtr;
+	bool		permanent = false;
+	ErrorContextCallback errcallback;
+	instr_time	io_start,
+				io_time;
+	int			i;
+
+	/* Setup error traceback support for ereport() */
+	errcallback.callback = shared_buffer_write_error_callback;
+	errcallback.arg = (void *) bufs[0];
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	for (i = 0; i < nbufs; i++)
+	{
+		BufferDesc *buf = bufs[i];
+		uint32		buf_state;
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_START(buf->tag.forkNum,
+											buf->tag.blockNum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode);
+
+		buf_state = LockBufHdr(buf);
+
+		/* Find the highest LSN among the permanent buffers */
+		if (buf_state & BM_PERMANENT)
+		{
+			recptr = Max(recptr, BufferGetLSN(buf));
+			permanent = true;
+		}
+
+		buf_state &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(buf, buf_state);
+	}
+
+	/* Force XLOG flush up to the buffers' LSN, once for the whole range */
+	if (permanent)
+		XLogFlush(recptr);
+
+	/*
+	 * Update page checksums if desired.  As in PageSetChecksumCopy, we must
+	 * checksum private copies, and we allocate space for them once, aligned
+	 * for direct I/O.
+	 */
+	for (i = 0; i < nbufs; i++)
+	{
+		Page		page = (Page) BufHdrGetBlock(bufs[i]);
+
+		if (PageIsNew(page) || !DataChecksumsEnabled())
+			pages[i] = (char *) page;
+		else
+		{
+			if (pageCopies == NULL)
+				pageCopies = (char *)
+					TYPEALIGN(PG_IO_ALIGN_SIZE,
+							  MemoryContextAlloc(TopMemoryContext,
+												 MAX_BUFFERS_PER_TRANSFER * BLCKSZ +
+												 PG_IO_ALIGN_SIZE));
+			pages[i] = pageCopies + i * BLCKSZ;
+			memcpy(pages[i], (char *) page, BLCKSZ);
+			PageSetChecksumInplace((Page) pages[i], bufs[i]->tag.blockNum);
+		}
+	}
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	smgrwritev(reln,
+			   bufs[0]->tag.forkNum,
+			   bufs[0]->tag.blockNum,
+			   pages,
+			   nbufs,
+			   false);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SUBTRACT(io_time, io_start);
+		pgstat_count_buffer_write_time(INSTR_TIME_GET_MICROSEC(io_time));
+		INSTR_TIME_ADD(pgBufferUsage.blk_write_time, io_time);
+	}
+
+	pgBufferUsage.shared_blks_written += nbufs;
+
+	for (i = 0; i < nbufs; i++)
+	{
+		BufferDesc *buf = bufs[i];
+
+		/*
+		 * Mark the buffer as clean (unless BM_JUST_DIRTIED has become set)
+		 * and end the io_in_progress state.
+		 */
+		TerminateBufferIO(buf, true, 0);
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(buf->tag.forkNum,
+										   buf->tag.blockNum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode);
+	}
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
 /*
  * RelationGetNumberOfBlocksInFork
  *		Determines the current number of pages in the specified relation fork.
@@ -2887,6 +3798,66 @@ RelationGetNumberOfBlocksInFork(Relation relation, ForkNumber forkNum)
 	return 0;					/* keep compiler quiet */
 }
 
+/*
+ * ExtendRelationBy
+ *		Adds extend_by all-zeroes blocks to the end of the specified relation
+ *		fork, and returns the number of the first one.
+ *
+ * This is much cheaper than calling ReadBuffer(P_NEW) extend_by times, since
+ * the storage manager can allocate the space with a single system call, and
+ * the new blocks are not read into shared buffers; the caller must be
+ * prepared to find them as new (all-zeroes) pages when it reads them later.
+ *
+ * As with P_NEW, the caller must hold the relation extension lock unless
+ * the relation is local to the backend.
+ */
+BlockNumber
+ExtendRelationBy(Relation reln, ForkNumber forkNum, uint32 extend_by)
+{
+	BlockNumber firstBlock;
+
+	Assert(extend_by > 0);
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	firstBlock = smgrnblocks(reln->rd_smgr, forkNum);
+	smgrzeroextend(reln->rd_smgr, forkNum, firstBlock, extend_by, false);
+
+	/*
+	 * Like ReadBuffer(P_NEW), make sure no shared buffer holds data for any
+	 * of the new blocks; see the comments in ReadBuffer_common.  We look for
+	 * them without locking, which could miss a buffer whose mapping is being
+	 * changed concurrently, but this is only a sanity check.
+	 */
+	if (!RelationUsesLocalBuffers(reln))
+	{
+		for (uint32 i = 0; i < extend_by; i++)
+		{
+			BufferTag	tag;
+			Buffer		buffer;
+
+			INIT_BUFFERTAG(tag, reln->rd_smgr->smgr_rnode.node, forkNum,
+						   firstBlock + i);
+			if (BufTableLookupUnlocked(&tag, BufTableHashCode(&tag)) < 0)
+				continue;
+
+			buffer = ReadBufferExtended(reln, forkNum, firstBlock + i,
+										RBM_NORMAL, NULL);
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			if (!PageIsNew(BufferGetPage(buffer)))
+				ereport(ERROR,
+						(errmsg("unexpected data beyond EOF in block %u of relation %s",
+								firstBlock + i,
+								relpath(reln->rd_smgr->smgr_rnode, forkNum)),
+						 errhint("This has been seen to occur with buggy kernels; consider updating your system.")));
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	return firstBlock;
+}
+
 /*
  * BufferIsPermanent
  *		Determines whether a buffer will potentially still be around after
@@ -4084,7 +5055,8 @@ WaitIO(BufferDesc *buf)
 /*
  * StartBufferIO: begin I/O on this buffer
  *	(Assumptions)
- *	My process is executing no IO
+ *	My process is executing no IO, except on a run of buffers being read
+ *	by ReadBuffers
  *	The buffer is Pinned
  *
  * In some scenarios there are race conditions in which multiple backends
@@ -4104,7 +5076,7 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 {
 	uint32		buf_state;
 
-	Assert(!InProgressBuf);
+	Assert(NumInProgressBufs < lengthof(InProgressBufs));
 
 	for (;;)
 	{
@@ -4143,8 +5115,9 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	buf_state |= BM_IO_IN_PROGRESS;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBufs[NumInProgressBufs].buf = buf;
+	InProgressBufs[NumInProgressBufs].forInput = forInput;
+	NumInProgressBufs++;
 
 	return true;
 }
@@ -4170,8 +5143,14 @@ static void
 TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 {
 	uint32		buf_state;
+	int			i;
 
-	Assert(buf == InProgressBuf);
+	for (i = 0; i < NumInProgressBufs; i++)
+	{
+		if (InProgressBufs[i].buf == buf)
+			break;
+	}
+	Assert(i < NumInProgressBufs);
 
 	buf_state = LockBufHdr(buf);
 
@@ -4184,13 +5163,14 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 	buf_state |= set_flag_bits;
 	UnlockBufHdr(buf, buf_state);
 
-	InProgressBuf = NULL;
+	/* forget it, moving the last entry into its place */
+	InProgressBufs[i] = InProgressBufs[--NumInProgressBufs];
 
 	LWLockRelease(BufferDescriptorGetIOLock(buf));
 }
 
 /*
- * AbortBufferIO: Clean up any active buffer I/O after an error.
+ * AbortBufferIO: Clean up any active buffer I/Os after an error.
  *
  *	All LWLocks we might have held have been released,
  *	but we haven't yet released buffer pins, so the buffer is still pinned.
@@ -4201,10 +5181,10 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 void
 AbortBufferIO(void)
 {
-	BufferDesc *buf = InProgressBuf;
-
-	if (buf)
+	while (NumInProgressBufs > 0)
 	{
+		BufferDesc *buf = InProgressBufs[NumInProgressBufs - 1].buf;
+		bool		forInput = InProgressBufs[NumInProgressBufs - 1].forInput;
 		uint32		buf_state;
 
 		/*
@@ -4217,7 +5197,7 @@ AbortBufferIO(void)
 
 		buf_state = LockBufHdr(buf);
 		Assert(buf_state & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (forInput)
 		{
 			Assert(!(buf_state & BM_DIRTY));
 
@@ -15,13 +15,32 @@
  */
 #include "postgres.h"
 
+#include "funcapi.h"
+#include "miscadmin.h"
 #include "port/atomics.h"
+#include "port/pg_numa.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/pg_shmem.h"
 #include "storage/proc.h"
+#include "utils/builtins.h"
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/*
+ * Parameters of the 2Q replacement policy.  Like the "Kin" and "Kout"
+ * parameters of the 2Q paper, these are the share of the buffer pool that
+ * the sweep tries to keep for cold buffers, and the number of evicted blocks
+ * remembered by ghost entries, both as a percentage of NBuffers.  We use the
+ * values the paper recommends.
+ */
+#define TWOQ_COLD_PERCENT		25
+#define TWOQ_GHOST_PERCENT		50
+
+/* GUC variable */
+int			buffer_replacement_policy = BUFFER_REPLACEMENT_CLOCK;
+
 
 /*
  * The shared freelist control information.
@@ -53,6 +72,17 @@ typedef struct
 	uint32		completePasses; /* Complete cycles of the clock sweep */
 	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
 
+	/*
+	 * Cumulative statistics about the replacement policy, shown by the
+	 * pg_stat_buffer_replacement view.  Backends add to them in batches, see
+	 * StrategyFlushReplacementStats().
+	 */
+	pg_atomic_uint64 victims;	/* buffers chosen by the clock sweep */
+	pg_atomic_uint64 demotions; /* hot buffers aged into cold ones (2Q) */
+	pg_atomic_uint64 hotSkips;	/* hot buffers passed over by the sweep (2Q) */
+	pg_atomic_uint64 ghostHits; /* misses that found a ghost entry (2Q) */
+	pg_atomic_uint64 ghostMisses;	/* misses that didn't (2Q) */
+
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
 	 * StrategyNotifyBgWriter.
@@ -63,6 +93,77 @@ typedef struct
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
 
+/*
+ * Ghost entries for the 2Q policy: a direct-mapped table remembering the
+ * buffer tag hash codes of recently evicted blocks, so that a block that's
+ * read back in soon after being evicted can be recognized as part of the
+ * working set.  An entry is overwritten by any later eviction that maps to
+ * the same slot, so the table approximates a FIFO of recent evictions
+ * without any locking.  Zero marks an empty slot.
+ */
+static pg_atomic_uint32 *GhostEntries = NULL;
+static int	NGhostEntries = 0;
+
+/*
+ * Backend-private estimate of the share of cold buffers in the pool, for the
+ * 2Q policy.  We count the unpinned buffers the clock hand has shown us, and
+ * how many of them were cold; the counts are halved regularly so that they
+ * follow changes in the workload.
+ */
+static uint32 SweepSeen = 0;
+static uint32 SweepCold = 0;
+
+/*
+ * Per-node shared state, when the buffer pool is spread over several NUMA
+ * nodes.  With numa = partition, each node has its own clock hand sweeping
+ * the node's partition of the pool, so that backends can find victim buffers
+ * in local memory.  The statistics are those of the backends running on the
+ * node, and are shown by the pg_stat_numa view.
+ */
+typedef struct
+{
+	pg_atomic_uint32 nextVictimBuffer;	/* offset within the partition */
+	pg_atomic_uint64 hits;		/* buffer hits */
+	pg_atomic_uint64 remoteHits;	/* hits on another node's partition */
+	pg_atomic_uint64 victims;	/* buffers chosen for replacement */
+	pg_atomic_uint64 remoteVictims; /* ... from another node's partition */
+} BufferNumaNode;
+
+typedef union
+{
+	BufferNumaNode node;
+	char		pad[PG_CACHE_LINE_SIZE];
+} BufferNumaNodePadded;
+
+static BufferNumaNodePadded *BufferNumaNodes = NULL;
+
+/*
+ * Statistics not yet added to the shared counters.  The counts are flushed
+ * every STATS_FLUSH_INTERVAL events, and at backend exit, so as to not add
+ * contention on the shared counters.
+ */
+#define STATS_FLUSH_INTERVAL	256
+
+/* ... of the replacement policy, for StrategyControl */
+static uint32 PendingReplacementEvents = 0;
+static uint64 PendingVictims = 0;
+static uint64 PendingDemotions = 0;
+static uint64 PendingHotSkips = 0;
+static uint64 PendingGhostHits = 0;
+static uint64 PendingGhostMisses = 0;
+
+/*
+ * ... of the NUMA node the backend was last seen running on (-1 if unknown),
+ * for BufferNumaNodes.  StrategyInitBackend() sets it before anything is
+ * counted.
+ */
+static int	MyNumaNode = -1;
+static uint32 PendingNumaEvents = 0;
+static uint64 PendingNumaHits = 0;
+static uint64 PendingNumaRemoteHits = 0;
+static uint64 PendingNumaVictims = 0;
+static uint64 PendingNumaRemoteVictims = 0;
+
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
  * This is currently the only kind of BufferAccessStrategy object, but someday
@@ -102,6 +203,12 @@ static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 									 uint32 *buf_state);
 static void AddBufferToRing(BufferAccessStrategy strategy,
 							BufferDesc *buf);
+static int	StrategyGhostEntries(void);
+static void StrategyCountVictim(int hot_skips, int demotions);
+static void StrategyFlushReplacementStats(void);
+static void StrategyCountNumaVictim(int buf_id);
+static void StrategyFlushNumaStats(void);
+static void StrategyStatsAtExit(int code, Datum arg);
 
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
@@ -168,6 +275,26 @@ ClockSweepTick(void)
 	return victim;
 }
 
+/*
+ * NumaClockSweepTick - Helper routine for StrategyGetBuffer()
+ *
+ * Like ClockSweepTick(), but for the clock hand of a node's partition of the
+ * buffer pool.  The hand's position is a free-running counter; there's no
+ * need to track complete passes here, since the background writer only
+ * follows the main clock hand.
+ */
+static inline uint32
+NumaClockSweepTick(int node)
+{
+	uint32		first = NumaNodeFirstBuffer(node);
+	uint32		nbuffers = NumaNodeFirstBuffer(node + 1) - first;
+	uint32		victim;
+
+	victim = pg_atomic_fetch_add_u32(&BufferNumaNodes[node].node.nextVictimBuffer, 1);
+
+	return first + victim % nbuffers;
+}
+
 /*
  * have_free_buffer -- a lockless check to see if there is a free buffer in
  *					   buffer pool.
@@ -196,6 +323,16 @@ have_free_buffer(void)
  *
  *	To ensure that no one else can pin the buffer before we do, we must
  *	return the buffer with the buffer header spinlock still held.
+ *
+ *	With buffer_replacement_policy = 2q, buffers whose usage_count is above
+ *	one are "hot", and the others "cold".  PinBuffer() only makes a buffer
+ *	hot when it is accessed again after the clock hand has passed it, so
+ *	that pages a query touches several times in quick succession stay cold,
+ *	and BufferAlloc() makes a block hot right away if it was evicted
+ *	recently, which it tells from the ghost entries.  Here, the sweep only
+ *	ages hot buffers while cold ones make up less than TWOQ_COLD_PERCENT of
+ *	the pool, so that a stream of pages accessed once, such as a large scan,
+ *	replaces cold buffers among themselves and leaves the hot set alone.
  */
 BufferDesc *
 StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
@@ -204,6 +341,11 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	int			bgwprocno;
 	int			trycounter;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
+	bool		twoq = (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q);
+	int			hot_skips = 0;
+	int			demotions = 0;
+	int			local_node = -1;
+	int			local_tries = 0;
 
 	/*
 	 * If given a strategy object, see whether it can select a buffer. We
@@ -305,6 +447,8 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
+				if (NumaNodes > 1)
+					StrategyCountNumaVictim(buf->buf_id);
 				return buf;
 			}
 			UnlockBufHdr(buf, local_buf_state);
@@ -312,23 +456,82 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		}
 	}
 
+	/*
+	 * If the buffer pool is partitioned across NUMA nodes, sweep the
+	 * partition of the node we're running on first, for up to one pass.  Only
+	 * if that fails do we resort to the main clock hand.
+	 */
+	if (NumaNodes > 1)
+	{
+		int			node = pg_numa_get_node();
+
+		/* statistics gathered on another node belong to that node */
+		if (node != MyNumaNode && PendingNumaEvents > 0)
+			StrategyFlushNumaStats();
+		MyNumaNode = node;
+
+		if (numa_mode == NUMA_PARTITION && MyNumaNode >= 0)
+		{
+			local_node = MyNumaNode;
+			local_tries = NumaNodeFirstBuffer(local_node + 1) -
+				NumaNodeFirstBuffer(local_node);
+		}
+	}
+
 	/* Nothing on the freelist, so run the "clock sweep" algorithm */
 	trycounter = NBuffers;
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		uint32		usagecount;
+
+		if (local_tries > 0)
+		{
+			buf = GetBufferDescriptor(NumaClockSweepTick(local_node));
+			if (--local_tries == 0)
+				trycounter = NBuffers;
+		}
+		else
+			buf = GetBufferDescriptor(ClockSweepTick());
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
 		 * it; decrement the usage_count (unless pinned) and keep scanning.
 		 */
 		local_buf_state = LockBufHdr(buf);
+		usagecount = BUF_STATE_GET_USAGECOUNT(local_buf_state);
 
 		if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0)
 		{
-			if (BUF_STATE_GET_USAGECOUNT(local_buf_state) != 0)
+			if (twoq)
+			{
+				/* update our estimate of the share of cold buffers */
+				if (++SweepSeen >= Min(NBuffers, 4096))
+				{
+					SweepSeen /= 2;
+					SweepCold /= 2;
+				}
+				if (usagecount <= 1)
+					SweepCold++;
+			}
+
+			if (usagecount > 1 && twoq &&
+				SweepCold * 100 >= SweepSeen * TWOQ_COLD_PERCENT &&
+				hot_skips < NBuffers)
+			{
+				/*
+				 * Leave the hot buffer alone, since there are enough cold
+				 * ones.  But if we've passed over every buffer in the pool
+				 * without finding a victim, our estimate must be off, and we
+				 * age hot buffers from then on.
+				 */
+				hot_skips++;
+				trycounter = NBuffers;
+			}
+			else if (usagecount != 0)
 			{
 				local_buf_state -= BUF_USAGECOUNT_ONE;
+				if (twoq && usagecount == 2)
+					demotions++;
 
 				trycounter = NBuffers;
 			}
@@ -338,6 +541,10 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
+
+				StrategyCountVictim(hot_skips, demotions);
+				if (NumaNodes > 1)
+					StrategyCountNumaVictim(buf->buf_id);
 				return buf;
 			}
 		}
@@ -456,11 +663,20 @@ StrategyShmemSize(void)
 	Size		size = 0;
 
 	/* size of lookup hash table ... see comment in StrategyInitialize */
-	size = add_size(size, BufTableShmemSize(NBuffers + NUM_BUFFER_PARTITIONS));
+	size = add_size(size, BufTableShmemSize(NBuffers));
 
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the per-node state, if the pool is spread over NUMA nodes */
+	if (NumaNodes > 1)
+		size = add_size(size, mul_size(NumaNodes, sizeof(BufferNumaNodePadded)));
+
+	/* size of the 2Q policy's ghost entries */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+		size = add_size(size, mul_size(StrategyGhostEntries(),
+									   sizeof(pg_atomic_uint32)));
+
 	return size;
 }
 
@@ -482,11 +698,10 @@ StrategyInitialize(bool init)
 	 * Since we can't tolerate running out of lookup table entries, we must be
 	 * sure to specify an adequate table size here.  The maximum steady-state
 	 * usage is of course NBuffers entries, but BufferAlloc() tries to insert
-	 * a new entry before deleting the old.  In principle this could be
-	 * happening in each partition concurrently, so we could need as many as
-	 * NBuffers + NUM_BUFFER_PARTITIONS entries.
+	 * a new entry before deleting the old, so buf_table.c sets aside two
+	 * entries for each buffer.
 	 */
-	InitBufTable(NBuffers + NUM_BUFFER_PARTITIONS);
+	InitBufTable(NBuffers);
 
 	/*
 	 * Get or create the shared strategy control block
@@ -518,12 +733,285 @@ StrategyInitialize(bool init)
 		/* Clear statistics */
 		StrategyControl->completePasses = 0;
 		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+		pg_atomic_init_u64(&StrategyControl->victims, 0);
+		pg_atomic_init_u64(&StrategyControl->demotions, 0);
+		pg_atomic_init_u64(&StrategyControl->hotSkips, 0);
+		pg_atomic_init_u64(&StrategyControl->ghostHits, 0);
+		pg_atomic_init_u64(&StrategyControl->ghostMisses, 0);
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
 	}
 	else
 		Assert(!init);
+
+	/*
+	 * Get or create the per-node state, if the pool is spread over NUMA
+	 * nodes
+	 */
+	if (NumaNodes > 1)
+	{
+		BufferNumaNodes = (BufferNumaNodePadded *)
+			ShmemInitStruct("Buffer NUMA Nodes",
+							NumaNodes * sizeof(BufferNumaNodePadded),
+							&found);
+		if (!found)
+		{
+			for (int node = 0; node < NumaNodes; node++)
+			{
+				BufferNumaNode *n = &BufferNumaNodes[node].node;
+
+				pg_atomic_init_u32(&n->nextVictimBuffer, 0);
+				pg_atomic_init_u64(&n->hits, 0);
+				pg_atomic_init_u64(&n->remoteHits, 0);
+				pg_atomic_init_u64(&n->victims, 0);
+				pg_atomic_init_u64(&n->remoteVictims, 0);
+			}
+		}
+	}
+
+	/*
+	 * Get or create the ghost entries, if the 2Q policy is in use
+	 */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		NGhostEntries = StrategyGhostEntries();
+		GhostEntries = (pg_atomic_uint32 *)
+			ShmemInitStruct("Buffer Ghost Entries",
+							NGhostEntries * sizeof(pg_atomic_uint32),
+							&found);
+		if (!found)
+		{
+			for (int i = 0; i < NGhostEntries; i++)
+				pg_atomic_init_u32(&GhostEntries[i], 0);
+		}
+	}
+}
+
+/*
+ * StrategyCountNumaHit -- count a buffer hit in the NUMA statistics
+ *
+ * The caller checks that NumaNodes > 1.  A hit is remote if the buffer is in
+ * another node's partition of the pool; with numa = interleave, we can't
+ * tell, and all hits are counted as local.
+ */
+void
+StrategyCountNumaHit(int buf_id)
+{
+	PendingNumaHits++;
+	if (numa_mode == NUMA_PARTITION && MyNumaNode >= 0 &&
+		BufferGetNumaNode(buf_id) != MyNumaNode)
+		PendingNumaRemoteHits++;
+
+	if (++PendingNumaEvents >= STATS_FLUSH_INTERVAL)
+		StrategyFlushNumaStats();
+}
+
+/*
+ * StrategyCountVictim -- count a victim buffer chosen by the clock sweep,
+ * and the hot buffers the sweep skipped or demoted on the way
+ */
+static void
+StrategyCountVictim(int hot_skips, int demotions)
+{
+	PendingVictims++;
+	PendingHotSkips += hot_skips;
+	PendingDemotions += demotions;
+
+	if (++PendingReplacementEvents >= STATS_FLUSH_INTERVAL)
+		StrategyFlushReplacementStats();
+}
+
+/*
+ * StrategyFlushReplacementStats -- add our pending replacement policy
+ * statistics to the shared counters
+ */
+static void
+StrategyFlushReplacementStats(void)
+{
+	if (PendingVictims > 0)
+		pg_atomic_fetch_add_u64(&StrategyControl->victims, PendingVictims);
+	if (PendingDemotions > 0)
+		pg_atomic_fetch_add_u64(&StrategyControl->demotions, PendingDemotions);
+	if (PendingHotSkips > 0)
+		pg_atomic_fetch_add_u64(&StrategyControl->hotSkips, PendingHotSkips);
+	if (PendingGhostHits > 0)
+		pg_atomic_fetch_add_u64(&StrategyControl->ghostHits, PendingGhostHits);
+	if (PendingGhostMisses > 0)
+		pg_atomic_fetch_add_u64(&StrategyControl->ghostMisses,
+								PendingGhostMisses);
+
+	PendingReplacementEvents = 0;
+	PendingVictims = 0;
+	PendingDemotions = 0;
+	PendingHotSkips = 0;
+	PendingGhostHits = 0;
+	PendingGhostMisses = 0;
+}
+
+/*
+ * StrategyCountNumaVictim -- count a victim buffer in the NUMA statistics
+ */
+static void
+StrategyCountNumaVictim(int buf_id)
+{
+	PendingNumaVictims++;
+	if (numa_mode == NUMA_PARTITION && MyNumaNode >= 0 &&
+		BufferGetNumaNode(buf_id) != MyNumaNode)
+		PendingNumaRemoteVictims++;
+
+	if (++PendingNumaEvents >= STATS_FLUSH_INTERVAL)
+		StrategyFlushNumaStats();
+}
+
+/*
+ * StrategyFlushNumaStats -- add our pending NUMA statistics to the shared
+ * counters of our node
+ *
+ * This is also when we find out again which node we're running on, for the
+ * sake of backends that never need to allocate a buffer.
+ */
+static void
+StrategyFlushNumaStats(void)
+{
+	if (MyNumaNode >= 0)
+	{
+		BufferNumaNode *node = &BufferNumaNodes[MyNumaNode].node;
+
+		pg_atomic_fetch_add_u64(&node->hits, PendingNumaHits);
+		pg_atomic_fetch_add_u64(&node->remoteHits, PendingNumaRemoteHits);
+		pg_atomic_fetch_add_u64(&node->victims, PendingNumaVictims);
+		pg_atomic_fetch_add_u64(&node->remoteVictims, PendingNumaRemoteVictims);
+	}
+
+	PendingNumaEvents = 0;
+	PendingNumaHits = 0;
+	PendingNumaRemoteHits = 0;
+	PendingNumaVictims = 0;
+	PendingNumaRemoteVictims = 0;
+
+	MyNumaNode = pg_numa_get_node();
+}
+
+/*
+ * StrategyInitBackend -- per-backend initialization of the statistics
+ *
+ * Called from InitBufferPoolBackend(), before the backend can count any
+ * events.  Find out which NUMA node we're running on, so that the first
+ * batch of hits and victims is attributed to it, and make sure that the
+ * last, partial batch of events is counted too, however few there are.
+ */
+void
+StrategyInitBackend(void)
+{
+	if (NumaNodes > 1)
+		MyNumaNode = pg_numa_get_node();
+
+	on_shmem_exit(StrategyStatsAtExit, 0);
+}
+
+/*
+ * StrategyStatsAtExit -- flush pending statistics at backend exit
+ */
+static void
+StrategyStatsAtExit(int code, Datum arg)
+{
+	if (PendingReplacementEvents > 0)
+		StrategyFlushReplacementStats();
+	if (PendingNumaEvents > 0)
+		StrategyFlushNumaStats();
+}
+
+/*
+ * StrategyGhostEntries -- number of ghost entries for the 2Q policy
+ */
+static int
+StrategyGhostEntries(void)
+{
+	return Max(NBuffers / 100 * TWOQ_GHOST_PERCENT, 16);
+}
+
+/*
+ * StrategyRememberEviction -- remember that a block was evicted
+ *
+ * hashcode is the BufTableHashCode() of the evicted block's buffer tag.
+ * BufferAlloc() calls this when it replaces a valid buffer for a caller
+ * without a BufferAccessStrategy, if the 2Q policy is in use.
+ */
+void
+StrategyRememberEviction(uint32 hashcode)
+{
+	Assert(GhostEntries != NULL);
+
+	/* never store zero, which marks an empty slot */
+	pg_atomic_write_u32(&GhostEntries[hashcode % NGhostEntries],
+						hashcode | 1);
+}
+
+/*
+ * StrategyRecentlyEvicted -- was a block evicted recently?
+ *
+ * hashcode is the BufTableHashCode() of the block's buffer tag.  Returns true
+ * if a ghost entry for it is found, and consumes the entry.  Distinct blocks
+ * can share a ghost entry, so this may occasionally give a false positive;
+ * the only consequence is that the block starts out hot.
+ */
+bool
+StrategyRecentlyEvicted(uint32 hashcode)
+{
+	pg_atomic_uint32 *entry;
+	uint32		expected = hashcode | 1;
+	bool		result;
+
+	Assert(GhostEntries != NULL);
+
+	entry = &GhostEntries[hashcode % NGhostEntries];
+	if (pg_atomic_read_u32(entry) == expected &&
+		pg_atomic_compare_exchange_u32(entry, &expected, 0))
+	{
+		PendingGhostHits++;
+		result = true;
+	}
+	else
+	{
+		PendingGhostMisses++;
+		result = false;
+	}
+
+	if (++PendingReplacementEvents >= STATS_FLUSH_INTERVAL)
+		StrategyFlushReplacementStats();
+
+	return result;
+}
+
+/*
+ * pg_stat_get_buffer_replacement -- SQL-callable access to the replacement
+ * policy's statistics, for the pg_stat_buffer_replacement view
+ */
+Datum
+pg_stat_get_buffer_replacement(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_BUFFER_REPLACEMENT_COLS	7
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_BUFFER_REPLACEMENT_COLS];
+	bool		nulls[PG_STAT_GET_BUFFER_REPLACEMENT_COLS];
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	values[0] = CStringGetTextDatum(buffer_replacement_policy == BUFFER_REPLACEMENT_2Q ?
+									"2q" : "clock");
+	values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&StrategyControl->victims));
+	values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&StrategyControl->demotions));
+	values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&StrategyControl->hotSkips));
+	values[4] = Int32GetDatum(NGhostEntries);
+	values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&StrategyControl->ghostHits));
+	values[6] = Int64GetDatum((int64) pg_atomic_read_u64(&StrategyControl->ghostMisses));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
 
@@ -702,3 +1190,75 @@ StrategyRejectBuffer(BufferAccessStrategy strategy, BufferDesc *buf)
 
 	return true;
 }
+
+/*
+ * pg_stat_get_numa -- SQL-callable access to the per-node buffer statistics,
+ * for the pg_stat_numa view
+ *
+ * Returns one row per NUMA node if the numa setting is enabled on a NUMA
+ * system, and no rows otherwise.
+ */
+Datum
+pg_stat_get_numa(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_NUMA_COLS	6
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* include our own recent activity */
+	if (NumaNodes > 1 && PendingNumaEvents > 0)
+		StrategyFlushNumaStats();
+
+	for (int i = 0; NumaNodes > 1 && i < NumaNodes; i++)
+	{
+		BufferNumaNode *node = &BufferNumaNodes[i].node;
+		Datum		values[PG_STAT_GET_NUMA_COLS];
+		bool		nulls[PG_STAT_GET_NUMA_COLS];
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = Int32GetDatum(pg_numa_node_id(i));
+		if (numa_mode == NUMA_PARTITION)
+			values[1] = Int64GetDatum(NumaNodeFirstBuffer(i + 1) -
+									  NumaNodeFirstBuffer(i));
+		else
+			nulls[1] = true;
+		values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&node->hits));
+		values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&node->remoteHits));
+		values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&node->victims));
+		values[5] = Int64GetDatum((int64) pg_atomic_read_u64(&node->remoteVictims));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -20,6 +20,7 @@
 #include "executor/instrument.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
@@ -86,9 +87,12 @@ PrefetchLocalBuffer(SMgrRelation smgr, ForkNumber forkNum,
 	else
 	{
 #ifdef USE_PREFETCH
-		/* Not in buffers, so initiate prefetch */
-		smgrprefetch(smgr, forkNum, blockNum);
-		result.initiated_io = true;
+		/* Not in buffers, so initiate prefetch, unless using direct I/O */
+		if ((io_direct_flags & IO_DIRECT_DATA) == 0)
+		{
+			smgrprefetch(smgr, forkNum, blockNum);
+			result.initiated_io = true;
+		}
 #endif							/* USE_PREFETCH */
 	}
 
@@ -524,10 +528,13 @@ GetLocalBufferStorage(void)
 		/* But not more than what we need for all remaining local bufs */
 		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
 		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
+		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ - 1);
 
-		cur_block = (char *) MemoryContextAlloc(LocalBufferContext,
-												num_bufs * BLCKSZ);
+		/* Align the buffers for direct I/O; we never free them anyway */
+		cur_block = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAlloc(LocalBufferContext,
+										 num_bufs * BLCKSZ + PG_IO_ALIGN_SIZE));
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
@@ -92,10 +92,12 @@
 #include "common/file_utils.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "port/pg_iovec.h"
 #include "portability/mem.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/resowner_private.h"
 
 /* Define PG_FLUSH_DATA_WORKS if we have an implementation for pg_flush_data */
@@ -157,6 +159,9 @@ int			max_safe_fds = FD_MINFREE;	/* default if not changed */
 /* Whether it is safe to continue running after fsync() fails. */
 bool		data_sync_retry = false;
 
+/* Which kinds of files to open with O_DIRECT; set by the io_direct GUC */
+int			io_direct_flags = 0;
+
 /* Debugging.... */
 
 #ifdef FDDEBUG
@@ -2056,6 +2061,167 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileReadV --- like FileRead, but scatters the data read into the "iovcnt"
+ * buffers described by "iov", with a single system call where possible.
+ *
+ * Returns the total number of bytes read, which may be less than requested
+ * at EOF, or -1 with errno set on failure.  iovcnt must not exceed PG_IOV_MAX.
+ */
+int
+FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		  uint32 wait_event_info)
+{
+	int			returnCode;
+	Vfd		   *vfdP;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	vfdP = &VfdCache[file];
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = pg_preadv(vfdP->fd, iov, iovcnt, offset);
+	pgstat_report_wait_end();
+
+	if (returnCode < 0)
+	{
+		/* see comments in FileRead */
+#ifdef WIN32
+		DWORD		error = GetLastError();
+
+		switch (error)
+		{
+			case ERROR_NO_SYSTEM_RESOURCES:
+				pg_usleep(1000L);
+				errno = EINTR;
+				break;
+			default:
+				_dosmaperr(error);
+				break;
+		}
+#endif
+		/* OK to retry if interrupted */
+		if (errno == EINTR)
+			goto retry;
+	}
+
+	return returnCode;
+}
+
+/*
+ * FileWriteV --- like FileWrite, but gathers the data to write from the
+ * "iovcnt" buffers described by "iov", with a single system call where
+ * possible.
+ *
+ * Returns the total number of bytes written, which may be less than
+ * requested, or -1 with errno set on failure.  iovcnt must not exceed
+ * PG_IOV_MAX.
+ */
+int
+FileWriteV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		   uint32 wait_event_info)
+{
+	int			returnCode;
+	Vfd		   *vfdP;
+	off_t		amount = 0;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	for (int i = 0; i < iovcnt; i++)
+		amount += iov[i].iov_len;
+
+	DO_DB(elog(LOG, "FileWriteV: %d (%s) " INT64_FORMAT " %d " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	vfdP = &VfdCache[file];
+
+	/* see comments in FileWrite */
+	if (temp_file_limit >= 0 && (vfdP->fdstate & FD_TEMP_FILE_LIMIT))
+	{
+		off_t		past_write = offset + amount;
+
+		if (past_write > vfdP->fileSize)
+		{
+			uint64		newTotal = temporary_files_size;
+
+			newTotal += past_write - vfdP->fileSize;
+			if (newTotal > (uint64) temp_file_limit * (uint64) 1024)
+				ereport(ERROR,
+						(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+						 errmsg("temporary file size exceeds temp_file_limit (%dkB)",
+								temp_file_limit)));
+		}
+	}
+
+retry:
+	errno = 0;
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = pg_pwritev(vfdP->fd, iov, iovcnt, offset);
+	pgstat_report_wait_end();
+
+	/* if write didn't set errno, assume problem is no disk space */
+	if (returnCode != amount && errno == 0)
+		errno = ENOSPC;
+
+	if (returnCode >= 0)
+	{
+		/*
+		 * Maintain fileSize and temporary_files_size if it's a temp file.
+		 */
+		if (vfdP->fdstate & FD_TEMP_FILE_LIMIT)
+		{
+			off_t		past_write = offset + returnCode;
+
+			if (past_write > vfdP->fileSize)
+			{
+				temporary_files_size += past_write - vfdP->fileSize;
+				vfdP->fileSize = past_write;
+			}
+		}
+	}
+	else
+	{
+		/* see comments in FileRead */
+#ifdef WIN32
+		DWORD		error = GetLastError();
+
+		switch (error)
+		{
+			case ERROR_NO_SYSTEM_RESOURCES:
+				pg_usleep(1000L);
+				errno = EINTR;
+				break;
+			default:
+				_dosmaperr(error);
+				break;
+		}
+#endif
+		/* OK to retry if interrupted */
+		if (errno == EINTR)
+			goto retry;
+	}
+
+	return returnCode;
+}
+
 int
 FileWrite(File file, char *buffer, int amount, off_t offset,
 		  uint32 wait_event_info)
@@ -2154,6 +2320,112 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileZero --- write zeroes to "amount" bytes of the file, starting at
+ * "offset".
+ *
+ * Returns 0 on success, or -1 with errno set on failure.
+ */
+int
+FileZero(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+	static char *zerobuf = NULL;
+	struct iovec iov[PG_IOV_MAX];
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileZero: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	/* suitably aligned for direct I/O */
+	if (zerobuf == NULL)
+		zerobuf = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAllocZero(TopMemoryContext,
+											 BLCKSZ + PG_IO_ALIGN_SIZE));
+
+	while (amount > 0)
+	{
+		off_t		remaining = amount;
+		int			iovcnt = 0;
+		int			written;
+
+		while (remaining > 0 && iovcnt < PG_IOV_MAX)
+		{
+			iov[iovcnt].iov_base = zerobuf;
+			iov[iovcnt].iov_len = Min(remaining, BLCKSZ);
+			remaining -= iov[iovcnt].iov_len;
+			iovcnt++;
+		}
+
+		written = FileWriteV(file, iov, iovcnt, offset, wait_event_info);
+		if (written < 0)
+			return -1;
+		if (written == 0)
+		{
+			/* see comments in FileWrite */
+			errno = ENOSPC;
+			return -1;
+		}
+
+		offset += written;
+		amount -= written;
+	}
+
+	return 0;
+}
+
+/*
+ * FileFallocate --- make sure that "amount" bytes of the file, starting at
+ * "offset", are allocated on disk, extending the file if necessary.  The
+ * new space reads as zeroes.
+ *
+ * Where posix_fallocate() is available, this doesn't require writing out
+ * the data, which makes it much cheaper than FileZero() for large amounts.
+ * Otherwise, or if the filesystem doesn't support it, we fall back to
+ * FileZero().
+ *
+ * Returns 0 on success, or -1 with errno set on failure.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileFallocate: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return -1;
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	pgstat_report_wait_end();
+
+	if (returnCode == 0)
+		return 0;
+	if (returnCode == EINTR)
+		goto retry;
+
+	/* for filesystems that don't support the operation, write zeroes */
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+	{
+		/* posix_fallocate() reports errors by return value, not errno */
+		errno = returnCode;
+		return -1;
+	}
+#endif
+
+	return FileZero(file, offset, amount, wait_event_info);
+}
+
 int
 FileSync(File file, uint32 wait_event_info)
 {
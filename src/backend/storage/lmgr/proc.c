@@ -40,6 +40,7 @@
 #include "access/xact.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "port/pg_numa.h"
 #include "postmaster/autovacuum.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
@@ -47,6 +48,7 @@
 #include "storage/condition_variable.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
+#include "storage/pg_shmem.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
@@ -88,10 +90,27 @@ static DeadLockState deadlock_state = DS_NOT_YET_CHECKED;
 /* Is a deadlock check pending? */
 static volatile sig_atomic_t got_deadlock_timeout;
 
+/*
+ * How far down its free list InitProcess() looks for a PGPROC on the
+ * backend's own NUMA node
+ */
+#define NUMA_PROC_SEARCH_LIMIT	16
+
+/*
+ * Placement of the PGPROC array on NUMA nodes, as set up by PlaceProcs():
+ * the pages starting at procNumaBase are placed on the nodes round-robin.
+ * procNumaNodes is 0 if the array wasn't placed.
+ */
+static char *procNumaBase = NULL;
+static Size procNumaPageSize = 0;
+static int	procNumaNodes = 0;
+
 static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
+static void PlaceProcs(PGPROC *procs, int nprocs);
+static int	ProcNumaNode(PGPROC *proc);
 
 
 /*
@@ -183,6 +202,7 @@ InitProcGlobal(void)
 	ProcGlobal->checkpointerLatch = NULL;
 	pg_atomic_init_u32(&ProcGlobal->procArrayGroupFirst, INVALID_PGPROCNO);
 	pg_atomic_init_u32(&ProcGlobal->clogGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u32(&ProcGlobal->walFlushGroupFirst, INVALID_PGPROCNO);
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -193,6 +213,7 @@ InitProcGlobal(void)
 	 * between groups.
 	 */
 	procs = (PGPROC *) ShmemAlloc(TotalProcs * sizeof(PGPROC));
+	PlaceProcs(procs, TotalProcs);
 	MemSet(procs, 0, TotalProcs * sizeof(PGPROC));
 	ProcGlobal->allProcs = procs;
 	/* XXX allProcCount isn't really all of them; it excludes prepared xacts */
@@ -229,6 +250,7 @@ InitProcGlobal(void)
 			LWLockInitialize(&(procs[i].fpInfoLock), LWTRANCHE_LOCK_FASTPATH);
 		}
 		procs[i].pgprocno = i;
+		procs[i].numaNode = ProcNumaNode(&procs[i]);
 
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
@@ -280,6 +302,7 @@ InitProcGlobal(void)
 		 */
 		pg_atomic_init_u32(&(procs[i].procArrayGroupNext), INVALID_PGPROCNO);
 		pg_atomic_init_u32(&(procs[i].clogGroupNext), INVALID_PGPROCNO);
+		pg_atomic_init_u32(&(procs[i].walFlushGroupNext), INVALID_PGPROCNO);
 	}
 
 	/*
@@ -294,6 +317,55 @@ InitProcGlobal(void)
 	SpinLockInit(ProcStructLock);
 }
 
+/*
+ * PlaceProcs -- place the pages of the PGPROC array on NUMA nodes
+ *
+ * With the numa setting enabled, the pages are spread over the nodes
+ * round-robin, so that each node has some PGPROCs in local memory for
+ * InitProcess() to hand out to backends running there.  This must be done
+ * before the array is first touched.
+ */
+static void
+PlaceProcs(PGPROC *procs, int nprocs)
+{
+	int			nnodes;
+	char	   *end;
+
+	if (numa_mode == NUMA_OFF || (nnodes = pg_numa_init()) < 2)
+		return;
+
+	procNumaPageSize = sysconf(_SC_PAGESIZE);
+	procNumaBase = (char *) TYPEALIGN_DOWN(procNumaPageSize, procs);
+	end = (char *) (procs + nprocs);
+
+	for (char *page = procNumaBase; page < end; page += procNumaPageSize)
+	{
+		int			node = ((page - procNumaBase) / procNumaPageSize) % nnodes;
+
+		if (pg_numa_prefer(page, procNumaPageSize, node) != 0)
+		{
+			/* this happens if the shared memory uses huge pages */
+			ereport(LOG,
+					(errmsg("could not place process structures on NUMA nodes: %m")));
+			return;
+		}
+	}
+
+	procNumaNodes = nnodes;
+}
+
+/*
+ * ProcNumaNode -- the NUMA node PlaceProcs() put a PGPROC on, or -1
+ */
+static int
+ProcNumaNode(PGPROC *proc)
+{
+	if (procNumaNodes == 0)
+		return -1;
+
+	return (((char *) proc - procNumaBase) / procNumaPageSize) % procNumaNodes;
+}
+
 /*
  * InitProcess -- initialize a per-process data structure for this backend
  */
@@ -301,6 +373,7 @@ void
 InitProcess(void)
 {
 	PGPROC	   *volatile *procgloballist;
+	int			numa_node = -1;
 
 	/*
 	 * ProcGlobal should be set up already (if we are a backend, we inherit
@@ -312,6 +385,10 @@ InitProcess(void)
 	if (MyProc != NULL)
 		elog(ERROR, "you already exist");
 
+	/* Find out which NUMA node we're on, to pick a PGPROC placed there */
+	if (numa_mode != NUMA_OFF)
+		numa_node = pg_numa_get_node();
+
 	/* Decide which list should supply our PGPROC. */
 	if (IsAnyAutoVacuumProcess())
 		procgloballist = &ProcGlobal->autovacFreeProcs;
@@ -335,6 +412,31 @@ InitProcess(void)
 
 	MyProc = *procgloballist;
 
+	/*
+	 * Prefer a PGPROC on our own NUMA node, if there's one near the head of
+	 * the list.  We don't search far, since we hold a spinlock.
+	 */
+	if (MyProc != NULL && numa_node >= 0 && MyProc->numaNode != numa_node)
+	{
+		PGPROC	   *prev = MyProc;
+
+		for (int n = 0; n < NUMA_PROC_SEARCH_LIMIT; n++)
+		{
+			PGPROC	   *proc = (PGPROC *) prev->links.next;
+
+			if (proc == NULL)
+				break;
+			if (proc->numaNode == numa_node)
+			{
+				prev->links.next = proc->links.next;
+				proc->links.next = (SHM_QUEUE *) MyProc;
+				MyProc = proc;
+				break;
+			}
+			prev = proc;
+		}
+	}
+
 	if (MyProc != NULL)
 	{
 		*procgloballist = (PGPROC *) MyProc->links.next;
@@ -437,6 +539,11 @@ InitProcess(void)
 	MyProc->clogGroupMemberLsn = InvalidXLogRecPtr;
 	Assert(pg_atomic_read_u32(&MyProc->clogGroupNext) == INVALID_PGPROCNO);
 
+	/* Initialize fields for group WAL flush. */
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupMemberLsn = InvalidXLogRecPtr;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch
 	 * on it.  That allows us to repoint the process latch, which so far
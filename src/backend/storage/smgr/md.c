@@ -31,6 +31,7 @@
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
+#include "port/pg_iovec.h"
 #include "postmaster/bgwriter.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
@@ -139,6 +140,38 @@ static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 							 BlockNumber blkno, bool skipFsync, int behavior);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 							  MdfdVec *seg);
+static char *_mdfd_bounce_buffer(void);
+
+/*
+ * Flags to open relation segment files with.  With io_direct=data, we bypass
+ * the kernel's page cache.
+ */
+static inline int
+_mdfd_open_flags(void)
+{
+	int			flags = O_RDWR | PG_BINARY;
+
+	if (io_direct_flags & IO_DIRECT_DATA)
+		flags |= PG_O_DIRECT;
+
+	return flags;
+}
+
+/*
+ * Does a block I/O on "buffer" need to go through the bounce buffer?  Direct
+ * I/O requires buffers aligned to PG_IO_ALIGN_SIZE.  Shared and local buffers
+ * always are, but some callers read and write pages in palloc'd or stack
+ * memory.
+ */
+#define MD_NEEDS_BOUNCE(buffer) \
+	((io_direct_flags & IO_DIRECT_DATA) != 0 && \
+	 (uintptr_t) (buffer) % PG_IO_ALIGN_SIZE != 0)
+
+/*
+ * mdzeroextend() uses posix_fallocate() when adding more than this many
+ * blocks to a segment, and writes zeroes otherwise.
+ */
+#define MD_FALLOCATE_MIN_BLOCKS	8
 
 
 /*
@@ -201,14 +234,14 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags() | O_CREAT | O_EXCL);
 
 	if (fd < 0)
 	{
 		int			save_errno = errno;
 
 		if (isRedo)
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+			fd = PathNameOpenFile(path, _mdfd_open_flags());
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -423,6 +456,9 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(blocknum >= mdnblocks(reln, forknum));
 #endif
 
+	if (MD_NEEDS_BOUNCE(buffer))
+		buffer = memcpy(_mdfd_bounce_buffer(), buffer, BLCKSZ);
+
 	/*
 	 * If a relation manages to grow to 2^32-1 blocks, refuse to extend it any
 	 * more --- we mustn't create a block whose number actually is
@@ -464,6 +500,81 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add new zeroed-out blocks to the specified relation.
+ *
+ *		Similar to mdextend(), except that it adds nblocks blocks starting at
+ *		blocknum, and the caller doesn't supply their contents.  Large
+ *		extensions are done with posix_fallocate(), which merely reserves the
+ *		space; for a few blocks, writing out zeroes is about as cheap, and
+ *		less prone to fragmenting the file on some filesystems.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, int nblocks, bool skipFsync)
+{
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/* see mdextend */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+		int			ret;
+		MdfdVec    *v;
+
+		/* don't cross a segment boundary */
+		if (segstartblock + remblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+		else
+			numblocks = remblocks;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync, EXTENSION_CREATE);
+
+		Assert(segstartblock < RELSEG_SIZE);
+		Assert(segstartblock + numblocks <= RELSEG_SIZE);
+
+		if (numblocks > MD_FALLOCATE_MIN_BLOCKS)
+			ret = FileFallocate(v->mdfd_vfd, seekpos,
+								(off_t) BLCKSZ * numblocks,
+								WAIT_EVENT_DATA_FILE_EXTEND);
+		else
+			ret = FileZero(v->mdfd_vfd, seekpos,
+						   (off_t) BLCKSZ * numblocks,
+						   WAIT_EVENT_DATA_FILE_EXTEND);
+		if (ret != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not extend file \"%s\": %m",
+							FilePathName(v->mdfd_vfd)),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		remblocks -= numblocks;
+		curblocknum += numblocks;
+	}
+}
+
 /*
  *	mdopenfork() -- Open one fork of the specified relation.
  *
@@ -487,7 +598,7 @@ mdopenfork(SMgrRelation reln, ForkNumber forknum, int behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags());
 
 	if (fd < 0)
 	{
@@ -583,6 +694,13 @@ void
 mdwriteback(SMgrRelation reln, ForkNumber forknum,
 			BlockNumber blocknum, BlockNumber nblocks)
 {
+	/*
+	 * With direct I/O, there's nothing in the kernel's page cache for us to
+	 * flush.
+	 */
+	if (io_direct_flags & IO_DIRECT_DATA)
+		return;
+
 	/*
 	 * Issue flush requests in as few requests as possible; have to split at
 	 * segment boundaries though, since those are actually separate files.
@@ -635,6 +753,7 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuffer = buffer;
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -649,7 +768,13 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
+	if (MD_NEEDS_BOUNCE(buffer))
+		iobuffer = _mdfd_bounce_buffer();
+
+	nbytes = FileRead(v->mdfd_vfd, iobuffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
+
+	if (iobuffer != buffer && nbytes > 0)
+		memcpy(buffer, iobuffer, nbytes);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -686,6 +811,97 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdreadv() -- Read the specified consecutive blocks from a relation.
+ *
+ *		buffers[i] receives block blocknum + i.  We issue one vectored read for
+ *		each run of blocks that lies within a single segment, up to PG_IOV_MAX
+ *		blocks at a time.  Short reads are treated as in mdread().  Unlike
+ *		mdread(), with direct I/O the buffers must be aligned to
+ *		PG_IO_ALIGN_SIZE.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		off_t		seekpos;
+		int			nbytes;
+		BlockNumber nblocks_this_read;
+		BlockNumber nblocks_done;
+		MdfdVec    *v;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		/* don't cross a segment boundary */
+		nblocks_this_read = Min(nblocks,
+								RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+		nblocks_this_read = Min(nblocks_this_read, PG_IOV_MAX);
+
+		for (int i = 0; i < nblocks_this_read; i++)
+		{
+			Assert(!MD_NEEDS_BOUNCE(buffers[i]));
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = BLCKSZ;
+		}
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode,
+											reln->smgr_rnode.backend);
+
+		nbytes = FileReadV(v->mdfd_vfd, iov, nblocks_this_read, seekpos,
+						   WAIT_EVENT_DATA_FILE_READ);
+
+		TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode,
+										   reln->smgr_rnode.backend,
+										   nbytes,
+										   BLCKSZ * nblocks_this_read);
+
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read blocks %u..%u in file \"%s\": %m",
+							blocknum, blocknum + nblocks_this_read - 1,
+							FilePathName(v->mdfd_vfd))));
+
+		/*
+		 * A short read that still returned some whole blocks just means we
+		 * have to go around again for the rest.  If not even the first block
+		 * could be read in full, we're at or past EOF, and we behave like
+		 * mdread() for that block.
+		 */
+		nblocks_done = nbytes / BLCKSZ;
+		if (nblocks_done == 0)
+		{
+			if (zero_damaged_pages || InRecovery)
+				MemSet(buffers[0], 0, BLCKSZ);
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								blocknum, FilePathName(v->mdfd_vfd),
+								nbytes, BLCKSZ)));
+			nblocks_done = 1;
+		}
+
+		buffers += nblocks_done;
+		blocknum += nblocks_done;
+		nblocks -= nblocks_done;
+	}
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -706,6 +922,9 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(blocknum < mdnblocks(reln, forknum));
 #endif
 
+	if (MD_NEEDS_BOUNCE(buffer))
+		buffer = memcpy(_mdfd_bounce_buffer(), buffer, BLCKSZ);
+
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_START(forknum, blocknum,
 										 reln->smgr_rnode.node.spcNode,
 										 reln->smgr_rnode.node.dbNode,
@@ -750,6 +969,100 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	mdwritev() -- Write the supplied consecutive blocks at the appropriate
+ *				  location.
+ *
+ *		buffers[i] holds block blocknum + i.  We issue one vectored write for
+ *		each run of blocks that lies within a single segment, up to PG_IOV_MAX
+ *		blocks at a time.  Otherwise this is just like mdwrite(), except that
+ *		with direct I/O the buffers must be aligned to PG_IO_ALIGN_SIZE.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum + nblocks <= mdnblocks(reln, forknum));
+#endif
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		off_t		seekpos;
+		int			nbytes;
+		BlockNumber nblocks_this_write;
+		BlockNumber nblocks_done;
+		MdfdVec    *v;
+
+		TRACE_POSTGRESQL_SMGR_MD_WRITE_START(forknum, blocknum,
+											 reln->smgr_rnode.node.spcNode,
+											 reln->smgr_rnode.node.dbNode,
+											 reln->smgr_rnode.node.relNode,
+											 reln->smgr_rnode.backend);
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		/* don't cross a segment boundary */
+		nblocks_this_write = Min(nblocks,
+								 RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+		nblocks_this_write = Min(nblocks_this_write, PG_IOV_MAX);
+
+		for (int i = 0; i < nblocks_this_write; i++)
+		{
+			Assert(!MD_NEEDS_BOUNCE(buffers[i]));
+			iov[i].iov_base = buffers[i];
+			iov[i].iov_len = BLCKSZ;
+		}
+
+		nbytes = FileWriteV(v->mdfd_vfd, iov, nblocks_this_write, seekpos,
+							WAIT_EVENT_DATA_FILE_WRITE);
+
+		TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode,
+											reln->smgr_rnode.backend,
+											nbytes,
+											BLCKSZ * nblocks_this_write);
+
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write blocks %u..%u in file \"%s\": %m",
+							blocknum, blocknum + nblocks_this_write - 1,
+							FilePathName(v->mdfd_vfd))));
+
+		/*
+		 * A short write that still wrote some whole blocks just means we have
+		 * to go around again for the rest.  Otherwise, complain as mdwrite()
+		 * would.
+		 */
+		nblocks_done = nbytes / BLCKSZ;
+		if (nblocks_done == 0 || nbytes % BLCKSZ != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not write block %u in file \"%s\": wrote only %d of %d bytes",
+							blocknum + nblocks_done,
+							FilePathName(v->mdfd_vfd),
+							nbytes % BLCKSZ, BLCKSZ),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		buffers += nblocks_done;
+		blocknum += nblocks_done;
+		nblocks -= nblocks_done;
+	}
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
@@ -1149,7 +1462,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags);
+	fd = PathNameOpenFile(fullpath, _mdfd_open_flags() | oflags);
 
 	pfree(fullpath);
 
@@ -1323,6 +1636,26 @@ _mdnblocks(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
 	return (BlockNumber) (len / BLCKSZ);
 }
 
+/*
+ * Get the bounce buffer used for direct I/O on unaligned buffers.
+ *
+ * We allocate it once and use it over on each subsequent call, like
+ * PageSetChecksumCopy() does.
+ */
+static char *
+_mdfd_bounce_buffer(void)
+{
+	static char *bounce = NULL;
+
+	if (bounce == NULL)
+		bounce = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAlloc(TopMemoryContext,
+										 BLCKSZ + PG_IO_ALIGN_SIZE));
+
+	return bounce;
+}
+
 /*
  * Sync a file to disk, given a file tag.  Write the path into an output
  * buffer so the caller can use it in error messages.
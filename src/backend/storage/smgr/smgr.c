@@ -18,10 +18,14 @@
 #include "postgres.h"
 
 #include "access/xlog.h"
+#include "access/xlogparallel.h"
 #include "lib/ilist.h"
+#include "port/atomics.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
+#include "storage/lwlock.h"
 #include "storage/md.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/hsearch.h"
 #include "utils/inval.h"
@@ -50,12 +54,21 @@ typedef struct f_smgr
 								bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 								BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, int nblocks,
+									bool skipFsync);
 	bool		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 								  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 							  BlockNumber blocknum, char *buffer);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+							   BlockNumber blocknum, char **buffers,
+							   BlockNumber nblocks);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 							   BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, char **buffers,
+								BlockNumber nblocks, bool skipFsync);
 	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
 								   BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
@@ -75,9 +88,12 @@ static const f_smgr smgrsw[] = {
 		.smgr_exists = mdexists,
 		.smgr_unlink = mdunlink,
 		.smgr_extend = mdextend,
+		.smgr_zeroextend = mdzeroextend,
 		.smgr_prefetch = mdprefetch,
 		.smgr_read = mdread,
+		.smgr_readv = mdreadv,
 		.smgr_write = mdwrite,
+		.smgr_writev = mdwritev,
 		.smgr_writeback = mdwriteback,
 		.smgr_nblocks = mdnblocks,
 		.smgr_truncate = mdtruncate,
@@ -95,8 +111,77 @@ static HTAB *SMgrRelationHash = NULL;
 
 static dlist_head unowned_relns;
 
+/*
+ * Shared relation size cache.
+ *
+ * To avoid asking the kernel for the size of a relation every time someone
+ * needs it, we keep the sizes of recently used relations in shared memory.
+ * A fixed pool of smgr_shared_relations entries is mapped by RelFileNode
+ * through a hash table protected by SMgrSharedRelationLock.  Entries are
+ * recycled in clock order when the pool is full.
+ *
+ * Each SMgrRelation remembers the entry for its relation, along with the
+ * entry's generation, which is advanced whenever the entry is recycled or
+ * invalidated.  The size of each fork is kept in a 64-bit atomic word that
+ * holds the generation in the high half and the number of blocks in the low
+ * half, so that a backend can read the size, or update it when it extends
+ * the relation, with a single atomic operation and no lock, while detecting
+ * whether the entry still describes its relation.
+ *
+ * A fork's size is InvalidBlockNumber if it's not known, and SR_FILLING
+ * while a backend is asking the kernel for it.  A backend that extends the
+ * relation while the size is being filled in resets it to unknown, so that
+ * a size measured before the extension can't be installed after it.
+ *
+ * Only permanent and unlogged relations are cached; temporary relations are
+ * private to a backend and don't suffer from the problem.  During recovery,
+ * the startup process keeps the cache up to date as it replays extensions
+ * and truncations, so that the sizes are valid on standbys too.
+ */
+#define SR_FILLING			(InvalidBlockNumber - 1)
+#define SR_WORD(gen, nblocks)	(((uint64) (gen) << 32) | (nblocks))
+#define SR_GEN(word)		((uint32) ((word) >> 32))
+#define SR_NBLOCKS(word)	((BlockNumber) (word))
+
+typedef struct SMgrSharedRelation
+{
+	/* these fields are protected by SMgrSharedRelationLock */
+	RelFileNode rnode;
+	bool		inuse;
+	bool		recently_used;
+	uint32		generation;
+
+	/* generation and size of each fork, see above */
+	pg_atomic_uint64 nblocks[MAX_FORKNUM + 1];
+} SMgrSharedRelation;
+
+typedef struct SMgrSharedRelationPool
+{
+	int			next_victim;	/* clock hand; protected by the lock */
+	SMgrSharedRelation objects[FLEXIBLE_ARRAY_MEMBER];
+} SMgrSharedRelationPool;
+
+typedef struct SMgrSharedRelationMapping
+{
+	RelFileNode rnode;			/* hash key */
+	int			index;			/* index in SMgrSharedRelationPool */
+} SMgrSharedRelationMapping;
+
+/* GUC variable */
+int			smgr_shared_relations = 1000;
+
+static SMgrSharedRelationPool *sr_pool = NULL;
+static HTAB *sr_mapping = NULL;
+
 /* local function prototypes */
 static void smgrshutdown(int code, Datum arg);
+static bool smgr_shared_attach(SMgrRelation reln);
+static void smgr_shared_forget(RelFileNode rnode);
+static BlockNumber smgr_shared_nblocks(SMgrRelation reln, ForkNumber forknum);
+static BlockNumber smgr_shared_fill(SMgrRelation reln, ForkNumber forknum,
+								   pg_atomic_uint64 *word, uint32 gen);
+static void smgr_shared_extended(SMgrRelation reln, ForkNumber forknum,
+								 BlockNumber nblocks);
 
 
 /*
@@ -122,6 +207,327 @@ smgrinit(void)
 	on_proc_exit(smgrshutdown, 0);
 }
 
+/*
+ * SMgrShmemSize -- report shared memory needed by the relation size cache
+ */
+Size
+SMgrShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(SMgrSharedRelationPool, objects);
+	size = add_size(size, mul_size(smgr_shared_relations,
+								   sizeof(SMgrSharedRelation)));
+	size = add_size(size, hash_estimate_size(smgr_shared_relations,
+											 sizeof(SMgrSharedRelationMapping)));
+
+	return size;
+}
+
+/*
+ * SMgrShmemInit -- initialize the relation size cache in shared memory
+ */
+void
+SMgrShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (smgr_shared_relations <= 0)
+		return;
+
+	sr_pool = ShmemInitStruct("SMgr Shared Relation Pool",
+							  offsetof(SMgrSharedRelationPool, objects) +
+							  smgr_shared_relations * sizeof(SMgrSharedRelation),
+							  &found);
+	if (!found)
+	{
+		sr_pool->next_victim = 0;
+		for (int i = 0; i < smgr_shared_relations; i++)
+		{
+			SMgrSharedRelation *sr = &sr_pool->objects[i];
+
+			sr->inuse = false;
+			sr->recently_used = false;
+			sr->generation = 0;
+			for (int forknum = 0; forknum <= MAX_FORKNUM; forknum++)
+				pg_atomic_init_u64(&sr->nblocks[forknum],
+								   SR_WORD(0, InvalidBlockNumber));
+		}
+	}
+
+	info.keysize = sizeof(RelFileNode);
+	info.entrysize = sizeof(SMgrSharedRelationMapping);
+	sr_mapping = ShmemInitHash("SMgr Shared Relation Mapping",
+							   smgr_shared_relations, smgr_shared_relations,
+							   &info, HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * smgr_shared_attach -- find or create the relation's shared size cache
+ *		entry, and remember it in the SMgrRelation
+ *
+ * Returns false if there's no cache, or the relation isn't cached.
+ */
+static bool
+smgr_shared_attach(SMgrRelation reln)
+{
+	RelFileNode rnode = reln->smgr_rnode.node;
+	SMgrSharedRelationMapping *mapping;
+	SMgrSharedRelation *sr;
+	bool		found;
+
+	reln->smgr_shared = NULL;
+	if (sr_pool == NULL || SmgrIsTemp(reln))
+		return false;
+
+	/* usually, somebody has set up the entry already */
+	LWLockAcquire(SMgrSharedRelationLock, LW_SHARED);
+	mapping = hash_search(sr_mapping, &rnode, HASH_FIND, NULL);
+	if (mapping != NULL)
+	{
+		sr = &sr_pool->objects[mapping->index];
+		reln->smgr_shared = sr;
+		reln->smgr_shared_generation = sr->generation;
+		sr->recently_used = true;
+		LWLockRelease(SMgrSharedRelationLock);
+		return true;
+	}
+	LWLockRelease(SMgrSharedRelationLock);
+
+	LWLockAcquire(SMgrSharedRelationLock, LW_EXCLUSIVE);
+	mapping = hash_search(sr_mapping, &rnode, HASH_FIND, NULL);
+	if (mapping == NULL)
+	{
+		/* recycle entries in clock order, sparing recently used ones */
+		for (;;)
+		{
+			sr = &sr_pool->objects[sr_pool->next_victim];
+			if (++sr_pool->next_victim >= smgr_shared_relations)
+				sr_pool->next_victim = 0;
+			if (!sr->inuse || !sr->recently_used)
+				break;
+			sr->recently_used = false;
+		}
+
+		if (sr->inuse &&
+			hash_search(sr_mapping, &sr->rnode, HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "shared relation size cache corrupted");
+		mapping = hash_search(sr_mapping, &rnode, HASH_ENTER, &found);
+		Assert(!found);
+
+		/*
+		 * Advance the generation, so that backends still pointing at the
+		 * entry see that it has been recycled.
+		 */
+		sr->generation++;
+		for (int forknum = 0; forknum <= MAX_FORKNUM; forknum++)
+			pg_atomic_write_u64(&sr->nblocks[forknum],
+								SR_WORD(sr->generation, InvalidBlockNumber));
+		sr->rnode = rnode;
+		sr->inuse = true;
+		mapping->index = sr - sr_pool->objects;
+	}
+	sr = &sr_pool->objects[mapping->index];
+	reln->smgr_shared = sr;
+	reln->smgr_shared_generation = sr->generation;
+	sr->recently_used = true;
+	LWLockRelease(SMgrSharedRelationLock);
+
+	return true;
+}
+
+/*
+ * smgr_shared_forget -- drop the cached sizes of a relation
+ *
+ * This is used when a relation's files are created or unlinked, so that a
+ * later relation reusing the RelFileNode doesn't inherit stale sizes.
+ */
+static void
+smgr_shared_forget(RelFileNode rnode)
+{
+	SMgrSharedRelationMapping *mapping;
+
+	if (sr_pool == NULL)
+		return;
+
+	LWLockAcquire(SMgrSharedRelationLock, LW_EXCLUSIVE);
+	mapping = hash_search(sr_mapping, &rnode, HASH_REMOVE, NULL);
+	if (mapping != NULL)
+	{
+		SMgrSharedRelation *sr = &sr_pool->objects[mapping->index];
+
+		sr->generation++;
+		for (int forknum = 0; forknum <= MAX_FORKNUM; forknum++)
+			pg_atomic_write_u64(&sr->nblocks[forknum],
+								SR_WORD(sr->generation, InvalidBlockNumber));
+		sr->inuse = false;
+	}
+	LWLockRelease(SMgrSharedRelationLock);
+}
+
+/*
+ * smgr_shared_nblocks -- get the size of a fork from the shared cache, asking
+ *		the storage manager and filling in the cache if need be
+ */
+static BlockNumber
+smgr_shared_nblocks(SMgrRelation reln, ForkNumber forknum)
+{
+	pg_atomic_uint64 *word;
+	uint64		value;
+	uint32		gen;
+
+	/* (re)attach to the relation's entry, if we aren't attached already */
+	for (int tries = 0;; tries++)
+	{
+		if (reln->smgr_shared == NULL && !smgr_shared_attach(reln))
+			return smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+
+		gen = reln->smgr_shared_generation;
+		word = &reln->smgr_shared->nblocks[forknum];
+		value = pg_atomic_read_u64(word);
+		if (SR_GEN(value) == gen)
+			break;
+
+		/* the entry has been recycled, look again */
+		reln->smgr_shared = NULL;
+		if (tries > 0)
+			return smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+	}
+
+	if (SR_NBLOCKS(value) < SR_FILLING)
+		return SR_NBLOCKS(value);
+
+	if (SR_NBLOCKS(value) == SR_FILLING)
+	{
+		/* someone else is filling it in; don't wait for them */
+		return smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+	}
+
+	/*
+	 * The size is unknown.  Ask the storage manager, and install the answer
+	 * unless the relation was extended or the entry recycled meanwhile.
+	 */
+	if (!pg_atomic_compare_exchange_u64(word, &value, SR_WORD(gen, SR_FILLING)))
+		return smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+
+	return smgr_shared_fill(reln, forknum, word, gen);
+}
+
+/*
+ * smgr_shared_fill -- measure a fork whose size we have marked SR_FILLING,
+ *		and install the result if nobody has spoiled the measurement meanwhile
+ */
+static BlockNumber
+smgr_shared_fill(SMgrRelation reln, ForkNumber forknum,
+				 pg_atomic_uint64 *word, uint32 gen)
+{
+	uint64		expected = SR_WORD(gen, SR_FILLING);
+	BlockNumber result;
+
+	PG_TRY();
+	{
+		result = smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+	}
+	PG_CATCH();
+	{
+		/* let the next caller try again */
+		pg_atomic_compare_exchange_u64(word, &expected,
+									   SR_WORD(gen, InvalidBlockNumber));
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	pg_atomic_compare_exchange_u64(word, &expected,
+								   SR_WORD(gen, result < SR_FILLING ?
+										   result : InvalidBlockNumber));
+
+	return result;
+}
+
+/*
+ * smgr_shared_extended -- note in the shared cache that a fork has been
+ *		extended to at least nblocks blocks
+ */
+static void
+smgr_shared_extended(SMgrRelation reln, ForkNumber forknum,
+					 BlockNumber nblocks)
+{
+	pg_atomic_uint64 *word;
+	uint64		value;
+	uint32		gen;
+	BlockNumber newsize;
+
+	if (reln->smgr_shared == NULL && !smgr_shared_attach(reln))
+		return;
+
+	for (;;)
+	{
+		gen = reln->smgr_shared_generation;
+		word = &reln->smgr_shared->nblocks[forknum];
+		value = pg_atomic_read_u64(word);
+
+		/*
+		 * If the entry has been recycled, the relation may have been cached
+		 * anew, possibly with a size measured before our extension, so we
+		 * must look up the current entry and update that.
+		 */
+		if (SR_GEN(value) != gen)
+		{
+			if (!smgr_shared_attach(reln))
+				return;
+			continue;
+		}
+
+		if (SR_NBLOCKS(value) == InvalidBlockNumber)
+			return;				/* not known, nothing to do */
+		else if (SR_NBLOCKS(value) == SR_FILLING)
+			newsize = InvalidBlockNumber;	/* spoil the measurement */
+		else if (SR_NBLOCKS(value) >= nblocks)
+			return;				/* already knew about it */
+		else if (nblocks >= SR_FILLING)
+			newsize = InvalidBlockNumber;	/* too large to cache */
+		else
+			newsize = nblocks;
+
+		if (pg_atomic_compare_exchange_u64(word, &value,
+										   SR_WORD(gen, newsize)))
+			return;
+	}
+}
+
+/*
+ * smgrinvalidatedb() -- Forget the cached sizes of all relations of a
+ *						 database.
+ *
+ *		This must be called when a database's files are removed other than
+ *		by smgrdounlinkall(), since a later database could reuse the OIDs.
+ */
+void
+smgrinvalidatedb(Oid dbid)
+{
+	if (sr_pool == NULL)
+		return;
+
+	LWLockAcquire(SMgrSharedRelationLock, LW_EXCLUSIVE);
+	for (int i = 0; i < smgr_shared_relations; i++)
+	{
+		SMgrSharedRelation *sr = &sr_pool->objects[i];
+
+		if (!sr->inuse || sr->rnode.dbNode != dbid)
+			continue;
+
+		if (hash_search(sr_mapping, &sr->rnode, HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "shared relation size cache corrupted");
+		sr->generation++;
+		for (int forknum = 0; forknum <= MAX_FORKNUM; forknum++)
+			pg_atomic_write_u64(&sr->nblocks[forknum],
+								SR_WORD(sr->generation, InvalidBlockNumber));
+		sr->inuse = false;
+	}
+	LWLockRelease(SMgrSharedRelationLock);
+}
+
 /*
  * on_proc_exit hook for smgr cleanup during backend shutdown
  */
@@ -177,6 +583,8 @@ smgropen(RelFileNode rnode, BackendId backend)
 		reln->smgr_targblock = InvalidBlockNumber;
 		for (int i = 0; i <= MAX_FORKNUM; ++i)
 			reln->smgr_cached_nblocks[i] = InvalidBlockNumber;
+		reln->smgr_shared = NULL;
+		reln->smgr_shared_generation = 0;
 		reln->smgr_which = 0;	/* we only have md.c at present */
 
 		/* implementation-specific initialization */
@@ -333,6 +741,11 @@ smgrclosenode(RelFileNodeBackend rnode)
 void
 smgrcreate(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 {
+	/* forget any sizes cached for an earlier relation with the same node */
+	if (!SmgrIsTemp(reln))
+		smgr_shared_forget(reln->smgr_rnode.node);
+	reln->smgr_shared = NULL;
+
 	smgrsw[reln->smgr_which].smgr_create(reln, forknum, isRedo);
 }
 
@@ -430,6 +843,13 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 	for (i = 0; i < nrels; i++)
 		CacheInvalidateSmgr(rnodes[i]);
 
+	/* Forget their cached sizes, too */
+	for (i = 0; i < nrels; i++)
+	{
+		if (!RelFileNodeBackendIsTemp(rnodes[i]))
+			smgr_shared_forget(rnodes[i].node);
+	}
+
 	/*
 	 * Delete the physical file(s).
 	 *
@@ -466,6 +886,10 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_extend(reln, forknum, blocknum,
 										 buffer, skipFsync);
 
+	/* Let other backends know about the new size */
+	if (!SmgrIsTemp(reln))
+		smgr_shared_extended(reln, forknum, blocknum + 1);
+
 	/*
 	 * Normally we expect this to increase nblocks by one, but if the cached
 	 * value isn't as expected, just invalidate it so the next call asks the
@@ -477,6 +901,30 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
 }
 
+/*
+ *	smgrzeroextend() -- Add new zeroed-out blocks to a file.
+ *
+ *		Like smgrextend(), but adds nblocks all-zeroes blocks starting at
+ *		blocknum at once, which is much cheaper than adding them one by one.
+ */
+void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   int nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_zeroextend(reln, forknum, blocknum,
+											 nblocks, skipFsync);
+
+	/* Let other backends know about the new size */
+	if (!SmgrIsTemp(reln))
+		smgr_shared_extended(reln, forknum, blocknum + nblocks);
+
+	/* see smgrextend */
+	if (reln->smgr_cached_nblocks[forknum] == blocknum)
+		reln->smgr_cached_nblocks[forknum] = blocknum + nblocks;
+	else
+		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+}
+
 /*
  *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
  *
@@ -505,6 +953,22 @@ smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_read(reln, forknum, blocknum, buffer);
 }
 
+/*
+ *	smgrreadv() -- read a range of consecutive blocks from a relation into
+ *				   the supplied buffers.
+ *
+ *		Equivalent to calling smgrread() for blocks blocknum through
+ *		blocknum + nblocks - 1, with buffers[i] receiving block blocknum + i,
+ *		but lets the storage manager combine the reads into fewer I/Os.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, BlockNumber nblocks)
+{
+	smgrsw[reln->smgr_which].smgr_readv(reln, forknum, blocknum, buffers,
+										nblocks);
+}
+
 /*
  *	smgrwrite() -- Write the supplied buffer out.
  *
@@ -528,6 +992,23 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 										buffer, skipFsync);
 }
 
+/*
+ *	smgrwritev() -- Write the supplied buffers out to a range of consecutive
+ *					blocks.
+ *
+ *		Equivalent to calling smgrwrite() for blocks blocknum through
+ *		blocknum + nblocks - 1, with buffers[i] holding block blocknum + i,
+ *		but lets the storage manager combine the writes into fewer I/Os.
+ *		The same restrictions as for smgrwrite() apply.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_writev(reln, forknum, blocknum, buffers,
+										 nblocks, skipFsync);
+}
+
 
 /*
  *	smgrwriteback() -- Trigger kernel writeback for the supplied range of
@@ -552,12 +1033,21 @@ smgrnblocks(SMgrRelation reln, ForkNumber forknum)
 
 	/*
 	 * For now, we only use cached values in recovery due to lack of a shared
-	 * invalidation mechanism for changes in file size.
+	 * invalidation mechanism for changes in file size.  Not with parallel
+	 * redo, though, since then several processes extend relations.
 	 */
-	if (InRecovery && reln->smgr_cached_nblocks[forknum] != InvalidBlockNumber)
+	if (InRecovery && recovery_parallel_workers == 0 &&
+		reln->smgr_cached_nblocks[forknum] != InvalidBlockNumber)
 		return reln->smgr_cached_nblocks[forknum];
 
-	result = smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
+	/*
+	 * Otherwise, the shared size cache, which is kept up to date by all
+	 * backends, saves us from asking the kernel most of the time.
+	 */
+	if (!SmgrIsTemp(reln))
+		result = smgr_shared_nblocks(reln, forknum);
+	else
+		result = smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
 
 	reln->smgr_cached_nblocks[forknum] = result;
 
@@ -605,6 +1095,15 @@ smgrtruncate(SMgrRelation reln, ForkNumber *forknum, int nforks, BlockNumber *nb
 
 		smgrsw[reln->smgr_which].smgr_truncate(reln, forknum[i], nblocks[i]);
 
+		/*
+		 * Make other backends ask the kernel for the new size.  A backend
+		 * measuring the size concurrently won't be able to install an
+		 * outdated answer, because this advances the entry's generation.
+		 */
+		if (!SmgrIsTemp(reln))
+			smgr_shared_forget(reln->smgr_rnode.node);
+		reln->smgr_shared = NULL;
+
 		/*
 		 * We might as well update the local smgr_cached_nblocks values. The
 		 * smgr cache inval message that this function sent will cause other
@@ -150,6 +150,11 @@ static bool verify_checksums = true;
 static bool manifest = true;
 static bool manifest_force_encode = false;
 static char *manifest_checksums = NULL;
+static char *incremental_basedir = NULL;
+static char *server_compression = NULL;
+static const char *server_compress_suffix = NULL;
+static int	server_compresslevel = 0;
+static int	jobs = 1;
 
 static bool success = false;
 static bool made_new_pgdata = false;
@@ -173,6 +178,11 @@ static int	bgpipe[2] = {-1, -1};
 static pid_t bgchild = -1;
 static bool in_log_streamer = false;
 
+/* Handles to the processes receiving tablespaces of a parallel backup */
+static pid_t *backupworkers = NULL;
+static int	nbackupworkers = 0;
+static bool in_backup_worker = false;
+
 /* End position for xlog streaming, empty string if unknown yet */
 static XLogRecPtr xlogendptr;
 
@@ -193,6 +203,9 @@ static void progress_report(int tablespacenum, const char *filename, bool force,
 
 static void ReceiveTarFile(PGconn *conn, PGresult *res, int rownum);
 static void ReceiveTarCopyChunk(size_t r, char *copybuf, void *callback_data);
+static void ReceiveCompressedTarFile(PGconn *conn, PGresult *res, int rownum);
+static void ReceiveCompressedTarCopyChunk(size_t r, char *copybuf,
+										  void *callback_data);
 static void ReceiveAndUnpackTarFile(PGconn *conn, PGresult *res, int rownum);
 static void ReceiveTarAndUnpackCopyChunk(size_t r, char *copybuf,
 										 void *callback_data);
@@ -202,6 +215,8 @@ static void ReceiveBackupManifestChunk(size_t r, char *copybuf,
 static void ReceiveBackupManifestInMemory(PGconn *conn, PQExpBuffer buf);
 static void ReceiveBackupManifestInMemoryChunk(size_t r, char *copybuf,
 											   void *callback_data);
+static void StartBackupWorkers(PGresult *res, const char *backup_id);
+static void WaitForBackupWorkers(void);
 static void BaseBackup(void);
 
 static bool reached_end_position(XLogRecPtr segendpos, uint32 timeline,
@@ -214,7 +229,7 @@ static void tablespace_list_append(const char *arg);
 static void
 cleanup_directories_atexit(void)
 {
-	if (success || in_log_streamer)
+	if (success || in_log_streamer || in_backup_worker)
 		return;
 
 	if (!noclean && !checksum_failure)
@@ -277,6 +292,21 @@ kill_bgchild_atexit(void)
 	if (bgchild > 0)
 		kill(bgchild, SIGTERM);
 }
+
+/*
+ * Likewise for the processes receiving tablespaces of a parallel backup.
+ */
+static void
+kill_backupworkers_atexit(void)
+{
+	int			i;
+
+	for (i = 0; i < nbackupworkers; i++)
+	{
+		if (backupworkers[i] > 0)
+			kill(backupworkers[i], SIGTERM);
+	}
+}
 #endif
 
 /*
@@ -383,6 +413,10 @@ usage(void)
 	printf(_("\nOptions controlling the output:\n"));
 	printf(_("  -D, --pgdata=DIRECTORY receive base backup into directory\n"));
 	printf(_("  -F, --format=p|t       output format (plain (default), tar)\n"));
+	printf(_("  -i, --incremental=OLDBACKUPDIR\n"
+			 "                         take incremental backup relative to plain-format\n"
+			 "                         backup in OLDBACKUPDIR\n"));
+	printf(_("  -j, --jobs=NUM         use this many connections to receive tablespaces\n"));
 	printf(_("  -r, --max-rate=RATE    maximum transfer rate to transfer data directory\n"
 			 "                         (in kB/s, or use suffix \"k\" or \"M\")\n"));
 	printf(_("  -R, --write-recovery-conf\n"
@@ -394,6 +428,8 @@ usage(void)
 			 "                         include required WAL files with specified method\n"));
 	printf(_("  -z, --gzip             compress tar output\n"));
 	printf(_("  -Z, --compress=0-9     compress tar output with given compression level\n"));
+	printf(_("      --server-compress=gzip|lz4|zstd[:LEVEL]\n"
+			 "                         have the server compress tar output\n"));
 	printf(_("\nGeneral options:\n"));
 	printf(_("  -c, --checkpoint=fast|spread\n"
 			 "                         set fast or spread checkpointing\n"));
@@ -711,6 +747,204 @@ StartLogStreamer(char *startpos, uint32 timeline, char *sysidentifier)
 #endif
 }
 
+typedef struct
+{
+	PGconn	   *conn;
+	PGresult   *res;			/* backup header, listing the tablespaces */
+	int			worker;			/* 0 .. nbackupworkers - 1 */
+	const char *backup_id;
+} backupworker_param;
+
+/*
+ * Receive our share of the tablespaces of a parallel backup, over our own
+ * connection.  Tablespaces other than the main data directory are handed
+ * out round-robin among the workers.
+ */
+static int
+BackupWorkerMain(backupworker_param *param)
+{
+	int			ntablespace = 0;
+	int			i;
+
+	for (i = 0; i < PQntuples(param->res); i++)
+	{
+		char	   *command;
+		PGresult   *res;
+
+		if (PQgetisnull(param->res, i, 0))
+			continue;
+		if (ntablespace++ % nbackupworkers != param->worker)
+			continue;
+
+		command = psprintf("BASE_BACKUP JOIN '%s' TABLESPACE %s",
+						   param->backup_id, PQgetvalue(param->res, i, 0));
+		if (PQsendQuery(param->conn, command) == 0)
+		{
+			pg_log_error("could not send replication command \"%s\": %s",
+						 "BASE_BACKUP", PQerrorMessage(param->conn));
+			return 1;
+		}
+		pfree(command);
+
+		if (server_compression != NULL)
+			ReceiveCompressedTarFile(param->conn, param->res, i);
+		else if (format == 't')
+			ReceiveTarFile(param->conn, param->res, i);
+		else
+			ReceiveAndUnpackTarFile(param->conn, param->res, i);
+
+		res = PQgetResult(param->conn);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			pg_log_error("could not receive tablespace %s: %s",
+						 PQgetvalue(param->res, i, 0),
+						 PQerrorMessage(param->conn));
+			return 1;
+		}
+		PQclear(res);
+
+		/* Consume the end of the command, so that we can send another */
+		while ((res = PQgetResult(param->conn)) != NULL)
+			PQclear(res);
+	}
+
+	PQfinish(param->conn);
+
+	return 0;
+}
+
+/*
+ * Start the background processes that receive the tablespaces of a
+ * parallel backup, each over its own database connection.  On Unix these
+ * are fork()ed processes, on Windows threads, like the WAL streamer.
+ */
+static void
+StartBackupWorkers(PGresult *res, const char *backup_id)
+{
+	int			i;
+
+	nbackupworkers = jobs - 1;
+	backupworkers = pg_malloc0(sizeof(pid_t) * nbackupworkers);
+
+	for (i = 0; i < nbackupworkers; i++)
+	{
+		backupworker_param *param;
+
+		param = pg_malloc0(sizeof(backupworker_param));
+		param->res = res;
+		param->worker = i;
+		param->backup_id = backup_id;
+
+#ifndef WIN32
+		backupworkers[i] = fork();
+		if (backupworkers[i] == 0)
+		{
+			/*
+			 * In child process.  The main connection, the WAL streamer and
+			 * the output directory all belong to the parent, so make sure we
+			 * don't touch them on exit.  Only the parent reports progress.
+			 */
+			conn = NULL;
+			bgchild = -1;
+			nbackupworkers = 0;
+			in_backup_worker = true;
+			showprogress = false;
+
+			param->conn = GetConnection();
+			if (!param->conn)
+				/* Error message already written in GetConnection() */
+				exit(1);
+			exit(BackupWorkerMain(param));
+		}
+		else if (backupworkers[i] < 0)
+		{
+			pg_log_error("could not create background process: %m");
+			exit(1);
+		}
+		pg_free(param);
+#else							/* WIN32 */
+		param->conn = GetConnection();
+		if (!param->conn)
+			/* Error message already written in GetConnection() */
+			exit(1);
+
+		backupworkers[i] = _beginthreadex(NULL, 0, (void *) BackupWorkerMain,
+										  param, 0, NULL);
+		if (backupworkers[i] == 0)
+		{
+			pg_log_error("could not create background thread: %m");
+			exit(1);
+		}
+#endif
+	}
+
+#ifndef WIN32
+	atexit(kill_backupworkers_atexit);
+#endif
+}
+
+/*
+ * Wait for the background processes of a parallel backup to exit, and
+ * check that they all succeeded.
+ */
+static void
+WaitForBackupWorkers(void)
+{
+	int			i;
+
+	if (verbose && nbackupworkers > 0)
+		pg_log_info("waiting for tablespace receivers to finish ...");
+
+	for (i = 0; i < nbackupworkers; i++)
+	{
+#ifndef WIN32
+		int			status;
+		pid_t		r;
+
+		r = waitpid(backupworkers[i], &status, 0);
+		if (r == (pid_t) -1)
+		{
+			pg_log_error("could not wait for child process: %m");
+			exit(1);
+		}
+		backupworkers[i] = -1;
+		if (status != 0)
+		{
+			pg_log_error("%s", wait_result_to_str(status));
+			exit(1);
+		}
+#else							/* WIN32 */
+		DWORD		status;
+
+		/*
+		 * get a pointer sized version of the handle to avoid warnings about
+		 * casting to a different size on WIN64.
+		 */
+		intptr_t	handle = backupworkers[i];
+
+		if (WaitForSingleObjectEx((HANDLE) handle, INFINITE, FALSE) !=
+			WAIT_OBJECT_0)
+		{
+			_dosmaperr(GetLastError());
+			pg_log_error("could not wait for child thread: %m");
+			exit(1);
+		}
+		if (GetExitCodeThread((HANDLE) handle, &status) == 0)
+		{
+			_dosmaperr(GetLastError());
+			pg_log_error("could not get child thread exit status: %m");
+			exit(1);
+		}
+		if (status != 0)
+		{
+			pg_log_error("child thread exited with error %u",
+						 (unsigned int) status);
+			exit(1);
+		}
+#endif
+	}
+}
+
 /*
  * Verify that the given directory exists and is empty. If it does not
  * exist, it is created. If it exists but is not empty, an error will
@@ -1291,6 +1525,65 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 	 */
 }
 
+/*
+ * Receive a tar file that the server has already compressed, and write it
+ * out unchanged as base.tar.gz or <tablespaceoid>.tar.gz, or with the
+ * suffix of whatever other method was used.
+ *
+ * The server terminates the compressed archive itself, so unlike
+ * ReceiveTarFile we don't add anything at the end.
+ */
+static void
+ReceiveCompressedTarFile(PGconn *conn, PGresult *res, int rownum)
+{
+	WriteTarState state;
+
+	memset(&state, 0, sizeof(state));
+	state.tablespacenum = rownum;
+	state.basetablespace = PQgetisnull(res, rownum, 0);
+
+	if (state.basetablespace)
+		snprintf(state.filename, sizeof(state.filename),
+				 "%s/base.tar.%s", basedir, server_compress_suffix);
+	else
+		snprintf(state.filename, sizeof(state.filename), "%s/%s.tar.%s",
+				 basedir, PQgetvalue(res, rownum, 0), server_compress_suffix);
+
+	state.tarfile = fopen(state.filename, "wb");
+	if (!state.tarfile)
+	{
+		pg_log_error("could not create file \"%s\": %m", state.filename);
+		exit(1);
+	}
+
+	ReceiveCopyData(conn, ReceiveCompressedTarCopyChunk, &state);
+
+	if (fclose(state.tarfile) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", state.filename);
+		exit(1);
+	}
+
+	progress_report(rownum, state.filename, true, false);
+}
+
+/*
+ * Receive one chunk of compressed tar-format data from the server.
+ *
+ * The progress counter then tracks compressed bytes, so it will fall short
+ * of the size estimated by the server.
+ */
+static void
+ReceiveCompressedTarCopyChunk(size_t r, char *copybuf, void *callback_data)
+{
+	WriteTarState *state = callback_data;
+
+	writeTarData(state, copybuf, r);
+
+	totaldone += r;
+	progress_report(state->tablespacenum, state->filename, false, false);
+}
+
 /*
  * Receive one chunk of tar-format data from the server.
  */
@@ -1793,6 +2086,48 @@ ReceiveBackupManifestInMemoryChunk(size_t r, char *copybuf,
 	appendPQExpBuffer(buf, copybuf, r);
 }
 
+/*
+ * Read the start LSN and timeline of the plain-format backup in
+ * incremental_basedir from its backup_label, and build the INCREMENTAL
+ * clause for BASE_BACKUP.
+ */
+static char *
+GetIncrementalClause(void)
+{
+	char		path[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *fp;
+	uint32		hi = 0,
+				lo = 0;
+	TimeLineID	tli = 0;
+	bool		found_lsn = false;
+	bool		found_tli = false;
+
+	snprintf(path, sizeof(path), "%s/backup_label", incremental_basedir);
+	if ((fp = fopen(path, "r")) == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+			found_lsn = true;
+		else if (sscanf(line, "START TIMELINE: %u", &tli) == 1)
+			found_tli = true;
+	}
+	fclose(fp);
+
+	if (!found_lsn || !found_tli)
+	{
+		pg_log_error("could not find start WAL location and timeline in file \"%s\"",
+					 path);
+		exit(1);
+	}
+
+	return psprintf("INCREMENTAL '%X/%X' TIMELINE %u", hi, lo, tli);
+}
+
 static void
 BaseBackup(void)
 {
@@ -1805,6 +2140,9 @@ BaseBackup(void)
 	char	   *maxrate_clause = NULL;
 	char	   *manifest_clause = NULL;
 	char	   *manifest_checksums_clause = "";
+	char	   *incremental_clause = "";
+	char	   *compression_clause = "";
+	char	   *backup_id = NULL;
 	int			i;
 	char		xlogstart[64];
 	char		xlogend[64];
@@ -1878,6 +2216,20 @@ BaseBackup(void)
 												 manifest_checksums);
 	}
 
+	if (incremental_basedir != NULL)
+		incremental_clause = GetIncrementalClause();
+
+	if (server_compression != NULL)
+	{
+		if (server_compresslevel != 0)
+			compression_clause = psprintf("COMPRESSION '%s' COMPRESSION_LEVEL %d",
+										  server_compression,
+										  server_compresslevel);
+		else
+			compression_clause = psprintf("COMPRESSION '%s'",
+										  server_compression);
+	}
+
 	if (verbose)
 		pg_log_info("initiating base backup, waiting for checkpoint to complete");
 
@@ -1891,7 +2243,7 @@ BaseBackup(void)
 	}
 
 	basebkp =
-		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s %s %s %s",
+		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s %s %s %s %s %s %s",
 				 escaped_label,
 				 estimatesize ? "PROGRESS" : "",
 				 includewal == FETCH_WAL ? "WAL" : "",
@@ -1901,7 +2253,10 @@ BaseBackup(void)
 				 format == 't' ? "TABLESPACE_MAP" : "",
 				 verify_checksums ? "" : "NOVERIFY_CHECKSUMS",
 				 manifest_clause ? manifest_clause : "",
-				 manifest_checksums_clause);
+				 manifest_checksums_clause,
+				 incremental_clause,
+				 compression_clause,
+				 jobs > 1 ? "PARALLEL" : "");
 
 	if (PQsendQuery(conn, basebkp) == 0)
 	{
@@ -1948,6 +2303,29 @@ BaseBackup(void)
 		pg_log_info("write-ahead log start point: %s on timeline %u",
 					xlogstart, starttli);
 
+	/*
+	 * For a parallel backup, get the ID that the other connections use to
+	 * join it.
+	 */
+	if (jobs > 1)
+	{
+		res = PQgetResult(conn);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		{
+			pg_log_error("could not get parallel backup ID: %s",
+						 PQerrorMessage(conn));
+			exit(1);
+		}
+		if (PQntuples(res) != 1 || PQnfields(res) != 1)
+		{
+			pg_log_error("server returned unexpected response to BASE_BACKUP command; got %d rows and %d fields, expected %d rows and %d fields",
+						 PQntuples(res), PQnfields(res), 1, 1);
+			exit(1);
+		}
+		backup_id = pg_strdup(PQgetvalue(res, 0, 0));
+		PQclear(res);
+	}
+
 	/*
 	 * Get the header
 	 */
@@ -2008,12 +2386,25 @@ BaseBackup(void)
 		StartLogStreamer(xlogstart, starttli, sysidentifier);
 	}
 
+	/*
+	 * For a parallel backup, start the connections that receive the other
+	 * tablespaces; the server sends only the main data directory over this
+	 * one.
+	 */
+	if (jobs > 1)
+		StartBackupWorkers(res, backup_id);
+
 	/*
 	 * Start receiving chunks
 	 */
 	for (i = 0; i < PQntuples(res); i++)
 	{
-		if (format == 't')
+		if (jobs > 1 && !PQgetisnull(res, i, 0))
+			continue;
+
+		if (server_compression != NULL)
+			ReceiveCompressedTarFile(conn, res, i);
+		else if (format == 't')
 			ReceiveTarFile(conn, res, i);
 		else
 			ReceiveAndUnpackTarFile(conn, res, i);
@@ -2035,6 +2426,12 @@ BaseBackup(void)
 	if (showprogress)
 		progress_report(PQntuples(res), NULL, true, true);
 
+	/*
+	 * The server doesn't send the manifest until every tablespace has been
+	 * sent, but the workers may still be writing out the last of it.
+	 */
+	WaitForBackupWorkers();
+
 	PQclear(res);
 
 	/*
@@ -2229,6 +2626,8 @@ main(int argc, char **argv)
 		{"version", no_argument, NULL, 'V'},
 		{"pgdata", required_argument, NULL, 'D'},
 		{"format", required_argument, NULL, 'F'},
+		{"incremental", required_argument, NULL, 'i'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"checkpoint", required_argument, NULL, 'c'},
 		{"create-slot", no_argument, NULL, 'C'},
 		{"max-rate", required_argument, NULL, 'r'},
@@ -2257,6 +2656,7 @@ main(int argc, char **argv)
 		{"no-manifest", no_argument, NULL, 5},
 		{"manifest-force-encode", no_argument, NULL, 6},
 		{"manifest-checksums", required_argument, NULL, 7},
+		{"server-compress", required_argument, NULL, 8},
 		{NULL, 0, NULL, 0}
 	};
 	int			c;
@@ -2284,7 +2684,7 @@ main(int argc, char **argv)
 
 	atexit(cleanup_directories_atexit);
 
-	while ((c = getopt_long(argc, argv, "CD:F:r:RS:T:X:l:nNzZ:d:c:h:p:U:s:wWkvP",
+	while ((c = getopt_long(argc, argv, "CD:F:i:j:r:RS:T:X:l:nNzZ:d:c:h:p:U:s:wWkvP",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -2354,6 +2754,18 @@ main(int argc, char **argv)
 			case 1:
 				xlog_dir = pg_strdup(optarg);
 				break;
+			case 'i':
+				incremental_basedir = pg_strdup(optarg);
+				break;
+			case 'j':
+				jobs = atoi(optarg);
+				if (jobs < 1)
+				{
+					pg_log_error("invalid number of parallel jobs \"%s\"",
+								 optarg);
+					exit(1);
+				}
+				break;
 			case 'l':
 				label = pg_strdup(optarg);
 				break;
@@ -2437,6 +2849,47 @@ main(int argc, char **argv)
 			case 7:
 				manifest_checksums = pg_strdup(optarg);
 				break;
+			case 8:
+				{
+					char	   *sep = strchr(optarg, ':');
+					int			maxlevel;
+
+					if (sep != NULL)
+						*sep = '\0';
+					if (strcmp(optarg, "gzip") == 0)
+					{
+						server_compress_suffix = "gz";
+						maxlevel = 9;
+					}
+					else if (strcmp(optarg, "lz4") == 0)
+					{
+						server_compress_suffix = "lz4";
+						maxlevel = 12;
+					}
+					else if (strcmp(optarg, "zstd") == 0)
+					{
+						server_compress_suffix = "zst";
+						maxlevel = 22;
+					}
+					else
+					{
+						pg_log_error("invalid server compression method \"%s\", must be \"gzip\", \"lz4\" or \"zstd\"",
+									 optarg);
+						exit(1);
+					}
+					if (sep != NULL)
+					{
+						server_compresslevel = atoi(sep + 1);
+						if (server_compresslevel < 1 || server_compresslevel > maxlevel)
+						{
+							pg_log_error("invalid compression level \"%s\"",
+										 sep + 1);
+							exit(1);
+						}
+					}
+					server_compression = pg_strdup(optarg);
+				}
+				break;
 			default:
 
 				/*
@@ -2482,6 +2935,40 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (server_compression != NULL)
+	{
+		if (format != 't')
+		{
+			pg_log_error("only tar mode backups can be compressed");
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+		if (compresslevel != 0)
+		{
+			pg_log_error("%s and %s are incompatible options",
+						 "--server-compress", "--compress");
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+		if (writerecoveryconf)
+		{
+			pg_log_error("%s and %s are incompatible options",
+						 "--server-compress", "--write-recovery-conf");
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+		if (strcmp(basedir, "-") == 0)
+		{
+			pg_log_error("cannot write server-compressed backup to stdout");
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+	}
+
 	if (format == 't' && includewal == STREAM_WAL && strcmp(basedir, "-") == 0)
 	{
 		pg_log_error("cannot stream write-ahead logs in tar mode to stdout");
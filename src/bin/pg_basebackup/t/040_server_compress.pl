@@ -0,0 +1,152 @@
+# Test server-side compression of tar-format backups, with the tablespaces
+# received over parallel connections, by restoring the backups and checking
+# their contents.
+
+use strict;
+use warnings;
+use File::Basename qw(basename);
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+if ($windows_os)
+{
+	plan skip_all => 'restoring tablespaces from tar files is not supported on Windows';
+}
+if (!$ENV{TAR})
+{
+	plan skip_all => 'no tar program available';
+}
+
+# Compression methods the server was built with, and a program to
+# decompress what it produces.
+my @methods;
+push @methods, [ 'gzip', 'gz', $ENV{GZIP_PROGRAM} || 'gzip' ]
+  if ($ENV{with_zlib} // '') eq 'yes';
+push @methods, [ 'lz4', 'lz4', 'lz4' ]
+  if ($ENV{with_lz4} // '') eq 'yes';
+push @methods, [ 'zstd', 'zst', 'zstd' ]
+  if ($ENV{with_zstd} // '') eq 'yes';
+@methods = grep { system("$_->[2] --version >/dev/null 2>&1") == 0 } @methods;
+
+if (!@methods)
+{
+	plan skip_all => 'no server compression method available';
+}
+plan tests => 2 + 7 * scalar(@methods);
+
+my $tempdir = TestLib::tempdir;
+
+my $primary = get_new_node('primary');
+$primary->init(allows_streaming => 1);
+$primary->start;
+
+# Two tablespaces, so that -j 3 sends each over its own connection
+mkdir "$tempdir/ts1";
+mkdir "$tempdir/ts2";
+$primary->safe_psql(
+	'postgres', qq{
+CREATE TABLESPACE ts1 LOCATION '$tempdir/ts1';
+CREATE TABLESPACE ts2 LOCATION '$tempdir/ts2';
+CREATE TABLE t_main AS
+  SELECT g AS a, md5(g::text) AS b FROM generate_series(1, 10000) g;
+CREATE TABLE t_ts1 TABLESPACE ts1 AS
+  SELECT g AS a, md5((g * 2)::text) AS b FROM generate_series(1, 10000) g;
+CREATE TABLE t_ts2 (a int, b text) TABLESPACE ts2;
+CREATE INDEX t_ts2_a ON t_ts2 (a) TABLESPACE ts2;
+INSERT INTO t_ts2
+  SELECT g, md5((g * 3)::text) FROM generate_series(1, 10000) g;
+});
+
+my $contents_query = q{
+SELECT 'main', count(*), sum(a), md5(string_agg(b, ',' ORDER BY a)) FROM t_main
+UNION ALL
+SELECT 'ts1', count(*), sum(a), md5(string_agg(b, ',' ORDER BY a)) FROM t_ts1
+UNION ALL
+SELECT 'ts2', count(*), sum(a), md5(string_agg(b, ',' ORDER BY a)) FROM t_ts2;
+};
+my $expected = $primary->safe_psql('postgres', $contents_query);
+
+foreach my $method (@methods)
+{
+	my ($name, $suffix, $program) = @$method;
+	my $backupdir = "$tempdir/backup_$name";
+
+	$primary->command_ok(
+		[
+			'pg_basebackup', '-D', $backupdir, '-Ft', '-X', 'fetch',
+			'--no-sync', "--server-compress=$name", '-j', '3'
+		],
+		"$name: parallel backup with server compression");
+
+	my @tarfiles = glob "$backupdir/*.tar.$suffix";
+	is(scalar(@tarfiles), 3,
+		"$name: one compressed tar file for each tablespace");
+
+	# Unpack the main data directory and the tablespaces, each into its
+	# own directory.
+	my $restored = get_new_node("restored_$name");
+	my $pgdata   = $restored->data_dir;
+	my %tblspcdirs;
+	my $unpacked = 1;
+
+	mkdir $pgdata;
+	chmod 0700, $pgdata;
+	foreach my $tarfile (@tarfiles)
+	{
+		my ($what) = basename($tarfile) =~ /^(base|\d+)\.tar\./;
+		my $dir = $what eq 'base' ? $pgdata : "$tempdir/restored_${name}_$what";
+
+		mkdir $dir;
+		$tblspcdirs{$what} = $dir if $what ne 'base';
+		$unpacked &&=
+		  run_log([ $program, '-dc', $tarfile ], '>', "$backupdir/$what.tar")
+		  && system_log($ENV{TAR}, 'xf', "$backupdir/$what.tar", '-C', $dir)
+		  == 0;
+	}
+	ok($unpacked, "$name: compressed tar files can be unpacked");
+	is(scalar(keys %tblspcdirs), 2, "$name: both tablespaces were sent");
+
+	# Point the tablespaces at where we unpacked them, and check the whole
+	# thing against the manifest.
+	foreach my $oid (keys %tblspcdirs)
+	{
+		dir_symlink($tblspcdirs{$oid}, "$pgdata/pg_tblspc/$oid")
+		  or BAIL_OUT("could not symlink tablespace $oid");
+	}
+	command_ok(
+		[ 'pg_verifybackup', '-m', "$backupdir/backup_manifest", $pgdata ],
+		"$name: backup is verified");
+
+	open my $map, '>', "$pgdata/tablespace_map"
+	  or BAIL_OUT("could not rewrite tablespace_map: $!");
+	print $map "$_ $tblspcdirs{$_}\n" foreach keys %tblspcdirs;
+	close $map;
+
+	# Start it up, as init_from_backup would, and compare its contents.
+	$restored->append_conf(
+		'postgresql.conf', qq{
+port = @{[ $restored->port ]}
+unix_socket_directories = '@{[ $restored->host ]}'
+});
+	$restored->start;
+	is($restored->safe_psql('postgres', $contents_query),
+		$expected, "$name: restored backup has the same contents");
+	is( $restored->safe_psql(
+			'postgres',
+			'SELECT count(*) FROM t_ts2 WHERE a BETWEEN 100 AND 199'),
+		'100',
+		"$name: index in tablespace is usable");
+	$restored->stop;
+}
+
+# Joining a parallel backup requires an ID the server handed out.
+my ($ret, $stdout, $stderr) = $primary->psql(
+	'postgres',
+	"BASE_BACKUP JOIN '00112233445566778899aabbccddeeff' TABLESPACE 1663",
+	replication => 'database');
+isnt($ret, 0, 'joining an unknown parallel backup fails');
+like(
+	$stderr,
+	qr/parallel base backup "00112233445566778899aabbccddeeff" does not exist/,
+	'joining an unknown parallel backup reports that it does not exist');
@@ -0,0 +1,781 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_combinebackup.c
+ *	  Reconstruct a full data directory from a full backup and a chain of
+ *	  incremental backups taken with pg_basebackup --incremental.
+ *
+ * Copyright (c) 2010-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/bin/pg_combinebackup/pg_combinebackup.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/xlogdefs.h"
+#include "common/controldata_utils.h"
+#include "common/file_perm.h"
+#include "common/file_utils.h"
+#include "common/logging.h"
+#include "getopt_long.h"
+#include "replication/incremental.h"
+#include "storage/block.h"
+
+/* Information taken from the backup_label of one input backup */
+typedef struct BackupInfo
+{
+	char	   *dir;
+	XLogRecPtr	start_lsn;
+	TimeLineID	start_tli;
+	bool		incremental;
+	XLogRecPtr	prior_lsn;
+	TimeLineID	prior_tli;
+} BackupInfo;
+
+/*
+ * Where to find the contents of one block of a reconstructed file: the
+ * index of the backup holding it and the offset within that backup's file,
+ * or backup index -1 for a block that must be zero-filled.
+ */
+typedef struct BlockSource
+{
+	int			backup;
+	off_t		offset;
+} BlockSource;
+
+#define BLOCK_UNRESOLVED	(-2)
+#define BLOCK_ZERO			(-1)
+
+#define COPY_BUF_SIZE		(64 * 1024)
+
+static const char *progname;
+
+static BackupInfo *backups;
+static int	nbackups;
+static char *output_dir = NULL;
+static bool dry_run = false;
+static bool do_sync = true;
+static bool verbose = false;
+
+static void usage(void);
+static void read_backup_label(BackupInfo *backup);
+static void check_backup_chain(void);
+static void process_directory(const char *relpath);
+static void copy_file(const char *src, const char *dst);
+static void write_backup_label(const char *src, const char *dst);
+static void reconstruct_file(const char *relpath, const char *incrname,
+							 const char *dst);
+static bool read_incremental_header(const char *path, int fd,
+									IncrementalFileHeader *hdr,
+									BlockNumber **blocks);
+static void write_all(int fd, const char *buf, size_t len, const char *path);
+
+static void
+usage(void)
+{
+	printf(_("%s reconstructs a data directory from incremental backups.\n\n"), progname);
+	printf(_("Usage:\n"));
+	printf(_("  %s [OPTION]... FULLBACKUP INCREMENTAL...\n"), progname);
+	printf(_("\nOptions:\n"));
+	printf(_("  -n, --dry-run          check the backups, but don't write anything\n"));
+	printf(_("  -N, --no-sync          do not wait for changes to be written safely to disk\n"));
+	printf(_("  -o, --output=DIRECTORY output directory\n"));
+	printf(_("  -v, --verbose          output verbose messages\n"));
+	printf(_("  -V, --version          output version information, then exit\n"));
+	printf(_("  -?, --help             show this help, then exit\n"));
+	printf(_("\nThe backups must be given oldest first, each incremental backup having\n"
+			 "been taken relative to the one before it.\n"));
+	printf(_("\nReport bugs to <%s>.\n"), PACKAGE_BUGREPORT);
+	printf(_("%s home page: <%s>\n"), PACKAGE_NAME, PACKAGE_URL);
+}
+
+/*
+ * Read the start location and, for an incremental backup, the location of
+ * the prior backup from the backup_label file of a backup.
+ */
+static void
+read_backup_label(BackupInfo *backup)
+{
+	char		path[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *fp;
+	uint32		hi,
+				lo;
+	bool		found_lsn = false;
+	bool		found_tli = false;
+	bool		found_prior_lsn = false;
+	bool		found_prior_tli = false;
+
+	snprintf(path, sizeof(path), "%s/backup_label", backup->dir);
+	if ((fp = fopen(path, "r")) == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+		{
+			backup->start_lsn = ((uint64) hi) << 32 | lo;
+			found_lsn = true;
+		}
+		else if (sscanf(line, "START TIMELINE: %u", &backup->start_tli) == 1)
+			found_tli = true;
+		else if (sscanf(line, INCREMENTAL_LSN_LABEL "%X/%X", &hi, &lo) == 2)
+		{
+			backup->prior_lsn = ((uint64) hi) << 32 | lo;
+			found_prior_lsn = true;
+		}
+		else if (sscanf(line, INCREMENTAL_TLI_LABEL "%u",
+						&backup->prior_tli) == 1)
+			found_prior_tli = true;
+	}
+	fclose(fp);
+
+	if (!found_lsn || !found_tli)
+	{
+		pg_log_error("could not find start WAL location and timeline in file \"%s\"",
+					 path);
+		exit(1);
+	}
+	if (found_prior_lsn != found_prior_tli)
+	{
+		pg_log_error("file \"%s\" is corrupt: incomplete incremental backup information",
+					 path);
+		exit(1);
+	}
+	backup->incremental = found_prior_lsn;
+}
+
+/*
+ * Check that the backups form a chain: one full backup followed by
+ * incremental backups each taken relative to its predecessor, all of the
+ * same cluster.
+ */
+static void
+check_backup_chain(void)
+{
+	uint64		system_identifier = 0;
+	int			i;
+
+	for (i = 0; i < nbackups; i++)
+	{
+		BackupInfo *backup = &backups[i];
+		ControlFileData *ControlFile;
+		bool		crc_ok;
+
+		read_backup_label(backup);
+
+		if (i == 0 && backup->incremental)
+		{
+			pg_log_error("backup at \"%s\" is an incremental backup, but the first backup must be a full backup",
+						 backup->dir);
+			exit(1);
+		}
+		if (i > 0 && !backup->incremental)
+		{
+			pg_log_error("backup at \"%s\" is a full backup, but only the first backup should be a full backup",
+						 backup->dir);
+			exit(1);
+		}
+		if (i > 0 &&
+			(backup->prior_lsn != backups[i - 1].start_lsn ||
+			 backup->prior_tli != backups[i - 1].start_tli))
+		{
+			pg_log_error("backup at \"%s\" was not taken relative to backup at \"%s\"",
+						 backup->dir, backups[i - 1].dir);
+			fprintf(stderr, _("The backup depends on a backup starting at %X/%X on timeline %u, but the previous backup starts at %X/%X on timeline %u.\n"),
+					(uint32) (backup->prior_lsn >> 32),
+					(uint32) backup->prior_lsn, backup->prior_tli,
+					(uint32) (backups[i - 1].start_lsn >> 32),
+					(uint32) backups[i - 1].start_lsn,
+					backups[i - 1].start_tli);
+			exit(1);
+		}
+
+		ControlFile = get_controlfile(backup->dir, &crc_ok);
+		if (!crc_ok)
+		{
+			pg_log_error("pg_control CRC value is incorrect in backup at \"%s\"",
+						 backup->dir);
+			exit(1);
+		}
+		if (ControlFile->blcksz != BLCKSZ)
+		{
+			pg_log_error("backup at \"%s\" was taken from a cluster with block size %u, but pg_combinebackup was compiled with block size %u",
+						 backup->dir, ControlFile->blcksz, BLCKSZ);
+			exit(1);
+		}
+		if (i == 0)
+			system_identifier = ControlFile->system_identifier;
+		else if (ControlFile->system_identifier != system_identifier)
+		{
+			pg_log_error("backup at \"%s\" is from a different system than backup at \"%s\"",
+						 backup->dir, backups[0].dir);
+			exit(1);
+		}
+		pg_free(ControlFile);
+	}
+}
+
+/*
+ * Reconstruct the directory relpath (relative to the top of the backup) of
+ * the newest backup into the output directory, recursing into
+ * subdirectories.
+ */
+static void
+process_directory(const char *relpath)
+{
+	const char *newest = backups[nbackups - 1].dir;
+	char		dirpath[MAXPGPATH];
+	DIR		   *dir;
+	struct dirent *de;
+
+	snprintf(dirpath, sizeof(dirpath), "%s%s%s", newest,
+			 relpath[0] != '\0' ? "/" : "", relpath);
+	dir = opendir(dirpath);
+	if (dir == NULL)
+	{
+		pg_log_error("could not open directory \"%s\": %m", dirpath);
+		exit(1);
+	}
+
+	while (errno = 0, (de = readdir(dir)) != NULL)
+	{
+		char		srcpath[MAXPGPATH];
+		char		dstpath[MAXPGPATH];
+		char		childrel[MAXPGPATH];
+		struct stat st;
+
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		snprintf(srcpath, sizeof(srcpath), "%s/%s", dirpath, de->d_name);
+		if (lstat(srcpath, &st) < 0)
+		{
+			pg_log_error("could not stat file \"%s\": %m", srcpath);
+			exit(1);
+		}
+
+		if (relpath[0] != '\0')
+			snprintf(childrel, sizeof(childrel), "%s/%s", relpath, de->d_name);
+		else
+			strlcpy(childrel, de->d_name, sizeof(childrel));
+
+		if (S_ISDIR(st.st_mode))
+		{
+			snprintf(dstpath, sizeof(dstpath), "%s/%s", output_dir, childrel);
+			if (!dry_run && mkdir(dstpath, pg_dir_create_mode) < 0)
+			{
+				pg_log_error("could not create directory \"%s\": %m", dstpath);
+				exit(1);
+			}
+			process_directory(childrel);
+		}
+#ifndef WIN32
+		else if (S_ISLNK(st.st_mode))
+#else
+		else if (pgwin32_is_junction(srcpath))
+#endif
+		{
+			pg_log_error("backup contains symbolic link \"%s\"", srcpath);
+			fprintf(stderr, _("Backups with tablespaces are not supported.\n"));
+			exit(1);
+		}
+		else if (S_ISREG(st.st_mode))
+		{
+			/* The manifest describes the newest backup, not the result. */
+			if (relpath[0] == '\0' && strcmp(de->d_name, "backup_manifest") == 0)
+				continue;
+
+			if (strncmp(de->d_name, INCREMENTAL_PREFIX,
+						INCREMENTAL_PREFIX_LENGTH) == 0)
+			{
+				char		origrel[MAXPGPATH];
+
+				snprintf(origrel, sizeof(origrel), "%s%s%s", relpath,
+						 relpath[0] != '\0' ? "/" : "",
+						 de->d_name + INCREMENTAL_PREFIX_LENGTH);
+				snprintf(dstpath, sizeof(dstpath), "%s/%s", output_dir, origrel);
+				reconstruct_file(origrel, childrel, dstpath);
+			}
+			else
+			{
+				snprintf(dstpath, sizeof(dstpath), "%s/%s", output_dir, childrel);
+				if (relpath[0] == '\0' && strcmp(de->d_name, "backup_label") == 0)
+					write_backup_label(srcpath, dstpath);
+				else
+					copy_file(srcpath, dstpath);
+			}
+		}
+	}
+	if (errno)
+	{
+		pg_log_error("could not read directory \"%s\": %m", dirpath);
+		exit(1);
+	}
+
+	closedir(dir);
+}
+
+static void
+write_all(int fd, const char *buf, size_t len, const char *path)
+{
+	errno = 0;
+	if (write(fd, buf, len) != len)
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		pg_log_error("could not write file \"%s\": %m", path);
+		exit(1);
+	}
+}
+
+/*
+ * Copy a file that the newest backup contains in full.
+ */
+static void
+copy_file(const char *src, const char *dst)
+{
+	char	   *buf;
+	int			srcfd;
+	int			dstfd;
+	int			rc;
+
+	if (verbose)
+		pg_log_info("copying \"%s\"", src);
+	if (dry_run)
+		return;
+
+	if ((srcfd = open(src, O_RDONLY | PG_BINARY, 0)) < 0)
+	{
+		pg_log_error("could not open file \"%s\": %m", src);
+		exit(1);
+	}
+	if ((dstfd = open(dst, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+					  pg_file_create_mode)) < 0)
+	{
+		pg_log_error("could not create file \"%s\": %m", dst);
+		exit(1);
+	}
+
+	buf = pg_malloc(COPY_BUF_SIZE);
+	while ((rc = read(srcfd, buf, COPY_BUF_SIZE)) > 0)
+		write_all(dstfd, buf, rc, dst);
+	if (rc < 0)
+	{
+		pg_log_error("could not read file \"%s\": %m", src);
+		exit(1);
+	}
+
+	pg_free(buf);
+	close(srcfd);
+	if (close(dstfd) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", dst);
+		exit(1);
+	}
+}
+
+/*
+ * Copy the newest backup's backup_label, dropping the lines that mark it as
+ * an incremental backup: the result is a full backup.
+ */
+static void
+write_backup_label(const char *src, const char *dst)
+{
+	char		line[MAXPGPATH];
+	FILE	   *in;
+	FILE	   *out;
+
+	if (dry_run)
+		return;
+
+	if ((in = fopen(src, "r")) == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", src);
+		exit(1);
+	}
+	if ((out = fopen(dst, "w")) == NULL)
+	{
+		pg_log_error("could not create file \"%s\": %m", dst);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		if (strncmp(line, INCREMENTAL_LSN_LABEL,
+					strlen(INCREMENTAL_LSN_LABEL)) == 0 ||
+			strncmp(line, INCREMENTAL_TLI_LABEL,
+					strlen(INCREMENTAL_TLI_LABEL)) == 0)
+			continue;
+		if (fputs(line, out) == EOF)
+		{
+			pg_log_error("could not write file \"%s\": %m", dst);
+			exit(1);
+		}
+	}
+
+	fclose(in);
+	if (fclose(out) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", dst);
+		exit(1);
+	}
+}
+
+/*
+ * Read and validate the header and block list of an INCREMENTAL file.
+ * Returns false if the file is malformed.
+ */
+static bool
+read_incremental_header(const char *path, int fd, IncrementalFileHeader *hdr,
+						BlockNumber **blocks)
+{
+	int			rc;
+	size_t		len;
+
+	rc = read(fd, hdr, sizeof(IncrementalFileHeader));
+	if (rc < 0)
+	{
+		pg_log_error("could not read file \"%s\": %m", path);
+		exit(1);
+	}
+	if (rc != sizeof(IncrementalFileHeader) ||
+		hdr->magic != INCREMENTAL_MAGIC ||
+		hdr->num_blocks > RELSEG_SIZE ||
+		hdr->truncation_block_length > RELSEG_SIZE)
+		return false;
+
+	len = sizeof(BlockNumber) * hdr->num_blocks;
+	*blocks = pg_malloc(Max(len, 1));
+	rc = read(fd, *blocks, len);
+	if (rc < 0)
+	{
+		pg_log_error("could not read file \"%s\": %m", path);
+		exit(1);
+	}
+	return rc == len;
+}
+
+/*
+ * Reconstruct the relation segment relpath, which the newest backup holds
+ * as the INCREMENTAL file incrname, into dst.
+ *
+ * Each block comes from the newest backup that contains it, working back
+ * until a backup has the whole file.  Blocks that no backup contains are
+ * past the end of the file as of some backup and were never modified
+ * afterwards, so they must have been zero-extended; WAL replay will fix them
+ * up if not.
+ */
+static void
+reconstruct_file(const char *relpath, const char *incrname, const char *dst)
+{
+	BlockSource *source;
+	BlockNumber nblocks = 0;
+	BlockNumber unresolved;
+	int		   *fds;
+	char	   *buf;
+	int			dstfd = -1;
+	int			i;
+	BlockNumber b;
+
+	if (verbose)
+		pg_log_info("reconstructing \"%s\"", relpath);
+
+	fds = pg_malloc(sizeof(int) * nbackups);
+	for (i = 0; i < nbackups; i++)
+		fds[i] = -1;
+	source = NULL;
+	unresolved = 0;
+
+	for (i = nbackups - 1; i >= 0; i--)
+	{
+		char		path[MAXPGPATH];
+		struct stat st;
+		BlockNumber limit;
+		bool		is_incremental;
+		const char *slash;
+
+		is_incremental = (i == nbackups - 1);
+		snprintf(path, sizeof(path), "%s/%s", backups[i].dir,
+				 is_incremental ? incrname : relpath);
+		if (!is_incremental && stat(path, &st) < 0)
+		{
+			if (errno != ENOENT)
+			{
+				pg_log_error("could not stat file \"%s\": %m", path);
+				exit(1);
+			}
+
+			/* Not here in full; maybe this backup has it incrementally. */
+			slash = strrchr(relpath, '/');
+			snprintf(path, sizeof(path), "%s/%.*s%s%s", backups[i].dir,
+					 slash ? (int) (slash - relpath + 1) : 0, relpath,
+					 INCREMENTAL_PREFIX, slash ? slash + 1 : relpath);
+			is_incremental = true;
+		}
+
+		if ((fds[i] = open(path, O_RDONLY | PG_BINARY, 0)) < 0)
+		{
+			/* The relation didn't exist yet; the remaining blocks are zero. */
+			if (errno == ENOENT && i < nbackups - 1)
+				break;
+			pg_log_error("could not open file \"%s\": %m", path);
+			exit(1);
+		}
+
+		if (is_incremental)
+		{
+			IncrementalFileHeader hdr;
+			BlockNumber *blocks;
+			off_t		data_offset;
+			unsigned	j;
+
+			if (!read_incremental_header(path, fds[i], &hdr, &blocks))
+			{
+				pg_log_error("file \"%s\" is not a valid incremental file", path);
+				exit(1);
+			}
+
+			/* The newest backup determines the length of the result. */
+			if (i == nbackups - 1)
+			{
+				nblocks = hdr.truncation_block_length;
+				unresolved = nblocks;
+				source = pg_malloc(sizeof(BlockSource) * Max(nblocks, 1));
+				for (b = 0; b < nblocks; b++)
+					source[b].backup = BLOCK_UNRESOLVED;
+			}
+
+			data_offset = sizeof(IncrementalFileHeader) +
+				sizeof(BlockNumber) * hdr.num_blocks;
+			for (j = 0; j < hdr.num_blocks; j++)
+			{
+				b = blocks[j];
+				if (b < nblocks && source[b].backup == BLOCK_UNRESOLVED)
+				{
+					source[b].backup = i;
+					source[b].offset = data_offset + (off_t) j * BLCKSZ;
+					unresolved--;
+				}
+			}
+			pg_free(blocks);
+			limit = hdr.truncation_block_length;
+		}
+		else
+		{
+			limit = st.st_size / BLCKSZ;
+			for (b = 0; b < nblocks && b < limit; b++)
+			{
+				if (source[b].backup == BLOCK_UNRESOLVED)
+				{
+					source[b].backup = i;
+					source[b].offset = (off_t) b * BLCKSZ;
+					unresolved--;
+				}
+			}
+		}
+
+		/* Blocks past the end of the file at this point were zero-extended. */
+		for (b = limit; b < nblocks; b++)
+		{
+			if (source[b].backup == BLOCK_UNRESOLVED)
+			{
+				source[b].backup = BLOCK_ZERO;
+				unresolved--;
+			}
+		}
+
+		if (unresolved == 0)
+			break;
+	}
+
+	if (dry_run)
+		goto done;
+
+	if ((dstfd = open(dst, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+					  pg_file_create_mode)) < 0)
+	{
+		pg_log_error("could not create file \"%s\": %m", dst);
+		exit(1);
+	}
+
+	buf = pg_malloc(BLCKSZ);
+	for (b = 0; b < nblocks; b++)
+	{
+		if (source[b].backup < 0)
+			memset(buf, 0, BLCKSZ);
+		else
+		{
+			int			rc;
+
+			rc = pg_pread(fds[source[b].backup], buf, BLCKSZ,
+						  source[b].offset);
+			if (rc < 0)
+			{
+				pg_log_error("could not read file \"%s\": %m", relpath);
+				exit(1);
+			}
+			if (rc != BLCKSZ)
+			{
+				pg_log_error("could not read block %u of file \"%s\" in backup \"%s\": read %d of %d",
+							 b, relpath, backups[source[b].backup].dir,
+							 rc, BLCKSZ);
+				exit(1);
+			}
+		}
+		write_all(dstfd, buf, BLCKSZ, dst);
+	}
+	pg_free(buf);
+
+	if (close(dstfd) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", dst);
+		exit(1);
+	}
+
+done:
+	for (i = 0; i < nbackups; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	pg_free(fds);
+	pg_free(source);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"dry-run", no_argument, NULL, 'n'},
+		{"no-sync", no_argument, NULL, 'N'},
+		{"output", required_argument, NULL, 'o'},
+		{"verbose", no_argument, NULL, 'v'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int			c;
+	int			option_index;
+	int			i;
+
+	pg_logging_init(argv[0]);
+	set_pglocale_pgservice(argv[0], PG_TEXTDOMAIN("pg_combinebackup"));
+	progname = get_progname(argv[0]);
+
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)
+		{
+			usage();
+			exit(0);
+		}
+		if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-V") == 0)
+		{
+			puts("pg_combinebackup (PostgreSQL) " PG_VERSION);
+			exit(0);
+		}
+	}
+
+	while ((c = getopt_long(argc, argv, "nNo:v", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+			case 'n':
+				dry_run = true;
+				break;
+			case 'N':
+				do_sync = false;
+				break;
+			case 'o':
+				output_dir = pg_strdup(optarg);
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			default:
+				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
+				exit(1);
+		}
+	}
+
+	if (optind >= argc)
+	{
+		pg_log_error("no input backups specified");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
+		exit(1);
+	}
+
+	if (output_dir == NULL)
+	{
+		pg_log_error("no output directory specified");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
+		exit(1);
+	}
+	canonicalize_path(output_dir);
+
+	nbackups = argc - optind;
+	backups = pg_malloc0(sizeof(BackupInfo) * nbackups);
+	for (i = 0; i < nbackups; i++)
+	{
+		backups[i].dir = pg_strdup(argv[optind + i]);
+		canonicalize_path(backups[i].dir);
+	}
+
+	check_backup_chain();
+
+	/* Create the output directory with the same permissions as the input. */
+	if (!GetDataDirectoryCreatePerm(backups[nbackups - 1].dir))
+	{
+		pg_log_error("could not read permissions of directory \"%s\": %m",
+					 backups[nbackups - 1].dir);
+		exit(1);
+	}
+	umask(pg_mode_mask);
+
+	if (!dry_run)
+	{
+		switch (pg_check_dir(output_dir))
+		{
+			case 0:
+				if (pg_mkdir_p(output_dir, pg_dir_create_mode) == -1)
+				{
+					pg_log_error("could not create directory \"%s\": %m",
+								 output_dir);
+					exit(1);
+				}
+				break;
+			case 1:
+				if (chmod(output_dir, pg_dir_create_mode) != 0)
+				{
+					pg_log_error("could not change permissions of directory \"%s\": %m",
+								 output_dir);
+					exit(1);
+				}
+				break;
+			case -1:
+				pg_log_error("could not access directory \"%s\": %m",
+							 output_dir);
+				exit(1);
+			default:
+				pg_log_error("directory \"%s\" exists but is not empty",
+							 output_dir);
+				exit(1);
+		}
+	}
+
+	process_directory("");
+
+	if (!dry_run && do_sync)
+		fsync_pgdata(output_dir, PG_VERSION_NUM);
+
+	return 0;
+}
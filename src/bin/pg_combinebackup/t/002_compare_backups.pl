@@ -0,0 +1,113 @@
+# Take a full and an incremental backup of a cluster that has seen
+# relation truncations and a new database in between, combine them, and
+# check that the result matches the original cluster.
+
+use strict;
+use warnings;
+use File::Compare;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 10;
+
+my $tempdir = TestLib::tempdir;
+
+my $primary = get_new_node('primary');
+$primary->init(allows_streaming => 1);
+$primary->append_conf(
+	'postgresql.conf', qq{
+summarize_wal = on
+autovacuum = off
+});
+$primary->start;
+my $backup_dir = $primary->backup_dir;
+
+$primary->safe_psql(
+	'postgres', q{
+CREATE TABLE t_unchanged AS
+  SELECT g AS a, md5(g::text) AS b FROM generate_series(1, 10000) g;
+CREATE TABLE t_modified (a int PRIMARY KEY, b text);
+INSERT INTO t_modified SELECT g, md5(g::text) FROM generate_series(1, 10000) g;
+CREATE TABLE t_vacuumed AS
+  SELECT g AS a, repeat('x', 200) AS b FROM generate_series(1, 20000) g;
+CREATE TABLE t_truncated AS
+  SELECT g AS a, repeat('y', 200) AS b FROM generate_series(1, 20000) g;
+CREATE TABLE t_dropped AS SELECT g AS a FROM generate_series(1, 1000) g;
+});
+
+$primary->command_ok(
+	[
+		'pg_basebackup', '-D', "$backup_dir/full", '--checkpoint', 'fast',
+		'--no-sync'
+	],
+	'full backup');
+
+# Change some blocks, shrink one relation with VACUUM and another with
+# TRUNCATE, drop one, and create a database with some contents.
+$primary->safe_psql(
+	'postgres', q{
+UPDATE t_modified SET b = 'updated ' || a WHERE a % 100 = 0;
+INSERT INTO t_modified SELECT g, md5(g::text) FROM generate_series(10001, 15000) g;
+DELETE FROM t_vacuumed WHERE a > 2000;
+VACUUM t_vacuumed;
+TRUNCATE t_truncated;
+INSERT INTO t_truncated SELECT g, 'z' FROM generate_series(1, 100) g;
+DROP TABLE t_dropped;
+CREATE DATABASE newdb;
+});
+$primary->safe_psql(
+	'newdb', q{
+CREATE TABLE t_new AS SELECT g AS a, md5(g::text) AS b FROM generate_series(1, 5000) g;
+CREATE INDEX t_new_b ON t_new (b);
+});
+
+my $vacuumed_size = $primary->safe_psql('postgres',
+	"SELECT pg_relation_size('t_vacuumed')");
+cmp_ok($vacuumed_size, '<', 20000 * 200 / 2,
+	'VACUUM truncated t_vacuumed on the primary');
+
+$primary->command_ok(
+	[
+		'pg_basebackup', '-D', "$backup_dir/incr", '--checkpoint', 'fast',
+		'--no-sync', '--incremental', "$backup_dir/full"
+	],
+	'incremental backup');
+
+command_ok(
+	[
+		'pg_combinebackup', "$backup_dir/full", "$backup_dir/incr",
+		'-o', "$backup_dir/combined"
+	],
+	'combine full and incremental backups');
+
+my $combined = get_new_node('combined');
+$combined->init_from_backup($primary, 'combined');
+$combined->start;
+
+# The combined relations must have the sizes they have now, not the ones
+# they had at the time of the full backup.
+foreach my $rel ('t_vacuumed', 't_truncated')
+{
+	is( $combined->safe_psql(
+			'postgres', "SELECT pg_relation_size('$rel')"),
+		$primary->safe_psql('postgres', "SELECT pg_relation_size('$rel')"),
+		"$rel has the same size in the combined cluster");
+}
+
+is($combined->safe_psql('newdb', 'SELECT count(*) FROM t_new'),
+	'5000', 'new database is present in the combined cluster');
+
+# Compare the whole contents
+$primary->command_ok(
+	[
+		'pg_dumpall', '-f', "$tempdir/primary.sql", '--no-sync',
+		'-d', $primary->connstr('postgres')
+	],
+	'dump primary');
+$combined->command_ok(
+	[
+		'pg_dumpall', '-f', "$tempdir/combined.sql", '--no-sync',
+		'-d', $combined->connstr('postgres')
+	],
+	'dump combined cluster');
+ok(compare("$tempdir/primary.sql", "$tempdir/combined.sql") == 0,
+	'combined cluster has the same contents as the primary');
@@ -15,13 +15,18 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 
 #include "access/transam.h"
 #include "access/xlog_internal.h"
 #include "access/xlogreader.h"
 #include "access/xlogrecord.h"
 #include "common/fe_memutils.h"
+#include "common/hashfn.h"
 #include "common/logging.h"
+#include "common/relpath.h"
 #include "getopt_long.h"
 #include "rmgrdesc.h"
 
@@ -37,6 +42,14 @@ typedef struct XLogDumpPrivate
 	bool		endptr_reached;
 } XLogDumpPrivate;
 
+/* Output formats for --stats */
+typedef enum StatsFormat
+{
+	STATS_FORMAT_TEXT,
+	STATS_FORMAT_CSV,
+	STATS_FORMAT_JSON
+} StatsFormat;
+
 typedef struct XLogDumpConfig
 {
 	/* display options */
@@ -47,6 +60,9 @@ typedef struct XLogDumpConfig
 	bool		follow;
 	bool		stats;
 	bool		stats_per_record;
+	bool		stats_per_relation;
+	StatsFormat stats_format;
+	int			jobs;
 
 	/* filter options */
 	int			filter_by_rmgr;
@@ -63,13 +79,53 @@ typedef struct Stats
 
 #define MAX_XLINFO_TYPES 16
 
+/*
+ * Per-relation statistics, for --stats=relation.  Records that reference no
+ * block are counted under a key with an invalid relfilenode and fork.
+ */
+typedef struct RelStatsKey
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+} RelStatsKey;
+
+typedef struct RelStatsEntry
+{
+	RelStatsKey key;
+	char		status;			/* hash table entry status */
+	Stats		stats;
+} RelStatsEntry;
+
+#define SH_PREFIX		relstats
+#define SH_ELEMENT_TYPE	RelStatsEntry
+#define SH_KEY_TYPE		RelStatsKey
+#define SH_KEY			key
+#define SH_HASH_KEY(tb, key) \
+	hash_bytes((const unsigned char *) &(key), sizeof(RelStatsKey))
+#define SH_EQUAL(tb, a, b)	(memcmp(&(a), &(b), sizeof(RelStatsKey)) == 0)
+#define SH_SCOPE		static inline
+#define SH_RAW_ALLOCATOR	pg_malloc0
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
 typedef struct XLogDumpStats
 {
 	uint64		count;
 	Stats		rmgr_stats[RM_NEXT_ID];
 	Stats		record_stats[RM_NEXT_ID][MAX_XLINFO_TYPES];
+	relstats_hash *rel_stats;	/* only used for --stats=relation */
 } XLogDumpStats;
 
+/* a row of --stats output, see XLogDumpStatsRow() */
+typedef struct StatsRow
+{
+	const char *name;
+	uint64		count;
+	uint64		rec_len;
+	uint64		fpi_len;
+} StatsRow;
+
 #define fatal_error(...) do { pg_log_fatal(__VA_ARGS__); exit(EXIT_FAILURE); } while(0)
 
 static void
@@ -405,6 +461,75 @@ XLogDumpRecordLen(XLogReaderState *record, uint32 *rec_len, uint32 *fpi_len)
 	*rec_len = XLogRecGetTotalLen(record) - *fpi_len;
 }
 
+/*
+ * Store per-relation statistics for a given record.
+ *
+ * The record is counted once for each relation it references.  Its size
+ * excluding full-page images is attributed to the relation of its first
+ * block reference, and the size of each full-page image to the relation of
+ * that block.
+ */
+static void
+XLogDumpCountRecordRelations(XLogDumpStats *stats, XLogReaderState *record,
+							 uint32 rec_len)
+{
+	RelStatsKey keys[XLR_MAX_BLOCK_ID + 1];
+	int			nkeys = 0;
+	bool		rec_len_counted = false;
+	int			block_id;
+	RelStatsEntry *entry;
+	bool		found;
+
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		RelStatsKey key;
+		int			i;
+
+		memset(&key, 0, sizeof(key));
+		if (!XLogRecGetBlockTag(record, block_id, &key.rnode, &key.forknum,
+								NULL))
+			continue;
+
+		entry = relstats_insert(stats->rel_stats, key, &found);
+		if (!found)
+			memset(&entry->stats, 0, sizeof(Stats));
+
+		/* count the record only once per relation */
+		for (i = 0; i < nkeys; i++)
+		{
+			if (memcmp(&keys[i], &key, sizeof(RelStatsKey)) == 0)
+				break;
+		}
+		if (i == nkeys)
+		{
+			keys[nkeys++] = key;
+			entry->stats.count++;
+		}
+
+		if (!rec_len_counted)
+		{
+			entry->stats.rec_len += rec_len;
+			rec_len_counted = true;
+		}
+		if (XLogRecHasBlockImage(record, block_id))
+			entry->stats.fpi_len += record->blocks[block_id].bimg_len;
+	}
+
+	/* records without block references are counted together */
+	if (nkeys == 0)
+	{
+		RelStatsKey key;
+
+		memset(&key, 0, sizeof(key));
+		key.forknum = InvalidForkNumber;
+		entry = relstats_insert(stats->rel_stats, key, &found);
+		if (!found)
+			memset(&entry->stats, 0, sizeof(Stats));
+		entry->stats.count++;
+		entry->stats.rec_len += rec_len;
+	}
+}
+
 /*
  * Store per-rmgr and per-record statistics for a given record.
  */
@@ -441,8 +566,12 @@ XLogDumpCountRecord(XLogDumpConfig *config, XLogDumpStats *stats,
 	stats->record_stats[rmid][recid].count++;
 	stats->record_stats[rmid][recid].rec_len += rec_len;
 	stats->record_stats[rmid][recid].fpi_len += fpi_len;
+
+	if (config->stats_per_relation)
+		XLogDumpCountRecordRelations(stats, record, rec_len);
 }
 
+
 /*
  * Print a record to stdout
  */
@@ -503,7 +632,14 @@ XLogDumpDisplayRecord(XLogDumpConfig *config, XLogReaderState *record)
 					   blk);
 			if (XLogRecHasBlockImage(record, block_id))
 			{
-				if (XLogRecBlockImageApply(record, block_id))
+				if (XLogRecBlockImageIsRef(record, block_id))
+				{
+					XLogRecPtr	ref_lsn = XLogRecGetBlockImageRef(record, block_id);
+
+					printf(" FPW ref %X/%X",
+						   (uint32) (ref_lsn >> 32), (uint32) ref_lsn);
+				}
+				else if (XLogRecBlockImageApply(record, block_id))
 					printf(" FPW");
 				else
 					printf(" FPW for WAL verification");
@@ -528,18 +664,38 @@ XLogDumpDisplayRecord(XLogDumpConfig *config, XLogReaderState *record)
 				   blk);
 			if (XLogRecHasBlockImage(record, block_id))
 			{
-				if (record->blocks[block_id].bimg_info &
-					BKPIMAGE_IS_COMPRESSED)
+				uint8		bimg_info = record->blocks[block_id].bimg_info;
+
+				if (bimg_info & BKPIMAGE_IS_REF)
+				{
+					XLogRecPtr	ref_lsn = XLogRecGetBlockImageRef(record, block_id);
+
+					printf(" (FPW ref to %X/%X)",
+						   (uint32) (ref_lsn >> 32), (uint32) ref_lsn);
+				}
+				else if (BKPIMAGE_COMPRESSED(bimg_info))
 				{
+					const char *method;
+
+					if ((bimg_info & BKPIMAGE_COMPRESS_PGLZ) != 0)
+						method = "pglz";
+					else if ((bimg_info & BKPIMAGE_COMPRESS_LZ4) != 0)
+						method = "lz4";
+					else if ((bimg_info & BKPIMAGE_COMPRESS_ZSTD) != 0)
+						method = "zstd";
+					else
+						method = "unknown";
+
 					printf(" (FPW%s); hole: offset: %u, length: %u, "
-						   "compression saved: %u",
+						   "compression saved: %u, method: %s",
 						   XLogRecBlockImageApply(record, block_id) ?
 						   "" : " for WAL verification",
 						   record->blocks[block_id].hole_offset,
 						   record->blocks[block_id].hole_length,
 						   BLCKSZ -
 						   record->blocks[block_id].hole_length -
-						   record->blocks[block_id].bimg_len);
+						   record->blocks[block_id].bimg_len,
+						   method);
 				}
 				else
 				{
@@ -556,31 +712,110 @@ XLogDumpDisplayRecord(XLogDumpConfig *config, XLogReaderState *record)
 }
 
 /*
- * Display a single row of record counts and sizes for an rmgr or record.
+ * Print a string as a CSV field.
+ */
+static void
+print_csv_string(const char *str)
+{
+	const char *p;
+
+	putchar('"');
+	for (p = str; *p; p++)
+	{
+		if (*p == '"')
+			putchar('"');
+		putchar(*p);
+	}
+	putchar('"');
+}
+
+/*
+ * Print a string as a JSON string.
+ */
+static void
+print_json_string(const char *str)
+{
+	const char *p;
+
+	putchar('"');
+	for (p = str; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			putchar('\\');
+		if ((unsigned char) *p < 0x20)
+			printf("\\u%04x", (unsigned char) *p);
+		else
+			putchar(*p);
+	}
+	putchar('"');
+}
+
+/*
+ * Display a single row of record counts and sizes for an rmgr, record or
+ * relation.  'rel' is only set for relation rows.
  */
 static void
-XLogDumpStatsRow(const char *name,
-				 uint64 n, uint64 total_count,
-				 uint64 rec_len, uint64 total_rec_len,
-				 uint64 fpi_len, uint64 total_fpi_len,
-				 uint64 tot_len, uint64 total_len)
+XLogDumpStatsRow(XLogDumpConfig *config, const StatsRow *row,
+				 const RelStatsKey *rel, bool first,
+				 uint64 total_count, uint64 total_rec_len,
+				 uint64 total_fpi_len, uint64 total_len)
 {
+	uint64		tot_len = row->rec_len + row->fpi_len;
 	double		n_pct,
 				rec_len_pct,
 				fpi_len_pct,
 				tot_len_pct;
 
+	if (config->stats_format == STATS_FORMAT_CSV)
+	{
+		if (rel != NULL)
+			printf("%u,%u,%u,%s,", rel->rnode.spcNode, rel->rnode.dbNode,
+				   rel->rnode.relNode,
+				   rel->forknum == InvalidForkNumber ? "" : forkNames[rel->forknum]);
+		else
+		{
+			print_csv_string(row->name);
+			putchar(',');
+		}
+		printf(UINT64_FORMAT "," UINT64_FORMAT "," UINT64_FORMAT "," UINT64_FORMAT "\n",
+			   row->count, row->rec_len, row->fpi_len, tot_len);
+		return;
+	}
+
+	if (config->stats_format == STATS_FORMAT_JSON)
+	{
+		printf("%s\n    {", first ? "" : ",");
+		if (rel != NULL)
+		{
+			printf("\"tablespace\": %u, \"database\": %u, \"relfilenode\": %u, \"fork\": ",
+				   rel->rnode.spcNode, rel->rnode.dbNode, rel->rnode.relNode);
+			if (rel->forknum == InvalidForkNumber)
+				printf("null");
+			else
+				print_json_string(forkNames[rel->forknum]);
+		}
+		else
+		{
+			printf("\"type\": ");
+			print_json_string(row->name);
+		}
+		printf(", \"count\": " UINT64_FORMAT ", \"record_size\": " UINT64_FORMAT
+			   ", \"fpi_size\": " UINT64_FORMAT ", \"combined_size\": " UINT64_FORMAT "}",
+			   row->count, row->rec_len, row->fpi_len, tot_len);
+		return;
+	}
+
 	n_pct = 0;
 	if (total_count != 0)
-		n_pct = 100 * (double) n / total_count;
+		n_pct = 100 * (double) row->count / total_count;
 
 	rec_len_pct = 0;
 	if (total_rec_len != 0)
-		rec_len_pct = 100 * (double) rec_len / total_rec_len;
+		rec_len_pct = 100 * (double) row->rec_len / total_rec_len;
 
 	fpi_len_pct = 0;
 	if (total_fpi_len != 0)
-		fpi_len_pct = 100 * (double) fpi_len / total_fpi_len;
+		fpi_len_pct = 100 * (double) row->fpi_len / total_fpi_len;
 
 	tot_len_pct = 0;
 	if (total_len != 0)
@@ -591,10 +826,25 @@ XLogDumpStatsRow(const char *name,
 		   "%20" INT64_MODIFIER "u (%6.02f) "
 		   "%20" INT64_MODIFIER "u (%6.02f) "
 		   "%20" INT64_MODIFIER "u (%6.02f)\n",
-		   name, n, n_pct, rec_len, rec_len_pct, fpi_len, fpi_len_pct,
-		   tot_len, tot_len_pct);
+		   row->name, row->count, n_pct, row->rec_len, rec_len_pct,
+		   row->fpi_len, fpi_len_pct, tot_len, tot_len_pct);
 }
 
+/*
+ * qsort comparator for relation statistics, largest combined size first.
+ */
+static int
+relstats_cmp(const void *a, const void *b)
+{
+	const RelStatsEntry *ea = *(const RelStatsEntry *const *) a;
+	const RelStatsEntry *eb = *(const RelStatsEntry *const *) b;
+	uint64		la = ea->stats.rec_len + ea->stats.fpi_len;
+	uint64		lb = eb->stats.rec_len + eb->stats.fpi_len;
+
+	if (la != lb)
+		return (la > lb) ? -1 : 1;
+	return memcmp(&ea->key, &eb->key, sizeof(RelStatsKey));
+}
 
 /*
  * Display summary statistics about the records seen so far.
@@ -610,6 +860,8 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogDumpStats *stats)
 	uint64		total_len = 0;
 	double		rec_len_pct,
 				fpi_len_pct;
+	bool		first = true;
+	StatsRow	row;
 
 	/*
 	 * Each row shows its percentages of the total, so make a first pass to
@@ -624,62 +876,133 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogDumpStats *stats)
 	}
 	total_len = total_rec_len + total_fpi_len;
 
-	/*
-	 * 27 is strlen("Transaction/COMMIT_PREPARED"), 20 is strlen(2^64), 8 is
-	 * strlen("(100.00%)")
-	 */
-
-	printf("%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n"
-		   "%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n",
-		   "Type", "N", "(%)", "Record size", "(%)", "FPI size", "(%)", "Combined size", "(%)",
-		   "----", "-", "---", "-----------", "---", "--------", "---", "-------------", "---");
-
-	for (ri = 0; ri < RM_NEXT_ID; ri++)
+	switch (config->stats_format)
 	{
-		uint64		count,
-					rec_len,
-					fpi_len,
-					tot_len;
-		const RmgrDescData *desc = &RmgrDescTable[ri];
+		case STATS_FORMAT_TEXT:
+
+			/*
+			 * 27 is strlen("Transaction/COMMIT_PREPARED"), 20 is
+			 * strlen(2^64), 8 is strlen("(100.00%)")
+			 */
+			printf("%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n"
+				   "%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n",
+				   config->stats_per_relation ? "Relation" : "Type",
+				   "N", "(%)", "Record size", "(%)", "FPI size", "(%)", "Combined size", "(%)",
+				   config->stats_per_relation ? "--------" : "----",
+				   "-", "---", "-----------", "---", "--------", "---", "-------------", "---");
+			break;
+		case STATS_FORMAT_CSV:
+			if (config->stats_per_relation)
+				printf("tablespace,database,relfilenode,fork,");
+			else
+				printf("type,");
+			printf("count,record_size,fpi_size,combined_size\n");
+			break;
+		case STATS_FORMAT_JSON:
+			printf("{\n  \"stats\": [");
+			break;
+	}
 
-		if (!config->stats_per_record)
+	if (config->stats_per_relation)
+	{
+		relstats_iterator it;
+		RelStatsEntry *entry;
+		RelStatsEntry **entries;
+		int			nentries = 0;
+		int			i;
+
+		entries = pg_malloc(sizeof(RelStatsEntry *) *
+							Max(stats->rel_stats->members, 1));
+		relstats_start_iterate(stats->rel_stats, &it);
+		while ((entry = relstats_iterate(stats->rel_stats, &it)) != NULL)
+			entries[nentries++] = entry;
+		qsort(entries, nentries, sizeof(RelStatsEntry *), relstats_cmp);
+
+		for (i = 0; i < nentries; i++)
 		{
-			count = stats->rmgr_stats[ri].count;
-			rec_len = stats->rmgr_stats[ri].rec_len;
-			fpi_len = stats->rmgr_stats[ri].fpi_len;
-			tot_len = rec_len + fpi_len;
-
-			XLogDumpStatsRow(desc->rm_name,
-							 count, total_count, rec_len, total_rec_len,
-							 fpi_len, total_fpi_len, tot_len, total_len);
+			RelStatsKey *key = &entries[i]->key;
+
+			if (key->forknum == InvalidForkNumber)
+				row.name = "(no block reference)";
+			else if (key->forknum != MAIN_FORKNUM)
+				row.name = psprintf("%u/%u/%u %s",
+									key->rnode.spcNode, key->rnode.dbNode,
+									key->rnode.relNode, forkNames[key->forknum]);
+			else
+				row.name = psprintf("%u/%u/%u",
+									key->rnode.spcNode, key->rnode.dbNode,
+									key->rnode.relNode);
+			row.count = entries[i]->stats.count;
+			row.rec_len = entries[i]->stats.rec_len;
+			row.fpi_len = entries[i]->stats.fpi_len;
+
+			XLogDumpStatsRow(config, &row, key, first,
+							 total_count, total_rec_len,
+							 total_fpi_len, total_len);
+			first = false;
 		}
-		else
+		pg_free(entries);
+	}
+	else
+	{
+		for (ri = 0; ri < RM_NEXT_ID; ri++)
 		{
-			for (rj = 0; rj < MAX_XLINFO_TYPES; rj++)
-			{
-				const char *id;
-
-				count = stats->record_stats[ri][rj].count;
-				rec_len = stats->record_stats[ri][rj].rec_len;
-				fpi_len = stats->record_stats[ri][rj].fpi_len;
-				tot_len = rec_len + fpi_len;
+			const RmgrDescData *desc = &RmgrDescTable[ri];
 
-				/* Skip undefined combinations and ones that didn't occur */
-				if (count == 0)
-					continue;
-
-				/* the upper four bits in xl_info are the rmgr's */
-				id = desc->rm_identify(rj << 4);
-				if (id == NULL)
-					id = psprintf("UNKNOWN (%x)", rj << 4);
-
-				XLogDumpStatsRow(psprintf("%s/%s", desc->rm_name, id),
-								 count, total_count, rec_len, total_rec_len,
-								 fpi_len, total_fpi_len, tot_len, total_len);
+			if (!config->stats_per_record)
+			{
+				row.name = desc->rm_name;
+				row.count = stats->rmgr_stats[ri].count;
+				row.rec_len = stats->rmgr_stats[ri].rec_len;
+				row.fpi_len = stats->rmgr_stats[ri].fpi_len;
+
+				XLogDumpStatsRow(config, &row, NULL, first,
+								 total_count, total_rec_len,
+								 total_fpi_len, total_len);
+				first = false;
+			}
+			else
+			{
+				for (rj = 0; rj < MAX_XLINFO_TYPES; rj++)
+				{
+					const char *id;
+
+					row.count = stats->record_stats[ri][rj].count;
+					row.rec_len = stats->record_stats[ri][rj].rec_len;
+					row.fpi_len = stats->record_stats[ri][rj].fpi_len;
+
+					/* Skip undefined combinations and ones that didn't occur */
+					if (row.count == 0)
+						continue;
+
+					/* the upper four bits in xl_info are the rmgr's */
+					id = desc->rm_identify(rj << 4);
+					if (id == NULL)
+						id = psprintf("UNKNOWN (%x)", rj << 4);
+					row.name = psprintf("%s/%s", desc->rm_name, id);
+
+					XLogDumpStatsRow(config, &row, NULL, first,
+									 total_count, total_rec_len,
+									 total_fpi_len, total_len);
+					first = false;
+				}
 			}
 		}
 	}
 
+	if (config->stats_format == STATS_FORMAT_CSV)
+		return;
+
+	if (config->stats_format == STATS_FORMAT_JSON)
+	{
+		printf("\n  ],\n  \"total\": {\"count\": " UINT64_FORMAT
+			   ", \"record_size\": " UINT64_FORMAT
+			   ", \"fpi_size\": " UINT64_FORMAT
+			   ", \"combined_size\": " UINT64_FORMAT "}\n}\n",
+			   stats->count, total_rec_len, total_fpi_len, total_len);
+		return;
+	}
+
 	printf("%-27s %20s %8s %20s %8s %20s %8s %20s\n",
 		   "", "--------", "", "--------", "", "--------", "", "--------");
 
@@ -709,6 +1032,386 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogDumpStats *stats)
 		   total_len, "[100%]");
 }
 
+/*
+ * Read WAL starting at private->startptr and process each record as
+ * requested by config.  If chunk_end is valid, stop at the first record that
+ * begins at or after it; parallel workers use this to handle just the
+ * records that begin in their own range of segments.
+ *
+ * Returns false if no record to start from could be found.  If reading
+ * stops because of an invalid record, a copy of the error message is
+ * returned in *errormsg and its location in *errorptr.
+ */
+static bool
+XLogDumpReadRecords(XLogDumpConfig *config, XLogDumpPrivate *private,
+					XLogDumpStats *stats, char *waldir, XLogRecPtr chunk_end,
+					char **errormsg, XLogRecPtr *errorptr)
+{
+	XLogReaderState *xlogreader_state;
+	XLogRecord *record;
+	XLogRecPtr	first_record;
+	char	   *readerrmsg = NULL;
+
+	*errormsg = NULL;
+	*errorptr = InvalidXLogRecPtr;
+
+	xlogreader_state =
+		XLogReaderAllocate(WalSegSz, waldir,
+						   XL_ROUTINE(.page_read = WALDumpReadPage,
+									  .segment_open = WALDumpOpenSegment,
+									  .segment_close = WALDumpCloseSegment),
+						   private);
+	if (!xlogreader_state)
+		fatal_error("out of memory");
+
+	/* first find a valid recptr to start from */
+	first_record = XLogFindNextRecord(xlogreader_state, private->startptr);
+
+	if (first_record == InvalidXLogRecPtr ||
+		(!XLogRecPtrIsInvalid(chunk_end) && first_record >= chunk_end))
+	{
+		XLogReaderFree(xlogreader_state);
+		return false;
+	}
+
+	/*
+	 * Display a message that we're skipping data if `from` wasn't a pointer
+	 * to the start of a record and also wasn't a pointer to the beginning of
+	 * a segment (e.g. we were used in file mode).  Parallel workers other
+	 * than the first always start at the beginning of a segment.
+	 */
+	if (first_record != private->startptr &&
+		XLogSegmentOffset(private->startptr, WalSegSz) != 0)
+		printf(ngettext("first record is after %X/%X, at %X/%X, skipping over %u byte\n",
+						"first record is after %X/%X, at %X/%X, skipping over %u bytes\n",
+						(first_record - private->startptr)),
+			   (uint32) (private->startptr >> 32), (uint32) private->startptr,
+			   (uint32) (first_record >> 32), (uint32) first_record,
+			   (uint32) (first_record - private->startptr));
+
+	for (;;)
+	{
+		/* try to read the next record */
+		record = XLogReadRecord(xlogreader_state, &readerrmsg);
+		if (!record)
+		{
+			if (!config->follow || private->endptr_reached)
+				break;
+			else
+			{
+				pg_usleep(1000000L);	/* 1 second */
+				continue;
+			}
+		}
+
+		/* records beginning after our chunk are someone else's */
+		if (!XLogRecPtrIsInvalid(chunk_end) &&
+			xlogreader_state->ReadRecPtr >= chunk_end)
+			break;
+
+		/* apply all specified filters */
+		if (config->filter_by_rmgr != -1 &&
+			config->filter_by_rmgr != record->xl_rmid)
+			continue;
+
+		if (config->filter_by_xid_enabled &&
+			config->filter_by_xid != record->xl_xid)
+			continue;
+
+		/* perform any per-record work */
+		if (!config->quiet)
+		{
+			if (config->stats == true)
+				XLogDumpCountRecord(config, stats, xlogreader_state);
+			else
+				XLogDumpDisplayRecord(config, xlogreader_state);
+		}
+
+		/* check whether we printed enough */
+		config->already_displayed_records++;
+		if (config->stop_after_records > 0 &&
+			config->already_displayed_records >= config->stop_after_records)
+			break;
+	}
+
+	if (readerrmsg)
+	{
+		*errormsg = pg_strdup(readerrmsg);
+		*errorptr = xlogreader_state->ReadRecPtr;
+	}
+
+	XLogReaderFree(xlogreader_state);
+
+	return true;
+}
+
+#ifndef WIN32
+
+/*
+ * Header of the results a parallel worker sends back to the main process.
+ * It is followed by the error message, if any, the worker's XLogDumpStats
+ * and, for --stats=relation, nrelations pairs of RelStatsKey and Stats.
+ */
+typedef struct WorkerResultHeader
+{
+	XLogRecPtr	errorptr;		/* location of the error, if any */
+	uint32		errlen;			/* length of the error message, or 0 */
+	uint64		nrelations;
+} WorkerResultHeader;
+
+static void
+write_to_parent(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t		written = write(fd, p, len);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fatal_error("could not write to pipe: %m");
+		}
+		p += written;
+		len -= written;
+	}
+}
+
+/*
+ * Returns false if the worker closed the pipe before sending len bytes.
+ */
+static bool
+read_from_worker(int fd, void *buf, size_t len)
+{
+	char	   *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t		nread = read(fd, p, len);
+
+		if (nread < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fatal_error("could not read from pipe: %m");
+		}
+		if (nread == 0)
+			return false;
+		p += nread;
+		len -= nread;
+	}
+	return true;
+}
+
+/*
+ * Main routine of a parallel worker: compute statistics for the records
+ * beginning in [chunk_start, chunk_end) and send them to the main process
+ * through fd.
+ */
+static void
+XLogDumpStatsWorker(XLogDumpConfig *config, XLogDumpPrivate *private,
+					char *waldir, XLogRecPtr chunk_start, XLogRecPtr chunk_end,
+					bool first_chunk, int fd)
+{
+	XLogDumpStats stats;
+	WorkerResultHeader hdr;
+	char	   *errormsg;
+
+	memset(&stats, 0, sizeof(XLogDumpStats));
+	if (config->stats_per_relation)
+		stats.rel_stats = relstats_create(1024, NULL);
+
+	private->startptr = chunk_start;
+	if (!XLogDumpReadRecords(config, private, &stats, waldir, chunk_end,
+							 &errormsg, &hdr.errorptr) && first_chunk)
+		fatal_error("could not find a valid record after %X/%X",
+					(uint32) (chunk_start >> 32), (uint32) chunk_start);
+
+	hdr.errlen = errormsg ? strlen(errormsg) : 0;
+	hdr.nrelations = stats.rel_stats ? stats.rel_stats->members : 0;
+
+	write_to_parent(fd, &hdr, sizeof(hdr));
+	if (hdr.errlen > 0)
+		write_to_parent(fd, errormsg, hdr.errlen);
+	write_to_parent(fd, &stats, sizeof(stats));
+	if (stats.rel_stats)
+	{
+		relstats_iterator it;
+		RelStatsEntry *entry;
+
+		relstats_start_iterate(stats.rel_stats, &it);
+		while ((entry = relstats_iterate(stats.rel_stats, &it)) != NULL)
+		{
+			write_to_parent(fd, &entry->key, sizeof(RelStatsKey));
+			write_to_parent(fd, &entry->stats, sizeof(Stats));
+		}
+	}
+
+	close(fd);
+}
+
+/*
+ * Compute statistics using config->jobs worker processes, each of which
+ * decodes the records beginning in its own range of segments, and merge
+ * their results into *stats.
+ *
+ * If a worker stopped at an invalid record, the results of the workers
+ * after it are ignored, like a serial run would never have read that far,
+ * and its error is returned in *errormsg and *errorptr.
+ */
+static void
+XLogDumpParallelStats(XLogDumpConfig *config, XLogDumpPrivate *private,
+					  XLogDumpStats *stats, char *waldir,
+					  char **errormsg, XLogRecPtr *errorptr)
+{
+	XLogSegNo	startsegno;
+	XLogSegNo	endsegno;
+	uint64		nsegs;
+	int			njobs;
+	pid_t	   *pids;
+	int		   *fds;
+	bool		stopped = false;
+	int			i;
+
+	*errormsg = NULL;
+	*errorptr = InvalidXLogRecPtr;
+
+	XLByteToSeg(private->startptr, startsegno, WalSegSz);
+	XLByteToPrevSeg(private->endptr, endsegno, WalSegSz);
+	nsegs = endsegno - startsegno + 1;
+	njobs = (int) Min((uint64) config->jobs, nsegs);
+
+	pids = pg_malloc(sizeof(pid_t) * njobs);
+	fds = pg_malloc(sizeof(int) * njobs);
+
+	/* don't let the workers inherit unflushed output */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < njobs; i++)
+	{
+		XLogRecPtr	chunk_start;
+		XLogRecPtr	chunk_end;
+		int			pipefd[2];
+
+		if (i == 0)
+			chunk_start = private->startptr;
+		else
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * i / njobs, 0,
+									WalSegSz, chunk_start);
+		if (i == njobs - 1)
+			chunk_end = private->endptr;
+		else
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * (i + 1) / njobs, 0,
+									WalSegSz, chunk_end);
+
+		if (pipe(pipefd) < 0)
+			fatal_error("could not create pipe: %m");
+
+		pids[i] = fork();
+		if (pids[i] < 0)
+			fatal_error("could not create worker process: %m");
+		if (pids[i] == 0)
+		{
+			/* in the worker */
+			close(pipefd[0]);
+			XLogDumpStatsWorker(config, private, waldir, chunk_start,
+								chunk_end, i == 0, pipefd[1]);
+			exit(EXIT_SUCCESS);
+		}
+
+		close(pipefd[1]);
+		fds[i] = pipefd[0];
+	}
+
+	/* collect the results in WAL order */
+	for (i = 0; i < njobs; i++)
+	{
+		WorkerResultHeader hdr;
+		XLogDumpStats wstats;
+		bool		ok;
+		int			status;
+		int			ri,
+					rj;
+		uint64		n;
+
+		ok = read_from_worker(fds[i], &hdr, sizeof(hdr));
+		if (ok && hdr.errlen > 0)
+		{
+			char	   *msg = pg_malloc(hdr.errlen + 1);
+
+			ok = read_from_worker(fds[i], msg, hdr.errlen);
+			msg[hdr.errlen] = '\0';
+			if (!stopped)
+			{
+				*errormsg = msg;
+				*errorptr = hdr.errorptr;
+			}
+			else
+				pg_free(msg);
+		}
+		ok = ok && read_from_worker(fds[i], &wstats, sizeof(wstats));
+
+		/* results after the first error are not used, see above */
+		if (ok && !stopped)
+		{
+			stats->count += wstats.count;
+			for (ri = 0; ri < RM_NEXT_ID; ri++)
+			{
+				stats->rmgr_stats[ri].count += wstats.rmgr_stats[ri].count;
+				stats->rmgr_stats[ri].rec_len += wstats.rmgr_stats[ri].rec_len;
+				stats->rmgr_stats[ri].fpi_len += wstats.rmgr_stats[ri].fpi_len;
+				for (rj = 0; rj < MAX_XLINFO_TYPES; rj++)
+				{
+					Stats	   *dst = &stats->record_stats[ri][rj];
+					Stats	   *src = &wstats.record_stats[ri][rj];
+
+					dst->count += src->count;
+					dst->rec_len += src->rec_len;
+					dst->fpi_len += src->fpi_len;
+				}
+			}
+		}
+
+		for (n = 0; ok && n < hdr.nrelations; n++)
+		{
+			RelStatsKey key;
+			Stats		relstats;
+			RelStatsEntry *entry;
+			bool		found;
+
+			ok = read_from_worker(fds[i], &key, sizeof(RelStatsKey)) &&
+				read_from_worker(fds[i], &relstats, sizeof(Stats));
+			if (!ok || stopped)
+				continue;
+
+			entry = relstats_insert(stats->rel_stats, key, &found);
+			if (!found)
+				memset(&entry->stats, 0, sizeof(Stats));
+			entry->stats.count += relstats.count;
+			entry->stats.rec_len += relstats.rec_len;
+			entry->stats.fpi_len += relstats.fpi_len;
+		}
+
+		close(fds[i]);
+
+		if (waitpid(pids[i], &status, 0) != pids[i])
+			fatal_error("could not wait for worker process: %m");
+		if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			fatal_error("worker process failed");
+
+		if (hdr.errlen > 0)
+			stopped = true;
+	}
+
+	pg_free(pids);
+	pg_free(fds);
+}
+
+#endif							/* !WIN32 */
+
 static void
 usage(void)
 {
@@ -720,6 +1423,9 @@ usage(void)
 	printf(_("  -b, --bkp-details      output detailed information about backup blocks\n"));
 	printf(_("  -e, --end=RECPTR       stop reading at WAL location RECPTR\n"));
 	printf(_("  -f, --follow           keep retrying after reaching end of WAL\n"));
+	printf(_("  -F, --stats-format=FORMAT\n"
+			 "                         output format of --stats: text (default), csv or json\n"));
+	printf(_("  -j, --jobs=NUM         use this many parallel processes to compute --stats\n"));
 	printf(_("  -n, --limit=N          number of records to display\n"));
 	printf(_("  -p, --path=PATH        directory in which to find log segment files or a\n"
 			 "                         directory with a ./pg_wal that contains such files\n"
@@ -732,8 +1438,9 @@ usage(void)
 			 "                         (default: 1 or the value used in STARTSEG)\n"));
 	printf(_("  -V, --version          output version information, then exit\n"));
 	printf(_("  -x, --xid=XID          only show records with transaction ID XID\n"));
-	printf(_("  -z, --stats[=record]   show statistics instead of records\n"
-			 "                         (optionally, show per-record statistics)\n"));
+	printf(_("  -z, --stats[=record|relation]\n"
+			 "                         show statistics instead of records\n"
+			 "                         (optionally, show per-record or per-relation statistics)\n"));
 	printf(_("  -?, --help             show this help, then exit\n"));
 	printf(_("\nReport bugs to <%s>.\n"), PACKAGE_BUGREPORT);
 	printf(_("%s home page: <%s>\n"), PACKAGE_NAME, PACKAGE_URL);
@@ -744,20 +1451,19 @@ main(int argc, char **argv)
 {
 	uint32		xlogid;
 	uint32		xrecoff;
-	XLogReaderState *xlogreader_state;
 	XLogDumpPrivate private;
 	XLogDumpConfig config;
 	XLogDumpStats stats;
-	XLogRecord *record;
-	XLogRecPtr	first_record;
 	char	   *waldir = NULL;
 	char	   *errormsg;
+	XLogRecPtr	errorptr;
 
 	static struct option long_options[] = {
 		{"bkp-details", no_argument, NULL, 'b'},
 		{"end", required_argument, NULL, 'e'},
 		{"follow", no_argument, NULL, 'f'},
 		{"help", no_argument, NULL, '?'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"limit", required_argument, NULL, 'n'},
 		{"path", required_argument, NULL, 'p'},
 		{"quiet", no_argument, NULL, 'q'},
@@ -767,6 +1473,7 @@ main(int argc, char **argv)
 		{"xid", required_argument, NULL, 'x'},
 		{"version", no_argument, NULL, 'V'},
 		{"stats", optional_argument, NULL, 'z'},
+		{"stats-format", required_argument, NULL, 'F'},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -810,6 +1517,9 @@ main(int argc, char **argv)
 	config.filter_by_xid_enabled = false;
 	config.stats = false;
 	config.stats_per_record = false;
+	config.stats_per_relation = false;
+	config.stats_format = STATS_FORMAT_TEXT;
+	config.jobs = 1;
 
 	if (argc <= 1)
 	{
@@ -817,7 +1527,7 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
-	while ((option = getopt_long(argc, argv, "be:fn:p:qr:s:t:x:z",
+	while ((option = getopt_long(argc, argv, "be:fF:j:n:p:qr:s:t:x:z",
 								 long_options, &optindex)) != -1)
 	{
 		switch (option)
@@ -837,6 +1547,29 @@ main(int argc, char **argv)
 			case 'f':
 				config.follow = true;
 				break;
+			case 'F':
+				if (pg_strcasecmp(optarg, "text") == 0)
+					config.stats_format = STATS_FORMAT_TEXT;
+				else if (pg_strcasecmp(optarg, "csv") == 0)
+					config.stats_format = STATS_FORMAT_CSV;
+				else if (pg_strcasecmp(optarg, "json") == 0)
+					config.stats_format = STATS_FORMAT_JSON;
+				else
+				{
+					pg_log_error("unrecognized statistics format \"%s\"",
+								 optarg);
+					goto bad_argument;
+				}
+				break;
+			case 'j':
+				if (sscanf(optarg, "%d", &config.jobs) != 1 ||
+					config.jobs < 1)
+				{
+					pg_log_error("could not parse number of jobs \"%s\"",
+								 optarg);
+					goto bad_argument;
+				}
+				break;
 			case 'n':
 				if (sscanf(optarg, "%d", &config.stop_after_records) != 1)
 				{
@@ -906,10 +1639,13 @@ main(int argc, char **argv)
 			case 'z':
 				config.stats = true;
 				config.stats_per_record = false;
+				config.stats_per_relation = false;
 				if (optarg)
 				{
 					if (strcmp(optarg, "record") == 0)
 						config.stats_per_record = true;
+					else if (strcmp(optarg, "relation") == 0)
+						config.stats_per_relation = true;
 					else if (strcmp(optarg, "rmgr") != 0)
 					{
 						pg_log_error("unrecognized argument to --stats: %s",
@@ -1031,91 +1767,70 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
-	/* done with argument parsing, do the actual work */
-
-	/* we have everything we need, start reading */
-	xlogreader_state =
-		XLogReaderAllocate(WalSegSz, waldir,
-						   XL_ROUTINE(.page_read = WALDumpReadPage,
-									  .segment_open = WALDumpOpenSegment,
-									  .segment_close = WALDumpCloseSegment),
-						   &private);
-	if (!xlogreader_state)
-		fatal_error("out of memory");
-
-	/* first find a valid recptr to start from */
-	first_record = XLogFindNextRecord(xlogreader_state, private.startptr);
-
-	if (first_record == InvalidXLogRecPtr)
-		fatal_error("could not find a valid record after %X/%X",
-					(uint32) (private.startptr >> 32),
-					(uint32) private.startptr);
-
-	/*
-	 * Display a message that we're skipping data if `from` wasn't a pointer
-	 * to the start of a record and also wasn't a pointer to the beginning of
-	 * a segment (e.g. we were used in file mode).
-	 */
-	if (first_record != private.startptr &&
-		XLogSegmentOffset(private.startptr, WalSegSz) != 0)
-		printf(ngettext("first record is after %X/%X, at %X/%X, skipping over %u byte\n",
-						"first record is after %X/%X, at %X/%X, skipping over %u bytes\n",
-						(first_record - private.startptr)),
-			   (uint32) (private.startptr >> 32), (uint32) private.startptr,
-			   (uint32) (first_record >> 32), (uint32) first_record,
-			   (uint32) (first_record - private.startptr));
+	if (config.stats_format != STATS_FORMAT_TEXT && !config.stats)
+	{
+		pg_log_error("option %s requires option %s",
+					 "-F/--stats-format", "-z/--stats");
+		goto bad_argument;
+	}
 
-	for (;;)
+	if (config.jobs > 1)
 	{
-		/* try to read the next record */
-		record = XLogReadRecord(xlogreader_state, &errormsg);
-		if (!record)
+#ifdef WIN32
+		pg_log_error("parallel decoding is not supported on this platform");
+		goto bad_argument;
+#endif
+		if (!config.stats)
 		{
-			if (!config.follow || private.endptr_reached)
-				break;
-			else
-			{
-				pg_usleep(1000000L);	/* 1 second */
-				continue;
-			}
+			pg_log_error("option %s requires option %s",
+						 "-j/--jobs", "-z/--stats");
+			goto bad_argument;
 		}
-
-		/* apply all specified filters */
-		if (config.filter_by_rmgr != -1 &&
-			config.filter_by_rmgr != record->xl_rmid)
-			continue;
-
-		if (config.filter_by_xid_enabled &&
-			config.filter_by_xid != record->xl_xid)
-			continue;
-
-		/* perform any per-record work */
-		if (!config.quiet)
+		if (config.follow)
 		{
-			if (config.stats == true)
-				XLogDumpCountRecord(&config, &stats, xlogreader_state);
-			else
-				XLogDumpDisplayRecord(&config, xlogreader_state);
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-f/--follow");
+			goto bad_argument;
+		}
+		if (config.stop_after_records > 0)
+		{
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-n/--limit");
+			goto bad_argument;
+		}
+		if (XLogRecPtrIsInvalid(private.endptr))
+		{
+			pg_log_error("option %s requires an end WAL location or segment",
+						 "-j/--jobs");
+			goto bad_argument;
 		}
-
-		/* check whether we printed enough */
-		config.already_displayed_records++;
-		if (config.stop_after_records > 0 &&
-			config.already_displayed_records >= config.stop_after_records)
-			break;
 	}
 
+	/* done with argument parsing, do the actual work */
+
+	if (config.stats_per_relation)
+		stats.rel_stats = relstats_create(1024, NULL);
+
+#ifndef WIN32
+	if (config.jobs > 1)
+		XLogDumpParallelStats(&config, &private, &stats, waldir,
+							  &errormsg, &errorptr);
+	else
+#endif
+	if (!XLogDumpReadRecords(&config, &private, &stats, waldir,
+							 InvalidXLogRecPtr, &errormsg, &errorptr))
+		fatal_error("could not find a valid record after %X/%X",
+					(uint32) (private.startptr >> 32),
+					(uint32) private.startptr);
+
 	if (config.stats == true && !config.quiet)
 		XLogDumpDisplayStats(&config, &stats);
 
 	if (errormsg)
 		fatal_error("error in WAL record at %X/%X: %s",
-					(uint32) (xlogreader_state->ReadRecPtr >> 32),
-					(uint32) xlogreader_state->ReadRecPtr,
+					(uint32) (errorptr >> 32), (uint32) errorptr,
 					errormsg);
 
-	XLogReaderFree(xlogreader_state);
-
 	return EXIT_SUCCESS;
 
 bad_argument:
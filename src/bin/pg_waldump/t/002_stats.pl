@@ -0,0 +1,90 @@
+# Checks the statistics of pg_waldump --stats in all formats, and that
+# computing them in parallel with --jobs gives the same results
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+if ($windows_os)
+{
+	plan skip_all => 'parallel decoding is not supported on Windows';
+}
+else
+{
+	plan tests => 24;
+}
+
+# Small segments, so that the range spans enough of them for all the jobs
+my $node = get_new_node('main');
+$node->init(extra => ['--wal-segsize=1']);
+$node->append_conf('postgresql.conf', 'autovacuum = off');
+$node->start;
+
+$node->safe_psql('postgres', 'CREATE TABLE t (a int PRIMARY KEY, b text)');
+my $start_lsn = $node->lsn('insert');
+
+# Records of several resource managers and types, some with full-page
+# images, and a WAL switch in the middle
+$node->safe_psql(
+	'postgres', q{
+INSERT INTO t SELECT g, repeat(md5(g::text), 10) FROM generate_series(1, 20000) g;
+CHECKPOINT;
+UPDATE t SET b = upper(b) WHERE a % 3 = 0;
+SELECT pg_switch_wal();
+DELETE FROM t WHERE a % 5 = 0;
+VACUUM t;
+});
+my $end_lsn = $node->lsn('insert');
+
+my $relfilenode =
+  $node->safe_psql('postgres', "SELECT pg_relation_filenode('t')");
+my $dboid = $node->safe_psql('postgres',
+	"SELECT oid FROM pg_database WHERE datname = 'postgres'");
+$node->stop;
+
+my @cmd = (
+	'pg_waldump', '-p', $node->data_dir . '/pg_wal',
+	'-s', $start_lsn, '-e', $end_lsn);
+
+# The serial and parallel runs must agree in every mode and format
+my %serial;
+foreach my $mode ('--stats', '--stats=record', '--stats=relation')
+{
+	foreach my $format ('text', 'csv', 'json')
+	{
+		my ($stdout, $stderr) = run_command([ @cmd, $mode, '-F', $format ]);
+		is($stderr, '', "$mode $format: no errors");
+		$serial{"$mode $format"} = $stdout;
+
+		($stdout, $stderr) =
+		  run_command([ @cmd, $mode, '-F', $format, '-j', '4' ]);
+		is($stdout, $serial{"$mode $format"},
+			"$mode $format: -j 4 gives the same output");
+	}
+}
+
+# Totals of the text output
+my ($total) = $serial{'--stats text'} =~ /^Total\s+(\d+)/m;
+cmp_ok($total, '>', 20000, 'text: total count of records');
+
+# CSV rows add up to the total
+my @rows = split /\n/, $serial{'--stats csv'};
+is(shift @rows, 'type,count,record_size,fpi_size,combined_size',
+	'csv: header');
+my $sum = 0;
+$sum += (split /,/)[1] foreach @rows;
+is($sum, $total, 'csv: counts add up to the total');
+
+# So do the JSON rows, and they agree with the total it reports
+my $json = $serial{'--stats json'};
+$sum = 0;
+$sum += $1 while $json =~ /"type": "[^"]*", "count": (\d+)/g;
+is($sum, $total, 'json: counts add up to the total');
+like($json, qr/"total": \{"count": $total,/, 'json: total');
+
+# Per-relation statistics list the table, with its full-page images
+like(
+	$serial{'--stats=relation csv'},
+	qr/^\d+,$dboid,$relfilenode,main,\d+,\d+,[1-9]\d*,\d+$/m,
+	'csv: per-relation row for the table');
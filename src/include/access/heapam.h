@@ -35,6 +35,7 @@
 #define HEAP_INSERT_FROZEN		TABLE_INSERT_FROZEN
 #define HEAP_INSERT_NO_LOGICAL	TABLE_INSERT_NO_LOGICAL
 #define HEAP_INSERT_SPECULATIVE 0x0010
+#define HEAP_INSERT_PARALLEL	TABLE_INSERT_PARALLEL
 
 typedef struct BulkInsertStateData *BulkInsertState;
 struct TupleTableSlot;
@@ -63,6 +64,12 @@ typedef struct HeapScanDescData
 	/* rs_numblocks is usually InvalidBlockNumber, meaning "scan whole rel" */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
 
+	/* read-ahead state for serial forward scans, see heap_scan_stream_next */
+	struct ReadStream *rs_read_stream;	/* NULL if scan doesn't read ahead */
+	bool		rs_stream_active;	/* does the stream follow the scan? */
+	BlockNumber rs_prefetch_block;	/* next block to hand to the stream */
+	BlockNumber rs_prefetch_remaining;	/* like rs_numblocks, for the stream */
+
 	HeapTupleData rs_ctup;		/* current tuple in scan, if any */
 
 	/* these fields only used in page-at-a-time mode and for bitmap scans */
@@ -133,6 +133,8 @@ typedef struct TM_FailureData
 #define TABLE_INSERT_SKIP_FSM		0x0002
 #define TABLE_INSERT_FROZEN			0x0004
 #define TABLE_INSERT_NO_LOGICAL		0x0008
+/* 0x0010 is reserved for HEAP_INSERT_SPECULATIVE */
+#define TABLE_INSERT_PARALLEL		0x0020
 
 /* flag bits for table_tuple_lock */
 /* Follow tuples whose update is in progress if lock modes don't conflict  */
@@ -1163,6 +1165,11 @@ table_compute_xid_horizon_for_tuples(Relation rel,
  * where RelationIsLogicallyLogged(relation) is not yet accurate for the new
  * relation.
  *
+ * TABLE_INSERT_PARALLEL allows the insertion to be performed by a parallel
+ * worker.  The caller is responsible for making sure that's safe, in
+ * particular that the insertion doesn't fire triggers or require a new
+ * command ID.
+ *
  * Note that most of these options will be applied when inserting into the
  * heap's TOAST table, too, if the tuple requires any out-of-line data.
  *
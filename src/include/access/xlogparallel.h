@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.h
+ *		Declarations for parallel WAL redo.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogparallel.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPARALLEL_H
+#define XLOGPARALLEL_H
+
+#include "access/xlogreader.h"
+#include "common/relpath.h"
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* GUCs */
+extern int	recovery_parallel_workers;
+
+/* Are we a parallel redo worker? */
+extern bool am_parallel_redo_worker;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+
+/* Called by the startup process */
+extern void ParallelRedoStartWorkers(void);
+extern void ParallelRedoStopWorkers(void);
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern void ParallelRedoBarrier(void);
+
+/* Called by parallel redo workers */
+extern void ParallelRedoForwardInvalidPage(RelFileNode node, ForkNumber forkno,
+										   BlockNumber blkno, bool present);
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif							/* XLOGPARALLEL_H */
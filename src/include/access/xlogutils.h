@@ -15,6 +15,8 @@
 #include "storage/bufmgr.h"
 
 
+extern void XLogRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+									BlockNumber blkno, bool present);
 extern bool XLogHaveInvalidPages(void);
 extern void XLogCheckInvalidPages(void);
 
@@ -14,6 +14,7 @@
 #ifndef COPY_H
 #define COPY_H
 
+#include "access/parallel.h"
 #include "nodes/execnodes.h"
 #include "nodes/parsenodes.h"
 #include "parser/parse_node.h"
@@ -48,6 +49,8 @@ typedef struct CopyFormatOptions
 	bool	   *force_null_flags;	/* per-column CSV FN flags */
 	bool		convert_selectively;	/* do selective binary conversion? */
 	List	   *convert_select; /* list of column names (can be NIL) */
+	int			nworkers;		/* number of parallel workers to use, COPY
+								 * FROM only */
 } CopyFormatOptions;
 
 /* These are private in commands/copy[from|to].c */
@@ -73,6 +76,10 @@ extern void CopyFromErrorCallback(void *arg);
 
 extern uint64 CopyFrom(CopyFromState cstate);
 
+extern bool ParallelCopyFrom(CopyFromState cstate, List *attnamelist,
+							 List *options, uint64 *processed);
+extern void ParallelCopyMain(dsm_segment *seg, shm_toc *toc);
+
 extern DestReceiver *CreateCopyDestReceiver(void);
 
 /*
@@ -160,5 +160,8 @@ typedef struct CopyFromStateData
 
 extern void ReceiveCopyBegin(CopyFromState cstate);
 extern void ReceiveCopyBinaryHeader(CopyFromState cstate);
+extern bool CopyLoadRawBuf(CopyFromState cstate);
+
+extern uint64 ParallelCopyWorkerLineNo(uint64 lineno);
 
 #endif							/* COPYFROM_INTERNAL_H */
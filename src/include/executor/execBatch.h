@@ -0,0 +1,135 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.h
+ *	  Support for batch-at-a-time execution of plan nodes.
+ *
+ * A node that supports batch execution can hand its parent many rows per
+ * call, laid out as one array per column, instead of one TupleTableSlot at
+ * a time.  Rows that have been filtered out are not removed from the
+ * arrays; instead the batch carries a selection vector listing the rows
+ * that are still valid.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execBatch.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "access/tupdesc.h"
+#include "executor/tuptable.h"
+#include "nodes/bitmapset.h"
+#include "nodes/primnodes.h"
+
+/* GUC parameter: rows per batch, or 0 to disable batch execution */
+extern int	executor_batch_size;
+
+#define MAX_EXECUTOR_BATCH_SIZE		8192
+
+/*
+ * A batch of rows.  Null entries of the column arrays hold (Datum) 0.
+ */
+typedef struct TupleBatch
+{
+	TupleDesc	tupdesc;		/* descriptor of the rows in the batch */
+	int			maxrows;		/* capacity of the column arrays */
+	int			nrows;			/* number of rows stored */
+	int			natts;			/* number of attributes to deform */
+	Datum	  **values;			/* per attribute; NULL if not stored */
+	bool	  **isnull;			/* per attribute; NULL if not stored */
+	int			nselected;		/* number of valid entries in sel */
+	uint16	   *sel;			/* indexes of the rows still selected */
+	MemoryContext context;		/* holds copies of pass-by-ref values */
+} TupleBatch;
+
+#define TupleBatchIsFull(batch) ((batch)->nrows >= (batch)->maxrows)
+
+/*
+ * A qual clause of the form "column op constant" that can be evaluated
+ * over a whole batch at once.
+ */
+typedef enum BatchQualType
+{
+	BATCH_QUAL_INT4,			/* int4 column, compared as int64 */
+	BATCH_QUAL_INT8,			/* int8 column */
+	BATCH_QUAL_FLOAT8			/* float8 column */
+} BatchQualType;
+
+typedef enum BatchQualOp
+{
+	BATCH_QUAL_EQ,
+	BATCH_QUAL_NE,
+	BATCH_QUAL_LT,
+	BATCH_QUAL_LE,
+	BATCH_QUAL_GT,
+	BATCH_QUAL_GE
+} BatchQualOp;
+
+#define BATCH_QUAL_NUM_OPS	(BATCH_QUAL_GE + 1)
+
+struct BatchQual;
+
+/*
+ * Kernels processing one column of a batch.  They look only at the rows
+ * listed in sel[0 .. nselected - 1], which must be in ascending order.
+ *
+ * A filter removes the rows that don't satisfy the qual from sel, and
+ * returns the new number of selected rows.
+ *
+ * An aggregate kernel returns the number of non-null rows among those
+ * selected, and if that is not zero, stores their sum, minimum or maximum
+ * in *result (count kernels don't touch *result).
+ */
+typedef int (*BatchFilterFunc) (const Datum *values, const bool *isnull,
+								uint16 *sel, int nselected,
+								const struct BatchQual *bqual);
+typedef int (*BatchAggFunc) (const Datum *values, const bool *isnull,
+							 const uint16 *sel, int nselected,
+							 int64 *result);
+
+typedef struct BatchQual
+{
+	AttrNumber	attno;			/* column compared, 1-based */
+	BatchQualType type;
+	BatchQualOp op;
+	int64		intval;			/* constant, for the integer types */
+	float8		floatval;		/* constant, for float8 */
+	BatchFilterFunc filter;		/* kernel evaluating the qual */
+} BatchQual;
+
+/*
+ * A complete set of kernels.  There's a portable implementation of each,
+ * and on x86 an AVX2 implementation that GetBatchKernels() chooses if the
+ * processor supports it.
+ */
+typedef struct BatchKernels
+{
+	BatchFilterFunc filter_int4[BATCH_QUAL_NUM_OPS];
+	BatchFilterFunc filter_int8[BATCH_QUAL_NUM_OPS];
+	BatchFilterFunc filter_float8[BATCH_QUAL_NUM_OPS];
+	BatchAggFunc count;
+	BatchAggFunc sum_int4;
+	BatchAggFunc min_int4;
+	BatchAggFunc max_int4;
+	BatchAggFunc min_int8;
+	BatchAggFunc max_int8;
+} BatchKernels;
+
+extern const BatchKernels batch_kernels_portable;
+#ifdef USE_AVX2_WITH_RUNTIME_CHECK
+extern const BatchKernels batch_kernels_avx2;
+#endif
+
+extern TupleBatch *MakeTupleBatch(TupleDesc tupdesc, int maxrows,
+								  Bitmapset *attnos);
+extern void ResetTupleBatch(TupleBatch *batch);
+extern void TupleBatchAddSlot(TupleBatch *batch, TupleTableSlot *slot);
+extern bool ExecBatchQualSupported(Expr *clause, Index varno,
+								   BatchQual *bqual);
+extern void ExecBatchQual(TupleBatch *batch, BatchQual *bqual);
+extern const BatchKernels *GetBatchKernels(void);
+
+#endif							/* EXECBATCH_H */
@@ -226,6 +226,10 @@ extern void EvalPlanQualEnd(EPQState *epqstate);
 extern PlanState *ExecInitNode(Plan *node, EState *estate, int eflags);
 extern void ExecSetExecProcNode(PlanState *node, ExecProcNodeMtd function);
 extern Node *MultiExecProcNode(PlanState *node);
+extern bool ExecSupportsBatchMode(PlanState *node);
+extern void ExecEnableBatchMode(PlanState *node, int maxrows,
+								Bitmapset *attnos);
+extern struct TupleBatch *ExecProcNodeBatch(PlanState *node);
 extern void ExecEndNode(PlanState *node);
 extern bool ExecShutdownNode(PlanState *node);
 extern void ExecSetTupleBound(int64 tuples_needed, PlanState *child_node);
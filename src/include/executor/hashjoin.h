@@ -63,6 +63,7 @@
 /* these are in nodes/execnodes.h: */
 /* typedef struct HashJoinTupleData *HashJoinTuple; */
 /* typedef struct HashJoinTableData *HashJoinTable; */
+/* typedef struct HashJoinFilterData *HashJoinFilter; */
 
 typedef struct HashJoinTupleData
 {
@@ -315,6 +316,9 @@ typedef struct HashJoinTableData
 
 	bool		growEnabled;	/* flag to shut off nbatch increases */
 
+	/* Bloom filter of the inner tuples' hash values, or NULL */
+	struct bloom_filter *bloom;
+
 	double		totalTuples;	/* # tuples obtained from inner plan */
 	double		partialTuples;	/* # tuples obtained from inner plan by me */
 	double		skewTuples;		/* # tuples inserted into skew tuples */
@@ -359,4 +363,32 @@ typedef struct HashJoinTableData
 	dsa_pointer current_chunk_shared;
 }			HashJoinTableData;
 
+/* ----------------------------------------------------------------
+ *				runtime join filters
+ *
+ * If the join discards outer tuples that have no match, a scan below the
+ * outer side of the join can discard them itself, saving the cost of passing
+ * them up through the intervening nodes (possibly crossing a Gather) and of
+ * probing the hash table.  To make that cheap, MultiExecPrivateHash adds the
+ * hash value of each inner tuple to a Bloom filter, and the scan tests the
+ * hash value of its tuples against that.  Only a tuple whose hash value is
+ * definitely not in the filter is rejected, so false positives merely cost
+ * the probe of the hash table that would have happened anyway.
+ *
+ * The filter belongs to the HashJoinState; the Bloom filter itself lives in
+ * the hashtable's hashCxt, so the filter is uninstalled from the scans
+ * whenever the hashtable is destroyed.  If too few of the tuples probed are
+ * rejected, the filter is uninstalled for good.
+ * ----------------------------------------------------------------
+ */
+typedef struct HashJoinFilterData
+{
+	HashJoinTable hashtable;	/* current hashtable, holding the filter */
+	List	   *hashkeys;		/* outer hash key ExprStates */
+	List	   *scans;			/* ScanStates the filter applies to */
+	bool		enabled;		/* still worth building and checking? */
+	uint64		nprobes;		/* # tuples checked */
+	uint64		nrejected;		/* # tuples rejected */
+}			HashJoinFilterData;
+
 #endif							/* HASHJOIN_H */
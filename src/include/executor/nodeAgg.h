@@ -15,9 +15,22 @@
 #define NODEAGG_H
 
 #include "access/parallel.h"
+#include "executor/execBatch.h"
 #include "nodes/execnodes.h"
 
 
+/*
+ * How a transition is advanced over a batch of input, in batch mode.
+ */
+typedef enum AggBatchKind
+{
+	AGG_BATCH_GENERIC,			/* call the transition function per row */
+	AGG_BATCH_COUNT,			/* count(*) or count(x) */
+	AGG_BATCH_SUM,				/* sum(int4) */
+	AGG_BATCH_MIN,				/* min() of int4 or int8 */
+	AGG_BATCH_MAX				/* max() of int4 or int8 */
+} AggBatchKind;
+
 /*
  * AggStatePerTransData - per aggregate state value information
  *
@@ -165,6 +178,13 @@ typedef struct AggStatePerTransData
 	FunctionCallInfo serialfn_fcinfo;
 
 	FunctionCallInfo deserialfn_fcinfo;
+
+	/*
+	 * In batch mode, how this transition is advanced, and the kernel used
+	 * to do it, if any.
+	 */
+	AggBatchKind batch_kind;
+	BatchAggFunc batch_func;
 }			AggStatePerTransData;
 
 /*
@@ -18,10 +18,16 @@
 #include "nodes/execnodes.h"
 #include "storage/buffile.h"
 
+/* GUC parameter */
+extern PGDLLIMPORT bool enable_hashjoin_filter;
+
 extern HashJoinState *ExecInitHashJoin(HashJoin *node, EState *estate, int eflags);
 extern void ExecEndHashJoin(HashJoinState *node);
 extern void ExecReScanHashJoin(HashJoinState *node);
 extern void ExecShutdownHashJoin(HashJoinState *node);
+extern bool ExecHashJoinFilterTuple(HashJoinFilter filter,
+									ExprContext *econtext,
+									TupleTableSlot *slot);
 extern void ExecHashJoinEstimate(HashJoinState *state, ParallelContext *pcxt);
 extern void ExecHashJoinInitializeDSM(HashJoinState *state, ParallelContext *pcxt);
 extern void ExecHashJoinReInitializeDSM(HashJoinState *state, ParallelContext *pcxt);
@@ -21,6 +21,12 @@ extern SeqScanState *ExecInitSeqScan(SeqScan *node, EState *estate, int eflags);
 extern void ExecEndSeqScan(SeqScanState *node);
 extern void ExecReScanSeqScan(SeqScanState *node);
 
+/* batch mode support */
+extern bool ExecSeqScanSupportsBatch(SeqScanState *node);
+extern void ExecSeqScanEnableBatch(SeqScanState *node, int maxrows,
+								   Bitmapset *attnos);
+extern struct TupleBatch *ExecSeqScanBatch(SeqScanState *node);
+
 /* parallel scan support */
 extern void ExecSeqScanEstimate(SeqScanState *node, ParallelContext *pcxt);
 extern void ExecSeqScanInitializeDSM(SeqScanState *node, ParallelContext *pcxt);
@@ -29,6 +29,9 @@ typedef struct JitInstrumentation
 	/* number of emitted functions */
 	size_t		created_functions;
 
+	/* number of functions whose code was found in the code cache */
+	size_t		cached_functions;
+
 	/* accumulated time to generate code */
 	instr_time	generation_counter;
 
@@ -89,6 +92,7 @@ extern bool jit_tuple_deforming;
 extern double jit_above_cost;
 extern double jit_inline_above_cost;
 extern double jit_optimize_above_cost;
+extern int	jit_cache_size;
 
 
 extern void jit_reset_after_error(void);
@@ -53,6 +53,9 @@ typedef struct LLVMJitContext
 
 	/* list of handles for code emitted via Orc */
 	List	   *handles;
+
+	/* list of code cache entries in use, see llvm_cache_function() */
+	List	   *cache_entries;
 } LLVMJitContext;
 
 /* llvm module containing information about types */
@@ -91,6 +94,9 @@ extern LLVMJitContext *llvm_create_context(int jitFlags);
 extern LLVMModuleRef llvm_mutable_module(LLVMJitContext *context);
 extern char *llvm_expand_funcname(LLVMJitContext *context, const char *basename);
 extern void *llvm_get_function(LLVMJitContext *context, const char *funcname);
+extern bool llvm_cache_enabled(void);
+extern void *llvm_cache_function(LLVMJitContext *context, LLVMModuleRef module,
+								 size_t module_generation, const char *funcname);
 extern void llvm_split_symbol_name(const char *name, char **modname, char **funcname);
 extern LLVMValueRef llvm_pg_func(LLVMModuleRef mod, const char *funcname);
 extern void llvm_copy_attributes(LLVMValueRef from, LLVMValueRef to);
@@ -0,0 +1,69 @@
+/*-------------------------------------------------------------------------
+ * templatejit.h
+ *	  Template JIT provider.
+ *
+ * Copyright (c) 2016-2020, PostgreSQL Global Development Group
+ *
+ * src/include/jit/templatejit.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef TEMPLATEJIT_H
+#define TEMPLATEJIT_H
+
+#include "access/tupdesc.h"
+#include "executor/tuptable.h"
+#include "jit/jit.h"
+#include "nodes/execnodes.h"
+
+
+typedef struct TemplateJitContext
+{
+	JitContext	base;
+} TemplateJitContext;
+
+/*
+ * How a column is fetched from a tuple by template_deform().
+ */
+typedef enum TemplateFetchKind
+{
+	TEMPLATE_FETCH_CHAR,		/* by value, 1 byte */
+	TEMPLATE_FETCH_INT16,		/* by value, 2 bytes */
+	TEMPLATE_FETCH_INT32,		/* by value, 4 bytes */
+	TEMPLATE_FETCH_INT64,		/* by value, 8 bytes */
+	TEMPLATE_FETCH_FIXED,		/* by reference, fixed length */
+	TEMPLATE_FETCH_VARLENA,		/* by reference, varlena */
+	TEMPLATE_FETCH_CSTRING		/* by reference, cstring */
+} TemplateFetchKind;
+
+typedef struct TemplateDeformColumn
+{
+	uint8		kind;			/* a TemplateFetchKind */
+	bool		notnull;		/* column can't be NULL */
+	uint8		alignby;		/* alignment in bytes */
+	int16		attlen;
+	int32		fixedoff;		/* offset in every tuple, or -1 */
+} TemplateDeformColumn;
+
+/*
+ * Tuple deforming specialized for one tuple descriptor, slot type and
+ * number of columns.
+ */
+typedef struct TemplateDeform
+{
+	const TupleTableSlotOps *ops;
+	int			natts;			/* number of columns to deform */
+	TemplateDeformColumn cols[FLEXIBLE_ARRAY_MEMBER];
+} TemplateDeform;
+
+
+extern TemplateJitContext *template_create_context(int jitFlags);
+
+extern TemplateDeform *template_compile_deform(TupleDesc desc,
+											   const TupleTableSlotOps *ops,
+											   int natts);
+extern void template_deform(TemplateDeform *deform, TupleTableSlot *slot);
+
+extern bool template_compile_expr(struct ExprState *state);
+
+#endif							/* TEMPLATEJIT_H */
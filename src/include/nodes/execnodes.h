@@ -93,6 +93,7 @@ typedef struct ExprState
 	Expr	   *expr;
 
 	/* private state for an evalfunc */
+#define FIELDNO_EXPRSTATE_EVALFUNC_PRIVATE 8
 	void	   *evalfunc_private;
 
 	/*
@@ -1310,6 +1311,8 @@ typedef struct BitmapOrState
  *		currentRelation    relation being scanned (NULL if none)
  *		currentScanDesc    current scan descriptor for scan (NULL if none)
  *		ScanTupleSlot	   pointer to slot in tuple table holding scan tuple
+ *		JoinFilter		   runtime filter pushed down by a hash join (NULL
+ *						   if none), see executor/hashjoin.h
  * ----------------
  */
 typedef struct ScanState
@@ -1318,6 +1321,7 @@ typedef struct ScanState
 	Relation	ss_currentRelation;
 	struct TableScanDescData *ss_currentScanDesc;
 	TupleTableSlot *ss_ScanTupleSlot;
+	struct HashJoinFilterData *ss_JoinFilter;
 } ScanState;
 
 /* ----------------
@@ -1328,6 +1332,12 @@ typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+	/* these fields are used only in batch mode: */
+	struct TupleBatch *batch;	/* batch returned by ExecSeqScanBatch */
+	struct BatchQual *batchquals;	/* quals evaluated over the batch */
+	int			nbatchquals;	/* number of entries in batchquals */
+	ExprState  *batchresidual;	/* other quals, evaluated per tuple */
+	bool		batch_done;		/* scan exhausted? */
 } SeqScanState;
 
 /* ----------------
@@ -1901,6 +1911,8 @@ typedef struct MergeJoinState
  *		hj_HashOperators		the join operators in the hashjoin condition
  *		hj_HashTable			hash table for the hashjoin
  *								(NULL if table not built yet)
+ *		hj_Filter				runtime filter for outer scans
+ *								(NULL if not applicable)
  *		hj_CurHashValue			hash value for current outer tuple
  *		hj_CurBucketNo			regular bucket# for current outer tuple
  *		hj_CurSkewBucketNo		skew bucket# for current outer tuple
@@ -1922,6 +1934,7 @@ typedef struct MergeJoinState
 /* these structs are defined in executor/hashjoin.h: */
 typedef struct HashJoinTupleData *HashJoinTuple;
 typedef struct HashJoinTableData *HashJoinTable;
+typedef struct HashJoinFilterData *HashJoinFilter;
 
 typedef struct HashJoinState
 {
@@ -1931,6 +1944,7 @@ typedef struct HashJoinState
 	List	   *hj_HashOperators;	/* list of operator OIDs */
 	List	   *hj_Collations;
 	HashJoinTable hj_HashTable;
+	HashJoinFilter hj_Filter;
 	uint32		hj_CurHashValue;
 	int			hj_CurBucketNo;
 	int			hj_CurSkewBucketNo;
@@ -2202,6 +2216,9 @@ typedef struct AggState
 										 * ->hash_pergroup */
 	ProjectionInfo *combinedproj;	/* projection machinery */
 	SharedAggInfo *shared_info; /* one entry per worker */
+	/* used only when reading the input in batch mode: */
+	bool		batch_mode;		/* read input with ExecProcNodeBatch? */
+	AttrNumber *batch_attnos;	/* per trans: input column, or 0 if none */
 } AggState;
 
 /* ----------------
@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.h
+ *	  Minimal support for placing memory on NUMA nodes.
+ *
+ * Nodes are identified by their index among the online nodes of the system,
+ * from 0 to pg_numa_init() - 1, rather than by the operating system's node
+ * numbers, which need not be contiguous.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ *
+ * src/include/port/pg_numa.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_NUMA_H
+#define PG_NUMA_H
+
+/* Maximum number of nodes we can make use of */
+#define PG_NUMA_MAX_NODES	64
+
+extern int	pg_numa_init(void);
+extern int	pg_numa_node_id(int node);
+extern int	pg_numa_get_node(void);
+extern int	pg_numa_interleave(void *addr, size_t len);
+extern int	pg_numa_prefer(void *addr, size_t len, int node);
+
+#endif							/* PG_NUMA_H */
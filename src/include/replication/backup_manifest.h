@@ -38,6 +38,12 @@ typedef struct backup_manifest_info
 extern void InitializeBackupManifest(backup_manifest_info *manifest,
 									 backup_manifest_option want_manifest,
 									 pg_checksum_type manifest_checksum_type);
+extern void InitializeBackupManifestFragment(backup_manifest_info *manifest,
+											 BufFile *buffile,
+											 backup_manifest_option want_manifest,
+											 pg_checksum_type manifest_checksum_type);
+extern void AppendBackupManifestFragment(backup_manifest_info *manifest,
+										 BufFile *fragment);
 extern void AddFileToBackupManifest(backup_manifest_info *manifest,
 									const char *spcoid,
 									const char *pathname, size_t size,
@@ -0,0 +1,42 @@
+/*-------------------------------------------------------------------------
+ *
+ * incremental.h
+ *	  Format of the files sent by incremental base backups.
+ *
+ * This is shared by the server, which writes these files, and
+ * pg_combinebackup, which reads them.
+ *
+ * Portions Copyright (c) 2010-2020, PostgreSQL Global Development Group
+ *
+ * src/include/replication/incremental.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+/*
+ * A relation segment file sent incrementally is stored in the backup as
+ * INCREMENTAL.<original name>.  It contains an IncrementalFileHeader, then
+ * num_blocks block numbers (relative to the start of the segment) in
+ * ascending order, then the contents of those blocks in the same order.
+ * Blocks not included are unchanged since the prior backup, except that
+ * the file is truncation_block_length blocks long.
+ */
+#define INCREMENTAL_PREFIX			"INCREMENTAL."
+#define INCREMENTAL_PREFIX_LENGTH	(sizeof(INCREMENTAL_PREFIX) - 1)
+
+#define INCREMENTAL_MAGIC			0xd3ae1f0d
+
+typedef struct IncrementalFileHeader
+{
+	uint32		magic;
+	uint32		num_blocks;
+	uint32		truncation_block_length;
+} IncrementalFileHeader;
+
+/* Lines added to the backup_label of an incremental backup */
+#define INCREMENTAL_LSN_LABEL		"INCREMENTAL FROM LSN: "
+#define INCREMENTAL_TLI_LABEL		"INCREMENTAL FROM TLI: "
+
+#endif							/* INCREMENTAL_H */
@@ -15,6 +15,7 @@
 #include "access/xlog.h"
 #include "nodes/nodes.h"
 #include "replication/syncrep.h"
+#include "storage/dsm.h"
 #include "storage/latch.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
@@ -28,6 +29,9 @@ typedef enum WalSndState
 	WALSNDSTATE_STOPPING
 } WalSndState;
 
+/* Length in bytes of the ID of a parallel base backup, see basebackup.c */
+#define PARALLEL_BACKUP_ID_LEN	16
+
 /*
  * Each walsender has a WalSnd struct in shared memory.
  *
@@ -78,6 +82,15 @@ typedef struct WalSnd
 	 * Timestamp of the last message received from standby.
 	 */
 	TimestampTz replyTime;
+
+	/*
+	 * The parallel base backup this walsender is leading, if any: the DSM
+	 * segment holding its shared state, or DSM_HANDLE_INVALID, and the
+	 * random ID that other connections present to join it.  Protected by
+	 * mutex.
+	 */
+	dsm_handle	parallelBackupHandle;
+	char		parallelBackupId[PARALLEL_BACKUP_ID_LEN];
 } WalSnd;
 
 extern WalSnd *MyWalSnd;
@@ -0,0 +1,64 @@
+/*-------------------------------------------------------------------------
+ *
+ * walsummary.h
+ *	  In-memory tables of modified blocks, and the WAL summary files
+ *	  that store them on disk.
+ *
+ * Portions Copyright (c) 2010-2020, PostgreSQL Global Development Group
+ *
+ * src/include/replication/walsummary.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef WALSUMMARY_H
+#define WALSUMMARY_H
+
+#include "access/xlogdefs.h"
+#include "common/relpath.h"
+#include "nodes/pg_list.h"
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* Directory, relative to the data directory, holding WAL summary files */
+#define WAL_SUMMARY_DIR		"pg_wal/summaries"
+
+/*
+ * Identifies one WAL summary file: the modified blocks of a range of WAL
+ * on a single timeline.  end_lsn is exclusive.
+ */
+typedef struct WalSummaryFile
+{
+	TimeLineID	tli;
+	XLogRecPtr	start_lsn;
+	XLogRecPtr	end_lsn;
+} WalSummaryFile;
+
+/* Opaque; see walsummary.c */
+typedef struct BlockRefTable BlockRefTable;
+
+extern BlockRefTable *CreateBlockRefTable(void);
+extern void BlockRefTableMarkBlockModified(BlockRefTable *brtab,
+										   const RelFileNode *rnode,
+										   ForkNumber forknum,
+										   BlockNumber blknum);
+extern void BlockRefTableSetLimitBlock(BlockRefTable *brtab,
+									   const RelFileNode *rnode,
+									   ForkNumber forknum,
+									   BlockNumber limit_block);
+extern int	BlockRefTableGetModifiedBlocks(BlockRefTable *brtab,
+										   const RelFileNode *rnode,
+										   ForkNumber forknum,
+										   BlockNumber start_blkno,
+										   BlockNumber stop_blkno,
+										   BlockNumber *blocks);
+
+extern List *GetWalSummaries(TimeLineID tli, XLogRecPtr start_lsn,
+							 XLogRecPtr end_lsn);
+extern XLogRecPtr WalSummariesCoverRange(List *wslist, XLogRecPtr start_lsn,
+										 XLogRecPtr end_lsn);
+extern void ReadWalSummary(WalSummaryFile *ws, BlockRefTable *brtab);
+extern void WriteWalSummary(BlockRefTable *brtab, TimeLineID tli,
+							XLogRecPtr start_lsn, XLogRecPtr end_lsn);
+extern void RemoveOldWalSummaries(int keep_minutes);
+
+#endif							/* WALSUMMARY_H */
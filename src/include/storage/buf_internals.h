@@ -228,6 +228,16 @@ typedef union BufferDescPadded
 
 extern PGDLLIMPORT LWLockMinimallyPadded *BufferIOLWLockArray;
 
+/*
+ * With numa = partition, the shared buffers are divided into NumaNodes
+ * contiguous partitions, whose pages and descriptors are placed on the
+ * corresponding NUMA node.
+ */
+#define BufferGetNumaNode(buf_id) \
+	((int) (((uint64) (buf_id) * NumaNodes) / NBuffers))
+#define NumaNodeFirstBuffer(node) \
+	((int) (((uint64) (node) * NBuffers + NumaNodes - 1) / NumaNodes))
+
 /*
  * The freeNext field is either the index of the next freelist entry,
  * or one of these special values:
@@ -273,6 +283,7 @@ typedef struct WritebackContext
 /* in buf_init.c */
 extern PGDLLIMPORT BufferDescPadded *BufferDescriptors;
 extern PGDLLIMPORT WritebackContext BackendWritebackContext;
+extern int	NumaNodes;
 
 /* in localbuf.c */
 extern BufferDesc *LocalBufferDescriptors;
@@ -313,9 +324,13 @@ extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 
 extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
 extern void StrategyNotifyBgWriter(int bgwprocno);
+extern void StrategyCountNumaHit(int buf_id);
+extern void StrategyRememberEviction(uint32 hashcode);
+extern bool StrategyRecentlyEvicted(uint32 hashcode);
 
 extern Size StrategyShmemSize(void);
 extern void StrategyInitialize(bool init);
+extern void StrategyInitBackend(void);
 extern bool have_free_buffer(void);
 
 /* buf_table.c */
@@ -323,6 +338,7 @@ extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
@@ -46,6 +46,13 @@ typedef enum
 								 * replay; otherwise same as RBM_NORMAL */
 } ReadBufferMode;
 
+/* Possible values for buffer_replacement_policy */
+typedef enum BufferReplacementPolicy
+{
+	BUFFER_REPLACEMENT_CLOCK,	/* plain clock sweep */
+	BUFFER_REPLACEMENT_2Q		/* clock sweep approximating 2Q */
+} BufferReplacementPolicy;
+
 /*
  * Type returned by PrefetchBuffer().
  */
@@ -55,6 +62,26 @@ typedef struct PrefetchBufferResult
 	bool		initiated_io;	/* If true, a miss resulting in async I/O */
 } PrefetchBufferResult;
 
+/*
+ * Maximum number of consecutive blocks the buffer manager transfers with a
+ * single I/O call.
+ */
+#define MAX_BUFFERS_PER_TRANSFER 16
+
+/*
+ * A read stream delivers a sequence of blocks of one relation fork, as
+ * chosen by a caller-supplied callback, while keeping a number of reads ahead
+ * of the consumer in flight.  The callback returns InvalidBlockNumber to end
+ * the stream.  If the stream was created with a nonzero per_block_data_size,
+ * the callback may also fill in a chunk of private data for each block, which
+ * is handed back to the consumer along with that block.
+ */
+typedef struct ReadStream ReadStream;
+
+typedef BlockNumber (*ReadStreamBlockNumberCB) (ReadStream *stream,
+												void *callback_private_data,
+												void *per_block_data);
+
 /* forward declared, to avoid having to expose buf_internals.h here */
 struct WritebackContext;
 
@@ -79,6 +106,9 @@ extern int	bgwriter_flush_after;
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
 
+/* in freelist.c */
+extern PGDLLIMPORT int buffer_replacement_policy;
+
 /* in localbuf.c */
 extern PGDLLIMPORT int NLocBuffer;
 extern PGDLLIMPORT Block *LocalBufferBlockPointers;
@@ -183,6 +213,9 @@ extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode,
 										ForkNumber forkNum, BlockNumber blockNum,
 										ReadBufferMode mode, BufferAccessStrategy strategy);
+extern void ReadBuffers(Relation reln, ForkNumber forkNum,
+						BlockNumber blockNum, int nblocks,
+						BufferAccessStrategy strategy, Buffer *buffers);
 extern void ReleaseBuffer(Buffer buffer);
 extern void UnlockReleaseBuffer(Buffer buffer);
 extern void MarkBufferDirty(Buffer buffer);
@@ -190,6 +223,20 @@ extern void IncrBufferRefCount(Buffer buffer);
 extern Buffer ReleaseAndReadBuffer(Buffer buffer, Relation relation,
 								   BlockNumber blockNum);
 
+extern ReadStream *ReadStreamBegin(Relation rel, ForkNumber forkNum,
+								   BufferAccessStrategy strategy,
+								   int max_ios,
+								   ReadStreamBlockNumberCB callback,
+								   void *callback_private_data,
+								   size_t per_block_data_size);
+extern BlockNumber ReadStreamNextBlock(ReadStream *stream,
+									   void **per_block_data);
+extern Buffer ReadStreamNextBuffer(ReadStream *stream, void **per_block_data);
+extern void ReadStreamSetAccessStrategy(ReadStream *stream,
+										BufferAccessStrategy strategy);
+extern void ReadStreamReset(ReadStream *stream);
+extern void ReadStreamEnd(ReadStream *stream);
+
 extern void InitBufferPool(void);
 extern void InitBufferPoolAccess(void);
 extern void InitBufferPoolBackend(void);
@@ -197,6 +244,8 @@ extern void AtEOXact_Buffers(bool isCommit);
 extern void PrintBufferLeakWarning(Buffer buffer);
 extern void CheckPointBuffers(int flags);
 extern BlockNumber BufferGetBlockNumber(Buffer buffer);
+extern BlockNumber ExtendRelationBy(Relation reln, ForkNumber forkNum,
+								   uint32 extend_by);
 extern BlockNumber RelationGetNumberOfBlocksInFork(Relation relation,
 												   ForkNumber forkNum);
 extern void FlushOneBuffer(Buffer buffer);
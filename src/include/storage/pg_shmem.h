@@ -45,6 +45,7 @@ typedef struct PGShmemHeader	/* standard header for all Postgres shmem */
 extern int	shared_memory_type;
 extern int	huge_pages;
 extern int	huge_page_size;
+extern int	numa_mode;
 
 /* Possible values for huge_pages */
 typedef enum
@@ -54,6 +55,14 @@ typedef enum
 	HUGE_PAGES_TRY
 }			HugePagesType;
 
+/* Possible values for numa */
+typedef enum
+{
+	NUMA_OFF,
+	NUMA_INTERLEAVE,
+	NUMA_PARTITION
+}			NumaModeType;
+
 /* Possible values for shared_memory_type */
 typedef enum
 {
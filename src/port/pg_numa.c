@@ -0,0 +1,201 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.c
+ *	  Minimal support for placing memory on NUMA nodes.
+ *
+ * This is implemented with the Linux system calls directly, so that we don't
+ * need libnuma.  On other platforms, the system is treated as having a single
+ * node and memory placement always fails.
+ *
+ * Portions Copyright (c) 1996-2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_numa.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "port/pg_numa.h"
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+#define USE_LINUX_NUMA 1
+
+/* memory policies, from <linux/mempolicy.h> */
+#define PG_MPOL_PREFERRED	1
+#define PG_MPOL_INTERLEAVE	3
+#endif
+
+/* number of online nodes, or 0 if not determined yet */
+static int	numa_nnodes = 0;
+
+/* operating system node numbers of the online nodes */
+static int	numa_node_ids[PG_NUMA_MAX_NODES];
+
+#ifdef USE_LINUX_NUMA
+/*
+ * Read the list of online nodes from sysfs.  The file contains a list of
+ * comma-separated ranges, such as "0-1,4".
+ */
+static void
+pg_numa_read_nodes(void)
+{
+	FILE	   *file;
+	char		buf[1024];
+	char	   *p;
+
+	file = fopen("/sys/devices/system/node/online", "r");
+	if (file == NULL)
+		return;
+	if (fgets(buf, sizeof(buf), file) == NULL)
+		buf[0] = '\0';
+	fclose(file);
+
+	p = buf;
+	while (*p != '\0' && *p != '\n')
+	{
+		char	   *end;
+		long		first;
+		long		last;
+
+		first = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		last = first;
+		p = end;
+		if (*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p)
+				break;
+			p = end;
+		}
+		for (long n = first; n <= last; n++)
+		{
+			/* node numbers must fit in the single-word masks we pass */
+			if (n >= PG_NUMA_MAX_NODES || numa_nnodes >= PG_NUMA_MAX_NODES)
+				break;
+			numa_node_ids[numa_nnodes++] = (int) n;
+		}
+		if (*p == ',')
+			p++;
+	}
+}
+#endif
+
+/*
+ * pg_numa_init
+ *		Returns the number of nodes, which is 1 if the system isn't NUMA or
+ *		we can't tell
+ */
+int
+pg_numa_init(void)
+{
+	if (numa_nnodes > 0)
+		return numa_nnodes;
+
+#ifdef USE_LINUX_NUMA
+	pg_numa_read_nodes();
+#endif
+
+	if (numa_nnodes == 0)
+	{
+		numa_node_ids[0] = 0;
+		numa_nnodes = 1;
+	}
+
+	return numa_nnodes;
+}
+
+/*
+ * pg_numa_node_id
+ *		Returns the operating system's number for a node
+ */
+int
+pg_numa_node_id(int node)
+{
+	Assert(node >= 0 && node < pg_numa_init());
+
+	return numa_node_ids[node];
+}
+
+/*
+ * pg_numa_get_node
+ *		Returns the node the calling process is running on, or -1 if unknown
+ *
+ * The process can of course be moved to another node at any time.
+ */
+int
+pg_numa_get_node(void)
+{
+#ifdef USE_LINUX_NUMA
+	unsigned int cpu;
+	unsigned int id;
+
+	if (pg_numa_init() > 1 &&
+		syscall(SYS_getcpu, &cpu, &id, NULL) == 0)
+	{
+		for (int node = 0; node < numa_nnodes; node++)
+		{
+			if (numa_node_ids[node] == (int) id)
+				return node;
+		}
+	}
+#endif
+
+	return -1;
+}
+
+/*
+ * pg_numa_interleave
+ *		Interleave the pages of a memory range across all nodes
+ *
+ * addr must be aligned to the page size.  The policy only affects pages
+ * that haven't been touched yet.  Returns 0 on success, or -1 with errno set.
+ */
+int
+pg_numa_interleave(void *addr, size_t len)
+{
+#ifdef USE_LINUX_NUMA
+	unsigned long mask = 0;
+
+	for (int node = 0; node < pg_numa_init(); node++)
+		mask |= 1UL << numa_node_ids[node];
+
+	return (int) syscall(SYS_mbind, addr, len, PG_MPOL_INTERLEAVE,
+						 &mask, (unsigned long) PG_NUMA_MAX_NODES + 1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ * pg_numa_prefer
+ *		Place the pages of a memory range on a node, if it has room for them
+ *
+ * addr must be aligned to the page size.  The policy only affects pages
+ * that haven't been touched yet.  Returns 0 on success, or -1 with errno set.
+ */
+int
+pg_numa_prefer(void *addr, size_t len, int node)
+{
+#ifdef USE_LINUX_NUMA
+	unsigned long mask;
+
+	Assert(node >= 0 && node < pg_numa_init());
+	mask = 1UL << numa_node_ids[node];
+
+	return (int) syscall(SYS_mbind, addr, len, PG_MPOL_PREFERRED,
+						 &mask, (unsigned long) PG_NUMA_MAX_NODES + 1, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
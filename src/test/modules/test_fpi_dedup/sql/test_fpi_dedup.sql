@@ -0,0 +1,30 @@
+CREATE EXTENSION test_fpi_dedup;
+
+-- A full heap page
+CREATE TABLE fpi_dedup (a int, b text);
+INSERT INTO fpi_dedup SELECT g, repeat('x', 100) FROM generate_series(1, 55) g;
+SELECT pg_relation_size('fpi_dedup') = current_setting('block_size')::int;
+
+-- Without deduplication, every image is logged in full
+SET wal_fpi_dedup = off;
+SELECT pg_current_wal_insert_lsn() AS before \gset
+SELECT test_log_newpage('fpi_dedup', 0, 3);
+SELECT pg_wal_lsn_diff(pg_current_wal_insert_lsn(), :'before') >
+  3 * (current_setting('block_size')::int - 1024) AS full_images;
+
+-- With it, only the first one
+SET wal_fpi_dedup = on;
+SELECT pg_current_wal_insert_lsn() AS before \gset
+SELECT test_log_newpage('fpi_dedup', 0, 3);
+SELECT pg_wal_lsn_diff(pg_current_wal_insert_lsn(), :'before') <
+  2 * (current_setting('block_size')::int - 1024) AS deduplicated;
+
+SELECT count(*), sum(a) FROM fpi_dedup;
+
+-- Errors
+SELECT test_log_newpage('fpi_dedup', 1, 1);
+CREATE TEMP TABLE fpi_dedup_temp (a int);
+INSERT INTO fpi_dedup_temp VALUES (1);
+SELECT test_log_newpage('fpi_dedup_temp', 0, 1);
+
+DROP TABLE fpi_dedup;
@@ -0,0 +1,8 @@
+/* src/test/modules/test_fpi_dedup/test_fpi_dedup--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION test_fpi_dedup" to load this file. \quit
+
+CREATE FUNCTION test_log_newpage(rel regclass, blkno int8, count int4)
+RETURNS pg_catalog.void STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
@@ -0,0 +1,73 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_fpi_dedup.c
+ *		Test deduplication of full-page images in WAL (wal_fpi_dedup)
+ *
+ * Copyright (c) 2020, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_fpi_dedup/test_fpi_dedup.c
+ *
+ * -------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/relation.h"
+#include "access/xloginsert.h"
+#include "catalog/pg_class.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "utils/rel.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(test_log_newpage);
+
+/*
+ * Logs a full-page image of a block of a relation's main fork 'count' times
+ * in a row, without changing the page in between.  With wal_fpi_dedup, all
+ * but the first image in a checkpoint cycle are logged as references to the
+ * first.
+ */
+Datum
+test_log_newpage(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int64		blkno = PG_GETARG_INT64(1);
+	int32		count = PG_GETARG_INT32(2);
+	Relation	rel;
+	Buffer		buf;
+
+	rel = relation_open(relid, ShareUpdateExclusiveLock);
+
+	if (!RELKIND_HAS_STORAGE(rel->rd_rel->relkind) ||
+		!RelationNeedsWAL(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("relation \"%s\" is not a WAL-logged relation with storage",
+						RelationGetRelationName(rel))));
+
+	if (blkno < 0 || blkno >= RelationGetNumberOfBlocks(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("block number " INT64_FORMAT " is out of range for relation \"%s\"",
+						blkno, RelationGetRelationName(rel))));
+
+	buf = ReadBufferExtended(rel, MAIN_FORKNUM, (BlockNumber) blkno,
+							 RBM_NORMAL, NULL);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+
+	for (int i = 0; i < count; i++)
+	{
+		START_CRIT_SECTION();
+		MarkBufferDirty(buf);
+		log_newpage_buffer(buf, true);
+		END_CRIT_SECTION();
+	}
+
+	UnlockReleaseBuffer(buf);
+	relation_close(rel, NoLock);
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,90 @@
+# Verify the buffer replacement policies and the statistics they report
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 8;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+buffer_replacement_policy = 2q
+});
+$node->start;
+
+# A table several times the size of shared_buffers
+$node->safe_psql('postgres',
+	    "CREATE TABLE t (id int PRIMARY KEY, filler text);"
+	  . "INSERT INTO t SELECT g, repeat('x', 500) FROM generate_series(1, 10000) g;"
+	  . "VACUUM ANALYZE t;");
+
+# Index lookups in a scattered order, so that blocks are read in without a
+# buffer access strategy and are evicted and read back in again.
+my $workload = q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT sum(length((SELECT filler FROM t WHERE id = (g * 7919) % 10000 + 1)))
+FROM generate_series(1, 20000) g;
+};
+
+my $result = $node->safe_psql('postgres', $workload);
+is($result, '10000000', 'workload gives the right answer under 2Q');
+
+is( $node->safe_psql(
+		'postgres', 'SELECT policy FROM pg_stat_buffer_replacement'),
+	'2q',
+	'policy is reported');
+
+# The statistics are flushed in batches and at backend exit, so wait for the
+# workload's backend to have reported them.
+ok( $node->poll_query_until(
+		'postgres',
+		'SELECT victims > 0 AND ghost_hits > 0 AND ghost_misses > 0 '
+		  . 'FROM pg_stat_buffer_replacement'),
+	'2Q counts victims and ghost hits and misses');
+
+is( $node->safe_psql(
+		'postgres',
+		'SELECT ghost_entries > 0 FROM pg_stat_buffer_replacement'),
+	't',
+	'ghost table is in use');
+
+# The default policy keeps none of the 2Q bookkeeping
+$node->append_conf('postgresql.conf', 'buffer_replacement_policy = clock');
+$node->restart;
+
+$result = $node->safe_psql('postgres', $workload);
+is($result, '10000000', 'workload gives the right answer under clock');
+
+ok( $node->poll_query_until(
+		'postgres',
+		'SELECT victims > 0 FROM pg_stat_buffer_replacement'),
+	'clock sweep counts victims');
+
+is( $node->safe_psql(
+		'postgres',
+		"SELECT policy || ' ' || ghost_entries || ' ' || demotions || ' ' || "
+		  . "hot_skips || ' ' || ghost_hits || ' ' || ghost_misses "
+		  . 'FROM pg_stat_buffer_replacement'),
+	'clock 0 0 0 0 0',
+	'clock sweep keeps no 2Q statistics');
+
+# A backend that exits before it has counted a full batch of events must
+# still report them
+$node->restart;
+$node->safe_psql(
+	'postgres', q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT sum(length((SELECT filler FROM t WHERE id = (g * 7919) % 10000 + 1)))
+FROM generate_series(1, 200) g;
+});
+ok( $node->poll_query_until(
+		'postgres',
+		'SELECT victims > 0 FROM pg_stat_buffer_replacement'),
+	'victims of a short-lived backend are counted');
+
+$node->stop;
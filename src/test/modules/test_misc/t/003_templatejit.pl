@@ -0,0 +1,93 @@
+# Check that queries compiled by the templatejit provider give the same
+# results as interpreted ones
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 9;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+jit_provider = 'templatejit'
+jit = on
+jit_above_cost = 0
+jit_inline_above_cost = 0
+jit_optimize_above_cost = 0
+max_parallel_workers_per_gather = 0
+});
+$node->start;
+
+is($node->safe_psql('postgres', 'SELECT pg_jit_available()'),
+	't', 'templatejit provider can be loaded');
+
+# Columns of every type the qual templates know, NOT NULL ones for the fixed
+# offset deforming, and nullable and variable-width ones in between.
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE jt (
+  id int4 NOT NULL,
+  i2 int2 NOT NULL,
+  i8 int8 NOT NULL,
+  i4 int4,
+  t text,
+  f8 float8,
+  o oid,
+  d date,
+  ts timestamp,
+  tstz timestamptz
+);
+INSERT INTO jt
+  SELECT g, (g % 1000)::int2, g * 1000,
+         CASE WHEN g % 17 = 0 THEN NULL ELSE g % 1000 END,
+         CASE WHEN g % 13 = 0 THEN NULL ELSE repeat('t', g % 50) END,
+         g / 7.0, g::oid,
+         date '2000-01-01' + g % 400,
+         timestamp '2000-01-01' + g * interval '1 hour',
+         timestamptz '2000-01-01 00:00+00' + g * interval '1 minute'
+  FROM generate_series(1, 20000) g;
+ANALYZE jt;
+});
+
+my %queries = (
+	'single-clause qual' =>
+	  'SELECT count(*), sum(i8) FROM jt WHERE i4 > 500',
+	'multi-clause qual' => q{
+SELECT count(*), sum(id) FROM jt
+WHERE i2 >= 100 AND i8 < 15000000 AND f8 <> 100 AND o > 50
+  AND d <= '2000-06-01' AND ts > '2000-02-01' AND tstz < '2000-01-10 00:00+00'},
+	'qual on nullable column' =>
+	  'SELECT count(*), min(id), max(id) FROM jt WHERE i4 < 10',
+	'deforming across NULLs and varlenas' =>
+	  'SELECT * FROM jt WHERE id % 97 = 0 ORDER BY id',
+	'aggregates' => q{
+SELECT i2 % 10, count(*), count(i4), sum(i8), avg(f8), min(d), max(ts),
+       max(tstz), sum(length(t)), string_agg(t, ',' ORDER BY id)
+FROM jt GROUP BY 1 ORDER BY 1},
+	'qual over a sorted subquery' => q{
+SELECT count(*), sum(i4) FROM
+  (SELECT * FROM jt ORDER BY t, id OFFSET 0) s
+WHERE i8 > 5000000 AND i4 IS NOT NULL});
+
+foreach my $name (sort keys %queries)
+{
+	my $query = $queries{$name};
+
+	is( $node->safe_psql('postgres', "SET jit = on; $query"),
+		$node->safe_psql('postgres', "SET jit = off; $query"),
+		"$name: same result with and without JIT");
+}
+
+# Make sure JIT was really used
+my $explain = $node->safe_psql('postgres',
+	"EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF) $queries{'multi-clause qual'}"
+);
+like($explain, qr/JIT:\n\s+Functions: [1-9]/,
+	'query was compiled by the JIT provider');
+
+$explain = $node->safe_psql('postgres',
+	"SET jit = off; EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF) $queries{'aggregates'}"
+);
+unlike($explain, qr/JIT:/, 'query was not compiled with jit = off');
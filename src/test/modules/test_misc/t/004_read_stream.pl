@@ -0,0 +1,123 @@
+# Exercise the read streams behind sequential scans, ANALYZE and VACUUM on
+# a table several times the size of shared_buffers
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 10;
+
+# Read-ahead advice needs posix_fadvise()
+my $io_concurrency =
+  check_pg_config("#define HAVE_DECL_POSIX_FADVISE 1") ? 16 : 0;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+effective_io_concurrency = $io_concurrency
+maintenance_io_concurrency = $io_concurrency
+autovacuum = off
+max_parallel_workers_per_gather = 0
+synchronize_seqscans = off
+});
+$node->start;
+
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE big (a int, b text);
+INSERT INTO big SELECT g, repeat('x', 100) FROM generate_series(1, 50000) g;
+});
+
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM big'),
+	'50000|1250025000', 'sequential scan sees every row');
+
+# A scan that stops early abandons its stream
+is($node->safe_psql('postgres', 'SELECT a FROM big LIMIT 3'),
+	"1\n2\n3", 'scan stopped early');
+
+# Changing direction in the middle of a scan
+is( $node->safe_psql(
+		'postgres', q{
+BEGIN;
+DECLARE c SCROLL CURSOR FOR SELECT a FROM big;
+MOVE FORWARD 30000 IN c;
+FETCH BACKWARD 2 FROM c;
+FETCH LAST FROM c;
+FETCH ABSOLUTE 1 FROM c;
+COMMIT;
+}),
+	"29999\n29998\n50000\n1",
+	'scan changing direction');
+
+# With synchronized scans, the outer scan starts where the one in the
+# initplan left off, and wraps around the end of the table
+is( $node->safe_psql(
+		'postgres', q{
+SET synchronize_seqscans = on;
+SELECT count(*), sum(x.a) FROM big x
+WHERE x.a <= (SELECT max(a) FROM big) AND x.a > 0;
+}),
+	'50000|1250025000',
+	'synchronized scans see every row');
+
+# ANALYZE reads all the pages, as there are fewer than it samples
+$node->safe_psql('postgres', 'ANALYZE big');
+is( $node->safe_psql(
+		'postgres', q{
+SELECT reltuples, relpages = pg_relation_size('big') / 8192
+FROM pg_class WHERE relname = 'big'}),
+	'50000|t',
+	'ANALYZE counted every row');
+
+# The first VACUUM visits everything; the second skips all-visible pages
+# except those with deleted rows.
+$node->safe_psql('postgres', 'VACUUM big');
+$node->safe_psql('postgres',
+	'DELETE FROM big WHERE a <= 10000 AND a % 10 = 0');
+$node->safe_psql('postgres', 'VACUUM big');
+
+my $size = $node->safe_psql('postgres', "SELECT pg_relation_size('big')");
+$node->safe_psql('postgres',
+	"INSERT INTO big SELECT -g, repeat('x', 100) FROM generate_series(1, 1000) g"
+);
+is($node->safe_psql('postgres', "SELECT pg_relation_size('big')"),
+	$size, 'space freed by VACUUM was reused');
+
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), count(*) FILTER (WHERE a < 0) FROM big'
+	),
+	'50000|1000',
+	'table contents after VACUUM');
+
+# Again without page skipping, and freezing
+$node->safe_psql('postgres',
+	'DELETE FROM big WHERE a < 0; VACUUM (DISABLE_PAGE_SKIPPING, FREEZE) big'
+);
+is( $node->safe_psql(
+		'postgres', q{
+SELECT count(*) FROM big WHERE a > 10000 OR a % 10 <> 0}),
+	'49000',
+	'table contents after aggressive VACUUM');
+is( $node->safe_psql(
+		'postgres', q{
+SELECT age(relfrozenxid) < 100 FROM pg_class WHERE relname = 'big'}),
+	't',
+	'aggressive VACUUM advanced relfrozenxid');
+
+# Temporary tables are read through streams of local buffers, one block at
+# a time; make this one bigger than temp_buffers, so that they're recycled
+is( $node->safe_psql(
+		'postgres', q{
+SET temp_buffers = '1MB';
+CREATE TEMP TABLE tmp AS SELECT * FROM big;
+SELECT count(*), sum(a) FROM tmp;
+DELETE FROM tmp WHERE a % 2 = 0;
+VACUUM tmp;
+ANALYZE tmp;
+SELECT count(*), sum(a) FROM tmp;
+SELECT reltuples FROM pg_class WHERE relname = 'tmp';
+}),
+	"49000|1245020000\n25000|625000000\n25000",
+	'scan, VACUUM and ANALYZE of a temporary table');
@@ -0,0 +1,92 @@
+# Exercise vectored reads of consecutive blocks, by several backends at
+# once scanning a table that doesn't fit in shared_buffers, while others
+# read scattered blocks of it into the buffer pool
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 8;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 2MB
+autovacuum = off
+max_parallel_workers_per_gather = 0
+});
+$node->start;
+
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE big (a int, b text);
+INSERT INTO big SELECT g, repeat('x', 100) FROM generate_series(1, 50000) g;
+CREATE INDEX big_a ON big (a);
+CREATE TABLE results (n bigint, s bigint);
+});
+
+# Each transaction first reads a random range through the index, leaving
+# holes in the runs of missing blocks the others' sequential scans read.
+my $script = $node->basedir . '/vectored_read.sql';
+TestLib::append_to_file(
+	$script, q{
+\set x random(1, 49000)
+SELECT sum(a) FROM big WHERE a BETWEEN :x AND :x + 500;
+INSERT INTO results SELECT count(*), sum(a) FROM big;
+});
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '25', '-f', $script,
+		'postgres'
+	],
+	'concurrent sequential scans');
+
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), count(DISTINCT (n, s)) FROM results'),
+	'100|1',
+	'every scan gave the same result');
+is($node->safe_psql('postgres', 'SELECT n, s FROM results LIMIT 1'),
+	'50000|1250025000', 'every scan saw every row');
+
+# Again after a restart, so that the first scans all start cold
+$node->restart;
+$node->safe_psql('postgres', 'TRUNCATE results');
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '5',
+		'-f', $script, 'postgres'
+	],
+	'concurrent sequential scans on a cold buffer pool');
+is( $node->safe_psql(
+		'postgres',
+		"SELECT count(*) FROM results WHERE (n, s) <> (50000, 1250025000)"),
+	'0',
+	'every scan on a cold buffer pool saw every row');
+
+# With a tiny buffer pool, many streams open at once in cursors must not pin
+# so many buffers ahead that none are left to evict
+$node->append_conf('postgresql.conf', 'shared_buffers = 256kB');
+$node->restart;
+
+my $cursors = "BEGIN;\nSET synchronize_seqscans = off;\n";
+$cursors .= "DECLARE c$_ CURSOR FOR SELECT a FROM big;\n" for 1 .. 8;
+for my $round (1 .. 5)
+{
+	$cursors .= "MOVE FORWARD 1000 IN c$_;\n" for 1 .. 8;
+}
+$cursors .= "FETCH 1 FROM c$_;\n" for 1 .. 8;
+$cursors .= "COMMIT;\n";
+
+my ($ret, $stdout, $stderr) = $node->psql('postgres', $cursors);
+is($ret, 0, 'interleaved scans in cursors with tiny shared_buffers')
+  or diag($stderr);
+is($stdout, join("\n", ('5001') x 8), 'every cursor is at the right row');
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '5', '-f', $script,
+		'postgres'
+	],
+	'concurrent sequential scans with tiny shared_buffers');
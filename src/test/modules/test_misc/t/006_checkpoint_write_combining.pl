@@ -0,0 +1,90 @@
+# Exercise the combined writes of adjacent dirty blocks at checkpoints, with
+# data checksums enabled and concurrent updates, and check the result after
+# a crash
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 7;
+
+my $node = get_new_node('main');
+$node->init(extra => ['--data-checksums']);
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 16MB
+checkpoint_timeout = 1h
+max_wal_size = 1GB
+autovacuum = off
+});
+$node->start;
+
+# Enough adjacent dirty blocks to fill many combined writes, in the table
+# and its index
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE t (a int PRIMARY KEY, b int, c text);
+INSERT INTO t SELECT g, 0, repeat('c', 100) FROM generate_series(1, 50000) g;
+});
+$node->safe_psql('postgres', 'CHECKPOINT');
+
+# Checkpoints while other backends keep locking and dirtying the same
+# buffers, so that some runs are cut short
+my $update = $node->basedir . '/update.sql';
+TestLib::append_to_file(
+	$update, q{
+\set x random(1, 50000)
+UPDATE t SET b = b + 1 WHERE a BETWEEN :x AND :x + 20;
+});
+my $checkpoint = $node->basedir . '/checkpoint.sql';
+TestLib::append_to_file($checkpoint, "CHECKPOINT;\n");
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '200',
+		'-f', "$update\@20", '-f', "$checkpoint\@1", 'postgres'
+	],
+	'checkpoints during concurrent updates');
+
+# Write everything out, then crash without changing anything else, so
+# that after recovery the data files hold what the checkpoint wrote
+$node->safe_psql('postgres', 'UPDATE t SET b = b + 1 WHERE a % 3 = 0');
+$node->safe_psql('postgres', 'CHECKPOINT');
+my $expected =
+  $node->safe_psql('postgres', 'SELECT count(*), sum(b), sum(length(c)) FROM t');
+$node->stop('immediate');
+$node->start;
+
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), sum(b), sum(length(c)) FROM t'),
+	$expected,
+	'contents after crash recovery');
+is( $node->safe_psql(
+		'postgres', 'SET enable_seqscan = off; SELECT count(*) FROM t WHERE a > 0'),
+	'50000',
+	'index usable after crash recovery');
+
+# Crash again in the middle of more updates
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '50',
+		'-f', "$update\@20", '-f', "$checkpoint\@1", 'postgres'
+	],
+	'more checkpoints during concurrent updates');
+$node->stop('immediate');
+$node->start;
+is($node->safe_psql('postgres', 'SELECT count(*) FROM t'),
+	'50000', 'table readable after second crash');
+
+# Every page the checkpoints wrote must have a valid checksum
+$node->safe_psql('postgres', 'CHECKPOINT');
+$node->stop;
+command_ok([ 'pg_checksums', '--check', '-D', $node->data_dir ],
+	'checksums are valid');
+
+$node->start;
+is( $node->safe_psql(
+		'postgres',
+		"SELECT sum(checksum_failures) FROM pg_stat_database"),
+	'0',
+	'no checksum failures reported');
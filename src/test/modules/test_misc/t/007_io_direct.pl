@@ -0,0 +1,125 @@
+# Run a variety of operations with io_direct enabled for data files and
+# WAL, including ones that go through md.c's bounce buffer, and recover
+# from a crash
+
+use strict;
+use warnings;
+use Fcntl;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+my $node = get_new_node('main');
+
+# Not every platform and file system supports O_DIRECT; tmpfs, for one,
+# doesn't.  Try it out where the cluster will live.
+my $o_direct = eval { Fcntl::O_DIRECT() };
+my $probe    = $node->basedir . '/o_direct_probe';
+if (!defined $o_direct)
+{
+	plan skip_all => 'O_DIRECT is not supported on this platform';
+}
+elsif (!sysopen(my $fh, $probe, O_RDWR | O_CREAT | $o_direct))
+{
+	plan skip_all => "O_DIRECT is not supported by the file system: $!";
+}
+else
+{
+	close $fh;
+	unlink $probe;
+	plan tests => 10;
+}
+
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+io_direct = 'data, wal'
+shared_buffers = 2MB
+autovacuum = off
+});
+$node->start;
+
+is($node->safe_psql('postgres', 'SHOW io_direct'),
+	'data, wal', 'io_direct is in effect');
+
+# Goes through shared buffers: inserts, a scan bigger than shared_buffers,
+# an index scan and VACUUM
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE t (a int, b text);
+INSERT INTO t SELECT g, md5(g::text) FROM generate_series(1, 50000) g;
+CREATE INDEX t_a ON t (a);
+DELETE FROM t WHERE a % 5 = 0;
+VACUUM t;
+});
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM t'),
+	'40000|1000000000', 'sequential scan');
+is( $node->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SELECT count(*) FROM t WHERE a BETWEEN 1000 AND 1999'
+	),
+	'800',
+	'index scan');
+
+# Write pages built in backend-local memory: index builds, table rewrites
+# and copying a relation to another tablespace
+my $tsdir = $node->basedir . '/ts';
+mkdir $tsdir;
+$node->safe_psql(
+	'postgres', qq{
+CREATE INDEX t_b ON t (b);
+CREATE INDEX t_a_hash ON t USING hash (a);
+VACUUM FULL t;
+CREATE TABLESPACE ts LOCATION '$tsdir';
+ALTER TABLE t SET TABLESPACE ts;
+});
+is( $node->safe_psql(
+		'postgres',
+		"SET enable_seqscan = off; SELECT count(*) FROM t WHERE b > 'f'"),
+	$node->safe_psql(
+		'postgres',
+		"SET enable_indexscan = off; SET enable_bitmapscan = off; SELECT count(*) FROM t WHERE b > 'f'"
+	),
+	'btree index built with direct I/O matches the table');
+is( $node->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SELECT count(*) FROM t WHERE a = 4242'),
+	'1',
+	'hash index built with direct I/O');
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM t'),
+	'40000|1000000000', 'contents after rewrite and tablespace move');
+
+# Local buffers
+is( $node->safe_psql(
+		'postgres', q{
+SET temp_buffers = '1MB';
+CREATE TEMP TABLE tmp AS SELECT * FROM t;
+UPDATE tmp SET a = -a;
+SELECT count(*), sum(a) FROM tmp;
+}),
+	'40000|-1000000000',
+	'temporary table');
+
+# COPY extends the table in bulk
+my $copyfile = $node->basedir . '/copy.data';
+TestLib::append_to_file($copyfile, join("\n", 1 .. 30000) . "\n");
+$node->safe_psql(
+	'postgres', qq{
+CREATE TABLE c (a int);
+COPY c FROM '$copyfile';
+});
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM c'),
+	'30000|450015000', 'COPY');
+
+# WAL is written with direct I/O too; crash and replay it
+$node->safe_psql('postgres', 'UPDATE t SET b = upper(b) WHERE a % 7 = 0');
+my $expected =
+  $node->safe_psql('postgres', 'SELECT count(*), sum(length(b)), max(b) FROM t');
+$node->stop('immediate');
+$node->start;
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), sum(length(b)), max(b) FROM t'),
+	$expected,
+	'contents after crash recovery');
+is($node->safe_psql('postgres', 'SELECT count(*) FROM c'),
+	'30000', 'COPY data after crash recovery');
@@ -0,0 +1,70 @@
+# Exercise buffer lookups without the buffer mapping lock, with many
+# backends hitting a few hot pages while others keep evicting and
+# reassigning buffers in a small buffer pool
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 5;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+autovacuum = off
+max_parallel_workers_per_gather = 0
+});
+$node->start;
+
+$node->command_ok([ 'pgbench', '-i', '-s', '2', '-q', 'postgres' ],
+	'pgbench tables initialized');
+
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE hot (a int PRIMARY KEY, b int);
+INSERT INTO hot SELECT g, g FROM generate_series(1, 100) g;
+CREATE TABLE results (n bigint, s bigint);
+});
+
+# Lookups of hot pages, which usually hit, next to scans that don't fit in
+# shared_buffers and keep giving buffers new tags.
+my $script = $node->basedir . '/lookup.sql';
+TestLib::append_to_file(
+	$script, q{
+\set x random(1, 100)
+SELECT b FROM hot WHERE a = :x;
+SELECT b FROM hot WHERE a = :x;
+INSERT INTO results SELECT count(*), sum(aid) FROM pgbench_accounts;
+});
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '8', '-j', '4', '-t', '100',
+		'-b', 'tpcb-like@4', '-f', "$script\@1", 'postgres'
+	],
+	'concurrent lookups, updates and scans');
+
+is( $node->safe_psql(
+		'postgres', q{
+SELECT (SELECT sum(abalance) FROM pgbench_accounts) =
+         (SELECT sum(delta) FROM pgbench_history),
+       (SELECT sum(bbalance) FROM pgbench_branches) =
+         (SELECT sum(delta) FROM pgbench_history),
+       (SELECT sum(tbalance) FROM pgbench_tellers) =
+         (SELECT sum(delta) FROM pgbench_history)}),
+	't|t|t',
+	'pgbench balances are consistent');
+
+is( $node->safe_psql(
+		'postgres',
+		'SELECT count(*) FROM results WHERE (n, s) <> (200000, 20000100000)'),
+	'0',
+	'every scan saw every row');
+
+is( $node->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SELECT count(*), sum(b) FROM hot WHERE a > 0'),
+	'100|5050',
+	'hot table intact');
@@ -0,0 +1,75 @@
+# Run a workload with each numa setting, and check what pg_stat_numa
+# reports.  On a machine with a single NUMA node, the placement code runs
+# but the view stays empty.
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 15;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 4MB
+autovacuum = off
+max_parallel_workers_per_gather = 0
+});
+$node->start;
+
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE big (a int, b text);
+INSERT INTO big SELECT g, repeat('x', 100) FROM generate_series(1, 100000) g;
+CREATE INDEX big_a ON big (a);
+});
+
+my $script = $node->basedir . '/numa.sql';
+TestLib::append_to_file(
+	$script, q{
+\set x random(1, 100000)
+SELECT b FROM big WHERE a = :x;
+UPDATE big SET b = b WHERE a = :x;
+});
+
+foreach my $mode ('off', 'interleave', 'partition')
+{
+	$node->append_conf('postgresql.conf', "numa = $mode");
+	$node->restart;
+
+	is($node->safe_psql('postgres', 'SHOW numa'), $mode, "numa = $mode");
+
+	# Many short-lived connections, each taking a PGPROC, reading buffers
+	# that are scattered over the pool, and evicting others
+	$node->command_ok(
+		[
+			'pgbench', '-n', '-C', '-c', '4', '-j', '4', '-t', '100',
+			'-f', $script, 'postgres'
+		],
+		"$mode: concurrent index lookups and updates");
+	is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM big'),
+		'100000|5000050000', "$mode: sequential scan sees every row");
+
+	my $nodes =
+	  $node->safe_psql('postgres', 'SELECT count(*) FROM pg_stat_numa');
+	if ($mode eq 'off' || $nodes == 0)
+	{
+		is($nodes, '0', "$mode: pg_stat_numa has no rows");
+		pass("$mode: nothing to count on a single node");
+		next;
+	}
+
+	cmp_ok($nodes, '>=', 2, "$mode: pg_stat_numa has a row per node");
+
+	# Backends report their counts in batches, and at exit.  With
+	# partitioning, every buffer belongs to exactly one node.
+	ok( $node->poll_query_until(
+			'postgres', q{
+SELECT sum(hits) > 0 AND sum(victims) > 0 AND
+       (current_setting('numa') <> 'partition' OR
+        sum(buffers) = (SELECT setting::bigint FROM pg_settings
+                        WHERE name = 'shared_buffers'))
+FROM pg_stat_numa}),
+		"$mode: pg_stat_numa counts buffer accesses");
+}
@@ -0,0 +1,199 @@
+# Exercise the shared relation size cache with more relations than it has
+# room for, while relations are extended, truncated and dropped, databases
+# are created and dropped, and a standby replays it all.  Then again with
+# the cache disabled.
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 15;
+
+my $primary = get_new_node('primary');
+$primary->init(allows_streaming => 1);
+$primary->append_conf(
+	'postgresql.conf', qq{
+smgr_shared_relations = 10
+shared_buffers = 1MB
+autovacuum = off
+max_parallel_workers_per_gather = 0
+});
+$primary->start;
+$primary->backup('backup');
+
+my $standby = get_new_node('standby');
+$standby->init_from_backup($primary, 'backup', has_streaming => 1);
+$standby->start;
+
+# 40 tables, each with a row in "expected" holding the number of rows it
+# should have.  check_sizes() scans every table and reports the ones that
+# disagree; a stale cached size would make a scan miss rows or fail.
+$primary->safe_psql(
+	'postgres', q{
+CREATE TABLE expected (i int PRIMARY KEY, n bigint);
+DO $$
+BEGIN
+  FOR i IN 1..40 LOOP
+    EXECUTE format('CREATE TABLE r%s (a int)', i);
+    EXECUTE format('INSERT INTO r%s SELECT generate_series(1, %s)', i, i * 500);
+    INSERT INTO expected VALUES (i, i * 500);
+  END LOOP;
+END $$;
+
+CREATE FUNCTION check_sizes() RETURNS text LANGUAGE plpgsql AS $$
+DECLARE
+  e record;
+  n bigint;
+  bad text := '';
+BEGIN
+  FOR e IN SELECT * FROM expected ORDER BY i LOOP
+    EXECUTE format('SELECT count(*) FROM r%s', e.i) INTO n;
+    IF n <> e.n THEN
+      bad := bad || format('r%s: %s rows, expected %s; ', e.i, n, e.n);
+    END IF;
+  END LOOP;
+  RETURN bad;
+END $$;
+
+CREATE FUNCTION bump(t int) RETURNS void LANGUAGE plpgsql AS $$
+BEGIN
+  EXECUTE format('INSERT INTO r%s SELECT generate_series(1, 300)', t);
+  UPDATE expected SET n = n + 300 WHERE i = t;
+END $$;
+
+CREATE FUNCTION trunc(t int) RETURNS void LANGUAGE plpgsql AS $$
+BEGIN
+  EXECUTE format('TRUNCATE r%s', t);
+  UPDATE expected SET n = 0 WHERE i = t;
+END $$;
+
+CREATE FUNCTION scan(t int) RETURNS bigint LANGUAGE plpgsql AS $$
+DECLARE
+  n bigint;
+BEGIN
+  EXECUTE format('SELECT count(*) FROM r%s', t) INTO n;
+  RETURN n;
+END $$;
+
+CREATE FUNCTION scratch(c int) RETURNS void LANGUAGE plpgsql AS $$
+BEGIN
+  EXECUTE format('DROP TABLE IF EXISTS scratch%s', c);
+  EXECUTE format('CREATE TABLE scratch%s AS SELECT generate_series(1, 1000) a', c);
+END $$;
+});
+
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes after creating more relations than the cache holds');
+
+# Truncate in all the ways there are, then extend again: TRUNCATE gives
+# the relation a new relfilenode, VACUUM cuts off the empty tail of the
+# existing one
+$primary->safe_psql(
+	'postgres', q{
+DO $$
+BEGIN
+  FOR t IN 1..40 LOOP
+    IF t % 2 = 0 THEN
+      PERFORM trunc(t);
+    END IF;
+    IF t % 3 = 0 THEN
+      EXECUTE format('DELETE FROM r%s WHERE a > 10', t);
+      UPDATE expected SET n = least(n, 10) WHERE i = t;
+    END IF;
+  END LOOP;
+END $$;
+});
+for my $t (grep { $_ % 3 == 0 } 1 .. 40)
+{
+	$primary->safe_psql('postgres', "VACUUM r$t");
+}
+is( $primary->safe_psql(
+		'postgres', q{
+SELECT count(*) FROM expected
+WHERE i % 3 = 0 AND n > 0 AND pg_relation_size('r' || i) > 8192}),
+	'0',
+	'VACUUM truncated the relations');
+$primary->safe_psql('postgres',
+	'SELECT bump(i) FROM expected WHERE i % 2 = 0 OR i % 3 = 0');
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes after truncation and extension');
+
+# Many backends at once, each extending or truncating random tables and
+# reading them back, so that entries keep being recycled
+my $script = $primary->basedir . '/size_cache.sql';
+TestLib::append_to_file(
+	$script, q{
+\set t random(1, 40)
+\set u random(1, 40)
+SELECT bump(:t);
+SELECT scan(:u);
+});
+my $truncate = $primary->basedir . '/size_cache_trunc.sql';
+TestLib::append_to_file(
+	$truncate, q{
+\set t random(1, 40)
+SELECT trunc(:t);
+SELECT scratch(:client_id);
+});
+
+sub run_pgbench
+{
+	my ($node, $name) = @_;
+
+	$node->command_ok(
+		[
+			'pgbench', '-n', '-c', '6', '-j', '3', '-t', '100',
+			'-f', "$script\@10", '-f', "$truncate\@1", 'postgres'
+		],
+		$name);
+	return;
+}
+
+run_pgbench($primary, 'concurrent extension and truncation');
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes after concurrent extension and truncation');
+
+# A new database has the same relfilenodes as its template, under another
+# database OID.  Drop it and make another, so that its OID gets reused.
+for my $round (1 .. 2)
+{
+	$primary->safe_psql('postgres', 'CREATE DATABASE copydb TEMPLATE postgres');
+	$primary->safe_psql('copydb', 'SELECT bump(i) FROM expected WHERE i <= 5');
+	$primary->safe_psql('copydb', 'SELECT trunc(7)');
+	is($primary->safe_psql('copydb', 'SELECT check_sizes()'),
+		'', "sizes in a copied database, round $round");
+	$primary->safe_psql('postgres', 'DROP DATABASE copydb');
+}
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes in the template database unchanged');
+
+# The standby replayed all of it, with its own cache
+$primary->safe_psql('postgres', 'SELECT bump(i) FROM expected');
+$primary->wait_for_catchup($standby, 'replay', $primary->lsn('insert'));
+is($standby->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes on the standby');
+is( $standby->safe_psql('postgres', 'SELECT sum(n) FROM expected'),
+	$primary->safe_psql('postgres', 'SELECT sum(n) FROM expected'),
+	'standby has the same rows as the primary');
+
+# Crash after more truncation and extension, and recover
+$primary->safe_psql('postgres', 'SELECT trunc(i) FROM expected WHERE i % 5 = 0');
+$primary->safe_psql('postgres', 'SELECT bump(i) FROM expected WHERE i % 4 = 0');
+$primary->stop('immediate');
+$primary->start;
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes after crash recovery');
+
+# And with the cache disabled
+$primary->append_conf('postgresql.conf', 'smgr_shared_relations = 0');
+$primary->restart;
+$standby->append_conf('postgresql.conf', 'smgr_shared_relations = 0');
+$standby->restart;
+is($primary->safe_psql('postgres', 'SHOW smgr_shared_relations'),
+	'0', 'cache disabled');
+run_pgbench($primary, 'concurrent extension and truncation without the cache');
+is($primary->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes without the cache');
+$primary->wait_for_catchup($standby, 'replay', $primary->lsn('insert'));
+is($standby->safe_psql('postgres', 'SELECT check_sizes()'),
+	'', 'sizes on the standby without the cache');
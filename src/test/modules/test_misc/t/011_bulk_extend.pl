@@ -0,0 +1,152 @@
+# Exercise extending relations by many blocks at once: bulk loads, with
+# and without concurrent loaders, hash index splitpoints and btree builds.
+# Check the contents after a crash, with data checksums enabled so that
+# pre-extended pages that never got written are read back too.
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 14;
+
+my $node = get_new_node('main');
+$node->init(extra => ['--data-checksums']);
+$node->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 4MB
+autovacuum = off
+max_parallel_maintenance_workers = 0
+});
+$node->start;
+
+# 200000 rows, or about 1000 heap blocks: enough for COPY to reach the
+# largest batch
+my $copyfile = $node->basedir . '/bulk.data';
+TestLib::append_to_file($copyfile,
+	join('', map { "$_\tpadding $_\n" } 1 .. 200000));
+
+$node->safe_psql(
+	'postgres', qq{
+CREATE TABLE bulk (a int, b text);
+COPY bulk FROM '$copyfile';
+CREATE TABLE bulk_ctas AS SELECT a, b, a % 1000 AS c FROM bulk;
+});
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), sum(a), sum(length(b)) FROM bulk'),
+	'200000|20000100000|2688895',
+	'COPY');
+is( $node->safe_psql(
+		'postgres', 'SELECT count(*), sum(a), sum(c) FROM bulk_ctas'),
+	'200000|20000100000|99900000',
+	'CREATE TABLE AS');
+
+# The last batch may leave pre-extended blocks unused at the end, for later
+# inserts to fill
+is( $node->safe_psql(
+		'postgres', q{
+SELECT pg_relation_size('bulk') % 8192,
+       pg_relation_size('bulk') >= 8192 * (SELECT count(DISTINCT (ctid::text::point)[0]) FROM bulk)}),
+	'0|t',
+	'heap size is a whole number of blocks covering all rows');
+
+# Index builds: btree pages are written out of order, leaving gaps to be
+# zero-filled, and a hash index allocates whole splitpoints
+$node->safe_psql(
+	'postgres', q{
+CREATE INDEX bulk_a ON bulk (a);
+CREATE INDEX bulk_b ON bulk (b);
+CREATE INDEX bulk_hash ON bulk USING hash (a);
+CREATE INDEX bulk_ctas_c_hash ON bulk_ctas USING hash (c);
+});
+is( $node->safe_psql(
+		'postgres', q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM bulk WHERE a BETWEEN 1000 AND 1999;
+SELECT count(*) FROM bulk WHERE b > 'padding 9';
+}),
+	"1000\n"
+	  . $node->safe_psql(
+		'postgres', q{
+SET enable_indexscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM bulk WHERE b > 'padding 9';
+}),
+	'btree indexes');
+is( $node->safe_psql(
+		'postgres', q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM bulk WHERE a = 123456;
+SELECT count(*) FROM bulk_ctas WHERE c = 7;
+}),
+	"1\n200",
+	'hash indexes');
+
+# The hash index keeps growing by splitpoints as rows are added
+$node->safe_psql('postgres',
+	'INSERT INTO bulk SELECT g, \'more\' FROM generate_series(200001, 300000) g'
+);
+is( $node->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SET enable_bitmapscan = off; SELECT count(*) FROM bulk WHERE a = 250000'
+	),
+	'1',
+	'hash index after splits');
+
+# Concurrent loaders compete for the extension lock, and take extra blocks
+# on behalf of each other
+my $copyscript = $node->basedir . '/copy.sql';
+TestLib::append_to_file($copyscript, "COPY bulk FROM '$copyfile';\n");
+my $insertscript = $node->basedir . '/insert.sql';
+TestLib::append_to_file($insertscript,
+	"INSERT INTO bulk_ctas VALUES (-1, repeat('x', 500), -1);\n");
+
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '1', '-f', $copyscript,
+		'postgres'
+	],
+	'concurrent COPY');
+$node->command_ok(
+	[
+		'pgbench', '-n', '-c', '8', '-j', '4', '-t', '500',
+		'-f', $insertscript, 'postgres'
+	],
+	'concurrent single-row inserts');
+
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM bulk'),
+	'1100000|' . (5 * 20000100000 + 25000050000),
+	'contents after concurrent COPY');
+is($node->safe_psql('postgres', 'SELECT count(*) FROM bulk_ctas WHERE a = -1'),
+	'4000', 'contents after concurrent inserts');
+
+# Crash.  The pre-extended blocks nobody wrote to are all zeroes on disk,
+# and have no valid checksum; scans and VACUUM must take them as new.
+$node->safe_psql(
+	'postgres', qq{
+CREATE TABLE after_checkpoint (a int);
+CHECKPOINT;
+COPY bulk FROM '$copyfile';
+INSERT INTO after_checkpoint SELECT generate_series(1, 100000);
+});
+$node->stop('immediate');
+$node->start;
+
+is($node->safe_psql('postgres', 'SELECT count(*), sum(a) FROM bulk'),
+	'1300000|' . (6 * 20000100000 + 25000050000),
+	'contents after crash recovery');
+is($node->safe_psql('postgres', 'SELECT count(*) FROM after_checkpoint'),
+	'100000', 'table filled after the checkpoint');
+$node->safe_psql('postgres', 'VACUUM bulk, bulk_ctas, after_checkpoint');
+is( $node->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SET enable_bitmapscan = off; SELECT count(*) FROM bulk WHERE a = 250000'
+	),
+	'1',
+	'indexes after crash recovery and VACUUM');
+is( $node->safe_psql(
+		'postgres',
+		'SELECT sum(checksum_failures) FROM pg_stat_database'),
+	'0',
+	'no checksum failures');
@@ -0,0 +1,69 @@
+# Check that the LLVM provider reuses cached code for repeated queries, and
+# that the cache is dropped after DDL
+
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+my $node = get_new_node('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq{
+jit = on
+jit_above_cost = 0
+jit_cache_size = 64
+max_parallel_workers_per_gather = 0
+});
+$node->start;
+
+if ($node->safe_psql('postgres', 'SELECT pg_jit_available()') ne 't')
+{
+	plan skip_all => 'JIT is not available';
+}
+else
+{
+	plan tests => 6;
+}
+
+# Returns the number of functions EXPLAIN reports as found in the cache
+$node->safe_psql(
+	'postgres', q{
+CREATE TABLE t (a int, b int);
+INSERT INTO t SELECT g, g % 100 FROM generate_series(1, 10000) g;
+ANALYZE t;
+CREATE FUNCTION cached_functions(query text) RETURNS int
+LANGUAGE plpgsql AS $$
+DECLARE
+  plan json;
+BEGIN
+  EXECUTE 'EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, FORMAT JSON) ' || query
+    INTO plan;
+  RETURN (plan->0->'JIT'->>'Cached Functions')::int;
+END
+$$;
+});
+
+my $query =
+  q{'SELECT sum(a + b), count(*) FROM t WHERE a % 7 = 3 AND b < 50'};
+
+# All in one session, as the cache is per backend
+my @counts = split /\n/, $node->safe_psql(
+	'postgres', qq{
+SELECT cached_functions($query);
+SELECT cached_functions($query);
+CREATE FUNCTION f() RETURNS int LANGUAGE sql AS 'SELECT 1';
+SELECT cached_functions($query);
+SELECT cached_functions($query);
+SET jit_cache_size = 0;
+SELECT cached_functions($query);
+SELECT cached_functions($query);
+});
+
+is($counts[0], '0', 'first execution compiles all functions');
+cmp_ok($counts[1], '>', 0, 'second execution reuses cached functions');
+is($counts[2], '0', 'cache is dropped after a pg_proc change');
+cmp_ok($counts[3], '>', 0, 'cache is filled again after the change');
+is($counts[4], '0', 'no cached functions with jit_cache_size = 0');
+is($counts[5], '0', 'nothing is cached with jit_cache_size = 0');
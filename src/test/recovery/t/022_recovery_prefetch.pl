@@ -0,0 +1,144 @@
+# Checks replay with recovery_prefetch = on, on a standby with a buffer
+# pool too small to hold the data and during crash recovery, including
+# WAL that creates, truncates and drops relations before they are replayed
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 11;
+
+# Initialize primary node
+my $node_primary = get_new_node('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq{
+recovery_prefetch = on
+checkpoint_timeout = 1h
+max_wal_size = 1GB
+autovacuum = off
+});
+$node_primary->start;
+
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE t (a int PRIMARY KEY, b int, c text);
+INSERT INTO t SELECT g, 0, repeat('c', 100) FROM generate_series(1, 100000) g;
+});
+
+# Take backup
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+# Create streaming standby from backup
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', qq{
+shared_buffers = 1MB
+maintenance_io_concurrency = 16
+});
+$node_standby->start;
+
+is($node_standby->safe_psql('postgres', 'SHOW recovery_prefetch'),
+	'on', 'prefetching is enabled on the standby');
+
+# Let WAL pile up while replay is paused, so that the prefetcher has
+# plenty to look ahead into when it resumes
+$node_standby->safe_psql('postgres', 'SELECT pg_wal_replay_pause()');
+$node_standby->poll_query_until('postgres', 'SELECT pg_is_wal_replay_paused()')
+  or die "Timed out while waiting for replay to pause";
+$node_standby->safe_psql('postgres',
+	"SELECT pg_stat_reset_shared('recovery_prefetch')");
+
+# Random updates all over the table, most of them to pages that already
+# have a full page image since the last checkpoint
+my $update = $node_primary->basedir . '/update.sql';
+TestLib::append_to_file(
+	$update, q{
+\set x random(1, 100000)
+UPDATE t SET b = b + 1 WHERE a = :x;
+});
+$node_primary->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '1000',
+		'-f', $update, 'postgres'
+	],
+	'random updates on the primary');
+
+# Relations that are created, extended, truncated and dropped in WAL the
+# standby hasn't replayed yet, so that the prefetcher finds them missing
+# or too short
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE gone (a int);
+INSERT INTO gone SELECT generate_series(1, 10000);
+DROP TABLE gone;
+CREATE TABLE shrinks (a int);
+INSERT INTO shrinks SELECT generate_series(1, 10000);
+TRUNCATE shrinks;
+INSERT INTO shrinks SELECT generate_series(1, 5000);
+DELETE FROM t WHERE a % 10 = 0;
+VACUUM t;
+});
+
+$node_standby->safe_psql('postgres', 'SELECT pg_wal_replay_resume()');
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+
+my $query = 'SELECT count(*), sum(a), sum(b) FROM t';
+my $expected = $node_primary->safe_psql('postgres', $query);
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby has the same table contents');
+is( $node_standby->safe_psql(
+		'postgres',
+		'SET enable_seqscan = off; SELECT count(*), sum(b) FROM t WHERE a > 0'),
+	$node_primary->safe_psql(
+		'postgres', 'SELECT count(*), sum(b) FROM t WHERE a > 0'),
+	'standby index matches');
+is($node_standby->safe_psql('postgres', 'SELECT count(*) FROM shrinks'),
+	'5000', 'truncated table replayed');
+is( $node_standby->safe_psql(
+		'postgres', q{
+SELECT prefetch > 0, skip_fpw > 0, skip_new > 0
+FROM pg_stat_recovery_prefetch}),
+	't|t|t',
+	'blocks were prefetched, and others skipped');
+
+# The distance and depth go back to zero once replay has caught up
+ok( $node_standby->poll_query_until(
+		'postgres',
+		'SELECT wal_distance = 0 AND io_depth = 0 FROM pg_stat_recovery_prefetch'
+	),
+	'prefetcher idle after catching up');
+
+# Crash recovery on the primary, with more of the same to replay
+$node_primary->safe_psql('postgres', 'CHECKPOINT');
+$node_primary->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '500',
+		'-f', $update, 'postgres'
+	],
+	'more random updates on the primary');
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE gone2 (a int);
+INSERT INTO gone2 SELECT generate_series(1, 10000);
+DROP TABLE gone2;
+TRUNCATE shrinks;
+INSERT INTO shrinks SELECT generate_series(1, 100);
+});
+$expected = $node_primary->safe_psql('postgres', $query);
+$node_primary->stop('immediate');
+$node_primary->start;
+is($node_primary->safe_psql('postgres', $query),
+	$expected, 'table contents after crash recovery');
+is($node_primary->safe_psql('postgres', 'SELECT count(*) FROM shrinks'),
+	'100', 'truncated table after crash recovery');
+
+# The standby gets the same WAL
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby has the same table contents after more replay');
@@ -0,0 +1,164 @@
+# Checks replay with recovery_parallel_workers set, both on a standby and
+# during crash recovery, with a mix of records the workers replay and
+# records the startup process has to replay itself
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 12;
+
+# Initialize primary node
+my $node_primary = get_new_node('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq{
+recovery_parallel_workers = 2
+checkpoint_timeout = 1h
+max_wal_size = 1GB
+autovacuum = off
+});
+$node_primary->start;
+
+$node_primary->command_ok([ 'pgbench', '-i', '-s', '2', '-q', 'postgres' ],
+	'pgbench tables initialized');
+
+# Take backup
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+# Create streaming standby from backup
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+like(
+	slurp_file($node_standby->logfile),
+	qr/started 2 parallel redo workers/,
+	'standby replays with parallel workers');
+
+# A table whose btree index gets posting lists and deduplication, plus
+# row locks, which the workers replay, next to DDL, VACUUM and
+# multi-block records, which the startup process replays after draining
+# the workers
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE dups (k int, v int);
+CREATE INDEX dups_k ON dups (k);
+CREATE INDEX dups_v ON dups (v);
+INSERT INTO dups SELECT g % 10, g FROM generate_series(1, 50000) g;
+
+CREATE FUNCTION scratch(c int) RETURNS void LANGUAGE plpgsql AS $$
+BEGIN
+  EXECUTE format('DROP TABLE IF EXISTS scratch%s', c);
+  EXECUTE format('CREATE TABLE scratch%s AS SELECT generate_series(1, 1000) a', c);
+  EXECUTE format('CREATE INDEX ON scratch%s (a)', c);
+END $$;
+});
+
+my $script = $node_primary->basedir . '/parallel_redo.sql';
+TestLib::append_to_file(
+	$script, q{
+\set x random(1, 50000)
+BEGIN;
+SELECT v FROM dups WHERE v = :x FOR UPDATE;
+UPDATE dups SET k = k + 1 WHERE v = :x;
+INSERT INTO dups VALUES (:x % 10, :x);
+DELETE FROM dups WHERE v = :x + 1;
+COMMIT;
+});
+my $ddl = $node_primary->basedir . '/ddl.sql';
+TestLib::append_to_file(
+	$ddl, q{
+SELECT scratch(:client_id);
+VACUUM pgbench_accounts;
+});
+
+$node_primary->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '300',
+		'-b', 'tpcb-like@10', '-f', "$script\@10", '-f', "$ddl\@1",
+		'postgres'
+	],
+	'concurrent workload on the primary');
+my $copyfile = $node_primary->basedir . '/dups.data';
+TestLib::append_to_file($copyfile,
+	join('', map { ($_ % 10) . "\t$_\n" } 1 .. 5000));
+$node_primary->safe_psql(
+	'postgres', qq{
+COPY dups FROM '$copyfile';
+ALTER TABLE dups ADD COLUMN w int DEFAULT 0;
+UPDATE dups SET w = v % 3 WHERE k = 3;
+TRUNCATE pgbench_history;
+INSERT INTO pgbench_history (tid, bid, aid, delta)
+  SELECT 1, 1, g, g FROM generate_series(1, 1000) g;
+});
+
+my $query = q{
+SELECT (SELECT sum(abalance) FROM pgbench_accounts),
+       (SELECT sum(bbalance) FROM pgbench_branches),
+       (SELECT sum(tbalance) FROM pgbench_tellers),
+       (SELECT count(*) || '/' || sum(delta) FROM pgbench_history),
+       (SELECT count(*) || '/' || sum(k) || '/' || sum(v) || '/' || sum(w)
+        FROM dups)};
+my $index_query = q{
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*), sum(v) FROM dups WHERE k = 3;
+SELECT count(*), sum(abalance) FROM pgbench_accounts WHERE aid > 0;
+};
+
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+my $expected = $node_primary->safe_psql('postgres', $query);
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby has the same table contents');
+is( $node_standby->safe_psql('postgres', $index_query),
+	$node_primary->safe_psql('postgres', $index_query),
+	'standby indexes match');
+
+# Crash the standby and let it replay from its last restartpoint
+$node_standby->stop('immediate');
+$node_primary->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '100',
+		'-b', 'tpcb-like', '-f', $script, 'postgres'
+	],
+	'more workload while the standby is down');
+$node_standby->start;
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+$expected = $node_primary->safe_psql('postgres', $query);
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby has the same table contents after a crash');
+
+# Crash recovery on the primary, everything since the backup's checkpoint
+$node_primary->command_ok(
+	[
+		'pgbench', '-n', '-c', '4', '-j', '4', '-t', '100',
+		'-b', 'tpcb-like', '-f', $script, '-f', $ddl, 'postgres'
+	],
+	'workload before crashing the primary');
+$expected = $node_primary->safe_psql('postgres', $query);
+my $expected_index = $node_primary->safe_psql('postgres', $index_query);
+$node_primary->stop('immediate');
+my $log_offset = -s $node_primary->logfile;
+$node_primary->start;
+
+like(
+	substr(slurp_file($node_primary->logfile), $log_offset),
+	qr/started 2 parallel redo workers/,
+	'crash recovery with parallel workers');
+is($node_primary->safe_psql('postgres', $query),
+	$expected, 'table contents after crash recovery');
+is($node_primary->safe_psql('postgres', $index_query),
+	$expected_index, 'indexes after crash recovery');
+
+# The standby still follows
+$node_primary->safe_psql('postgres', 'UPDATE dups SET w = w + 1 WHERE k = 5');
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+$expected = $node_primary->safe_psql('postgres', $query);
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby follows the recovered primary');
@@ -0,0 +1,95 @@
+# Checks WAL insertion with different numbers of insertion locks, by many
+# concurrent inserters along with WAL switches and checkpoints, by
+# recovering from a crash and by streaming the WAL to a standby
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 21;
+
+# Initialize primary node
+my $node_primary = get_new_node('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf('postgresql.conf', 'autovacuum = off');
+$node_primary->start;
+
+$node_primary->command_ok([ 'pgbench', '-i', '-s', '1', '-q', 'postgres' ],
+	'pgbench tables initialized');
+$node_primary->safe_psql('postgres', 'CREATE TABLE big (t text)');
+
+# Take backup
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+# Create streaming standby from backup
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+# Records of all sizes: small ones from pgbench's transactions, ones that
+# span WAL pages from large, poorly compressible rows, and WAL switches
+# and checkpoints, which hold all the insertion locks at once
+my $big = $node_primary->basedir . '/big.sql';
+TestLib::append_to_file(
+	$big, q{
+INSERT INTO big
+  SELECT string_agg(md5(g::text || random()::text), '')
+  FROM generate_series(1, 300) g;
+});
+my $switch = $node_primary->basedir . '/switch.sql';
+TestLib::append_to_file(
+	$switch, q{
+SELECT pg_switch_wal();
+CHECKPOINT;
+});
+
+my $query = q{
+SELECT (SELECT sum(abalance) FROM pgbench_accounts) =
+         (SELECT sum(delta) FROM pgbench_history),
+       (SELECT sum(bbalance) FROM pgbench_branches) =
+         (SELECT sum(delta) FROM pgbench_history),
+       (SELECT count(*) FROM pgbench_history),
+       (SELECT count(*) || '/' || sum(length(t)) FROM big)};
+
+foreach my $locks (1, 2, 128, -1)
+{
+	$node_primary->append_conf('postgresql.conf',
+		"wal_insert_locks = $locks");
+	$node_primary->restart;
+
+	my $setting = $node_primary->safe_psql('postgres', 'SHOW wal_insert_locks');
+	if ($locks == -1)
+	{
+		like($setting, qr/^(8|16|32|64)$/,
+			'wal_insert_locks chosen automatically');
+	}
+	else
+	{
+		is($setting, $locks, "wal_insert_locks = $locks");
+	}
+
+	$node_primary->command_ok(
+		[
+			'pgbench', '-n', '-c', '16', '-j', '4', '-t', '200',
+			'-b', 'tpcb-like@20', '-f', "$big\@4", '-f', "$switch\@1",
+			'postgres'
+		],
+		"$setting locks: concurrent inserters");
+
+	my $expected = $node_primary->safe_psql('postgres', $query);
+	like($expected, qr/^t\|t\|/,
+		"$setting locks: pgbench balances are consistent");
+
+	# Crash, and replay everything since the last checkpoint
+	$node_primary->stop('immediate');
+	$node_primary->start;
+	is($node_primary->safe_psql('postgres', $query),
+		$expected, "$setting locks: contents after crash recovery");
+
+	$node_primary->wait_for_catchup($node_standby, 'replay',
+		$node_primary->lsn('insert'));
+	is($node_standby->safe_psql('postgres', $query),
+		$expected, "$setting locks: standby has the same contents");
+}
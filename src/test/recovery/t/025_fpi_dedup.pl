@@ -0,0 +1,100 @@
+# Checks replay of full-page images that wal_fpi_dedup logged as references
+# to an earlier image of the same page, on a standby and in crash recovery
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 8;
+
+# Initialize primary node
+my $node_primary = get_new_node('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq{
+wal_fpi_dedup = on
+checkpoint_timeout = 1h
+max_wal_size = 1GB
+autovacuum = off
+});
+$node_primary->start;
+
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE EXTENSION test_fpi_dedup;
+CREATE TABLE t (a int PRIMARY KEY, b int);
+INSERT INTO t SELECT g, 0 FROM generate_series(1, 2000) g;
+});
+
+# Take backup
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+# Create streaming standby from backup
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+my $start_lsn =
+  $node_primary->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+
+# Images of the same heap and index pages, logged several times in a row,
+# then again after the pages have changed, over several checkpoint cycles.
+# Each cycle's first image of a page has to be logged in full.
+my $round = q{
+SELECT test_log_newpage('t', b, 3) FROM generate_series(0, 3) b;
+SELECT test_log_newpage('t_pkey', 1, 3);
+UPDATE t SET b = b + 1 WHERE a <= 100;
+SELECT test_log_newpage('t', 0, 2);
+SELECT test_log_newpage('t_pkey', 1, 2);
+};
+for my $i (1 .. 3)
+{
+	$node_primary->safe_psql('postgres', $round);
+	$node_primary->safe_psql('postgres', 'CHECKPOINT');
+}
+$node_primary->safe_psql('postgres', $round);
+
+my $end_lsn =
+  $node_primary->safe_psql('postgres', 'SELECT pg_current_wal_insert_lsn()');
+
+# pg_waldump shows which images are references
+my ($stdout, $stderr) = run_command(
+	[
+		'pg_waldump', '-p', $node_primary->data_dir . '/pg_wal',
+		'-s', $start_lsn, '-e', $end_lsn
+	]);
+my $refs = () = $stdout =~ /FPW ref/g;
+my $images = () = $stdout =~ / FPW(?! ref|_)/g;
+cmp_ok($refs, '>=', 4 * 11, 'images were logged as references');
+cmp_ok($images, '>=', 4 * 6, 'first images of each cycle were logged in full');
+
+my $query = 'SELECT count(*), sum(a), sum(b) FROM t';
+my $index_query =
+  'SET enable_seqscan = off; SELECT count(*), sum(b) FROM t WHERE a > 0';
+my $expected       = $node_primary->safe_psql('postgres', $query);
+my $expected_index = $node_primary->safe_psql('postgres', $index_query);
+is($expected, '2000|2001000|400', 'contents on the primary');
+
+$node_primary->wait_for_catchup($node_standby, 'replay', $end_lsn);
+is($node_standby->safe_psql('postgres', $query),
+	$expected, 'standby replayed the references');
+is($node_standby->safe_psql('postgres', $index_query),
+	$expected_index, 'standby index matches');
+
+# The last round is after the last checkpoint, so crash recovery replays it
+$node_primary->stop('immediate');
+$node_primary->start;
+is($node_primary->safe_psql('postgres', $query),
+	$expected, 'contents after crash recovery');
+is($node_primary->safe_psql('postgres', $index_query),
+	$expected_index, 'index after crash recovery');
+
+# And the standby follows on
+$node_primary->safe_psql('postgres', $round);
+$node_primary->wait_for_catchup($node_standby, 'replay',
+	$node_primary->lsn('insert'));
+is( $node_standby->safe_psql('postgres', $query),
+	$node_primary->safe_psql('postgres', $query),
+	'standby follows the recovered primary');
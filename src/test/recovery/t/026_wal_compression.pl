@@ -0,0 +1,87 @@
+# Checks replay of full-page images compressed with each of the methods of
+# wal_compression that the server was built with, by recovering from a
+# crash and by streaming the WAL to a standby
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 12;
+
+# Initialize primary node
+my $node_primary = get_new_node('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf(
+	'postgresql.conf', qq{
+checkpoint_timeout = 1h
+max_wal_size = 1GB
+autovacuum = off
+});
+$node_primary->start;
+
+# Compressible rows, on a few hundred pages
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE t (a int PRIMARY KEY, b int, c text);
+INSERT INTO t SELECT g, 0, repeat(md5(g::text), 4) FROM generate_series(1, 20000) g;
+});
+
+# Take backup
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+# Create streaming standby from backup
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+my $query = 'SELECT count(*), sum(b), sum(length(c)) FROM t';
+
+my %supported = (
+	pglz => 1,
+	lz4  => check_pg_config("#define USE_LZ4 1"),
+	zstd => check_pg_config("#define USE_ZSTD 1"));
+
+foreach my $method ('pglz', 'lz4', 'zstd')
+{
+  SKIP:
+	{
+		skip "$method not supported by this build", 4
+		  unless $supported{$method};
+
+		$node_primary->append_conf('postgresql.conf',
+			"wal_compression = $method");
+		$node_primary->restart;
+		is($node_primary->safe_psql('postgres', 'SHOW wal_compression'),
+			$method, "wal_compression = $method");
+
+		# The first change to each page after a checkpoint logs its image
+		$node_primary->safe_psql('postgres', 'CHECKPOINT');
+		my $start_lsn = $node_primary->lsn('insert');
+		$node_primary->safe_psql('postgres', 'UPDATE t SET b = b + 1');
+		my $end_lsn = $node_primary->lsn('insert');
+
+		my ($stdout, $stderr) = run_command(
+			[
+				'pg_waldump', '-b', '-p',
+				$node_primary->data_dir . '/pg_wal', '-s',
+				$start_lsn, '-e', $end_lsn
+			]);
+		my $images = () = $stdout =~ /method: $method$/mg;
+		cmp_ok($images, '>', 100, "$method: images were compressed");
+
+		my $expected = $node_primary->safe_psql('postgres', $query);
+
+		# Crash, and replay everything since the checkpoint
+		$node_primary->stop('immediate');
+		$node_primary->start;
+		is($node_primary->safe_psql('postgres', $query),
+			$expected, "$method: contents after crash recovery");
+
+		$node_primary->wait_for_catchup($node_standby, 'replay',
+			$node_primary->lsn('insert'));
+		is($node_standby->safe_psql('postgres', $query),
+			$expected, "$method: standby has the same contents");
+	}
+}
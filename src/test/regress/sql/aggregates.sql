@@ -1224,3 +1224,22 @@ drop table agg_hash_1;
 drop table agg_hash_2;
 drop table agg_hash_3;
 drop table agg_hash_4;
+
+--
+-- Batch execution of plain aggregates over sequential scans
+--
+set executor_batch_size = 64;
+create temp table batch_agg_t as
+  select case when g % 3 = 0 then null else g end as x, g::float8 as f,
+         g::int8 as b
+  from generate_series(1, 1000) g;
+insert into batch_agg_t values (null, 'NaN', null);
+select count(*), count(x), sum(x), min(x), max(x), avg(b) from batch_agg_t;
+select count(*), count(x), sum(x), min(x), max(f) from batch_agg_t
+  where f >= 500 and 1000 >= x;
+select count(*), sum(b) from batch_agg_t where x < 10::int8 and b <> 4;
+select count(*) from batch_agg_t where f > 999;
+select count(*), max(b) from batch_agg_t where x is null and b > 990;
+select min(b), max(b) from batch_agg_t where f <> 'NaN' and b % 7 = 0;
+select min(x), max(x), sum(x) from batch_agg_t where x is null;
+reset executor_batch_size;
@@ -454,6 +454,43 @@ test1
 SELECT * FROM instead_of_insert_tbl;
 COMMIT;
 
+-- parallel COPY FROM
+CREATE TABLE parallel_copy (a int, b text);
+COPY parallel_copy FROM stdin WITH (PARALLEL 2);
+1	one
+2	two
+\.
+COPY parallel_copy FROM stdin WITH (FORMAT csv, HEADER, PARALLEL 2);
+a,b
+3,"three, too"
+4,four
+\.
+SELECT * FROM parallel_copy ORDER BY a;
+COPY parallel_copy FROM stdin WITH (FORMAT binary, PARALLEL 2);
+COPY parallel_copy TO stdout WITH (PARALLEL 2);
+-- input of more than one 256kB chunk, through a file in the data directory
+SELECT current_setting('data_directory') || '/parallel_copy.data' AS filename \gset
+TRUNCATE parallel_copy;
+COPY (SELECT g, repeat('z', 50) FROM generate_series(1, 10000) g) TO :'filename';
+COPY parallel_copy FROM :'filename' WITH (PARALLEL 2);
+SELECT count(*), sum(a), sum(length(b)) FROM parallel_copy;
+-- 100-byte records, so that the embedded newline of record 2622 falls on
+-- the end of the first chunk
+TRUNCATE parallel_copy;
+COPY (SELECT lpad(g::text, 6, '0'), repeat('x', 36) || E'\n' || repeat('y', 53)
+      FROM generate_series(1, 5000) g) TO :'filename' WITH (FORMAT csv);
+COPY parallel_copy FROM :'filename' WITH (FORMAT csv, PARALLEL 2);
+SELECT count(*), sum(a),
+       count(*) FILTER (WHERE b = repeat('x', 36) || E'\n' || repeat('y', 53))
+FROM parallel_copy;
+-- the line number of an error is counted from the start of the input
+COPY (SELECT CASE WHEN g = 9900 THEN 'oops' ELSE g::text END, repeat('z', 50)
+      FROM generate_series(1, 10000) g) TO :'filename';
+COPY parallel_copy FROM :'filename' WITH (PARALLEL 2);
+-- don't leave the data behind in the data directory
+COPY (SELECT 1 WHERE false) TO :'filename';
+DROP TABLE parallel_copy;
+
 -- clean up
 DROP TABLE forcetest;
 DROP TABLE vistest;
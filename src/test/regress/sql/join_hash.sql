@@ -538,3 +538,14 @@ WHERE
     AND hjtest_1.a <> hjtest_2.b;
 
 ROLLBACK;
+
+-- Runtime join filter: the outer scan discards the rows that can't have a
+-- match.  (The first outer row is fetched before the hash table is built.)
+BEGIN;
+SET LOCAL enable_nestloop = off;
+SET LOCAL enable_mergejoin = off;
+SET LOCAL max_parallel_workers_per_gather = 0;
+EXPLAIN (ANALYZE, COSTS OFF, TIMING OFF, SUMMARY OFF)
+SELECT count(*) FROM tenk1 t JOIN int4_tbl i ON t.fivethous = i.f1;
+SELECT count(*) FROM tenk1 t JOIN int4_tbl i ON t.fivethous = i.f1;
+ROLLBACK;